@@ -8,6 +8,7 @@ class P1MeterBase : public CDomoticzHardwareBase
 	friend class P1MeterSerial;
 	friend class P1MeterTCP;
 	friend class CRFXBase;
+	friend class CIngestBenchmark;
 
 	struct _tAvrKwh
 	{
@@ -2,6 +2,7 @@
 #include "HTTPClient.h"
 #include <curl/curl.h>
 #include "../main/Logger.h"
+#include "../main/Helper.h"
 
 #include <algorithm>
 #include <iostream>
@@ -11,8 +12,63 @@
 	#define O_LARGEFILE 0
 #endif
 
+#define HTTP_MAX_IDLE_HANDLES 16
+#define HTTP_ASYNC_WAIT_MS 100
+#define HTTP_ASYNC_MAX_REQUESTS 256
+
 extern std::string szUserDataFolder;
 
+namespace
+{
+	// Idle easy handles, keyed by scheme://host:port. A reused handle keeps its open connections
+	std::mutex g_handlePoolMutex;
+	std::map<std::string, std::vector<CURL *>> g_idleHandles;
+	size_t g_idleHandleCount = 0;
+
+	// DNS cache, TLS sessions (and connections when supported) shared by all handles
+	// Cookies are not shared, a new session of one caller would drop the session cookies of all others
+	CURLSH *g_curlShare = nullptr;
+	std::mutex g_shareMutex[CURL_LOCK_DATA_LAST];
+
+	void curl_share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+	{
+		g_shareMutex[data].lock();
+	}
+
+	void curl_share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+	{
+		g_shareMutex[data].unlock();
+	}
+
+	std::string GetHostKey(const std::string &url)
+	{
+		size_t pos = url.find("://");
+		pos = (pos == std::string::npos) ? 0 : pos + 3;
+		return url.substr(0, url.find_first_of("/?#", pos));
+	}
+
+	struct _tAsyncRequest
+	{
+		CURL *curl = nullptr;
+		std::string url;
+		std::string postdata;
+		struct curl_slist *headers = nullptr;
+		std::vector<unsigned char> response;
+		std::vector<std::string> vHeaderData;
+		HTTPClient::AsyncCallback callback;
+	};
+
+	std::mutex g_asyncMutex;
+	std::condition_variable g_asyncCondition;
+	std::vector<std::unique_ptr<_tAsyncRequest>> g_asyncPending;
+	size_t g_asyncRequests = 0; // pending + busy, an unreachable endpoint should not let this grow without limit
+	uint64_t g_asyncDropped = 0;
+	bool g_bAsyncFull = false; // only log the first dropped request until there is room again
+	std::shared_ptr<std::thread> g_asyncThread;
+	bool g_bAsyncStop = false;
+	CURLM *g_curlMulti = nullptr;
+} // namespace
+
 bool		HTTPClient::m_bCurlGlobalInitialized = false;
 bool		HTTPClient::m_bVerifyHost = false;
 bool		HTTPClient::m_bVerifyPeer = false;
@@ -81,6 +137,18 @@ bool HTTPClient::CheckIfGlobalInitDone()
 		CURLcode res = curl_global_init(CURL_GLOBAL_ALL);
 		if (res != CURLE_OK)
 			return false;
+
+		g_curlShare = curl_share_init();
+		if (g_curlShare)
+		{
+			curl_share_setopt(g_curlShare, CURLSHOPT_LOCKFUNC, curl_share_lock);
+			curl_share_setopt(g_curlShare, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+			curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+			curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+			curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+		}
 		m_bCurlGlobalInitialized = true;
 	}
 	return true;
@@ -90,10 +158,72 @@ void HTTPClient::Cleanup()
 {
 	if (m_bCurlGlobalInitialized)
 	{
+		if (g_asyncThread)
+		{
+			{
+				std::lock_guard<std::mutex> l(g_asyncMutex);
+				g_bAsyncStop = true;
+			}
+			g_asyncCondition.notify_one();
+			g_asyncThread->join();
+			g_asyncThread.reset();
+		}
+		{
+			std::lock_guard<std::mutex> l(g_handlePoolMutex);
+			for (auto &itt : g_idleHandles)
+			{
+				for (auto curl : itt.second)
+					curl_easy_cleanup(curl);
+			}
+			g_idleHandles.clear();
+			g_idleHandleCount = 0;
+		}
+		if (g_curlShare)
+		{
+			curl_share_cleanup(g_curlShare);
+			g_curlShare = nullptr;
+		}
 		curl_global_cleanup();
 	}
 }
 
+void *HTTPClient::AcquireHandle(const std::string &url)
+{
+	CURL *curl = nullptr;
+	{
+		std::lock_guard<std::mutex> l(g_handlePoolMutex);
+		auto itt = g_idleHandles.find(GetHostKey(url));
+		if ((itt != g_idleHandles.end()) && (!itt->second.empty()))
+		{
+			curl = itt->second.back();
+			itt->second.pop_back();
+			g_idleHandleCount--;
+		}
+	}
+	if (curl == nullptr)
+		return curl_easy_init();
+	//forget the options of the previous request, connections and caches are kept
+	curl_easy_reset(curl);
+	return curl;
+}
+
+void HTTPClient::ReleaseHandle(void *curlobj, const std::string &url)
+{
+	CURL *curl = (CURL *)curlobj;
+	//cookies are only written to the jar on cleanup, and pooled handles live long
+	curl_easy_setopt(curl, CURLOPT_COOKIELIST, "FLUSH");
+	{
+		std::lock_guard<std::mutex> l(g_handlePoolMutex);
+		if (g_idleHandleCount < HTTP_MAX_IDLE_HANDLES)
+		{
+			g_idleHandles[GetHostKey(url)].push_back(curl);
+			g_idleHandleCount++;
+			return;
+		}
+	}
+	curl_easy_cleanup(curl);
+}
+
 void HTTPClient::SetGlobalOptions(void *curlobj)
 {
 	CURL *curl=(CURL *)curlobj;
@@ -108,6 +238,9 @@ void HTTPClient::SetGlobalOptions(void *curlobj)
 	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, m_bVerifyPeer ? 1L : 0);
 	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, m_bVerifyHost ? 2L : 0); //allow self signed certificates
 	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	if (g_curlShare)
+		curl_easy_setopt(curl, CURLOPT_SHARE, g_curlShare);
 	std::string domocookie = szUserDataFolder + "domocookie.txt";
 	curl_easy_setopt(curl, CURLOPT_COOKIEFILE, domocookie.c_str());
 	curl_easy_setopt(curl, CURLOPT_COOKIEJAR, domocookie.c_str());
@@ -235,7 +368,7 @@ bool HTTPClient::GETBinary(const std::string &url, const std::vector<std::string
 	{
 		if (!CheckIfGlobalInitDone())
 			return false;
-		CURL *curl = curl_easy_init();
+		CURL *curl = (CURL *)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -245,7 +378,11 @@ bool HTTPClient::GETBinary(const std::string &url, const std::vector<std::string
 			curl_easy_setopt(curl, CURLOPT_TIMEOUT, TimeOut);
 
 		if (bStartNewSession)
+		{
+			//a pooled handle keeps the session cookies of its previous requests, drop them too
 			curl_easy_setopt(curl, CURLOPT_COOKIESESSION, 1);
+			curl_easy_setopt(curl, CURLOPT_COOKIELIST, "SESS");
+		}
 
 		struct curl_slist *headers = nullptr;
 		if (!ExtraHeaders.empty())
@@ -286,7 +423,7 @@ bool HTTPClient::GETBinary(const std::string &url, const std::vector<std::string
 			}
 		}
 
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		if (headers != nullptr)
 		{
@@ -309,7 +446,7 @@ bool HTTPClient::POSTBinary(const std::string &url, const std::string &postdata,
 	{
 		if (!CheckIfGlobalInitDone())
 			return false;
-		CURL *curl = curl_easy_init();
+		CURL *curl = (CURL *)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -337,6 +474,7 @@ bool HTTPClient::POSTBinary(const std::string &url, const std::string &postdata,
 		}
 
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postdata.c_str());
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(postdata.size())); // postdata can be binary (gzip)
 		res = curl_easy_perform(curl);
 
 		if (res != CURLE_OK)
@@ -357,7 +495,7 @@ bool HTTPClient::POSTBinary(const std::string &url, const std::string &postdata,
 			}
 		}
 
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		if (headers != nullptr)
 		{
@@ -379,7 +517,7 @@ std::vector<std::string> &vHeaderData, const long TimeOut)
 	{
 		if (!CheckIfGlobalInitDone())
 			return false;
-		CURL *curl = curl_easy_init();
+		CURL *curl = (CURL *)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -426,7 +564,7 @@ std::vector<std::string> &vHeaderData, const long TimeOut)
 			}
 		}
 
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		if (headers != nullptr)
 		{
@@ -448,7 +586,7 @@ std::vector<std::string> &vHeaderData, const long TimeOut)
 	{
 		if (!CheckIfGlobalInitDone())
 			return false;
-		CURL *curl = curl_easy_init();
+		CURL *curl = (CURL *)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -495,7 +633,7 @@ std::vector<std::string> &vHeaderData, const long TimeOut)
 			}
 		}
 
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		if (headers != nullptr)
 		{
@@ -517,7 +655,7 @@ bool HTTPClient::PatchBinary(const std::string& url, const std::string& putdata,
 	{
 		if (!CheckIfGlobalInitDone())
 			return false;
-		CURL* curl = curl_easy_init();
+		CURL* curl = (CURL*)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -564,7 +702,7 @@ bool HTTPClient::PatchBinary(const std::string& url, const std::string& putdata,
 			}
 		}
 
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		if (headers != nullptr)
 		{
@@ -598,7 +736,7 @@ bool HTTPClient::GETBinarySingleLine(const std::string &url, const std::vector<s
 	{
 		if (!CheckIfGlobalInitDone())
 			return false;
-		CURL *curl = curl_easy_init();
+		CURL *curl = (CURL *)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -645,7 +783,7 @@ bool HTTPClient::GETBinarySingleLine(const std::string &url, const std::vector<s
 			}
 		}
 
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		if (headers != nullptr)
 		{
@@ -820,7 +958,7 @@ bool HTTPClient::GETBinaryToFile(const std::string &url, const std::string &outp
 		if (!outfile.is_open())
 			return false;
 
-		CURL *curl = curl_easy_init();
+		CURL *curl = (CURL *)AcquireHandle(url);
 		if (!curl)
 			return false;
 
@@ -830,7 +968,7 @@ bool HTTPClient::GETBinaryToFile(const std::string &url, const std::string &outp
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&outfile);
 		curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
 		res = curl_easy_perform(curl);
-		curl_easy_cleanup(curl);
+		ReleaseHandle(curl, url);
 
 		outfile.close();
 
@@ -841,3 +979,221 @@ bool HTTPClient::GETBinaryToFile(const std::string &url, const std::string &outp
 		return false;
 	}
 }
+
+/************************************************************************
+ *									*
+ * asynchronous requests						*
+ *									*
+ ************************************************************************/
+
+bool HTTPClient::AsyncRequest(const _eHTTPmethod method, const std::string &url, const std::string &postdata, const std::vector<std::string> &ExtraHeaders, const AsyncCallback &callback, const long TimeOut)
+{
+	try
+	{
+		if (!CheckIfGlobalInitDone())
+			return false;
+		CURL *curl = (CURL *)AcquireHandle(url);
+		if (!curl)
+			return false;
+
+		std::unique_ptr<_tAsyncRequest> pRequest(new _tAsyncRequest);
+		pRequest->curl = curl;
+		pRequest->url = url;
+		pRequest->postdata = postdata;
+		pRequest->callback = callback;
+
+		SetGlobalOptions(curl);
+		if (TimeOut != -1)
+			curl_easy_setopt(curl, CURLOPT_TIMEOUT, TimeOut);
+
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_curl_headerdata);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &pRequest->vHeaderData);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&pRequest->response);
+		curl_easy_setopt(curl, CURLOPT_URL, pRequest->url.c_str());
+
+		switch (method)
+		{
+		case HTTP_METHOD_GET:
+			break;
+		case HTTP_METHOD_POST:
+			curl_easy_setopt(curl, CURLOPT_POST, 1);
+			break;
+		case HTTP_METHOD_PUT:
+			curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+			break;
+		case HTTP_METHOD_DELETE:
+			curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+			break;
+		case HTTP_METHOD_PATCH:
+			curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
+			break;
+		}
+		if (method != HTTP_METHOD_GET)
+		{
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, pRequest->postdata.c_str());
+			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(pRequest->postdata.size()));
+		}
+
+		if (!ExtraHeaders.empty())
+		{
+			for (const auto &header : ExtraHeaders)
+			{
+				pRequest->headers = curl_slist_append(pRequest->headers, header.c_str());
+			}
+			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, pRequest->headers);
+		}
+
+		{
+			std::lock_guard<std::mutex> l(g_asyncMutex);
+			if (!g_asyncThread)
+			{
+				g_curlMulti = curl_multi_init();
+				if (!g_curlMulti)
+				{
+					if (pRequest->headers != nullptr)
+						curl_slist_free_all(pRequest->headers);
+					ReleaseHandle(curl, url);
+					return false;
+				}
+				g_bAsyncStop = false;
+				g_asyncThread = std::make_shared<std::thread>([] { AsyncWorker(); });
+				SetThreadName(g_asyncThread->native_handle(), "HTTPClientAsync");
+			}
+			if (g_asyncRequests >= HTTP_ASYNC_MAX_REQUESTS)
+			{
+				g_asyncDropped++;
+				if (!g_bAsyncFull)
+				{
+					_log.Log(LOG_ERROR, "HTTPClient: Too many asynchronous requests (%d) busy, dropping request to %s (%s dropped in total)", HTTP_ASYNC_MAX_REQUESTS, url.c_str(),
+						 std::to_string(g_asyncDropped).c_str());
+					g_bAsyncFull = true;
+				}
+				if (pRequest->headers != nullptr)
+					curl_slist_free_all(pRequest->headers);
+				ReleaseHandle(curl, url);
+				return false;
+			}
+			g_bAsyncFull = false;
+			g_asyncRequests++;
+			g_asyncPending.push_back(std::move(pRequest));
+		}
+		g_asyncCondition.notify_one();
+		return true;
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
+void HTTPClient::AsyncWorker()
+{
+	std::map<CURL *, std::unique_ptr<_tAsyncRequest>> activeRequests;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(g_asyncMutex);
+			if (activeRequests.empty())
+				g_asyncCondition.wait(lock, [] { return g_bAsyncStop || !g_asyncPending.empty(); });
+			if (g_bAsyncStop)
+				break;
+			for (auto &pRequest : g_asyncPending)
+			{
+				curl_multi_add_handle(g_curlMulti, pRequest->curl);
+				activeRequests[pRequest->curl] = std::move(pRequest);
+			}
+			g_asyncPending.clear();
+		}
+
+		int running = 0;
+		curl_multi_perform(g_curlMulti, &running);
+
+		int msgs_left = 0;
+		CURLMsg *msg;
+		while ((msg = curl_multi_info_read(g_curlMulti, &msgs_left)) != nullptr)
+		{
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			CURL *curl = msg->easy_handle;
+			CURLcode res = msg->data.result;
+			curl_multi_remove_handle(g_curlMulti, curl);
+
+			auto itt = activeRequests.find(curl);
+			if (itt == activeRequests.end())
+				continue;
+			std::unique_ptr<_tAsyncRequest> pRequest = std::move(itt->second);
+			activeRequests.erase(itt);
+			{
+				std::lock_guard<std::mutex> l(g_asyncMutex);
+				g_asyncRequests--;
+			}
+
+			long http_code = 0;
+			bool bOK = false;
+			if (res == CURLE_OK)
+			{
+				curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+				bOK = ((http_code) && (http_code < 400));
+				if (!bOK)
+					LogError(http_code);
+			}
+			else
+			{
+				//Need to generate a header
+				std::stringstream ss;
+				ss << "HTTP/1.1 " << res << " " << curl_easy_strerror(res);
+				pRequest->vHeaderData.push_back(ss.str());
+			}
+
+			ReleaseHandle(curl, pRequest->url);
+			if (pRequest->headers != nullptr)
+			{
+				curl_slist_free_all(pRequest->headers);
+				pRequest->headers = nullptr;
+			}
+
+			if (pRequest->callback)
+			{
+				try
+				{
+					pRequest->callback(bOK, http_code, pRequest->response, pRequest->vHeaderData);
+				}
+				catch (...)
+				{
+					_log.Log(LOG_ERROR, "HTTPClient: Exception in callback for %s", pRequest->url.c_str());
+				}
+			}
+		}
+
+		if (!activeRequests.empty())
+		{
+			int numfds = 0;
+			curl_multi_wait(g_curlMulti, nullptr, 0, HTTP_ASYNC_WAIT_MS, &numfds);
+			if (numfds == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10)); // nothing to wait on yet (resolving), do not spin
+		}
+	}
+
+	//shutting down, requests that are still busy are abandoned without calling back
+	for (auto &itt : activeRequests)
+	{
+		curl_multi_remove_handle(g_curlMulti, itt.first);
+		curl_easy_cleanup(itt.first);
+		if (itt.second->headers != nullptr)
+			curl_slist_free_all(itt.second->headers);
+	}
+	{
+		std::lock_guard<std::mutex> l(g_asyncMutex);
+		for (auto &pRequest : g_asyncPending)
+		{
+			curl_easy_cleanup(pRequest->curl);
+			if (pRequest->headers != nullptr)
+				curl_slist_free_all(pRequest->headers);
+		}
+		g_asyncPending.clear();
+		g_asyncRequests = 0;
+	}
+	curl_multi_cleanup(g_curlMulti);
+	g_curlMulti = nullptr;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 class HTTPClient
 {
 	// give MainWorker acces to the protected Cleanup() function
@@ -15,6 +17,9 @@ class HTTPClient
 		HTTP_METHOD_PATCH
 	};
 
+	// bOK is true when the request completed with a HTTP status below 400
+	typedef std::function<void(bool bOK, long http_code, const std::vector<unsigned char> &response, const std::vector<std::string> &vHeaderData)> AsyncCallback;
+
       protected:
 	// Cleanup function, should be called before application closed
 	static void Cleanup();
@@ -111,7 +116,24 @@ class HTTPClient
 	static bool PatchBinary(const std::string& url, const std::string& putdata, const std::vector<std::string>& ExtraHeaders, std::vector<unsigned char>& response,
 		std::vector<std::string>& vHeaderData, long TimeOut = -1);
 
+	/************************************************************************
+	 *									*
+	 * asynchronous request							*
+	 *   - returns immediately, the transfer is done by a shared		*
+	 *     background thread which calls the callback when finished.	*
+	 *     Keep the callback short, it blocks all other async transfers	*
+	 *   - returns false (and drops the request) when too many requests	*
+	 *     are still busy, for example when an endpoint is unreachable	*
+	 *									*
+	 ************************************************************************/
+
+	static bool AsyncRequest(_eHTTPmethod method, const std::string &url, const std::string &postdata, const std::vector<std::string> &ExtraHeaders, const AsyncCallback &callback,
+				 long TimeOut = -1);
+
       private:
+	static void *AcquireHandle(const std::string &url);
+	static void ReleaseHandle(void *curlobj, const std::string &url);
+	static void AsyncWorker();
 	static void SetGlobalOptions(void *curlobj);
 	static bool CheckIfGlobalInitDone();
 	static void LogError(long response_code);
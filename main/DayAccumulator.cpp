@@ -0,0 +1,126 @@
+#include "stdafx.h"
+#include "DayAccumulator.h"
+#include "localtime_r.h"
+
+namespace
+{
+	std::string FormatDay(const struct tm &ltime)
+	{
+		char szDay[20];
+		sprintf(szDay, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+		return szDay;
+	}
+} // namespace
+
+void CDayAccumulator::Start(const CShortLogStore::_eShortLogTable table, const std::string &szDay, const std::vector<std::vector<std::string>> &rows)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	_tTableDays &days = m_tables[table];
+	days = _tTableDays();
+	days.szCurrentDay = szDay;
+	days.bCurrentComplete = true;
+
+	std::vector<double> values;
+	for (const auto &sd : rows)
+	{
+		if (sd.size() < 2)
+			continue;
+		values.resize(sd.size() - 1);
+		for (size_t ii = 1; ii < sd.size(); ii++)
+			values[ii - 1] = atof(sd[ii].c_str());
+		AddSample(days.Current[std::stoull(sd[0])], values);
+	}
+}
+
+void CDayAccumulator::Add(const CShortLogStore::_eShortLogTable table, const uint64_t DeviceRowID, const time_t sampleTime, const std::vector<double> &values)
+{
+	struct tm ltime;
+	localtime_r(&sampleTime, &ltime);
+	const std::string szDay = FormatDay(ltime);
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	_tTableDays &days = m_tables[table];
+	if (days.szCurrentDay.empty())
+		return; // not started
+	if (szDay != days.szCurrentDay)
+	{
+		if (szDay < days.szCurrentDay)
+		{
+			// clock was set back, the totals can not be trusted anymore
+			days.bCurrentComplete = false;
+			days.bPreviousComplete = false;
+			return;
+		}
+		days.szPreviousDay = days.szCurrentDay;
+		days.bPreviousComplete = days.bCurrentComplete;
+		days.Previous = std::move(days.Current);
+		days.Current.clear();
+		days.szCurrentDay = szDay;
+		days.bCurrentComplete = true;
+	}
+	AddSample(days.Current[DeviceRowID], values);
+
+	if ((ltime.tm_hour == 0) && (ltime.tm_min == 0) && (ltime.tm_sec == 0))
+	{
+		// the daily queries count a sample of exactly midnight for the day before as well
+		time_t yesterday;
+		struct tm tm2;
+		getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1);
+		if (FormatDay(tm2) == days.szPreviousDay)
+			AddSample(days.Previous[DeviceRowID], values);
+	}
+}
+
+bool CDayAccumulator::GetDay(const CShortLogStore::_eShortLogTable table, const std::string &szDay, _tDayDevices &devices)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	const _tTableDays &days = m_tables[table];
+	if ((days.bCurrentComplete) && (szDay == days.szCurrentDay))
+	{
+		devices = days.Current;
+		return true;
+	}
+	if ((days.bPreviousComplete) && (szDay == days.szPreviousDay))
+	{
+		devices = days.Previous;
+		return true;
+	}
+	return false;
+}
+
+void CDayAccumulator::Invalidate(const CShortLogStore::_eShortLogTable table)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_tables[table].bCurrentComplete = false;
+	m_tables[table].bPreviousComplete = false;
+}
+
+void CDayAccumulator::Clear()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	for (auto &days : m_tables)
+		days = _tTableDays();
+}
+
+void CDayAccumulator::AddSample(_tDayTotals &totals, const std::vector<double> &values)
+{
+	if (totals.Count == 0)
+	{
+		totals.Columns.resize(values.size());
+		for (size_t ii = 0; ii < values.size(); ii++)
+			totals.Columns[ii] = { values[ii], values[ii], 0, values[ii] };
+	}
+	if (totals.Columns.size() != values.size())
+		return;
+	totals.Count++;
+	for (size_t ii = 0; ii < values.size(); ii++)
+	{
+		_tColumnTotals &column = totals.Columns[ii];
+		if (values[ii] < column.Min)
+			column.Min = values[ii];
+		if (values[ii] > column.Max)
+			column.Max = values[ii];
+		column.Sum += values[ii];
+		column.Last = values[ii];
+	}
+}
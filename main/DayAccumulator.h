@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ShortLogStore.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Running totals per device of the short log samples of the current and the previous (local) day
+//
+// The daily schedule makes the calendar rows from these totals, so it does not have to read back the short log of the whole day.
+// The totals of a day are only complete when every sample of that day went through Add. After a restart, or when the short log
+// is changed by other queries, GetDay returns false and the short log table has to be read instead.
+class CDayAccumulator
+{
+public:
+	struct _tColumnTotals
+	{
+		double Min;
+		double Max;
+		double Sum;
+		double Last;
+	};
+	struct _tDayTotals
+	{
+		uint64_t Count = 0;
+		std::vector<_tColumnTotals> Columns; // in the column order of CShortLogStore::GetColumns
+	};
+	typedef std::map<uint64_t, _tDayTotals> _tDayDevices;
+
+	// Starts collecting for szDay (YYYY-MM-DD) with the samples that are already in the table, rows are DeviceRowID followed by the columns
+	void Start(CShortLogStore::_eShortLogTable table, const std::string &szDay, const std::vector<std::vector<std::string>> &rows);
+	void Add(CShortLogStore::_eShortLogTable table, uint64_t DeviceRowID, time_t sampleTime, const std::vector<double> &values);
+	bool GetDay(CShortLogStore::_eShortLogTable table, const std::string &szDay, _tDayDevices &devices);
+
+	void Invalidate(CShortLogStore::_eShortLogTable table);
+	void Clear();
+
+	static void AddSample(_tDayTotals &totals, const std::vector<double> &values);
+
+private:
+	struct _tTableDays
+	{
+		std::string szCurrentDay;
+		bool bCurrentComplete = false;
+		_tDayDevices Current;
+		std::string szPreviousDay;
+		bool bPreviousComplete = false;
+		_tDayDevices Previous;
+	};
+
+	std::mutex m_mutex;
+	_tTableDays m_tables[CShortLogStore::SLT_COUNT];
+};
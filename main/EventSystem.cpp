@@ -7,6 +7,7 @@
 #include "HTMLSanitizer.h"
 #include "SQLHelper.h"
 #include "Logger.h"
+#include "LatencyStats.h"
 #include "../hardware/hardwaretypes.h"
 #include "../hardware/Kodi.h"
 #include "../hardware/LogitechMediaServer.h"
@@ -23,6 +24,7 @@
 #include "../main/LuaTable.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <sys/stat.h>
 
 extern "C" {
 #include <lua.h>
@@ -121,9 +123,23 @@ const CEventSystem::_tJsonMap CEventSystem::JsonMap[] = {
 	{ nullptr, nullptr, JTYPE_STRING },
 };
 
+// Latency histogram of a database event, the file scripts get theirs when the script index is built
+static CLatencyHistogram *EventLatency(const std::string &interpreter, const std::string &name)
+{
+	if ((interpreter != "Lua") && (interpreter != "Python"))
+		return nullptr;
+	return m_latencystats.Get(CLatencyStats::STAGE_SCRIPT, name);
+}
+
 CEventSystem::CEventSystem()
 {
 	m_bEnabled = false;
+	m_luaScriptIndex.Extension = ".lua";
+	m_luaScriptIndex.bMatchDeviceNames = true;
+	m_dzVentsScriptIndex.Extension = ".lua";
+#ifdef ENABLE_PYTHON
+	m_pythonScriptIndex.Extension = ".py";
+#endif
 }
 
 CEventSystem::~CEventSystem()
@@ -177,6 +193,8 @@ void CEventSystem::StopEventSystem()
 		m_thread.reset();
 	}
 
+	ClearLuaStatePool();
+
 #ifdef ENABLE_PYTHON
 	Plugins::PythonEventsStop();
 #endif
@@ -192,6 +210,11 @@ void CEventSystem::SetEnabled(const bool bEnabled)
 	}
 }
 
+size_t CEventSystem::GetQueueDepth()
+{
+	return m_eventqueue.size();
+}
+
 void CEventSystem::LoadEvents()
 {
 	std::string dzv_Dir;
@@ -251,6 +274,7 @@ void CEventSystem::LoadEvents()
 			eitem.Actions = sd[3];
 			eitem.EventStatus = atoi(sd[4].c_str());
 			eitem.SequenceNo = atoi(sd[5].c_str());
+			eitem.pLatency = EventLatency(eitem.Interpreter, eitem.Name);
 			m_events.push_back(eitem);
 		}
 	}
@@ -282,6 +306,7 @@ void CEventSystem::LoadEvents()
 			eitem.EventStatus = atoi(sd[4].c_str());
 			eitem.Actions = sd[5];
 			eitem.SequenceNo = 0;
+			eitem.pLatency = EventLatency(eitem.Interpreter, eitem.Name);
 			m_events.push_back(eitem);
 
 			// Write active dzVents scripts to disk.
@@ -303,12 +328,76 @@ void CEventSystem::LoadEvents()
 			}
 		}
 	}
+	BuildEventIndex();
+	{
+		std::lock_guard<std::mutex> l(m_blocklyChunksMutex);
+		m_blocklyChunks.clear();
+	}
+	eventsMutexLock.unlock();
+
 	m_mainworker.m_notificationsystem.Notify(Notification::DZ_ALLEVENTRESET, Notification::STATUS_INFO);
 #ifdef _DEBUG
 	_log.Log(LOG_STATUS, "EventSystem: Events (re)loaded");
 #endif
 }
 
+// Adds the numbers of all "[number]" in the conditions (optionally only with the prefix in front) to the index
+static void AddBlocklyIndexes(std::map<uint64_t, std::vector<size_t>> &index, const std::string &conditions, const std::string &prefix, const size_t position)
+{
+	std::string search = prefix + "[";
+	for (size_t pos = conditions.find(search); pos != std::string::npos; pos = conditions.find(search, pos + 1))
+	{
+		size_t spos = pos + search.size();
+		size_t epos = conditions.find(']', spos);
+		if ((epos == std::string::npos) || (epos == spos) || (epos - spos > 19))
+			continue;
+		std::string number = conditions.substr(spos, epos - spos);
+		// must be written the way the item id is, "[01]" is not "[1]"
+		if ((number.find_first_not_of("0123456789") != std::string::npos) || ((number[0] == '0') && (number.size() > 1)))
+			continue;
+		std::vector<size_t> &events = index[std::stoull(number)];
+		if (events.empty() || (events.back() != position))
+			events.push_back(position);
+	}
+}
+
+void CEventSystem::BuildEventIndex()
+{
+	// caller holds a unique lock on m_eventsMutex
+	m_eventIndex = _tEventIndex();
+	const size_t reasons = sizeof(m_szReason) / sizeof(m_szReason[0]);
+	for (size_t ii = 0; ii < m_events.size(); ii++)
+	{
+		const _tEventItem &event = m_events[ii];
+		if (event.EventStatus != 1)
+			continue;
+		bool bInScope[REASON_SHELLCOMMAND + 1];
+		for (int reason = 0; reason <= REASON_SHELLCOMMAND; reason++)
+			bInScope[reason] = ((event.Type == "all") || ((reason < (int)reasons) && (event.Type == m_szReason[reason])));
+
+		if (event.Interpreter == "Blockly")
+		{
+			// same criteria as the text searches EvaluateDatabaseEvents used to do for every item
+			if (bInScope[REASON_DEVICE])
+				AddBlocklyIndexes(m_eventIndex.BlocklyDevices, event.Conditions, "", ii);
+			if ((bInScope[REASON_SECURITY]) && (event.Conditions.find("securitystatus") != std::string::npos))
+				m_eventIndex.BlocklySecurity.push_back(ii);
+			if ((bInScope[REASON_TIME]) && ((event.Conditions.find("timeofday") != std::string::npos) || (event.Conditions.find("weekday") != std::string::npos)))
+				m_eventIndex.BlocklyTime.push_back(ii);
+			if (bInScope[REASON_USERVARIABLE])
+				AddBlocklyIndexes(m_eventIndex.BlocklyVariables, event.Conditions, "variable", ii);
+		}
+		else if ((event.Interpreter == "Lua") || (event.Interpreter == "Python"))
+		{
+			for (int reason = 0; reason <= REASON_SHELLCOMMAND; reason++)
+			{
+				if (bInScope[reason])
+					m_eventIndex.Scripts[reason].push_back(ii);
+			}
+		}
+	}
+}
+
 void CEventSystem::Do_Work()
 {
 #ifdef ENABLE_PYTHON
@@ -438,6 +527,8 @@ void CEventSystem::GetCurrentStates()
 
 	_log.Log(LOG_STATUS, "EventSystem: reset all device statuses...");
 	m_devicestates.clear();
+	m_devicestatesResetGeneration = ++m_devicestatesGeneration;
+	m_devicenamesGeneration++;
 
 	result = m_sql.safe_query(
 		"SELECT A.HardwareID, A.ID, A.Name, A.nValue, A.sValue, A.Type, A.SubType, A.SwitchType, A.LastUpdate, A.LastLevel, A.Options, A.Description, A.BatteryLevel, A.SignalLevel, A.Unit, A.DeviceID, A.Protected, A.AddjValue, A.AddjMulti, A.AddjValue2, A.AddjMulti2 "
@@ -510,6 +601,7 @@ void CEventSystem::GetCurrentStates()
 			{
 				UpdateJsonMap(sitem, sitem.ID);
 			}
+			sitem.generation = m_devicestatesGeneration;
 			m_devicestates_temp[sitem.ID] = sitem;
 		}
 		m_devicestates = m_devicestates_temp;
@@ -1075,6 +1167,8 @@ void CEventSystem::RemoveSingleState(const uint64_t ulDevID, const _eReason reas
 	{
 		boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 		m_devicestates.erase(ulDevID);
+		m_devicestatesResetGeneration = ++m_devicestatesGeneration;
+		m_devicenamesGeneration++;
 	}
 	else if (reason == REASON_SCENEGROUP)
 	{
@@ -1098,7 +1192,10 @@ void CEventSystem::WWWUpdateSingleState(const uint64_t ulDevID, const std::strin
 		if (itt != m_devicestates.end())
 		{
 			_tDeviceStatus replaceitem = itt->second;
+			if (replaceitem.deviceName != l_deviceName)
+				m_devicenamesGeneration++;
 			replaceitem.deviceName = l_deviceName;
+			TouchDeviceState(replaceitem);
 			itt->second = replaceitem;
 		}
 	}
@@ -1307,6 +1404,7 @@ void CEventSystem::UpdateBatteryLevel(const uint64_t ulDevID, const unsigned cha
 	{
 		_tDeviceStatus replaceitem = itt->second;
 		replaceitem.batteryLevel = batteryLevel;
+		TouchDeviceState(replaceitem);
 		itt->second = replaceitem;
 	}
 }
@@ -1339,6 +1437,8 @@ std::string CEventSystem::UpdateSingleState(
 	{
 		//_log.Log(LOG_STATUS,"EventSystem: update device %" PRIu64 "",ulDevID);
 		_tDeviceStatus replaceitem = itt->second;
+		if (replaceitem.deviceName != l_deviceName)
+			m_devicenamesGeneration++;
 		replaceitem.deviceName = l_deviceName;
 		//replaceitem.batteryLevel = batteryLevel;
 		if (nValue != -1)
@@ -1356,6 +1456,7 @@ std::string CEventSystem::UpdateSingleState(
 		{
 			UpdateJsonMap(replaceitem, ulDevID);
 		}
+		TouchDeviceState(replaceitem);
 		itt->second = replaceitem;
 	}
 	else
@@ -1378,11 +1479,19 @@ std::string CEventSystem::UpdateSingleState(
 		{
 			UpdateJsonMap(newitem, ulDevID);
 		}
+		TouchDeviceState(newitem);
 		m_devicestates[newitem.ID] = newitem;
+		m_devicenamesGeneration++;
 	}
 	return nValueWording;
 }
 
+void CEventSystem::TouchDeviceState(_tDeviceStatus &item)
+{
+	// caller holds a unique lock on m_devicestatesMutex
+	item.generation = ++m_devicestatesGeneration;
+}
+
 void CEventSystem::UnlockEventQueueThread()
 {
 	// Push dummy message to unlock queue
@@ -1405,6 +1514,7 @@ void CEventSystem::EventQueueThread()
 
 		if (m_TaskQueue.IsStopRequested(0))
 			break;
+		m_latencystats.Record(CLatencyStats::STAGE_EVENT_QUEUE_WAIT, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - item.EnqueueTime).count());
 #ifdef _DEBUG
 		//_log.Log(LOG_STATUS, "EventSystem: \n reason => %d\n id => %" PRIu64 "\n devname => %s\n nValue => %d\n sValue => %s\n nValueWording => %s\n lastUpdate => %s\n lastLevel => %d\n",
 			//item.reason, item.id, item.devname.c_str(), item.nValue, item.sValue.c_str(), item.nValueWording.c_str(), item.lastUpdate.c_str(), item.lastLevel);
@@ -1510,9 +1620,11 @@ void CEventSystem::ProcessDevice(
 			_tDeviceStatus replaceitem = itt->second;
 			replaceitem.lastUpdate = lastUpdate;
 			replaceitem.lastLevel = lastLevel;
+			TouchDeviceState(replaceitem);
 			itt->second = replaceitem;
 		}
-		m_eventqueue.push(item);
+		item.EnqueueTime = std::chrono::steady_clock::now();
+		m_eventqueue.push(std::move(item));
 	}
 	else
 		UpdateSingleState(ulDevID, devname, nValue, osValue, devType, subType, switchType, lastUpdate, lastLevel, batterylevel, options);
@@ -1531,98 +1643,54 @@ void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
 	if (!m_bEnabled)
 		return;
 
-	std::vector<std::string> FileEntries;
+	std::unique_lock<std::mutex> scriptIndexLock(m_scriptIndexMutex);
+	RefreshScriptIndex(m_luaScriptIndex, m_lua_Dir);
 #ifdef ENABLE_PYTHON
-	std::vector<std::string> FileEntriesPython;
-	DirectoryListing(FileEntriesPython, m_python_Dir, false, true);
+	RefreshScriptIndex(m_pythonScriptIndex, m_python_Dir);
 #endif
 
 	if (!m_sql.m_bDisableDzVentsSystem)
 	{
 		CdzVents* dzvents = CdzVents::GetInstance();
-		if (dzvents->m_bdzVentsExist)
-			EvaluateLua(items, dzvents->m_runtimeDir + "dzVents.lua", "");
-		else
+		bool bRunDzVents = dzvents->m_bdzVentsExist;
+		if (!bRunDzVents)
 		{
-			DirectoryListing(FileEntries, dzvents->m_scriptsDir, false, true);
-			for (const auto &filename : FileEntries)
-			{
-				if (filename.length() > 4 &&
-					filename.compare(filename.length() - 4, 4, ".lua") == 0)
-				{
-					EvaluateLua(items, dzvents->m_runtimeDir + "dzVents.lua", "");
-					break;
-				}
-			}
-			FileEntries.clear();
+			RefreshScriptIndex(m_dzVentsScriptIndex, dzvents->m_scriptsDir);
+			bRunDzVents = m_dzVentsScriptIndex.bHaveScripts;
+		}
+		if (bRunDzVents)
+		{
+			scriptIndexLock.unlock();
+			static CLatencyHistogram *pLatency = m_latencystats.Get(CLatencyStats::STAGE_SCRIPT, "dzVents");
+			EvaluateLua(items, dzvents->m_runtimeDir + "dzVents.lua", "", pLatency);
+			scriptIndexLock.lock();
 		}
 	}
+	scriptIndexLock.unlock();
 
-	bool bDeviceFileFound = false;
-	DirectoryListing(FileEntries, m_lua_Dir, false, true);
+	std::vector<_tIndexedScript> scripts;
 	for (const auto &item : items)
 	{
-		for (const auto &filename : FileEntries)
-		{
-			if (filename.length() > 4 &&
-				filename.compare(filename.length() - 4, 4, ".lua") == 0 &&
-				filename.find("_demo.lua") == std::string::npos)
-			{
-				if (item.reason == REASON_DEVICE && filename.find("_device_") != std::string::npos)
-				{
-					bDeviceFileFound = false;
-					boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-					for (const auto &state : m_devicestates)
-					{
-						std::string deviceName = SpaceToUnderscore(LowerCase(state.second.deviceName));
-						if (filename.find("_device_" + deviceName + ".lua") != std::string::npos)
-						{
-							bDeviceFileFound = true;
-							if (deviceName == SpaceToUnderscore(LowerCase(item.devname)))
-							{
-								devicestatesMutexLock.unlock();
-								EvaluateLua(item, m_lua_Dir + filename, "");
-								break;
-							}
-						}
-					}
-					if (!bDeviceFileFound)
-					{
-						devicestatesMutexLock.unlock();
-						EvaluateLua(item, m_lua_Dir + filename, "");
-					}
-				}
-				else if ((item.reason == REASON_TIME && filename.find("_time_") != std::string::npos)
-					 || (item.reason == REASON_SECURITY && filename.find("_security_") != std::string::npos)
-					 || (item.reason == REASON_NOTIFICATION && filename.find("_notification_") != std::string::npos)
-					 || (item.reason == REASON_USERVARIABLE && filename.find("_variable_") != std::string::npos))
-				{
-					EvaluateLua(item, m_lua_Dir + filename, "");
-				}
-			}
-			// else _log.Log(LOG_STATUS,"EventSystem: ignore file not .lua or is demo file: %s", filename.c_str());
-		}
+		scriptIndexLock.lock();
+		GetEventScripts(m_luaScriptIndex, item, scripts);
+		scriptIndexLock.unlock();
+		for (const auto &script : scripts)
+			EvaluateLua(item, m_lua_Dir + script.Name, "", script.pLatency);
 
 #ifdef ENABLE_PYTHON
+		// Python scripts have no notification trigger
+		scripts.clear();
+		if (item.reason != REASON_NOTIFICATION)
+		{
+			scriptIndexLock.lock();
+			GetEventScripts(m_pythonScriptIndex, item, scripts);
+			scriptIndexLock.unlock();
+		}
 		boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
 		try
 		{
-			for (const auto &filename : FileEntriesPython)
-			{
-				if (filename.length() > 3 &&
-					filename.compare(filename.length() - 3, 3, ".py") == 0 &&
-					filename.find("_demo.py") == std::string::npos)
-				{
-					if ((item.reason == REASON_DEVICE && filename.find("_device_") != std::string::npos)
-					    || (item.reason == REASON_TIME && filename.find("_time_") != std::string::npos)
-					    || (item.reason == REASON_SECURITY && filename.find("_security_") != std::string::npos)
-					    || (item.reason == REASON_USERVARIABLE && filename.find("_variable_") != std::string::npos))
-					{
-						EvaluatePython(item, m_python_Dir + filename, "");
-					}
-				}
-				// else _log.Log(LOG_STATUS,"EventSystem: ignore file not .py or is demo file: %s", filename.c_str());
-			}
+			for (const auto &script : scripts)
+				EvaluatePython(item, m_python_Dir + script.Name, "", script.pLatency);
 		}
 		catch (...)
 		{
@@ -1650,6 +1718,124 @@ void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
 	}
 }
 
+
+void CEventSystem::RefreshScriptIndex(_tScriptIndex &index, const std::string &dir)
+{
+	// caller holds m_scriptIndexMutex
+	// the script folders end in a separator, stat fails on that on Windows
+	std::string statDir = dir;
+	while ((statDir.size() > 1) && ((statDir.back() == '/') || (statDir.back() == '\\')))
+		statDir.pop_back();
+	struct stat st;
+	const bool bHaveModified = (stat(statDir.c_str(), &st) == 0);
+	const time_t modified = (bHaveModified) ? st.st_mtime : 0;
+	// a change in the same second as the listing keeps the directory time, so such a listing is done again,
+	// and without a directory time the folder is listed every time
+	if ((bHaveModified) && (index.Listed != 0) && (modified == index.DirModified) && (index.Listed > modified + 1))
+		return;
+	index.DirModified = modified;
+	index.Listed = mytime(nullptr);
+
+	index.bHaveScripts = false;
+	for (auto &reasonScripts : index.Scripts)
+		reasonScripts.clear();
+	index.DeviceScriptNames.clear();
+	index.ResolvedGeneration = 0;
+
+	std::vector<std::string> FileEntries;
+	DirectoryListing(FileEntries, dir, false, true);
+	std::sort(FileEntries.begin(), FileEntries.end());
+
+	const std::string &ext = index.Extension;
+	for (const auto &filename : FileEntries)
+	{
+		if ((filename.length() <= ext.length()) || (filename.compare(filename.length() - ext.length(), ext.length(), ext) != 0))
+			continue;
+		index.bHaveScripts = true;
+		if (filename.find("_demo" + ext) != std::string::npos)
+			continue;
+
+		const _tIndexedScript script{ filename, m_latencystats.Get(CLatencyStats::STAGE_SCRIPT, filename) };
+
+		if (filename.find("_device_") != std::string::npos)
+		{
+			index.Scripts[REASON_DEVICE].push_back(script);
+			if (index.bMatchDeviceNames)
+			{
+				// every name X for which the file name contains "_device_X.lua"
+				std::vector<std::string> &names = index.DeviceScriptNames[filename];
+				for (size_t pos = filename.find("_device_"); pos != std::string::npos; pos = filename.find("_device_", pos + 1))
+				{
+					for (size_t epos = filename.find(ext, pos + 8); epos != std::string::npos; epos = filename.find(ext, epos + 1))
+					{
+						std::string name = filename.substr(pos + 8, epos - pos - 8);
+						if (std::find(names.begin(), names.end(), name) == names.end())
+							names.push_back(name);
+					}
+				}
+			}
+		}
+		if (filename.find("_time_") != std::string::npos)
+			index.Scripts[REASON_TIME].push_back(script);
+		if (filename.find("_security_") != std::string::npos)
+			index.Scripts[REASON_SECURITY].push_back(script);
+		if (filename.find("_notification_") != std::string::npos)
+			index.Scripts[REASON_NOTIFICATION].push_back(script);
+		if (filename.find("_variable_") != std::string::npos)
+			index.Scripts[REASON_USERVARIABLE].push_back(script);
+	}
+}
+
+void CEventSystem::GetEventScripts(_tScriptIndex &index, const _tEventQueue &item, std::vector<_tIndexedScript> &scripts)
+{
+	// caller holds m_scriptIndexMutex
+	scripts.clear();
+	if (item.reason > REASON_SHELLCOMMAND)
+		return;
+	if ((item.reason != REASON_DEVICE) || (!index.bMatchDeviceNames))
+	{
+		scripts = index.Scripts[item.reason];
+		return;
+	}
+
+	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
+	if (index.ResolvedGeneration != m_devicenamesGeneration)
+	{
+		// a device script named after a device only runs for that device, the others run for every device
+		std::set<std::string> deviceNames;
+		for (const auto &state : m_devicestates)
+			deviceNames.insert(SpaceToUnderscore(LowerCase(state.second.deviceName)));
+
+		index.AnyDeviceScripts.clear();
+		index.DeviceScripts.clear();
+		for (const auto &script : index.Scripts[REASON_DEVICE])
+		{
+			bool bNamed = false;
+			for (const auto &name : index.DeviceScriptNames[script.Name])
+			{
+				if (deviceNames.find(name) != deviceNames.end())
+				{
+					index.DeviceScripts[name].push_back(script);
+					bNamed = true;
+				}
+			}
+			if (!bNamed)
+				index.AnyDeviceScripts.push_back(script);
+		}
+		index.ResolvedGeneration = m_devicenamesGeneration;
+	}
+	devicestatesMutexLock.unlock();
+
+	auto itt = index.DeviceScripts.find(SpaceToUnderscore(LowerCase(item.devname)));
+	if (itt == index.DeviceScripts.end())
+	{
+		scripts = index.AnyDeviceScripts;
+		return;
+	}
+	// both lists are sorted
+	std::merge(index.AnyDeviceScripts.begin(), index.AnyDeviceScripts.end(), itt->second.begin(), itt->second.end(), std::back_inserter(scripts));
+}
+
 lua_State *CEventSystem::CreateBlocklyLuaState()
 {
 	lua_State *lua_state = luaL_newstate();
@@ -1827,30 +2013,71 @@ lua_State *CEventSystem::CreateBlocklyLuaState()
 	return lua_state;
 }
 
+static int BlocklyChunkWriter(lua_State *lua_state, const void *p, size_t sz, void *ud)
+{
+	static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+	return 0;
+}
+
 lua_State *CEventSystem::ParseBlocklyLua(lua_State *lua_state, const _tEventItem &item)
 {
-	std::string conditions = item.Conditions;
-	// Replace Sunrise and sunset placeholder with actual time for query
-	if (conditions.find("@Sunrise") != std::string::npos)
+	if (lua_state == nullptr)
 	{
-		stdreplace(conditions, "@Sunrise", std::to_string(getSunRiseSunSetMinutes("Sunrise")));
+		lua_state = CreateBlocklyLuaState();
+		if (lua_state == nullptr)
+			return nullptr;
 	}
-	if (conditions.find("@Sunset") != std::string::npos)
+
+	// The conditions are compiled once, and again when the sunrise or sunset time they use has changed
+	int sunrise = -1;
+	int sunset = -1;
+	if (item.Conditions.find("@Sunrise") != std::string::npos)
+		sunrise = getSunRiseSunSetMinutes("Sunrise");
+	if (item.Conditions.find("@Sunset") != std::string::npos)
+		sunset = getSunRiseSunSetMinutes("Sunset");
+
+	std::string byteCode;
 	{
-		stdreplace(conditions, "@Sunset", std::to_string(getSunRiseSunSetMinutes("Sunset")));
+		std::lock_guard<std::mutex> l(m_blocklyChunksMutex);
+		auto itt = m_blocklyChunks.find(item.ID);
+		if ((itt != m_blocklyChunks.end()) && (itt->second.Sunrise == sunrise) && (itt->second.Sunset == sunset))
+			byteCode = itt->second.ByteCode;
 	}
 
-	std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
-
-	if (lua_state == nullptr)
+	int status;
+	if (!byteCode.empty())
+		status = luaL_loadbufferx(lua_state, byteCode.data(), byteCode.size(), item.Name.c_str(), "b");
+	else
 	{
-		lua_state = CreateBlocklyLuaState();
-		if (lua_state == nullptr)
-			return nullptr;
+		std::string conditions = item.Conditions;
+		// Replace Sunrise and sunset placeholder with actual time for query
+		if (sunrise != -1)
+		{
+			stdreplace(conditions, "@Sunrise", std::to_string(sunrise));
+		}
+		if (sunset != -1)
+		{
+			stdreplace(conditions, "@Sunset", std::to_string(sunset));
+		}
+
+		std::string ifCondition = "result = 0; weekday = os.date('*t')['wday']; timeofday = ((os.date('*t')['hour']*60)+os.date('*t')['min']); if " + conditions + " then result = 1 end; return result";
+
+		//_log.Log(LOG_STATUS,"EventSystem: ifc: %s",ifCondition.c_str());
+		status = luaL_loadstring(lua_state, ifCondition.c_str());
+		if (status == 0)
+		{
+			_tBlocklyChunk chunk;
+			chunk.Sunrise = sunrise;
+			chunk.Sunset = sunset;
+			if (lua_dump(lua_state, BlocklyChunkWriter, &chunk.ByteCode, 0) == 0)
+			{
+				std::lock_guard<std::mutex> l(m_blocklyChunksMutex);
+				m_blocklyChunks[item.ID] = chunk;
+			}
+		}
 	}
 
-	//_log.Log(LOG_STATUS,"EventSystem: ifc: %s",ifCondition.c_str());
-	if (luaL_dostring(lua_state, ifCondition.c_str()))
+	if ((status != 0) || (lua_pcall(lua_state, 0, LUA_MULTRET, 0) != 0))
 	{
 		_log.Log(LOG_ERROR, "EventSystem: Lua script error (Blockly), Name: %s => %s", item.Name.c_str(), lua_tostring(lua_state, -1));
 	}
@@ -1874,58 +2101,51 @@ void CEventSystem::EvaluateDatabaseEvents(const _tEventQueue &item)
 	boost::shared_lock<boost::shared_mutex> eventsMutexLock(m_eventsMutex);
 	try
 	{
-		for (const auto &event : m_events)
-		{
-			bool eventInScope = ((event.Type == "all") || (event.Type == m_szReason[item.reason]));
-			bool eventActive = (event.EventStatus == 1);
+		if (item.reason > REASON_SHELLCOMMAND)
+			return;
 
-			if (eventInScope && eventActive)
-			{
-				if (event.Interpreter == "Blockly")
-				{
-					std::size_t found = std::string::npos;
-					if ((item.reason == REASON_DEVICE) && (item.id > 0))
-					{
-						std::stringstream sstr;
-						sstr << "[" << item.id << "]";
-						found = event.Conditions.find(sstr.str());
-					}
-					else if (item.reason == REASON_SECURITY)
-					{
-						// security status change
-						std::stringstream sstr;
-						sstr << "securitystatus";
-						found = event.Conditions.find(sstr.str());
-					}
-					else if (item.reason == REASON_TIME)
-					{
-						// time rules will only run when time or date based criteria are found
-						found = event.Conditions.find("timeofday");
-						if (found == std::string::npos)
-							found = event.Conditions.find("weekday");
-					}
-					else if ((item.reason == REASON_USERVARIABLE) && (item.id > 0))
-					{
-						std::stringstream sstr;
-						sstr << "variable[" << item.id << "]";
-						found = event.Conditions.find(sstr.str());
-					}
+		// Blockly events only run when their conditions use the item
+		const std::vector<size_t> *pBlockly = nullptr;
+		if ((item.reason == REASON_DEVICE) && (item.id > 0))
+		{
+			auto itt = m_eventIndex.BlocklyDevices.find(item.id);
+			if (itt != m_eventIndex.BlocklyDevices.end())
+				pBlockly = &itt->second;
+		}
+		else if (item.reason == REASON_SECURITY)
+			pBlockly = &m_eventIndex.BlocklySecurity;
+		else if (item.reason == REASON_TIME)
+			pBlockly = &m_eventIndex.BlocklyTime;
+		else if ((item.reason == REASON_USERVARIABLE) && (item.id > 0))
+		{
+			auto itt = m_eventIndex.BlocklyVariables.find(item.id);
+			if (itt != m_eventIndex.BlocklyVariables.end())
+				pBlockly = &itt->second;
+		}
 
-					if (found != std::string::npos)
-						lua_state = ParseBlocklyLua(lua_state, event);
-				}
-				else if (event.Interpreter == "Lua")
-					EvaluateLua(item, event.Name, event.Actions);
+		// run them in the order of the events, as before
+		const std::vector<size_t> &scripts = m_eventIndex.Scripts[item.reason];
+		std::vector<size_t> events;
+		if (pBlockly != nullptr)
+			std::merge(scripts.begin(), scripts.end(), pBlockly->begin(), pBlockly->end(), std::back_inserter(events));
+		else
+			events = scripts;
 
-				else if (event.Interpreter == "Python")
-				{
+		for (const auto position : events)
+		{
+			const _tEventItem &event = m_events[position];
+			if (event.Interpreter == "Blockly")
+				lua_state = ParseBlocklyLua(lua_state, event);
+			else if (event.Interpreter == "Lua")
+				EvaluateLua(item, event.Name, event.Actions, event.pLatency);
+			else if (event.Interpreter == "Python")
+			{
 #ifdef ENABLE_PYTHON
-					boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
-					EvaluatePython(item, event.Name, event.Actions);
+				boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
+				EvaluatePython(item, event.Name, event.Actions, event.pLatency);
 #else
-					_log.Log(LOG_ERROR, "EventSystem: Error processing database scripts, Python not enabled");
+				_log.Log(LOG_ERROR, "EventSystem: Error processing database scripts, Python not enabled");
 #endif
-				}
 			}
 		}
 	}
@@ -2587,8 +2807,10 @@ bool CEventSystem::PythonScheduleEvent(const std::string &ID, const std::string
 	return ScheduleEvent(ID, Action, eventName);
 }
 
-void CEventSystem::EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString)
+void CEventSystem::EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString, CLatencyHistogram *pLatency)
 {
+	CLatencyTimer latencyTimer(pLatency);
+
 	//_log.Log(LOG_NORM, "EventSystem: Already scheduled this event, skipping");
 	// _log.Log(LOG_STATUS, "EventSystem: script %s trigger, file: %s, script: %s, deviceName: %s" , reason.c_str(), filename.c_str(), PyString.c_str(), devname.c_str());
 
@@ -2647,11 +2869,7 @@ void CEventSystem::ExportDeviceStatesToLua(lua_State *lua_state, const _tEventQu
 
 void CEventSystem::EvaluateLuaClassic(lua_State *lua_state, const _tEventQueue &item, const int secStatus)
 {
-	// reroute print library to Domoticz logger
-	luaL_openlibs(lua_state);
-	lua_pushcfunction(lua_state, l_domoticz_print);
-	lua_setglobal(lua_state, "print");
-
+	// the libraries and the print to the Domoticz logger are set up by AcquireLuaState
 	{
 		std::lock_guard<std::mutex> measurementStatesMutexLock(m_measurementStatesMutex);
 		GetCurrentMeasurementStates();
@@ -2970,38 +3188,23 @@ void CEventSystem::EvaluateLuaClassic(lua_State *lua_state, const _tEventQueue &
 	}
 }
 
-void CEventSystem::EvaluateLua(const _tEventQueue &item, const std::string &filename, const std::string &LuaString)
+void CEventSystem::EvaluateLua(const _tEventQueue &item, const std::string &filename, const std::string &LuaString, CLatencyHistogram *pLatency)
 {
 	std::vector<_tEventQueue> items;
 	items.push_back(item);
-	EvaluateLua(items, filename, LuaString);
+	EvaluateLua(items, filename, LuaString, pLatency);
 }
 
-void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std::string &filename, const std::string &LuaString)
+void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std::string &filename, const std::string &LuaString, CLatencyHistogram *pLatency)
 {
 	std::lock_guard<std::mutex> l(luaMutex);
 
-	lua_State *lua_state;
-	lua_state = luaL_newstate();
-
-	// load Lua libraries
-	static const luaL_Reg lualibs[] = {
-		{ "base", luaopen_base },     { "io", luaopen_io },	{ "table", luaopen_table },
-		{ "string", luaopen_string }, { "math", luaopen_math }, { nullptr, nullptr },
-	};
-
-	const luaL_Reg *lib = lualibs;
-	for (; lib->func != nullptr; lib++)
-	{
-		lib->func(lua_state);
-		lua_settop(lua_state, 0);
-	}
+	CdzVents* dzvents = CdzVents::GetInstance();
+	bool bDzVents = (!m_sql.m_bDisableDzVentsSystem && filename == dzvents->m_runtimeDir + "dzVents.lua");
 
-	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
-	lua_setglobal(lua_state, "domoticz_applyJsonPath");
+	CLatencyTimer latencyTimer(pLatency);
 
-	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
-	lua_setglobal(lua_state, "domoticz_applyXPath");
+	lua_State *lua_state = AcquireLuaState(bDzVents);
 
 #ifdef _DEBUG
 	_log.Log(LOG_STATUS, "EventSystem: script %s trigger (%s)", m_szReason[items[0].reason].c_str(), filename.c_str());
@@ -3063,8 +3266,7 @@ void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std
 
 	int secstatus = 0;
 	m_sql.GetPreferencesVar("SecStatus", secstatus);
-	CdzVents* dzvents = CdzVents::GetInstance();
-	if (!m_sql.m_bDisableDzVentsSystem && filename == dzvents->m_runtimeDir + "dzVents.lua")
+	if (bDzVents)
 		dzvents->EvaluateDzVents(lua_state, items, secstatus);
 	else
 		EvaluateLuaClassic(lua_state, items[0], secstatus);
@@ -3079,22 +3281,26 @@ void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std
 	{
 		lua_sethook(lua_state, luaStop, LUA_MASKCOUNT, 10000000);
 
-		boost::thread aluaThread([this, lua_state, filename] { luaThread(lua_state, filename); });
+		std::shared_ptr<_tLuaRun> run = std::make_shared<_tLuaRun>();
+		boost::thread aluaThread([this, lua_state, filename, run] { luaThread(lua_state, filename, run); });
 		SetThreadName(aluaThread.native_handle(), "luaThread");
 
 		if (!aluaThread.timed_join(boost::posix_time::seconds(10)))
 		{
 			_log.Log(LOG_ERROR, "EventSystem: Warning!, lua script %s has been running for more than 10 seconds", filename.c_str());
+			std::lock_guard<std::mutex> runLock(run->mutex);
+			if (!run->bFinished)
+			{
+				run->bAbandoned = true;
+				return;
+			}
 		}
-		else
-		{
-			//_log.Log(LOG_ERROR, "EventSystem: lua script completed");
-		}
+		ReleaseLuaState(lua_state, bDzVents, run->bSuccess);
 	}
 	else
 	{
 		report_errors(lua_state, status, filename);
-		lua_close(lua_state);
+		ReleaseLuaState(lua_state, bDzVents, false);
 		return;
 	}
 
@@ -3130,7 +3336,7 @@ void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std
 	*/
 }
 
-void CEventSystem::luaThread(lua_State *lua_state, const std::string &filename)
+void CEventSystem::luaThread(lua_State *lua_state, const std::string &filename, const std::shared_ptr<_tLuaRun> &run)
 {
 	int status;
 	status = lua_pcall(lua_state, 0, LUA_MULTRET, 0);
@@ -3157,8 +3363,132 @@ void CEventSystem::luaThread(lua_State *lua_state, const std::string &filename)
 			_log.Log(LOG_STATUS, "EventSystem: Script event triggered: %s", filename.c_str());
 	}
 
-	lua_close(lua_state);
+	bool bAbandoned;
+	{
+		std::lock_guard<std::mutex> l(run->mutex);
+		run->bFinished = true;
+		run->bSuccess = (status == 0);
+		bAbandoned = run->bAbandoned;
+	}
+	if (bAbandoned)
+		lua_close(lua_state);
+}
+
+// Taken when a state is created: remembers the clean globals, the contents of the standard library tables,
+// the metatables of the globals and of strings and the loaded modules and returns a function that puts them
+// back after a run. Modules required by a run (also the dzVents runtime) are dropped, they keep state in their upvalues.
+static const char *szLuaStateReset =
+	"local G, pkg, loaded, pairs, type = _G, package, package.loaded, pairs, type\n"
+	"local getmetatable, setmetatable = debug.getmetatable, debug.setmetatable\n"
+	"local path, cpath = package.path, package.cpath\n"
+	"local function snapshot(t)\n"
+	"	local copy = {}\n"
+	"	for k, v in pairs(t) do copy[k] = v end\n"
+	"	return copy\n"
+	"end\n"
+	"local function restore(t, copy)\n"
+	"	for k in pairs(t) do\n"
+	"		if copy[k] == nil then t[k] = nil end\n"
+	"	end\n"
+	"	for k, v in pairs(copy) do t[k] = v end\n"
+	"end\n"
+	"local globals, modules, libs = snapshot(G), {}, {}\n"
+	"for k, v in pairs(loaded) do\n"
+	"	modules[k] = v\n"
+	"	if type(v) == 'table' and v ~= G and v ~= loaded then libs[v] = snapshot(v) end\n"
+	"end\n"
+	"local Gmeta, stringmeta = getmetatable(G), getmetatable('')\n"
+	"local stringmetacopy = stringmeta and snapshot(stringmeta)\n"
+	"return function()\n"
+	"	for k in pairs(loaded) do\n"
+	"		if not modules[k] then loaded[k] = nil end\n"
+	"	end\n"
+	"	for k, v in pairs(modules) do loaded[k] = v end\n"
+	"	restore(G, globals)\n"
+	"	for t, copy in pairs(libs) do restore(t, copy) end\n"
+	"	setmetatable(G, Gmeta)\n"
+	"	setmetatable('', stringmeta)\n"
+	"	if stringmeta then restore(stringmeta, stringmetacopy) end\n"
+	"	pkg.path, pkg.cpath = path, cpath\n"
+	"end\n";
+
+lua_State *CEventSystem::AcquireLuaState(const bool bDzVents)
+{
+	std::vector<lua_State *> &pool = m_luaStatePool[bDzVents ? 1 : 0];
+	if (!pool.empty())
+	{
+		lua_State *lua_state = pool.back();
+		pool.pop_back();
+		return lua_state;
+	}
+
+	lua_State *lua_state = luaL_newstate();
+
+	// load Lua libraries
+	static const luaL_Reg lualibs[] = {
+		{ "base", luaopen_base },     { "io", luaopen_io },	{ "table", luaopen_table },
+		{ "string", luaopen_string }, { "math", luaopen_math }, { nullptr, nullptr },
+	};
+
+	const luaL_Reg *lib = lualibs;
+	for (; lib->func != nullptr; lib++)
+	{
+		lib->func(lua_state);
+		lua_settop(lua_state, 0);
+	}
+	luaL_openlibs(lua_state);
 
+	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
+	lua_setglobal(lua_state, "domoticz_applyJsonPath");
+
+	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
+	lua_setglobal(lua_state, "domoticz_applyXPath");
+
+	// reroute print library to Domoticz logger
+	lua_pushcfunction(lua_state, (bDzVents) ? CdzVents::l_domoticz_print : l_domoticz_print);
+	lua_setglobal(lua_state, "print");
+
+	if (luaL_dostring(lua_state, szLuaStateReset) == 0)
+		lua_setfield(lua_state, LUA_REGISTRYINDEX, "domoticz_reset_state");
+	lua_settop(lua_state, 0);
+	return lua_state;
+}
+
+void CEventSystem::ReleaseLuaState(lua_State *lua_state, const bool bDzVents, const bool bReuse)
+{
+	std::vector<lua_State *> &pool = m_luaStatePool[bDzVents ? 1 : 0];
+	if ((!bReuse) || (pool.size() >= 2))
+	{
+		lua_close(lua_state);
+		return;
+	}
+
+	lua_sethook(lua_state, nullptr, 0, 0);
+	lua_settop(lua_state, 0);
+	if (lua_getfield(lua_state, LUA_REGISTRYINDEX, "domoticz_reset_state") != LUA_TFUNCTION)
+	{
+		lua_close(lua_state);
+		return;
+	}
+	if (lua_pcall(lua_state, 0, 0, 0) != 0)
+	{
+		_log.Log(LOG_ERROR, "EventSystem: could not reset Lua state (%s)", lua_tostring(lua_state, -1));
+		lua_close(lua_state);
+		return;
+	}
+	lua_settop(lua_state, 0);
+	pool.push_back(lua_state);
+}
+
+void CEventSystem::ClearLuaStatePool()
+{
+	std::lock_guard<std::mutex> l(luaMutex);
+	for (auto &pool : m_luaStatePool)
+	{
+		for (auto lua_state : pool)
+			lua_close(lua_state);
+		pool.clear();
+	}
 }
 
 void CEventSystem::luaStop(lua_State *L, lua_Debug *ar)
@@ -8,6 +8,8 @@
 #include "LuaCommon.h"
 #include "NotificationObserver.h"
 
+class CLatencyHistogram;
+
 class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 {
 	friend class CdzVents;
@@ -24,6 +26,7 @@ class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 		std::string Actions;
 		int SequenceNo;
 		int EventStatus;
+		CLatencyHistogram *pLatency; // Lua and Python events
 
 	};
 
@@ -79,6 +82,7 @@ public:
 		std::map<uint8_t, float> JsonMapFloat;
 		std::map<uint8_t, bool> JsonMapBool;
 		std::map<uint8_t, std::string> JsonMapString;
+		uint64_t generation = 0; // m_devicestatesGeneration of the last change
 	};
 
 	struct _tUserVariable
@@ -118,6 +122,7 @@ public:
 	void WWWUpdateSecurityState(int securityStatus);
 	void WWWGetItemStates(std::vector<_tDeviceStatus> &iStates);
 	void SetEnabled(bool bEnabled);
+	size_t GetQueueDepth();
 	void GetCurrentStates();
 	void GetCurrentScenesGroups();
 	void GetCurrentUserVariables();
@@ -155,6 +160,51 @@ private:
 		time_t timestamp;
 	};
 
+	// Positions in m_events of the active database events that can trigger on an item, built by LoadEvents
+	struct _tEventIndex
+	{
+		std::vector<size_t> Scripts[REASON_SHELLCOMMAND + 1]; // Lua and Python events, they run for every item in their scope
+		std::map<uint64_t, std::vector<size_t>> BlocklyDevices; // Blockly events with "[idx]" in their conditions
+		std::map<uint64_t, std::vector<size_t>> BlocklyVariables; // Blockly events with "variable[idx]" in their conditions
+		std::vector<size_t> BlocklySecurity;
+		std::vector<size_t> BlocklyTime;
+	};
+
+	// Compiled conditions of a Blockly event, for the sunrise and sunset times they were compiled with
+	struct _tBlocklyChunk
+	{
+		int Sunrise = -1;
+		int Sunset = -1;
+		std::string ByteCode;
+	};
+
+	// Event scripts of a script directory by trigger, so an event does not have to list the directory
+	// and compare every script with every device name. Rebuilt when the directory changes.
+	struct _tIndexedScript
+	{
+		std::string Name; // file name
+		CLatencyHistogram *pLatency;
+		bool operator<(const _tIndexedScript &other) const
+		{
+			return Name < other.Name;
+		}
+	};
+
+	struct _tScriptIndex
+	{
+		std::string Extension;
+		bool bMatchDeviceNames = false; // device scripts named after a device only run for that device
+		time_t DirModified = 0;
+		time_t Listed = 0;
+		bool bHaveScripts = false; // any file with the extension, including the demo scripts
+		std::vector<_tIndexedScript> Scripts[REASON_SHELLCOMMAND + 1]; // sorted by file name per reason
+		std::map<std::string, std::vector<std::string>> DeviceScriptNames; // device script -> device names in its file name
+		// device scripts resolved against the device names of m_devicenamesGeneration
+		uint64_t ResolvedGeneration = 0;
+		std::vector<_tIndexedScript> AnyDeviceScripts;
+		std::map<std::string, std::vector<_tIndexedScript>> DeviceScripts; // lower case device name with underscores -> scripts
+	};
+
 	struct _tEventQueue
 	{
 		_eReason reason;
@@ -173,8 +223,9 @@ private:
 		std::map<uint8_t, bool> JsonMapBool;
 		std::map<uint8_t, std::string> JsonMapString;
 		queue_element_trigger* trigger = nullptr;
+		std::chrono::steady_clock::time_point EnqueueTime = std::chrono::steady_clock::now();
 	};
-	concurrent_queue<_tEventQueue> m_eventqueue;
+	mpsc_queue<_tEventQueue> m_eventqueue;
 
 	std::vector<_tEventTrigger> m_eventtrigger;
 	bool m_bEnabled;
@@ -185,12 +236,19 @@ private:
 	boost::shared_mutex m_eventtriggerMutex;
 	std::mutex m_measurementStatesMutex;
 	std::mutex luaMutex;
+	std::vector<lua_State *> m_luaStatePool[2]; // idle warm states, [0] classic Lua, [1] dzVents (guarded by luaMutex)
 	std::shared_ptr<std::thread> m_thread;
 	std::shared_ptr<std::thread> m_eventqueuethread;
 	StoppableTask m_TaskQueue;
 	int m_SecStatus;
 	std::string m_lua_Dir;
 	std::string m_szStartTime;
+	std::mutex m_scriptIndexMutex;
+	_tScriptIndex m_luaScriptIndex;
+	_tScriptIndex m_dzVentsScriptIndex;
+#ifdef ENABLE_PYTHON
+	_tScriptIndex m_pythonScriptIndex;
+#endif
 
 	static const std::string m_szReason[], m_szSecStatus[];
 	static const _tJsonMap JsonMap[];
@@ -202,17 +260,29 @@ private:
 	std::string UpdateSingleState(uint64_t ulDevID, const std::string &devname, int nValue, const std::string &sValue, unsigned char devType, unsigned char subType, _eSwitchType switchType,
 				      const std::string &lastUpdate, unsigned char lastLevel, unsigned char batteryLevel, const std::map<std::string, std::string> &options);
 	void EvaluateEvent(const std::vector<_tEventQueue> &items);
+	void RefreshScriptIndex(_tScriptIndex &index, const std::string &dir);
+	void GetEventScripts(_tScriptIndex &index, const _tEventQueue &item, std::vector<_tIndexedScript> &scripts);
 	void EvaluateDatabaseEvents(const _tEventQueue &item);
 	lua_State *ParseBlocklyLua(lua_State *lua_state, const _tEventItem &item);
 	bool parseBlocklyActions(const _tEventItem &item);
 	std::string ProcessVariableArgument(const std::string &Argument);
 #ifdef ENABLE_PYTHON
 	std::string m_python_Dir;
-	void EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString);
+	void EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString, CLatencyHistogram *pLatency);
 #endif
-	void EvaluateLua(const _tEventQueue &item, const std::string &filename, const std::string &LuaString);
-	void EvaluateLua(const std::vector<_tEventQueue> &items, const std::string &filename, const std::string &LuaString);
-	void luaThread(lua_State *lua_state, const std::string &filename);
+	void EvaluateLua(const _tEventQueue &item, const std::string &filename, const std::string &LuaString, CLatencyHistogram *pLatency);
+	void EvaluateLua(const std::vector<_tEventQueue> &items, const std::string &filename, const std::string &LuaString, CLatencyHistogram *pLatency);
+	struct _tLuaRun
+	{
+		std::mutex mutex;
+		bool bFinished = false;
+		bool bAbandoned = false; // set when the script runs too long, the thread closes the state itself
+		bool bSuccess = false;
+	};
+	void luaThread(lua_State *lua_state, const std::string &filename, const std::shared_ptr<_tLuaRun> &run);
+	lua_State *AcquireLuaState(bool bDzVents);
+	void ReleaseLuaState(lua_State *lua_state, bool bDzVents, bool bReuse);
+	void ClearLuaStatePool();
 	static void luaStop(lua_State *L, lua_Debug *ar);
 	std::string nValueToWording(uint8_t dType, uint8_t dSubType, _eSwitchType switchtype, int nValue, const std::string &sValue, const std::map<std::string, std::string> &options);
 	static int l_domoticz_print(lua_State* lua_state);
@@ -232,9 +302,20 @@ private:
 
 	//std::string reciprocalAction (std::string Action);
 	std::vector<_tEventItem> m_events;
+	_tEventIndex m_eventIndex; // guarded by m_eventsMutex, like m_events
+	void BuildEventIndex();
+	std::mutex m_blocklyChunksMutex;
+	std::map<uint64_t, _tBlocklyChunk> m_blocklyChunks; // by event rule ID
 
 
 	std::map<uint64_t, _tDeviceStatus> m_devicestates;
+	// increased on every device state change, the reset generation is set when devices are reloaded or removed
+	// (both guarded by m_devicestatesMutex, used by dzVents to only export what changed)
+	uint64_t m_devicestatesGeneration = 0;
+	uint64_t m_devicestatesResetGeneration = 0;
+	// increased when a device is added, removed or renamed (guarded by m_devicestatesMutex)
+	uint64_t m_devicenamesGeneration = 1;
+	void TouchDeviceState(_tDeviceStatus &item);
 	std::map<uint64_t, _tUserVariable> m_uservariables;
 	std::map<uint64_t, _tScenesGroups> m_scenesgroups;
 	std::map<std::string, float> m_tempValuesByName;
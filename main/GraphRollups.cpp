@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "GraphRollups.h"
+#include "SQLHelper.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+bool CGraphRollups::GetGroupBy(const std::string &sgroupby, _eGroupBy &groupBy)
+{
+	if (sgroupby == "month")
+		groupBy = GB_MONTH;
+	else if (sgroupby == "quarter")
+		groupBy = GB_QUARTER;
+	else if (sgroupby == "year")
+		groupBy = GB_YEAR;
+	else
+		return false;
+	return true;
+}
+
+bool CGraphRollups::GetColumnTotals(CSQLHelper &sql, const std::string &szTable, uint64_t DeviceRowID, const std::string &szColumn, const bool bSum, const _eGroupBy groupBy,
+				    std::vector<_tRollupItem> &result)
+{
+	result.clear();
+	_tRollup rollup;
+	if (!CatchUp(sql, szTable, DeviceRowID, szColumn, "", rollup))
+		return false;
+	MakeResult(rollup, groupBy, bSum, false, result);
+	return true;
+}
+
+bool CGraphRollups::GetCounterUsage(CSQLHelper &sql, const std::string &szTable, uint64_t DeviceRowID, const std::string &szCounter, const std::string &szValue,
+				    const bool bUseValuesWithoutCounter, const _eGroupBy groupBy, std::vector<_tRollupItem> &result)
+{
+	result.clear();
+	_tRollup rollup;
+	if (!CatchUp(sql, szTable, DeviceRowID, szValue, szCounter, rollup))
+		return false;
+	if ((bUseValuesWithoutCounter) && (!rollup.bNonZeroCounter))
+		MakeResult(rollup, groupBy, true, false, result);
+	else
+		MakeResult(rollup, groupBy, false, true, result);
+	return true;
+}
+
+void CGraphRollups::OnCalendarChanged()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_generation++;
+	m_rollups.clear();
+}
+
+void CGraphRollups::Clear()
+{
+	OnCalendarChanged();
+}
+
+bool CGraphRollups::CatchUp(CSQLHelper &sql, const std::string &szTable, uint64_t DeviceRowID, const std::string &szValue, const std::string &szCounter, _tRollup &rollup)
+{
+	const std::string szKey = szTable + ";" + std::to_string(DeviceRowID) + ";" + szValue + ";" + szCounter;
+	uint64_t generation;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		generation = m_generation;
+		auto itt = m_rollups.find(szKey);
+		if (itt != m_rollups.end())
+			rollup = itt->second;
+	}
+	if (rollup.Generation != generation)
+	{
+		rollup = _tRollup();
+		rollup.Generation = generation;
+	}
+
+	auto result = sql.safe_query("SELECT COUNT(*), MIN(Date), MAX(Date) FROM %s WHERE (DeviceRowID==%" PRIu64 ")", szTable.c_str(), DeviceRowID);
+	if (result.empty())
+		return false;
+	const uint64_t totalRows = std::stoull(result[0][0]);
+	const std::string szFirstDate = result[0][1];
+	const std::string szLastDate = result[0][2];
+
+	if ((rollup.Rows > totalRows) || ((rollup.Rows != 0) && (rollup.FirstDate != szFirstDate)))
+	{
+		// rows were removed, start over
+		rollup = _tRollup();
+		rollup.Generation = generation;
+	}
+	if ((rollup.Rows == totalRows) && (rollup.LastDate == szLastDate))
+		return true;
+
+	const bool bHaveCounter = !szCounter.empty();
+	for (int iPass = 0; iPass < 2; iPass++)
+	{
+		if (bHaveCounter)
+			result = sql.safe_query("SELECT Date, (%s), (%s) FROM %s WHERE (DeviceRowID==%" PRIu64 ") AND (Date>'%q') ORDER BY Date", szValue.c_str(), szCounter.c_str(),
+						szTable.c_str(), DeviceRowID, rollup.LastDate.c_str());
+		else
+			result = sql.safe_query("SELECT Date, (%s) FROM %s WHERE (DeviceRowID==%" PRIu64 ") AND (Date>'%q') ORDER BY Date", szValue.c_str(), szTable.c_str(), DeviceRowID,
+						rollup.LastDate.c_str());
+		if ((iPass == 0) && (rollup.Rows != 0) && (rollup.Rows + result.size() != totalRows))
+		{
+			// a day before the last one was added, start over
+			rollup = _tRollup();
+			rollup.Generation = generation;
+			continue;
+		}
+		break;
+	}
+	AddRows(result, bHaveCounter, rollup);
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_generation == generation)
+		m_rollups[szKey] = rollup;
+	return true;
+}
+
+void CGraphRollups::AddRows(const std::vector<std::vector<std::string>> &rows, const bool bHaveCounter, _tRollup &rollup)
+{
+	for (const auto &sd : rows)
+	{
+		rollup.Rows++;
+		if (rollup.FirstDate.empty())
+			rollup.FirstDate = sd[0];
+		rollup.LastDate = sd[0];
+		if (sd[0].size() < 7)
+			continue;
+		const int year = atoi(sd[0].substr(0, 4).c_str());
+		const int month = atoi(sd[0].substr(5, 2).c_str());
+		if ((month < 1) || (month > 12))
+			continue;
+		_tMonthBucket &bucket = rollup.Months[year * 12 + month - 1];
+		const double value = atof(sd[1].c_str());
+		bucket.Sum += value;
+		bucket.Count++;
+		if (!bHaveCounter)
+			continue;
+
+		const double counter = atof(sd[2].c_str());
+		if (counter != 0)
+			rollup.bNonZeroCounter = true;
+		if (counter <= 0)
+			continue;
+		if (!rollup.bHaveCounter)
+			bucket.Usage += value;
+		else if (rollup.LastCounter <= counter)
+			bucket.Usage += counter - rollup.LastCounter;
+		else
+			bucket.Usage += value; // meter change
+		bucket.bHaveUsage = true;
+		rollup.bHaveCounter = true;
+		rollup.LastCounter = counter;
+	}
+}
+
+void CGraphRollups::MakeResult(const _tRollup &rollup, const _eGroupBy groupBy, const bool bSum, const bool bUsage, std::vector<_tRollupItem> &result)
+{
+	std::map<std::pair<int, int>, _tMonthBucket> groups;
+	for (const auto &itt : rollup.Months)
+	{
+		const int year = itt.first / 12;
+		const int month = (itt.first % 12) + 1;
+		int category = 0;
+		if (groupBy == GB_MONTH)
+			category = month;
+		else if (groupBy == GB_QUARTER)
+			category = ((month - 1) / 3) + 1;
+		_tMonthBucket &group = groups[std::make_pair(year, category)];
+		group.Sum += itt.second.Sum;
+		group.Count += itt.second.Count;
+		group.Usage += itt.second.Usage;
+		group.bHaveUsage |= itt.second.bHaveUsage;
+	}
+	result.reserve(groups.size());
+	for (const auto &itt : groups)
+	{
+		double value;
+		if (bUsage)
+		{
+			if (!itt.second.bHaveUsage)
+				continue;
+			value = itt.second.Usage;
+		}
+		else
+		{
+			if (itt.second.Count == 0)
+				continue;
+			value = (bSum) ? itt.second.Sum : itt.second.Sum / itt.second.Count;
+		}
+		result.push_back({ itt.first.first, itt.first.second, value });
+	}
+}
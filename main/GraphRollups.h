@@ -0,0 +1,75 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CSQLHelper;
+
+// Monthly roll-ups of the calendar tables, used by the compare (groupby) graphs
+//
+// A roll-up is kept per table, device and column expression. It is caught up with the calendar rows that
+// were added since the last request, so a graph only reads the new days instead of the whole history.
+// Quarters and years are combined from the monthly buckets.
+// Updating or deleting calendar rows (or adding rows before the last day) rebuilds the roll-up.
+class CGraphRollups
+{
+public:
+	enum _eGroupBy
+	{
+		GB_MONTH = 0,
+		GB_QUARTER,
+		GB_YEAR
+	};
+	struct _tRollupItem
+	{
+		int Year;
+		int Category; // month 1-12, quarter 1-4, or 0 for a year
+		double Value;
+	};
+
+	static bool GetGroupBy(const std::string &sgroupby, _eGroupBy &groupBy);
+
+	// Average (or sum) of the column expression per group
+	bool GetColumnTotals(CSQLHelper &sql, const std::string &szTable, uint64_t DeviceRowID, const std::string &szColumn, bool bSum, _eGroupBy groupBy,
+			     std::vector<_tRollupItem> &result);
+	// Usage per group as the difference between the (positive) counters of consecutive days.
+	// When the counter went down the value of that day is used, the first day with a counter adds its value.
+	// With bUseValuesWithoutCounter the values are summed when the device has no counters at all (managed counters)
+	bool GetCounterUsage(CSQLHelper &sql, const std::string &szTable, uint64_t DeviceRowID, const std::string &szCounter, const std::string &szValue,
+			     bool bUseValuesWithoutCounter, _eGroupBy groupBy, std::vector<_tRollupItem> &result);
+
+	// Called for every update or delete of a calendar row
+	void OnCalendarChanged();
+	void Clear();
+
+private:
+	struct _tMonthBucket
+	{
+		double Sum = 0;
+		uint64_t Count = 0;
+		double Usage = 0;
+		bool bHaveUsage = false;
+	};
+	struct _tRollup
+	{
+		uint64_t Generation = 0;
+		uint64_t Rows = 0;
+		std::string FirstDate;
+		std::string LastDate;
+		bool bHaveCounter = false;
+		bool bNonZeroCounter = false;
+		double LastCounter = 0;
+		// year * 12 + (month - 1)
+		std::map<int, _tMonthBucket> Months;
+	};
+
+	bool CatchUp(CSQLHelper &sql, const std::string &szTable, uint64_t DeviceRowID, const std::string &szValue, const std::string &szCounter, _tRollup &rollup);
+	static void AddRows(const std::vector<std::vector<std::string>> &rows, bool bHaveCounter, _tRollup &rollup);
+	static void MakeResult(const _tRollup &rollup, _eGroupBy groupBy, bool bSum, bool bUsage, std::vector<_tRollupItem> &result);
+
+	std::mutex m_mutex;
+	uint64_t m_generation = 0;
+	std::map<std::string, _tRollup> m_rollups;
+};
@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include "IngestBenchmark.h"
+#include "Helper.h"
+#include "Logger.h"
+#include "RFXNames.h"
+#include "SQLHelper.h"
+#include "mainworker.h"
+#include "../hardware/Dummy.h"
+#include "../hardware/P1MeterTCP.h"
+#include "../hardware/hardwaretypes.h"
+#include <ctime>
+#include <fstream>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#define BENCHMARK_BUILTIN_SENSORS 32
+#define BENCHMARK_BUILTIN_METERS 8
+#define BENCHMARK_BUILTIN_SWITCHES 16
+#define BENCHMARK_IDLE_TIMEOUT_SEC 60
+
+CIngestBenchmark::~CIngestBenchmark()
+{
+	RemoveHardware();
+}
+
+bool CIngestBenchmark::Run(const std::string &szFile, const int iRepeat)
+{
+	m_bBuiltin = szFile.empty();
+	if ((!m_bBuiltin) && (!LoadFrames(szFile)))
+		return false;
+	if (!AddHardware())
+		return false;
+
+	_log.Log(LOG_STATUS, "Benchmark: Replaying %s %d times", (m_bBuiltin) ? "the built-in frames" : std_format("%d frames", static_cast<int>(m_frames.size())).c_str(), iRepeat);
+
+	// The first pass creates the devices, it is not measured
+	RunPass(1, false);
+
+	bool bSuccess = true;
+	_tPassResult results[2];
+	for (int ii = 0; ii < 2; ii++)
+	{
+		const bool bEventSystem = (ii == 1);
+		results[ii] = RunPass(iRepeat, bEventSystem);
+		const _tPassResult &result = results[ii];
+		_log.Log(LOG_STATUS, "Benchmark: Event system %s: %" PRIu64 " updates in %.2f seconds, %.0f updates/s, latency p50 %" PRIu64 " us, p99 %" PRIu64 " us, max %" PRIu64
+			 " us, cpu %.1f us/update",
+			 (bEventSystem) ? "on " : "off", result.Updates, result.Seconds, result.UpdatesPerSecond, result.P50LatencyUs, result.P99LatencyUs, result.MaxLatencyUs,
+			 result.CpuUsPerUpdate);
+		if (result.Updates == 0)
+			bSuccess = false;
+	}
+	if (bSuccess)
+		_log.Log(LOG_STATUS, "Benchmark: Event system cost: %.1f us cpu/update", results[1].CpuUsPerUpdate - results[0].CpuUsPerUpdate);
+	else
+		_log.Log(LOG_ERROR, "Benchmark: No updates were processed!");
+
+	RemoveHardware();
+	return bSuccess;
+}
+
+void CIngestBenchmark::RemoveDatabase(const std::string &szDatabase)
+{
+	std::remove(szDatabase.c_str());
+	std::remove((szDatabase + "-wal").c_str());
+	std::remove((szDatabase + "-shm").c_str());
+	std::remove((szDatabase + "-journal").c_str());
+	CShortLogStore::Remove(szDatabase + "-shortlog/");
+}
+
+bool CIngestBenchmark::LoadFrames(const std::string &szFile)
+{
+	std::ifstream infile(szFile.c_str());
+	if (!infile.is_open())
+	{
+		_log.Log(LOG_ERROR, "Benchmark: Could not open frames file: %s", szFile.c_str());
+		return false;
+	}
+	std::string sLine;
+	std::string szTelegram;
+	bool bInTelegram = false;
+	int iLine = 0;
+	while (std::getline(infile, sLine))
+	{
+		iLine++;
+		stdstring_trimws(sLine);
+		if (bInTelegram)
+		{
+			szTelegram += sLine + "\r\n";
+			if ((!sLine.empty()) && (sLine[0] == '!'))
+			{
+				_tFrame frame;
+				frame.bP1 = true;
+				frame.Data.assign(szTelegram.begin(), szTelegram.end());
+				m_frames.push_back(frame);
+				bInTelegram = false;
+			}
+			continue;
+		}
+		if ((sLine.empty()) || (sLine[0] == '#'))
+			continue;
+		if (sLine[0] == '/')
+		{
+			// start of a P1 telegram
+			szTelegram = sLine + "\r\n";
+			bInTelegram = true;
+			continue;
+		}
+		stdreplace(sLine, " ", "");
+		std::vector<char> bytes = HexToBytes(sLine);
+		if ((bytes.size() < 2) || (static_cast<uint8_t>(bytes[0]) != bytes.size() - 1))
+		{
+			_log.Log(LOG_ERROR, "Benchmark: Invalid frame on line %d", iLine);
+			continue;
+		}
+		_tFrame frame;
+		frame.Data.assign(bytes.begin(), bytes.end());
+		m_frames.push_back(frame);
+	}
+	if (m_frames.empty())
+	{
+		_log.Log(LOG_ERROR, "Benchmark: No frames found in: %s", szFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+void CIngestBenchmark::MakeBuiltinFrames(const int iRound, std::vector<_tFrame> &frames)
+{
+	frames.clear();
+	RBUF tsen;
+	for (int ii = 0; ii < BENCHMARK_BUILTIN_SENSORS; ii++)
+	{
+		memset(&tsen, 0, sizeof(RBUF));
+		tsen.TEMP_HUM.packetlength = sizeof(tsen.TEMP_HUM) - 1;
+		tsen.TEMP_HUM.packettype = pTypeTEMP_HUM;
+		tsen.TEMP_HUM.subtype = sTypeTH5;
+		tsen.TEMP_HUM.battery_level = 9;
+		tsen.TEMP_HUM.rssi = 12;
+		tsen.TEMP_HUM.id1 = 0x10;
+		tsen.TEMP_HUM.id2 = static_cast<BYTE>(ii);
+		int at10 = 150 + ((iRound + ii) % 100);
+		tsen.TEMP_HUM.temperatureh = static_cast<BYTE>(at10 / 256);
+		tsen.TEMP_HUM.temperaturel = static_cast<BYTE>(at10 % 256);
+		tsen.TEMP_HUM.humidity = static_cast<BYTE>(40 + ((iRound + ii) % 40));
+		tsen.TEMP_HUM.humidity_status = Get_Humidity_Level(tsen.TEMP_HUM.humidity);
+		_tFrame frame;
+		frame.Data.assign(reinterpret_cast<const uint8_t *>(&tsen.TEMP_HUM), reinterpret_cast<const uint8_t *>(&tsen.TEMP_HUM) + sizeof(tsen.TEMP_HUM));
+		frames.push_back(frame);
+	}
+	for (int ii = 0; ii < BENCHMARK_BUILTIN_METERS; ii++)
+	{
+		memset(&tsen, 0, sizeof(RBUF));
+		tsen.ENERGY.packetlength = sizeof(tsen.ENERGY) - 1;
+		tsen.ENERGY.packettype = pTypeENERGY;
+		tsen.ENERGY.subtype = sTypeELEC2;
+		tsen.ENERGY.battery_level = 9;
+		tsen.ENERGY.rssi = 12;
+		tsen.ENERGY.id1 = 0x20;
+		tsen.ENERGY.id2 = static_cast<BYTE>(ii);
+		const uint32_t instant = 100 + ((iRound * 7 + ii) % 2000);
+		tsen.ENERGY.instant3 = static_cast<BYTE>(instant >> 8);
+		tsen.ENERGY.instant4 = static_cast<BYTE>(instant & 0xFF);
+		// total in Wh * 223.666
+		const uint64_t total = static_cast<uint64_t>((1000000.0 + iRound * 10.0) * 223.666);
+		tsen.ENERGY.total3 = static_cast<BYTE>((total >> 24) & 0xFF);
+		tsen.ENERGY.total4 = static_cast<BYTE>((total >> 16) & 0xFF);
+		tsen.ENERGY.total5 = static_cast<BYTE>((total >> 8) & 0xFF);
+		tsen.ENERGY.total6 = static_cast<BYTE>(total & 0xFF);
+		_tFrame frame;
+		frame.Data.assign(reinterpret_cast<const uint8_t *>(&tsen.ENERGY), reinterpret_cast<const uint8_t *>(&tsen.ENERGY) + sizeof(tsen.ENERGY));
+		frames.push_back(frame);
+	}
+	for (int ii = 0; ii < BENCHMARK_BUILTIN_SWITCHES; ii++)
+	{
+		memset(&tsen, 0, sizeof(RBUF));
+		tsen.LIGHTING2.packetlength = sizeof(tsen.LIGHTING2) - 1;
+		tsen.LIGHTING2.packettype = pTypeLighting2;
+		tsen.LIGHTING2.subtype = sTypeAC;
+		tsen.LIGHTING2.id1 = 0x01;
+		tsen.LIGHTING2.id2 = 0x23;
+		tsen.LIGHTING2.id3 = 0x45;
+		tsen.LIGHTING2.id4 = static_cast<BYTE>(ii);
+		tsen.LIGHTING2.unitcode = 1;
+		tsen.LIGHTING2.cmnd = ((iRound + ii) % 2 == 0) ? light2_sOn : light2_sOff;
+		tsen.LIGHTING2.level = 15;
+		tsen.LIGHTING2.rssi = 12;
+		_tFrame frame;
+		frame.Data.assign(reinterpret_cast<const uint8_t *>(&tsen.LIGHTING2), reinterpret_cast<const uint8_t *>(&tsen.LIGHTING2) + sizeof(tsen.LIGHTING2));
+		frames.push_back(frame);
+	}
+}
+
+bool CIngestBenchmark::AddHardware()
+{
+	m_sql.safe_query("INSERT INTO Hardware (Name, Enabled, Type, Address, Port) VALUES ('Benchmark RFX', 1, %d, '', 0)", HTYPE_Dummy);
+	auto result = m_sql.safe_query("SELECT MAX(ID) FROM Hardware");
+	if (result.empty())
+		return false;
+	const int iRFXID = atoi(result[0][0].c_str());
+	m_sql.safe_query("INSERT INTO Hardware (Name, Enabled, Type, Address, Port) VALUES ('Benchmark P1', 1, %d, '127.0.0.1', 0)", HTYPE_P1SmartMeterLAN);
+	result = m_sql.safe_query("SELECT MAX(ID) FROM Hardware");
+	if (result.empty())
+		return false;
+	const int iP1ID = atoi(result[0][0].c_str());
+
+	// The hardware is never started, the frames are fed to it directly
+	m_pRFXHardware = new CDummy(iRFXID);
+	m_pRFXHardware->HwdType = HTYPE_Dummy;
+	m_pRFXHardware->m_Name = "Benchmark RFX";
+	m_pRFXHardware->m_ShortName = Hardware_Short_Desc(HTYPE_Dummy);
+	m_mainworker.AddDomoticzHardware(m_pRFXHardware);
+
+	m_pP1Hardware = new P1MeterTCP(iP1ID, "127.0.0.1", 0, true, 0, "");
+	m_pP1Hardware->HwdType = HTYPE_P1SmartMeterLAN;
+	m_pP1Hardware->m_Name = "Benchmark P1";
+	m_pP1Hardware->m_ShortName = Hardware_Short_Desc(HTYPE_P1SmartMeterLAN);
+	m_mainworker.AddDomoticzHardware(m_pP1Hardware);
+
+	// Without configured hardware the main worker does not start these
+	m_mainworker.m_notificationsystem.Start();
+	return true;
+}
+
+void CIngestBenchmark::RemoveHardware()
+{
+	if (m_pRFXHardware)
+		m_mainworker.RemoveDomoticzHardware(m_pRFXHardware);
+	m_pRFXHardware = nullptr;
+	if (m_pP1Hardware)
+		m_mainworker.RemoveDomoticzHardware(m_pP1Hardware);
+	m_pP1Hardware = nullptr;
+}
+
+CIngestBenchmark::_tPassResult CIngestBenchmark::RunPass(const int iRepeat, const bool bEventSystem)
+{
+	m_sql.m_bEnableEventSystem = bEventSystem;
+	m_mainworker.m_eventsystem.SetEnabled(bEventSystem);
+	if (bEventSystem)
+		m_mainworker.m_eventsystem.StartEventSystem();
+	else
+		m_mainworker.m_eventsystem.StopEventSystem();
+
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_latencies.clear();
+		m_latencies.reserve(static_cast<size_t>(iRepeat) * ((m_bBuiltin) ? (BENCHMARK_BUILTIN_SENSORS + BENCHMARK_BUILTIN_METERS + BENCHMARK_BUILTIN_SWITCHES) : m_frames.size()));
+	}
+	m_mainworker.SetRxProcessedCallback([this](uint64_t latencyUs) { OnProcessed(latencyUs); });
+
+	const std::clock_t cpuStart = std::clock();
+	const auto tStart = std::chrono::steady_clock::now();
+	for (int iRound = 0; iRound < iRepeat; iRound++)
+	{
+		if (m_bBuiltin)
+			MakeBuiltinFrames(iRound, m_frames);
+		for (const auto &frame : m_frames)
+		{
+			if (frame.bP1)
+				m_pP1Hardware->ParseP1Data(frame.Data.data(), static_cast<int>(frame.Data.size()), true, 0);
+			else
+				m_pRFXHardware->sDecodeRXMessage(m_pRFXHardware, frame.Data.data(), nullptr, 255, nullptr);
+		}
+	}
+	WaitIdle(bEventSystem);
+	const std::clock_t cpuEnd = std::clock();
+
+	m_mainworker.SetRxProcessedCallback(nullptr);
+
+	_tPassResult result;
+	std::lock_guard<std::mutex> l(m_mutex);
+	result.Updates = m_latencies.size();
+	if (result.Updates == 0)
+		return result;
+	result.Seconds = std::chrono::duration<double>(m_lastProcessed - tStart).count();
+	if (result.Seconds > 0)
+		result.UpdatesPerSecond = result.Updates / result.Seconds;
+	std::sort(m_latencies.begin(), m_latencies.end());
+	result.P50LatencyUs = m_latencies[(m_latencies.size() - 1) * 50 / 100];
+	result.P99LatencyUs = m_latencies[(m_latencies.size() - 1) * 99 / 100];
+	result.MaxLatencyUs = m_latencies.back();
+	result.CpuUsPerUpdate = (static_cast<double>(cpuEnd - cpuStart) * 1000000.0 / CLOCKS_PER_SEC) / result.Updates;
+	return result;
+}
+
+void CIngestBenchmark::WaitIdle(const bool bEventSystem)
+{
+	// The RX queues are idle when they are empty and nothing was processed for a while
+	const auto tTimeout = std::chrono::steady_clock::now() + std::chrono::seconds(BENCHMARK_IDLE_TIMEOUT_SEC);
+	size_t lastCount = (size_t)-1;
+	int iIdleChecks = 0;
+	while ((iIdleChecks < 5) && (std::chrono::steady_clock::now() < tTimeout))
+	{
+		sleep_milliseconds(20);
+		size_t queued = 0;
+		for (const auto &stats : m_mainworker.GetRxQueueStats())
+			queued += stats.QueueDepth;
+		size_t count;
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			count = m_latencies.size();
+		}
+		if ((queued == 0) && (count == lastCount))
+			iIdleChecks++;
+		else
+			iIdleChecks = 0;
+		lastCount = count;
+	}
+	m_sql.FlushWrites();
+	while ((bEventSystem) && (m_mainworker.m_eventsystem.GetQueueDepth() != 0) && (std::chrono::steady_clock::now() < tTimeout))
+		sleep_milliseconds(10);
+}
+
+void CIngestBenchmark::OnProcessed(const uint64_t latencyUs)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_latencies.push_back(latencyUs);
+	m_lastProcessed = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CDomoticzHardwareBase;
+class P1MeterBase;
+
+// Replays received frames through the RX pipeline (hardware -> MainWorker RX queue -> decoders -> database)
+//
+// Used by the -benchmark command line option, on a temporary database without web servers.
+// The frames file has one RFXtrx frame (tRBUF packet) in hex per line, the first byte is the packet length.
+// P1 telegrams are copied as they are, from the '/' line up to and including the '!' line.
+// Empty lines and lines starting with '#' are skipped. Without a file a built-in set of sensors, meters and switches is used.
+class CIngestBenchmark
+{
+public:
+	struct _tPassResult
+	{
+		uint64_t Updates = 0;
+		double Seconds = 0;
+		double UpdatesPerSecond = 0;
+		uint64_t P50LatencyUs = 0; // from push to processed (written to DeviceStatus)
+		uint64_t P99LatencyUs = 0;
+		uint64_t MaxLatencyUs = 0;
+		double CpuUsPerUpdate = 0; // process cpu time, including the event system when it is enabled
+	};
+
+	~CIngestBenchmark();
+
+	// Replays the frames iRepeat times, first with the event system disabled and then enabled
+	bool Run(const std::string &szFile, int iRepeat);
+	// Removes the temporary database (and its short log store)
+	static void RemoveDatabase(const std::string &szDatabase);
+
+private:
+	struct _tFrame
+	{
+		bool bP1 = false;
+		std::vector<uint8_t> Data;
+	};
+
+	bool LoadFrames(const std::string &szFile);
+	static void MakeBuiltinFrames(int iRound, std::vector<_tFrame> &frames);
+	bool AddHardware();
+	void RemoveHardware();
+	_tPassResult RunPass(int iRepeat, bool bEventSystem);
+	void WaitIdle(bool bEventSystem);
+	void OnProcessed(uint64_t latencyUs);
+
+	std::vector<_tFrame> m_frames;
+	bool m_bBuiltin = false;
+	CDomoticzHardwareBase *m_pRFXHardware = nullptr;
+	P1MeterBase *m_pP1Hardware = nullptr;
+
+	std::mutex m_mutex;
+	std::vector<uint64_t> m_latencies;
+	std::chrono::steady_clock::time_point m_lastProcessed;
+};
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "LatencyStats.h"
+#include <sstream>
+
+// more names per stage are counted as "other"
+#define LATENCY_MAX_NAMES_PER_STAGE 256
+
+CLatencyHistogram::CLatencyHistogram()
+{
+	for (auto &bucket : m_buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	m_sumUs.store(0, std::memory_order_relaxed);
+	m_maxUs.store(0, std::memory_order_relaxed);
+}
+
+void CLatencyHistogram::Record(const uint64_t latencyUs)
+{
+	int iBucket = 0;
+	while ((iBucket < NumBuckets - 1) && (latencyUs > (1ULL << iBucket)))
+		iBucket++;
+	m_buckets[iBucket].fetch_add(1, std::memory_order_relaxed);
+	m_sumUs.fetch_add(latencyUs, std::memory_order_relaxed);
+	uint64_t maxUs = m_maxUs.load(std::memory_order_relaxed);
+	while ((latencyUs > maxUs) && (!m_maxUs.compare_exchange_weak(maxUs, latencyUs, std::memory_order_relaxed)))
+		;
+}
+
+CLatencyHistogram::_tSnapshot CLatencyHistogram::GetSnapshot() const
+{
+	_tSnapshot snapshot;
+	for (int ii = 0; ii < NumBuckets; ii++)
+	{
+		snapshot.Buckets[ii] = m_buckets[ii].load(std::memory_order_relaxed);
+		// the count is the sum of the buckets, so a snapshot taken while recording stays consistent
+		snapshot.Count += snapshot.Buckets[ii];
+	}
+	snapshot.SumUs = m_sumUs.load(std::memory_order_relaxed);
+	snapshot.MaxUs = m_maxUs.load(std::memory_order_relaxed);
+	return snapshot;
+}
+
+uint64_t CLatencyHistogram::BucketBound(const int iBucket)
+{
+	if (iBucket >= NumBuckets - 1)
+		return 0;
+	return 1ULL << iBucket;
+}
+
+uint64_t CLatencyHistogram::Percentile(const _tSnapshot &snapshot, const int iPercentile)
+{
+	if (snapshot.Count == 0)
+		return 0;
+	const uint64_t rank = (snapshot.Count * iPercentile + 99) / 100;
+	uint64_t total = 0;
+	for (int ii = 0; ii < NumBuckets; ii++)
+	{
+		total += snapshot.Buckets[ii];
+		if (total >= rank)
+		{
+			const uint64_t bound = BucketBound(ii);
+			return ((bound == 0) || (bound > snapshot.MaxUs)) ? snapshot.MaxUs : bound;
+		}
+	}
+	return snapshot.MaxUs;
+}
+
+CLatencyHistogram *CLatencyStats::Get(const _eStage stage)
+{
+	return &m_stages[stage];
+}
+
+CLatencyHistogram *CLatencyStats::Get(const _eStage stage, const std::string &szName)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	auto itt = m_named.find(std::make_pair(static_cast<int>(stage), szName));
+	if (itt != m_named.end())
+		return itt->second.get();
+
+	// the web commands are a fixed set registered at startup, the other names come from the configuration
+	size_t names = 0;
+	if (stage != STAGE_WEB_COMMAND)
+	{
+		for (const auto &named : m_named)
+		{
+			if (named.first.first == stage)
+				names++;
+		}
+	}
+	std::string szKey = (names < LATENCY_MAX_NAMES_PER_STAGE) ? szName : "other";
+	std::unique_ptr<CLatencyHistogram> &pHistogram = m_named[std::make_pair(static_cast<int>(stage), szKey)];
+	if (!pHistogram)
+		pHistogram.reset(new CLatencyHistogram());
+	return pHistogram.get();
+}
+
+void CLatencyStats::Record(const _eStage stage, const uint64_t latencyUs)
+{
+	m_stages[stage].Record(latencyUs);
+}
+
+void CLatencyStats::Record(const _eStage stage, const std::string &szName, const uint64_t latencyUs)
+{
+	Get(stage, szName)->Record(latencyUs);
+}
+
+std::vector<CLatencyStats::_tSeries> CLatencyStats::GetSeries()
+{
+	std::vector<_tSeries> series;
+	for (int ii = 0; ii < STAGE_MAX; ii++)
+	{
+		_tSeries item;
+		item.Stage = static_cast<_eStage>(ii);
+		item.Snapshot = m_stages[ii].GetSnapshot();
+		// the named stages are only reported per name
+		if (item.Snapshot.Count != 0)
+			series.push_back(item);
+	}
+	std::lock_guard<std::mutex> l(m_mutex);
+	for (const auto &named : m_named)
+	{
+		_tSeries item;
+		item.Stage = static_cast<_eStage>(named.first.first);
+		item.Name = named.first.second;
+		item.Snapshot = named.second->GetSnapshot();
+		// histograms are looked up before they are used, leave out the ones that never recorded anything
+		if (item.Snapshot.Count != 0)
+			series.push_back(item);
+	}
+	return series;
+}
+
+static std::string EscapeLabelValue(const std::string &szValue)
+{
+	std::string szEscaped;
+	for (const char c : szValue)
+	{
+		if (c == '\\')
+			szEscaped += "\\\\";
+		else if (c == '"')
+			szEscaped += "\\\"";
+		else if (c == '\n')
+			szEscaped += "\\n";
+		else
+			szEscaped += c;
+	}
+	return szEscaped;
+}
+
+std::string CLatencyStats::GetPrometheusText()
+{
+	std::stringstream sstr;
+	sstr.precision(10);
+	sstr << "# HELP domoticz_stage_latency_seconds Time spent in a stage of the receive, event and web pipelines\n";
+	sstr << "# TYPE domoticz_stage_latency_seconds histogram\n";
+	for (const auto &series : GetSeries())
+	{
+		std::string szLabels = std::string("stage=\"") + StageName(series.Stage) + "\"";
+		if (!series.Name.empty())
+			szLabels += ",name=\"" + EscapeLabelValue(series.Name) + "\"";
+
+		uint64_t cumulative = 0;
+		for (int ii = 0; ii < CLatencyHistogram::NumBuckets; ii++)
+		{
+			cumulative += series.Snapshot.Buckets[ii];
+			const uint64_t bound = CLatencyHistogram::BucketBound(ii);
+			sstr << "domoticz_stage_latency_seconds_bucket{" << szLabels << ",le=\"";
+			if (bound == 0)
+				sstr << "+Inf";
+			else
+				sstr << static_cast<double>(bound) / 1000000.0;
+			sstr << "\"} " << cumulative << "\n";
+		}
+		sstr << "domoticz_stage_latency_seconds_sum{" << szLabels << "} " << static_cast<double>(series.Snapshot.SumUs) / 1000000.0 << "\n";
+		sstr << "domoticz_stage_latency_seconds_count{" << szLabels << "} " << series.Snapshot.Count << "\n";
+	}
+	return sstr.str();
+}
+
+const char *CLatencyStats::StageName(const _eStage stage)
+{
+	switch (stage)
+	{
+	case STAGE_RX_QUEUE_WAIT:
+		return "rx_queue_wait";
+	case STAGE_RX_DECODE:
+		return "rx_decode";
+	case STAGE_SQL_UPDATE_VALUE:
+		return "sql_update_value";
+	case STAGE_EVENT_QUEUE_WAIT:
+		return "event_queue_wait";
+	case STAGE_SCRIPT:
+		return "script";
+	case STAGE_PUSH_LINK:
+		return "push_link";
+	case STAGE_WEB_COMMAND:
+		return "web_command";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Latency histogram with fixed power of two buckets (1 us up to 16.7 seconds and +Inf)
+//
+// Record() only uses relaxed atomics, so it can be called from any thread without locking.
+class CLatencyHistogram
+{
+public:
+	static const int NumBuckets = 26;
+
+	struct _tSnapshot
+	{
+		uint64_t Count = 0;
+		uint64_t SumUs = 0;
+		uint64_t MaxUs = 0;
+		uint64_t Buckets[NumBuckets] = {}; // not cumulative
+	};
+
+	CLatencyHistogram();
+
+	void Record(uint64_t latencyUs);
+	_tSnapshot GetSnapshot() const;
+
+	// Upper bound of a bucket in microseconds, the last bucket has no bound (0)
+	static uint64_t BucketBound(int iBucket);
+	// Approximate percentile (upper bound of the bucket it falls in)
+	static uint64_t Percentile(const _tSnapshot &snapshot, int iPercentile);
+
+private:
+	std::atomic<uint64_t> m_buckets[NumBuckets];
+	std::atomic<uint64_t> m_sumUs;
+	std::atomic<uint64_t> m_maxUs;
+};
+
+// Latency histograms of the fixed stages between a hardware receiving a message and the scripts it triggers
+//
+// The named stages (scripts, push links, web commands) get one histogram per name, the callers look it up once
+// (when a command is registered, a script is indexed or a push link is first used) and keep the pointer.
+// Histograms are never removed, so the pointers handed out stay valid.
+class CLatencyStats
+{
+public:
+	enum _eStage
+	{
+		STAGE_RX_QUEUE_WAIT = 0,
+		STAGE_RX_DECODE,
+		STAGE_SQL_UPDATE_VALUE,
+		STAGE_EVENT_QUEUE_WAIT,
+		STAGE_SCRIPT,
+		STAGE_PUSH_LINK,
+		STAGE_WEB_COMMAND,
+		STAGE_MAX
+	};
+
+	struct _tSeries
+	{
+		_eStage Stage;
+		std::string Name;
+		CLatencyHistogram::_tSnapshot Snapshot;
+	};
+
+	CLatencyStats() = default;
+	CLatencyStats(const CLatencyStats &) = delete;
+	CLatencyStats &operator=(const CLatencyStats &) = delete;
+
+	CLatencyHistogram *Get(_eStage stage);
+	CLatencyHistogram *Get(_eStage stage, const std::string &szName);
+
+	void Record(_eStage stage, uint64_t latencyUs);
+	void Record(_eStage stage, const std::string &szName, uint64_t latencyUs);
+
+	std::vector<_tSeries> GetSeries();
+	// Prometheus text exposition format
+	std::string GetPrometheusText();
+
+	static const char *StageName(_eStage stage);
+
+private:
+	CLatencyHistogram m_stages[STAGE_MAX];
+	std::mutex m_mutex;
+	std::map<std::pair<int, std::string>, std::unique_ptr<CLatencyHistogram>> m_named;
+};
+
+// Records the time between construction and destruction
+class CLatencyTimer
+{
+public:
+	explicit CLatencyTimer(CLatencyHistogram *pHistogram)
+		: m_pHistogram(pHistogram)
+		, m_tStart(std::chrono::steady_clock::now())
+	{
+	}
+	~CLatencyTimer()
+	{
+		m_pHistogram->Record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_tStart).count());
+	}
+	CLatencyTimer(const CLatencyTimer &) = delete;
+	CLatencyTimer &operator=(const CLatencyTimer &) = delete;
+
+private:
+	CLatencyHistogram *m_pHistogram;
+	std::chrono::steady_clock::time_point m_tStart;
+};
+
+extern CLatencyStats m_latencystats;
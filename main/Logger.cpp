@@ -10,6 +10,9 @@
 #ifndef WIN32
 #include <syslog.h>
 #include <errno.h>
+#include <unistd.h>
+#else
+#include <io.h>
 #endif
 
 #include "SQLHelper.h"
@@ -19,6 +22,23 @@
 
 #define MAX_ACLFLOG_LINES 100000
 
+// lines a thread can queue for the log file before the overflow policy applies (power of 2)
+#define LOG_RING_SIZE 1024
+// the file writer wakes up at least this often (milliseconds)
+#define LOG_WRITE_INTERVAL 200
+// the log file is synced to disk at most this often (seconds)
+#define LOG_SYNC_INTERVAL 5
+
+// Lines queued for the log file by one thread, it is the only producer and the file writer (m_filemutex locked) the only consumer
+struct CLogger::_tLogRing
+{
+	std::string lines[LOG_RING_SIZE];
+	uint64_t sequence[LOG_RING_SIZE];
+	std::atomic<uint32_t> head{ 0 }; // next slot to write, owned by the producer
+	std::atomic<uint32_t> tail{ 0 }; // next slot to read, owned by the consumer
+	std::atomic<bool> bClosed{ false }; // the thread has ended, the ring is dropped once it is empty
+};
+
 extern bool g_bRunAsDaemon;
 extern bool g_bUseSyslog;
 
@@ -29,9 +49,28 @@ CLogger::_tLogLineStruct::_tLogLineStruct(const _eLogLevel nlevel, const std::st
 	logmessage = nlogmessage;
 }
 
+// Index of the level in m_lastlog
+static int LastLogIndex(const _eLogLevel level)
+{
+	switch (level)
+	{
+	case LOG_STATUS:
+		return 1;
+	case LOG_ERROR:
+		return 2;
+	case LOG_DEBUG_INT:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+static const _eLogLevel g_lastloglevels[4] = { LOG_NORM, LOG_STATUS, LOG_ERROR, LOG_DEBUG_INT };
+
 CLogger::CLogger()
 {
-	m_bInSequenceMode = false;
+	for (auto &last : m_lastlog)
+		last.lines.resize(MAX_LOG_LINE_BUFFER);
 	m_bEnableLogThreadIDs = false;
 	m_bEnableLogTimestamps = true;
 	m_bEnableErrorsToNotificationSystem = false;
@@ -42,8 +81,13 @@ CLogger::CLogger()
 
 CLogger::~CLogger()
 {
-	if (m_outputfile.is_open())
-		m_outputfile.close();
+	StopFileWriter();
+	std::unique_lock<std::mutex> lock(m_filemutex);
+	if (m_outputfile != nullptr)
+	{
+		fclose(m_outputfile);
+		m_outputfile = nullptr;
+	}
 }
 
 // Supported flags: all,normal,status,error,debug
@@ -173,26 +217,256 @@ bool CLogger::IsACLFlogEnabled()
 
 void CLogger::SetOutputFile(const char *OutputFile)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-	if (m_outputfile.is_open())
-		m_outputfile.close();
+	std::unique_lock<std::mutex> lock(m_filemutex);
+	// lines queued for the previous file are still written to it
+	WriteQueuedLines(true);
+	m_outputfilename = (OutputFile != nullptr) ? OutputFile : "";
+	OpenOutputFile();
+}
+
+void CLogger::ReopenOutputFile()
+{
+	m_bReopenOutputFile = true;
+}
+
+void CLogger::OpenOutputFile()
+{
+	if (m_outputfile != nullptr)
+	{
+		fclose(m_outputfile);
+		m_outputfile = nullptr;
+	}
+	m_bReopenOutputFile = false;
+
+	if (!m_outputfilename.empty())
+	{
+#ifdef _DEBUG
+		m_outputfile = fopen(m_outputfilename.c_str(), "w");
+#else
+		m_outputfile = fopen(m_outputfilename.c_str(), "a");
+#endif
+		if (m_outputfile == nullptr)
+			std::cerr << "Error opening output log file..." << std::endl;
+	}
+	m_bHaveOutputFile = (m_outputfile != nullptr);
+}
+
+// Supported policies: block,drop
+bool CLogger::SetOverflowPolicy(const std::string &sPolicy)
+{
+	if (sPolicy == "block")
+		m_overflowpolicy = LOG_OVERFLOW_BLOCK;
+	else if (sPolicy == "drop")
+		m_overflowpolicy = LOG_OVERFLOW_DROP;
+	else
+		return false;
+	return true;
+}
 
-	if (OutputFile == nullptr)
+void CLogger::StartFileWriter()
+{
+	if (m_writerthread)
 		return;
-	if (*OutputFile == 0)
+	m_bStopWriter = false;
+	m_writerthread = std::make_shared<std::thread>([this] { Do_FileWriter(); });
+	SetThreadName(m_writerthread->native_handle(), "Logger");
+	m_bWriterRunning = true;
+}
+
+void CLogger::StopFileWriter()
+{
+	if (!m_writerthread)
 		return;
+	{
+		std::unique_lock<std::mutex> lock(m_writermutex);
+		m_bStopWriter = true;
+	}
+	m_writercondition.notify_one();
+	m_writerthread->join();
+	m_writerthread.reset();
+	m_bWriterRunning = false;
+	// lines queued while the writer was stopping
+	Flush();
+}
 
-	try
+void CLogger::Flush()
+{
+	// a fatal signal can arrive while the file writer holds the lock, do not wait for it forever
+	std::unique_lock<std::mutex> lock(m_filemutex, std::defer_lock);
+	for (int ii = 0; ii < 100; ii++)
 	{
-#ifdef _DEBUG
-		m_outputfile.open(OutputFile, std::ios::out | std::ios::trunc);
+		if (lock.try_lock())
+			break;
+		sleep_milliseconds(10);
+	}
+	if (!lock.owns_lock())
+		return;
+	WriteQueuedLines(false);
+	if (m_outputfile != nullptr)
+		fflush(m_outputfile);
+}
+
+uint64_t CLogger::GetDroppedLines()
+{
+	return m_droppedlines;
+}
+
+CLogger::_tLogRing *CLogger::GetThreadRing()
+{
+	// The ring is registered on the first line a thread queues, and closed when the thread ends
+	struct _tLogRingHolder
+	{
+		std::shared_ptr<_tLogRing> ring;
+		~_tLogRingHolder()
+		{
+			if (ring)
+				ring->bClosed = true;
+		}
+	};
+	static thread_local _tLogRingHolder holder;
+	if (!holder.ring)
+	{
+		holder.ring = std::make_shared<_tLogRing>();
+		std::unique_lock<std::mutex> lock(m_ringsmutex);
+		m_rings.push_back(holder.ring);
+	}
+	return holder.ring.get();
+}
+
+CLogger::_tLogRing *CLogger::ReserveFileLine()
+{
+	// only this thread adds lines to its ring, so the room found here is still there when the line is queued
+	_tLogRing *pRing = GetThreadRing();
+	while (pRing->head.load(std::memory_order_relaxed) - pRing->tail.load(std::memory_order_acquire) >= LOG_RING_SIZE)
+	{
+		if (m_overflowpolicy == LOG_OVERFLOW_DROP)
+		{
+			m_droppedlines++;
+			return nullptr;
+		}
+		if (!m_bWriterRunning)
+		{
+			Flush();
+			continue;
+		}
+		m_writercondition.notify_one();
+		sleep_milliseconds(1);
+	}
+	return pRing;
+}
+
+void CLogger::QueueFileLine(_tLogRing *pRing, std::string &szLine, const uint64_t sequence)
+{
+	// m_mutex is locked, so the lines of all threads are published in sequence order
+	const uint32_t head = pRing->head.load(std::memory_order_relaxed);
+	const uint32_t slot = head & (LOG_RING_SIZE - 1);
+	pRing->lines[slot].swap(szLine);
+	pRing->sequence[slot] = sequence;
+	pRing->head.store(head + 1, std::memory_order_release);
+
+	// wake the writer early when the ring fills up, otherwise it picks the lines up on its interval
+	if (head + 1 - pRing->tail.load(std::memory_order_relaxed) == LOG_RING_SIZE / 2)
+		m_writercondition.notify_one();
+}
+
+void CLogger::WriteQueuedLines(const bool bWaitForLoggers)
+{
+	std::vector<std::shared_ptr<_tLogRing>> rings;
+	{
+		std::unique_lock<std::mutex> lock(m_ringsmutex);
+		rings = m_rings;
+	}
+
+	// Lines are published under m_mutex, so the heads taken under it leave no gap in the sequence
+	// and the lines of all threads are written in the order they were logged.
+	// A fatal signal can arrive while a logger holds it, then the heads are taken without it.
+	std::vector<uint32_t> heads;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+		if (bWaitForLoggers)
+			lock.lock();
+		else
+		{
+			for (int ii = 0; (ii < 100) && (!lock.try_lock()); ii++)
+				sleep_milliseconds(10);
+		}
+		for (const auto &ring : rings)
+			heads.push_back(ring->head.load(std::memory_order_acquire));
+	}
+
+	std::vector<std::pair<uint64_t, std::string>> lines;
+	for (size_t ii = 0; ii < rings.size(); ii++)
+	{
+		const std::shared_ptr<_tLogRing> &ring = rings[ii];
+		const uint32_t head = heads[ii];
+		uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+		while (tail != head)
+		{
+			const uint32_t slot = tail & (LOG_RING_SIZE - 1);
+			lines.emplace_back(ring->sequence[slot], std::string());
+			lines.back().second.swap(ring->lines[slot]);
+			tail++;
+		}
+		ring->tail.store(tail, std::memory_order_release);
+	}
+	std::sort(lines.begin(), lines.end(), [](const std::pair<uint64_t, std::string> &a, const std::pair<uint64_t, std::string> &b) { return a.first < b.first; });
+
+	if (m_bReopenOutputFile)
+		OpenOutputFile();
+
+	if (m_outputfile != nullptr)
+	{
+		const uint64_t dropped = m_droppedlines;
+		if (dropped != m_reporteddroppedlines)
+		{
+			std::string szTime = (m_bEnableLogTimestamps) ? TimeToString(nullptr, TF_DateTimeMs) + "  " : "";
+			fprintf(m_outputfile, "%sError: Logger: %s log lines dropped, the log file could not keep up\n", szTime.c_str(), std::to_string(dropped - m_reporteddroppedlines).c_str());
+			m_reporteddroppedlines = dropped;
+		}
+		if (!lines.empty())
+		{
+			std::string szBuffer;
+			for (const auto &line : lines)
+			{
+				szBuffer += line.second;
+				szBuffer += '\n';
+			}
+			fwrite(szBuffer.data(), 1, szBuffer.size(), m_outputfile);
+		}
+		fflush(m_outputfile);
+
+		const time_t now = mytime(nullptr);
+		if ((!lines.empty()) && (now - m_lastsync >= LOG_SYNC_INTERVAL))
+		{
+#ifdef WIN32
+			_commit(_fileno(m_outputfile));
 #else
-		m_outputfile.open(OutputFile, std::ios::out | std::ios::app);
+			fsync(fileno(m_outputfile));
 #endif
+			m_lastsync = now;
+		}
 	}
-	catch (...)
+
+	// drop the rings of ended threads
+	std::unique_lock<std::mutex> lock(m_ringsmutex);
+	m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(),
+				     [](const std::shared_ptr<_tLogRing> &ring) {
+					     return (ring->bClosed) && (ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed));
+				     }),
+		      m_rings.end());
+}
+
+void CLogger::Do_FileWriter()
+{
+	while (!m_bStopWriter)
 	{
-		std::cerr << "Error opening output log file..." << std::endl;
+		{
+			std::unique_lock<std::mutex> lock(m_writermutex);
+			if (!m_bStopWriter)
+				m_writercondition.wait_for(lock, std::chrono::milliseconds(LOG_WRITE_INTERVAL));
+		}
+		std::unique_lock<std::mutex> lock(m_filemutex);
+		WriteQueuedLines(true);
 	}
 }
 
@@ -298,6 +572,10 @@ void CLogger::Log(const _eLogLevel level, const char *logline, ...)
 
 	std::string szIntLog = sstr.str();
 
+	// room for the file line is made before the lock, waiting for the file writer does not hold up the other threads
+	const bool bQueueFileLine = (m_bHaveOutputFile && m_bWriterRunning);
+	_tLogRing *pRing = (bQueueFileLine) ? ReserveFileLine() : nullptr;
+
 	{
 		// Locked region to allow multiple threads to print at the same time
 		std::unique_lock<std::mutex> lock(m_mutex);
@@ -326,20 +604,30 @@ void CLogger::Log(const _eLogLevel level, const char *logline, ...)
 #endif
 		}
 
-		if (m_outputfile.is_open())
-		{
-			// output to file
-			m_outputfile << szIntLog << std::endl;
-			m_outputfile.flush();
-		}
+		// the slot of the oldest line is reused, its string keeps its buffer
+		_tLastLogLines &last = m_lastlog[LastLogIndex(level)];
+		_tLogLineStruct &line = last.lines[last.count % MAX_LOG_LINE_BUFFER];
+		line.logtime = mytime(nullptr);
+		line.level = level;
+		line.logmessage.assign(szIntLog);
+		line.sequence = ++m_lastlogsequence;
+		last.count++;
+
+		// output to file, by the file writer once it runs
+		if (pRing != nullptr)
+			QueueFileLine(pRing, szIntLog, line.sequence);
+	}
 
-		auto itt = m_lastlog.find(level);
-		if (itt != m_lastlog.end())
+	if ((m_bHaveOutputFile) && (!bQueueFileLine))
+	{
+		std::unique_lock<std::mutex> lock(m_filemutex);
+		if (m_bReopenOutputFile)
+			OpenOutputFile();
+		if (m_outputfile != nullptr)
 		{
-			if (m_lastlog[level].size() >= MAX_LOG_LINE_BUFFER)
-				m_lastlog[level].erase(m_lastlog[level].begin());
+			fprintf(m_outputfile, "%s\n", szIntLog.c_str());
+			fflush(m_outputfile);
 		}
-		m_lastlog[level].push_back(_tLogLineStruct(level, szIntLog));
 	}
 }
 
@@ -408,45 +696,49 @@ bool strhasEnding(std::string const &fullString, std::string const &ending)
 	return fullString.size() >= ending.size() && !fullString.compare(fullString.size() - ending.size(), ending.size(), ending);
 }
 
+// Sequence state is kept per thread so RX messages decoded in parallel do not mix their lines
+static thread_local bool g_bInSequenceMode = false;
+static thread_local std::stringstream g_sequencestring;
+
 void CLogger::LogSequenceStart()
 {
-	m_bInSequenceMode = true;
-	m_sequencestring.clear();
-	m_sequencestring.str("");
+	g_bInSequenceMode = true;
+	g_sequencestring.clear();
+	g_sequencestring.str("");
 }
 
 void CLogger::LogSequenceEnd(const _eLogLevel level)
 {
-	if (!m_bInSequenceMode)
+	if (!g_bInSequenceMode)
 		return;
 
-	std::string message = m_sequencestring.str();
+	std::string message = g_sequencestring.str();
 	if (strhasEnding(message, "\n"))
 	{
 		message.resize(message.size() - 1);
 	}
 
 	Log(level, message);
-	m_sequencestring.clear();
-	m_sequencestring.str("");
+	g_sequencestring.clear();
+	g_sequencestring.str("");
 
-	m_bInSequenceMode = false;
+	g_bInSequenceMode = false;
 }
 
 void CLogger::LogSequenceAdd(const char *logline)
 {
-	if (!m_bInSequenceMode)
+	if (!g_bInSequenceMode)
 		return;
 
-	m_sequencestring << logline << std::endl;
+	g_sequencestring << logline << std::endl;
 }
 
 void CLogger::LogSequenceAddNoLF(const char *logline)
 {
-	if (!m_bInSequenceMode)
+	if (!g_bInSequenceMode)
 		return;
 
-	m_sequencestring << logline;
+	g_sequencestring << logline;
 }
 
 void CLogger::EnableLogTimestamps(const bool bEnableTimestamps)
@@ -459,36 +751,41 @@ bool CLogger::IsLogTimestampsEnabled()
 	return (m_bEnableLogTimestamps && !g_bUseSyslog);
 }
 
-bool compareLogByTime(const CLogger::_tLogLineStruct &a, const CLogger::_tLogLineStruct &b)
-{
-	return a.logtime < b.logtime;
-}
-
-std::list<CLogger::_tLogLineStruct> CLogger::GetLog(const _eLogLevel level, const time_t lastlogtime)
+uint64_t CLogger::GetLog(const uint32_t levelMask, const uint64_t lastSequence, std::vector<_tLogLineStruct> &lines)
 {
+	lines.clear();
 	std::unique_lock<std::mutex> lock(m_mutex);
-	std::list<_tLogLineStruct> mlist;
-
-	if (level != LOG_ALL)
+	// a cursor beyond the last line comes from before a restart, the client gets everything we have
+	const uint64_t cursor = (lastSequence > m_lastlogsequence) ? 0 : lastSequence;
+	for (int ii = 0; ii < 4; ii++)
 	{
-		if (m_lastlog.find(level) == m_lastlog.end())
-			return mlist;
-
-		std::copy_if(std::begin(m_lastlog[level]), std::end(m_lastlog[level]), std::back_inserter(mlist), [lastlogtime](const _tLogLineStruct &l) { return l.logtime > lastlogtime; });
+		if (!(levelMask & g_lastloglevels[ii]))
+			continue;
+		// the lines of a level are kept in sequence order, walk back to the first one after the cursor
+		const _tLastLogLines &last = m_lastlog[ii];
+		const size_t oldest = (last.count > MAX_LOG_LINE_BUFFER) ? last.count - MAX_LOG_LINE_BUFFER : 0;
+		size_t first = last.count;
+		while ((first > oldest) && (last.lines[(first - 1) % MAX_LOG_LINE_BUFFER].sequence > cursor))
+			first--;
+		for (size_t jj = first; jj < last.count; jj++)
+			lines.push_back(last.lines[jj % MAX_LOG_LINE_BUFFER]);
 	}
-	else
-		for (const auto &l : m_lastlog)
-			std::copy_if(l.second.begin(), l.second.end(), std::back_inserter(mlist), [lastlogtime](const _tLogLineStruct &l2) { return l2.logtime > lastlogtime; });
+	std::sort(lines.begin(), lines.end(), [](const _tLogLineStruct &a, const _tLogLineStruct &b) { return a.sequence < b.sequence; });
+	return m_lastlogsequence;
+}
 
-	// Sort by time
-	mlist.sort(compareLogByTime);
-	return mlist;
+uint64_t CLogger::GetLastLogSequence()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_lastlogsequence;
 }
 
 void CLogger::ClearLog()
 {
 	std::unique_lock<std::mutex> lock(m_mutex);
-	m_lastlog.clear();
+	// the sequence numbers go on, so the cursors of the clients stay valid
+	for (auto &last : m_lastlog)
+		last.count = 0;
 }
 
 std::list<CLogger::_tLogLineStruct> CLogger::GetNotificationLogs()
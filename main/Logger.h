@@ -1,9 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <list>
+#include <memory>
 #include <string>
 #include <fstream>
+#include <thread>
+#include <vector>
 
 enum _eLogLevel : uint32_t
 {
@@ -34,6 +39,11 @@ enum _eLogACLF : uint8_t
 	LOG_ACLF_FILE = 0x02,
 	LOG_ACLF_SYSLOG = 0x04
 };
+enum _eLogOverflow : uint8_t
+{
+	LOG_OVERFLOW_BLOCK = 0, // wait for the file writer when a thread queued too many lines
+	LOG_OVERFLOW_DROP	// drop the line and count it
+};
 
 class CLogger
 {
@@ -43,6 +53,8 @@ class CLogger
 		time_t logtime;
 		_eLogLevel level;
 		std::string logmessage;
+		uint64_t sequence = 0; // increases with every line kept for the UI
+		_tLogLineStruct() = default;
 		_tLogLineStruct(_eLogLevel nlevel, const std::string &nlogmessage);
 	};
 
@@ -61,6 +73,18 @@ class CLogger
 	bool IsACLFlogEnabled();
 
 	void SetOutputFile(const char *OutputFile);
+	// Reopens the log file from the file writer (log rotation), only sets a flag so it can be called from a signal handler
+	void ReopenOutputFile();
+
+	// Lines for the log file are queued per thread and written in batches by the file writer thread.
+	// Until the writer is started (after daemonizing) and after it is stopped, they are written directly
+	bool SetOverflowPolicy(const std::string &sPolicy);
+	void StartFileWriter();
+	void StopFileWriter();
+	// Writes the queued lines now, used before the process is ended by a fatal signal
+	void Flush();
+	uint64_t GetDroppedLines();
+
 	void SetACLFOutputFile(const char *OutputFile);
 	void OpenACLFOutputFile();
 
@@ -92,7 +116,10 @@ class CLogger
 
 	void ForwardErrorsToNotificationSystem(bool bDoForward);
 
-	std::list<_tLogLineStruct> GetLog(_eLogLevel level, time_t lastlogtime = 0);
+	// Copies the kept lines of the levels in levelMask with a sequence number above lastSequence, oldest first.
+	// Returns the sequence number of the last line logged, to pass as lastSequence on the next call
+	uint64_t GetLog(uint32_t levelMask, uint64_t lastSequence, std::vector<_tLogLineStruct> &lines);
+	uint64_t GetLastLogSequence();
 	void ClearLog();
 
 	std::list<_tLogLineStruct> GetNotificationLogs();
@@ -104,17 +131,51 @@ class CLogger
 	uint8_t m_aclf_flags = 0;
 	uint32_t m_aclf_loggedlinescnt = 0;
 
+	struct _tLogRing;
+
+	// Last lines of one log level for the UI, preallocated and overwritten oldest first
+	struct _tLastLogLines
+	{
+		std::vector<_tLogLineStruct> lines;
+		size_t count = 0; // lines kept since the last clear
+	};
+
+	_tLogRing *GetThreadRing();
+	_tLogRing *ReserveFileLine();
+	// m_mutex locked
+	void QueueFileLine(_tLogRing *pRing, std::string &szLine, uint64_t sequence);
+	// m_filemutex locked
+	void OpenOutputFile();
+	void WriteQueuedLines(bool bWaitForLoggers);
+	void Do_FileWriter();
+
 	std::mutex m_mutex;
-	std::ofstream m_outputfile;
+	std::mutex m_filemutex;
+	FILE *m_outputfile = nullptr;
+	std::string m_outputfilename;
+	std::atomic<bool> m_bHaveOutputFile{ false };
+	std::atomic<bool> m_bReopenOutputFile{ false };
+
+	std::mutex m_ringsmutex;
+	std::vector<std::shared_ptr<_tLogRing>> m_rings;
+	std::shared_ptr<std::thread> m_writerthread;
+	std::mutex m_writermutex;
+	std::condition_variable m_writercondition;
+	std::atomic<bool> m_bWriterRunning{ false };
+	std::atomic<bool> m_bStopWriter{ false };
+	std::atomic<uint64_t> m_droppedlines{ 0 };
+	uint64_t m_reporteddroppedlines = 0;
+	_eLogOverflow m_overflowpolicy = LOG_OVERFLOW_BLOCK;
+	time_t m_lastsync = 0;
+
 	const char *m_aclflogfile = nullptr;
 	std::ofstream m_aclfoutputfile;
-	std::map<_eLogLevel, std::deque<_tLogLineStruct>> m_lastlog;
+	_tLastLogLines m_lastlog[4]; // normal, status, error, debug
+	uint64_t m_lastlogsequence = 0;
 	std::deque<_tLogLineStruct> m_notification_log;
-	bool m_bInSequenceMode;
 	bool m_bEnableLogTimestamps;
 	bool m_bEnableLogThreadIDs;
 	bool m_bEnableErrorsToNotificationSystem;
 	time_t m_LastLogNotificationsSend;
-	std::stringstream m_sequencestring;
 };
 extern CLogger _log;
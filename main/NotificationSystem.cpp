@@ -102,7 +102,7 @@ void CNotificationSystem::Notify(const Notification::_eType type, const Notifica
 	item.type = type;
 	item.status = status;
 	item.eventdata = eventdata;
-	m_notificationqueue.push(item);
+	m_notificationqueue.push(std::move(item));
 }
 
 bool CNotificationSystem::NotifyWait(const Notification::_eType type, const Notification::_eStatus status, const std::string &eventdata)
@@ -44,7 +44,7 @@ private:
 	volatile bool m_stoprequested = false;
 	std::mutex m_mutex;
 	std::vector<CNotificationObserver*> m_notifiers;
-	concurrent_queue<_tNotificationQueue> m_notificationqueue;
+	mpsc_queue<_tNotificationQueue> m_notificationqueue;
 	std::shared_ptr<std::thread> m_pQueueThread;
 
 	static const _tNotificationTypeTable typeTable[];
@@ -12,9 +12,12 @@
 #include "RFXtrx.h"
 #include "RFXNames.h"
 #include "Logger.h"
+#include "LatencyStats.h"
 #include "mainworker.h"
 #include "../main/json_helper.h"
 #include <sqlite3.h>
+#include <zlib.h>
+#include <boost/functional/hash.hpp>
 #include "../hardware/hardwaretypes.h"
 #include "../hardware/DomoticzTCP.h"
 #include "../smtpclient/SMTPClient.h"
@@ -45,6 +48,8 @@
 #define DEFAULT_ADMINUSER "admin"
 #define DEFAULT_ADMINPWD "domoticz"
 
+#define DEVICE_CACHE_MAX_INVALIDATED 4096
+
 extern http::server::CWebServerHelper m_webservers;
 extern std::string szWWWFolder;
 extern std::string szAppVersion;
@@ -615,6 +620,54 @@ constexpr auto sqlCreateApplications =
 extern std::string szUserDataFolder;
 #define round(a) (int)(a + .5)
 
+//Set while the short log schedule writes, these samples are also added to the day totals
+static thread_local bool g_bDayTotalsWrite = false;
+
+//Set while UpdateValueInt writes the value of this device (its cache entry is updated in place instead of dropped)
+//or while a column that is not cached is written (UpdateBatteryLevel)
+static thread_local uint64_t g_ulDeviceValueWrite = 0;
+
+//Drops cached DeviceStatus entries when a row is changed by any query
+// tables (besides DeviceStatus) that are used to present a device, see GetConfigurationGeneration
+static const char *szConfigurationTables[] = {
+	"Hardware", "Users", "SharedDevices", "Plans", "DeviceToPlansMap", "Timers", "SetpointTimers", "Notifications",
+	"LightSubDevices", "Cameras", "CamerasActiveDevices", "CustomImages", "Preferences", nullptr
+};
+
+static void DeviceStatusUpdateHook(void* pUser, const int op, const char* /*szDatabase*/, const char* szTable, const sqlite3_int64 rowid)
+{
+	if (strcmp(szTable, "DeviceStatus") == 0)
+	{
+		if ((op != SQLITE_INSERT) && ((op != SQLITE_UPDATE) || (static_cast<uint64_t>(rowid) != g_ulDeviceValueWrite)))
+			static_cast<CSQLHelper*>(pUser)->InvalidateDeviceCache(static_cast<uint64_t>(rowid));
+		return;
+	}
+	const size_t tableLen = strlen(szTable);
+	if ((tableLen > 9) && (strcmp(szTable + tableLen - 9, "_Calendar") == 0))
+	{
+		// new days are picked up by the roll-ups themselves
+		if (op != SQLITE_INSERT)
+			static_cast<CSQLHelper*>(pUser)->m_graphrollups.OnCalendarChanged();
+		return;
+	}
+	for (int ii = 0; szConfigurationTables[ii] != nullptr; ii++)
+	{
+		if (strcmp(szTable, szConfigurationTables[ii]) == 0)
+		{
+			static_cast<CSQLHelper*>(pUser)->OnConfigurationChanged();
+			return;
+		}
+	}
+	CShortLogStore::_eShortLogTable shortlogTable;
+	if ((!g_bDayTotalsWrite) && (CShortLogStore::GetTable(szTable, shortlogTable)))
+		static_cast<CSQLHelper*>(pUser)->InvalidateDayTotals(shortlogTable);
+}
+
+//short log tables with a calendar, in the order of the daily schedule
+static const char *szCalendarTables[] = {
+	"Temperature", "Rain", "UV", "Wind", "Meter", "MultiMeter", "Percentage", "Fan", nullptr
+};
+
 CSQLHelper::CSQLHelper()
 {
 	m_LastSwitchRowID = 0;
@@ -661,6 +714,8 @@ bool CSQLHelper::OpenDatabase()
 	sqlite3_exec(m_dbase, "PRAGMA synchronous = NORMAL", nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA foreign_keys = ON", nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA busy_timeout = 1000", nullptr, nullptr, nullptr);
+	sqlite3_update_hook(m_dbase, DeviceStatusUpdateHook, this);
+	ClearDeviceCache();
 
 	std::vector<std::vector<std::string> > result = query("SELECT name FROM sqlite_master WHERE type='table' AND name='DeviceStatus'");
 	bool bNewInstall = (result.empty());
@@ -673,6 +728,7 @@ bool CSQLHelper::OpenDatabase()
 			//User is using a newer database on a old Domoticz version
 			//This is very dangerous and should not be allowed
 			_log.Log(LOG_ERROR, "Database incompatible with this Domoticz version. (You cannot downgrade to an old Domoticz version!)");
+			ClearStatementCache();
 			sqlite3_close(m_dbase);
 			m_dbase = nullptr;
 			return false;
@@ -3577,6 +3633,21 @@ bool CSQLHelper::OpenDatabase()
 
 	CorrectOffDelaySwitchStates();
 
+	OpenShortLogStore();
+	StartDayAccumulator();
+
+	if ((m_read_pool_size > 0) && (m_journal_mode == "WAL"))
+	{
+		if (m_readpool.Open(m_dbase_name, m_read_pool_size))
+			_log.Log(LOG_STATUS, "SQLHelper: Using %d read connections", m_read_pool_size);
+	}
+
+	if (m_group_commit_interval > 0)
+	{
+		_log.Log(LOG_STATUS, "SQLHelper: Group commit enabled, interval: %d ms", m_group_commit_interval);
+		m_bGroupCommitEnabled = true;
+	}
+
 	//Start background thread
 	if (!StartThread())
 		return false;
@@ -3585,13 +3656,21 @@ bool CSQLHelper::OpenDatabase()
 
 void CSQLHelper::CloseDatabase()
 {
+	m_readpool.Close();
 	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 	if (m_dbase != nullptr)
 	{
+		CommitGroupTransaction();
+		m_bGroupCommitEnabled = false;
+		ClearStatementCache();
+		ClearDeviceCache();
+		m_graphrollups.Clear();
+		m_dayaccumulator.Clear();
 		OptimizeDatabase(m_dbase);
 		sqlite3_close(m_dbase);
 		m_dbase = nullptr;
 	}
+	m_shortlogstore.Close();
 }
 
 void CSQLHelper::StopThread()
@@ -3602,6 +3681,11 @@ void CSQLHelper::StopThread()
 		m_thread->join();
 		m_thread.reset();
 	}
+	if (m_calendar_thread)
+	{
+		m_calendar_thread->join();
+		m_calendar_thread.reset();
+	}
 }
 
 bool CSQLHelper::StartThread()
@@ -3609,6 +3693,8 @@ bool CSQLHelper::StartThread()
 	RequestStart();
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "SQLHelper");
+	m_calendar_thread = std::make_shared<std::thread>([this] { CatchUpCalendar(); });
+	SetThreadName(m_calendar_thread->native_handle(), "SQLCalendar");
 	return (m_thread != nullptr);
 }
 
@@ -3922,40 +4008,28 @@ void CSQLHelper::PerformThreadedAction(const _tTaskItem &tItem)
 
 		if (!tItem._relatedEvent.empty())
 			StringSplit(tItem._relatedEvent, "!#", extraHeaders);
-		std::string response;
-		std::vector<std::string> headerData;
 
 		HTTPClient::_eHTTPmethod tmethod = static_cast<HTTPClient::_eHTTPmethod>(method);
-
-		bool ret = false;
-		if (tmethod == HTTPClient::HTTP_METHOD_GET)
-		{
-			ret = HTTPClient::GET(url, extraHeaders, response, headerData);
-		}
-		else if (tmethod == HTTPClient::HTTP_METHOD_POST)
-		{
-			ret = HTTPClient::POST(url, postData, extraHeaders, response, headerData, true, true);
-		}
-		else if (tmethod == HTTPClient::HTTP_METHOD_PUT)
-		{
-			ret = HTTPClient::PUT(url, postData, extraHeaders, response, headerData, true);
-		}
-		else if (tmethod == HTTPClient::HTTP_METHOD_DELETE)
-		{
-			ret = HTTPClient::Delete(url, postData, extraHeaders, response, headerData, true);
-		}
-		else if (tmethod == HTTPClient::HTTP_METHOD_PATCH)
-		{
-			ret = HTTPClient::Patch(url, postData, extraHeaders, response, headerData, true);
-		}
-		else
+		if ((tmethod < HTTPClient::HTTP_METHOD_GET) || (tmethod > HTTPClient::HTTP_METHOD_PATCH))
 			return; // unsupported method
 
-		if (m_bEnableEventSystem && !callback.empty())
-		{
-			m_mainworker.m_eventsystem.TriggerURL(response, headerData, callback);
-		}
+		// the task thread does not wait for the server, the callback event is triggered when the response arrives
+		bool ret = HTTPClient::AsyncRequest(tmethod, url, postData, extraHeaders,
+			[this, url, callback, tmethod](bool bOK, long http_code, const std::vector<unsigned char> &vResponse, const std::vector<std::string> &headerData) {
+				std::string response(vResponse.begin(), vResponse.end());
+				if ((tmethod == HTTPClient::HTTP_METHOD_GET) && (response.empty()))
+					bOK = false;
+
+				if (m_bEnableEventSystem && !callback.empty())
+				{
+					m_mainworker.m_eventsystem.TriggerURL(response, headerData, callback);
+				}
 
+				if (!bOK)
+				{
+					_log.Log(LOG_ERROR, "Error opening url: %s", url.c_str());
+				}
+			});
 		if (!ret)
 		{
 			_log.Log(LOG_ERROR, "Error opening url: %s", url.c_str());
@@ -4027,6 +4101,8 @@ void CSQLHelper::Do_Work()
 	{
 		std::vector<_tTaskItem> _items2do;
 
+		CheckGroupCommit();
+
 		if (m_bAcceptHardwareTimerActive)
 		{
 			m_iAcceptHardwareTimerCounter -= static_cast<float>(1. / timer_resolution_hz);
@@ -4379,6 +4455,24 @@ std::vector<std::vector<std::string>> CSQLHelper::unsafe_query(const std::string
 	return query(szQuery);
 }
 
+std::vector<std::vector<std::string>> CSQLHelper::safe_query_read(const char *fmt, ...)
+{
+	std::vector<std::vector<std::string> > results;
+	va_list args;
+	va_start(args, fmt);
+	char* zQuery = sqlite3_vmprintf(fmt, args);
+	va_end(args);
+	if (!zQuery)
+	{
+		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
+		return results;
+	}
+	if ((m_bGroupTransactionOpen) || (!m_readpool.Query(zQuery, results)))
+		results = query(zQuery);
+	sqlite3_free(zQuery);
+	return results;
+}
+
 std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQuery)
 {
 	if (!m_dbase)
@@ -4387,7 +4481,9 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
+	const auto tStart = std::chrono::steady_clock::now();
 	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	const auto tAcquired = std::chrono::steady_clock::now();
 
 	sqlite3_stmt* statement;
 	std::vector<std::vector<std::string> > results;
@@ -4425,6 +4521,15 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 	std::string error = sqlite3_errmsg(m_dbase);
 	if (error != "not an error")
 		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+
+	const uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(tAcquired - tStart).count();
+	const uint64_t busyUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tAcquired).count();
+	std::lock_guard<std::mutex> l2(m_primary_stats_mutex);
+	m_primary_stats.Queries++;
+	m_primary_stats.WaitTotalUs += waitUs;
+	if (waitUs > m_primary_stats.WaitMaxUs)
+		m_primary_stats.WaitMaxUs = waitUs;
+	m_primary_stats.BusyTotalUs += busyUs;
 	return results;
 }
 
@@ -4496,136 +4601,625 @@ std::vector<std::vector<std::string> > CSQLHelper::queryBlob(const std::string&
 	return results;
 }
 
-uint64_t CSQLHelper::CreateDevice(const int HardwareID, const int SensorType, const int SensorSubType, std::string &devname, const unsigned long nid, const std::string &soptions,
-				  const std::string &userName)
+size_t CSQLHelper::_tDeviceCacheKeyHash::operator()(const _tDeviceCacheKey& key) const
 {
-	uint64_t DeviceRowIdx = (uint64_t)-1;
-	char ID[20];
-	sprintf(ID, "%lu", nid);
+	size_t seed = std::hash<std::string>()(key.DeviceID);
+	boost::hash_combine(seed, key.HardwareID);
+	boost::hash_combine(seed, key.OrgHardwareID);
+	boost::hash_combine(seed, (key.unit << 16) | (key.devType << 8) | key.subType);
+	return seed;
+}
 
-#ifdef ENABLE_PYTHON
+bool CSQLHelper::GetCachedDevice(const _tDeviceCacheKey& key, _tDeviceCacheItem& item, uint64_t& generation)
+{
+	std::lock_guard<std::mutex> l(m_device_cache_mutex);
+	generation = m_device_cache_generation;
+	auto itt = m_device_cache.find(key);
+	if (itt == m_device_cache.end())
+		return false;
+	item = itt->second;
+	return true;
+}
+
+void CSQLHelper::SetCachedDevice(const _tDeviceCacheKey& key, const _tDeviceCacheItem& item, const uint64_t generation)
+{
+	std::lock_guard<std::mutex> l(m_device_cache_mutex);
+	// the row was changed (or the cache cleared) after it was read
+	if (generation < m_device_cache_cleared)
+		return;
+	auto itt = m_device_cache_invalidated.find(item.ID);
+	if ((itt != m_device_cache_invalidated.end()) && (itt->second > generation))
+		return;
+	m_device_cache[key] = item;
+	m_device_cache_ids[item.ID] = key;
+}
+
+void CSQLHelper::UpdateCachedDeviceValue(const _tDeviceCacheKey& key, const uint64_t idx, const int nValue, const std::string& sValue, const std::string& sLastUpdate)
+{
+	std::lock_guard<std::mutex> l(m_device_cache_mutex);
+	auto itt = m_device_cache.find(key);
+	if ((itt == m_device_cache.end()) || (itt->second.ID != idx))
+		return;
+	itt->second.nValue = nValue;
+	itt->second.sValue = sValue;
+	itt->second.LastUpdate = sLastUpdate;
+}
+
+void CSQLHelper::InvalidateDeviceCache(const uint64_t idx)
+{
+	std::lock_guard<std::mutex> l(m_device_cache_mutex);
+	if (m_device_cache_invalidated.size() >= DEVICE_CACHE_MAX_INVALIDATED)
 	{
-		std::vector<std::vector<std::string> > result;
-		result = safe_query("SELECT Type FROM Hardware WHERE (ID == %d)", HardwareID);
-		if (!result.empty())
+		// forget the single invalidations, no device read before now is cached anymore
+		m_device_cache_invalidated.clear();
+		m_device_cache_cleared = m_device_cache_generation + 1;
+	}
+	m_device_cache_invalidated[idx] = ++m_device_cache_generation;
+	auto itt = m_device_cache_ids.find(idx);
+	if (itt == m_device_cache_ids.end())
+		return;
+	m_device_cache.erase(itt->second);
+	m_device_cache_ids.erase(itt);
+}
+
+void CSQLHelper::ClearDeviceCache()
+{
+	std::lock_guard<std::mutex> l(m_device_cache_mutex);
+	m_device_cache.clear();
+	m_device_cache_ids.clear();
+	m_device_cache_invalidated.clear();
+	m_device_cache_cleared = ++m_device_cache_generation;
+}
+
+void CSQLHelper::SetGroupCommitInterval(const int iMilliseconds)
+{
+	m_group_commit_interval = (iMilliseconds > 0) ? iMilliseconds : 0;
+}
+
+void CSQLHelper::EnableShortLogStore(const bool bEnable)
+{
+	m_bShortLogStoreEnabled = bEnable;
+}
+
+void CSQLHelper::SetReadPoolSize(const int iConnections)
+{
+	m_read_pool_size = (iConnections > 0) ? iConnections : 0;
+}
+
+std::vector<CSQLReadPool::_tConnectionStats> CSQLHelper::GetConnectionStats()
+{
+	std::vector<CSQLReadPool::_tConnectionStats> stats;
+	{
+		std::lock_guard<std::mutex> l(m_primary_stats_mutex);
+		stats.push_back(m_primary_stats);
+	}
+	for (const auto &itt : m_readpool.GetStats())
+		stats.push_back(itt);
+	return stats;
+}
+
+void CSQLHelper::OpenShortLogStore()
+{
+	std::string szFolder = m_dbase_name + "-shortlog/";
+	if (!m_bShortLogStoreEnabled)
+	{
+		//remove a store of a previous run, it is not updated anymore
+		CShortLogStore::Remove(szFolder);
+		return;
+	}
+	if (!m_shortlogstore.Open(szFolder))
+	{
+		_log.Log(LOG_ERROR, "SQLHelper: Unable to open the short log store (%s)", szFolder.c_str());
+		return;
+	}
+	if (!m_shortlogstore.IsNew())
+		return;
+
+	//fill the store with the current short logs
+	_log.Log(LOG_STATUS, "SQLHelper: Filling the short log store...");
+	for (int ii = 0; ii < CShortLogStore::SLT_COUNT; ii++)
+	{
+		auto table = static_cast<CShortLogStore::_eShortLogTable>(ii);
+		std::vector<std::string> columns = CShortLogStore::GetColumns(table);
+		std::string szColumns;
+		for (const auto &column : columns)
+			szColumns += column + ", ";
+		std::vector<std::vector<std::string>> result;
+		result = safe_query("SELECT DeviceRowID, %sCAST(strftime('%%s', Date, 'utc') AS INTEGER) FROM %s ORDER BY Date ASC", szColumns.c_str(), CShortLogStore::GetTableName(table));
+		std::vector<double> values(columns.size());
+		for (const auto &sd : result)
 		{
-			std::vector<std::string> sd = result[0];
-			_eHardwareTypes Type = (_eHardwareTypes)atoi(sd[0].c_str());
-			if (Type == HTYPE_PythonPlugin)
-			{
-				// Not allowed to add device to plugin HW (plugin framework does not use key column "ID" but instead uses column "unit" as key)
-				_log.Log(LOG_ERROR, "CSQLHelper::CreateDevice: Not allowed to add device owned by plugin %u!", HardwareID);
-				return DeviceRowIdx;
-			}
+			for (size_t jj = 0; jj < columns.size(); jj++)
+				values[jj] = atof(sd[jj + 1].c_str());
+			m_shortlogstore.Append(table, std::stoull(sd[0]), static_cast<time_t>(std::stoll(sd.back())), values);
 		}
 	}
-#endif
+	m_shortlogstore.SetImported();
+	_log.Log(LOG_STATUS, "SQLHelper: Short log store filled");
+}
 
-	switch (SensorType)
+void CSQLHelper::AddShortLogSample(const CShortLogStore::_eShortLogTable table, const uint64_t DeviceRowID, const time_t sampleTime, const std::vector<double> &values)
+{
+	std::vector<double> rounded = CShortLogStore::RoundValues(table, values);
+	m_shortlogstore.Append(table, DeviceRowID, sampleTime, rounded);
+	m_dayaccumulator.Add(table, DeviceRowID, sampleTime, rounded);
+}
+
+void CSQLHelper::InvalidateDayTotals(const CShortLogStore::_eShortLogTable table)
+{
+	m_dayaccumulator.Invalidate(table);
+}
+
+void CSQLHelper::StartDayAccumulator()
+{
+	time_t now = mytime(nullptr);
+	struct tm ltime;
+	localtime_r(&now, &ltime);
+	char szToday[40];
+	sprintf(szToday, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+
+	//start with the samples of today that are already in the short log
+	for (int ii = 0; ii < CShortLogStore::SLT_COUNT; ii++)
 	{
-	case pTypeTEMP:
-	case pTypeWEIGHT:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0", devname, true, userName.c_str());
-		break;
-	case pTypeUV:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;0.0", devname, true, userName.c_str());
-		break;
-	case pTypeRAIN:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0;0", devname, true, userName.c_str());
-		break;
-	case pTypeTEMP_BARO:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;1038.0;0;188.0", devname, true, userName.c_str());
-		break;
-	case pTypeHUM:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 50, "1", devname, true, userName.c_str());
-		break;
-	case pTypeTEMP_HUM:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;50;1", devname, true, userName.c_str());
-		break;
-	case pTypeTEMP_HUM_BARO:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;50;1;1010;1", devname, true, userName.c_str());
-		break;
-	case pTypeRFXMeter:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 10, 255, 0, "0", devname, true, userName.c_str());
-		break;
-	case pTypeUsage:
-	case pTypeLux:
-	case pTypeP1Gas:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0", devname, true, userName.c_str());
-		break;
-	case pTypeP1Power:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0;0;0;0;0;0", devname, true, userName.c_str());
-		break;
-	case pTypeAirQuality:
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, devname, true, userName.c_str());
-		break;
-	case pTypeCURRENT:
-		//Current/Ampere
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;0.0;0.0", devname, true, userName.c_str());
-		break;
-	case pTypeSetpoint: //Thermostat Setpoint
+		auto table = static_cast<CShortLogStore::_eShortLogTable>(ii);
+		std::string szColumns;
+		for (const auto &column : CShortLogStore::GetColumns(table))
+			szColumns += ", " + column;
+		std::vector<std::vector<std::string>> result;
+		result = safe_query("SELECT DeviceRowID%s FROM %s WHERE (Date>='%q') ORDER BY ROWID", szColumns.c_str(), CShortLogStore::GetTableName(table), szToday);
+		m_dayaccumulator.Start(table, szToday, result);
+	}
+}
+
+bool CSQLHelper::GetDayTotals(const CShortLogStore::_eShortLogTable table, const char *szDateStart, const char *szDateEnd, CDayAccumulator::_tDayDevices &devices)
+{
+	devices.clear();
+	if (m_dayaccumulator.GetDay(table, szDateStart, devices))
+		return !devices.empty();
+
+	//Not collected (completely), read the short log of that day for all devices at once
+	const char *szTable = CShortLogStore::GetTableName(table);
+	std::vector<std::string> columns = CShortLogStore::GetColumns(table);
+	std::string szColumns;
+	for (const auto &column : columns)
+		szColumns += std_format(", MIN(%s), MAX(%s), SUM(%s)", column.c_str(), column.c_str(), column.c_str());
+	std::vector<std::vector<std::string>> result;
+	result = safe_query("SELECT DeviceRowID, COUNT(*)%s FROM %s WHERE (Date>='%q' AND Date<='%q 00:00:00') GROUP BY DeviceRowID", szColumns.c_str(), szTable, szDateStart, szDateEnd);
+	for (const auto &sd : result)
 	{
-		unsigned char ID1 = (unsigned char)((nid & 0xFF000000) >> 24);
-		unsigned char ID2 = (unsigned char)((nid & 0x00FF0000) >> 16);
-		unsigned char ID3 = (unsigned char)((nid & 0x0000FF00) >> 8);
-		unsigned char ID4 = (unsigned char)((nid & 0x000000FF));
-		sprintf(ID, "%X%02X%02X%02X", ID1, ID2, ID3, ID4);
+		CDayAccumulator::_tDayTotals &totals = devices[std::stoull(sd[0])];
+		totals.Count = std::stoull(sd[1]);
+		totals.Columns.resize(columns.size());
+		for (size_t ii = 0; ii < columns.size(); ii++)
+			totals.Columns[ii] = { atof(sd[2 + ii * 3].c_str()), atof(sd[3 + ii * 3].c_str()), atof(sd[4 + ii * 3].c_str()), 0 };
+	}
+	if (devices.empty())
+		return false;
 
-		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "20.5", devname, true, userName.c_str());
-		break;
+	//values of the last sample of the day (with a single MAX() sqlite returns the other columns of that row)
+	szColumns.clear();
+	for (const auto &column : columns)
+		szColumns += ", " + column;
+	result = safe_query("SELECT DeviceRowID, MAX(ROWID)%s FROM %s WHERE (Date>='%q' AND Date<='%q 00:00:00') GROUP BY DeviceRowID", szColumns.c_str(), szTable, szDateStart, szDateEnd);
+	for (const auto &sd : result)
+	{
+		auto itt = devices.find(std::stoull(sd[0]));
+		if (itt == devices.end())
+			continue;
+		for (size_t ii = 0; ii < columns.size(); ii++)
+			itt->second.Columns[ii].Last = atof(sd[2 + ii].c_str());
 	}
+	return true;
+}
 
-	case pTypeGeneral:
+std::set<uint64_t> CSQLHelper::GetCalendarDevices(const char *szTable, const char *szDate, const std::vector<uint64_t> &DeviceRowIDs)
+{
+	std::set<uint64_t> devices;
+	if (DeviceRowIDs.empty())
+		return devices;
+	std::string szDeviceRowIDs;
+	for (const auto &ID : DeviceRowIDs)
 	{
-		switch (SensorSubType)
-		{
-		case sTypePressure: //Pressure (Bar)
-		case sTypePercentage: //Percentage
-		case sTypeWaterflow: //Waterflow
-		{
-			std::string rID = std::string(ID);
-			padLeft(rID, 8, '0');
-			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "0.0", devname, true, userName.c_str());
-		}
-		break;
-		case sTypeCounterIncremental:
-			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0", devname, true, userName.c_str());
-			break;
-		case sTypeManagedCounter:
-			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "-1;0", devname, true, userName.c_str());
-			break;
-		case sTypeVoltage:		//Voltage
-		{
-			std::string rID = std::string(ID);
-			padLeft(rID, 8, '0');
-			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "0.000", devname, true, userName.c_str());
-		}
-		break;
-		case sTypeTextStatus:		//Text
-		{
-			std::string rID = std::string(ID);
-			padLeft(rID, 8, '0');
-			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "Hello World", devname, true, userName.c_str());
-		}
-		break;
-		case sTypeAlert:		//Alert
-			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "No Alert!", devname, true, userName.c_str());
-			break;
-		case sTypeSoundLevel:		//Sound Level
-		{
-			std::string rID = std::string(ID);
-			padLeft(rID, 8, '0');
-			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "65", devname, true, userName.c_str());
-		}
-		break;
-		case sTypeBaro:		//Barometer (hPa)
-		{
-			std::string rID = std::string(ID);
-			padLeft(rID, 8, '0');
-			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "1021.34;0", devname, true, userName.c_str());
-		}
-		break;
-		case sTypeVisibility:		//Visibility (km)
+		if (!szDeviceRowIDs.empty())
+			szDeviceRowIDs += ",";
+		szDeviceRowIDs += std::to_string(ID);
+	}
+	std::vector<std::vector<std::string>> result;
+	result = safe_query("SELECT DISTINCT DeviceRowID FROM %s WHERE (DeviceRowID IN (%s)) AND (Date=='%q')", szTable, szDeviceRowIDs.c_str(), szDate);
+	for (const auto &sd : result)
+		devices.insert(std::stoull(sd[0]));
+	return devices;
+}
+
+std::set<uint64_t> CSQLHelper::GetCalendarDevices(const char *szTable, const char *szDate, const CDayAccumulator::_tDayDevices &devices)
+{
+	std::vector<uint64_t> DeviceRowIDs;
+	for (const auto &itt : devices)
+		DeviceRowIDs.push_back(itt.first);
+	return GetCalendarDevices(szTable, szDate, DeviceRowIDs);
+}
+
+std::vector<std::vector<std::string>> CSQLHelper::GetShortLog(const std::string &szTable, const std::string &szColumns, const uint64_t DeviceRowID)
+{
+	CShortLogStore::_eShortLogTable table;
+	if ((m_bShortLogStoreEnabled) && (CShortLogStore::GetTable(szTable, table)) && (m_shortlogstore.IsOpen()))
+	{
+		std::vector<std::string> columns;
+		StringSplit(szColumns, ",", columns);
+		for (auto &column : columns)
+			stdstring_trimws(column);
+
+		int n5MinuteHistoryDays = 1;
+		GetPreferencesVar("5MinuteHistoryDays", n5MinuteHistoryDays);
+		time_t fromTime = mytime(nullptr) - (n5MinuteHistoryDays * 86400);
+
+		std::vector<std::vector<std::string>> result;
+		if (m_shortlogstore.GetRows(table, DeviceRowID, columns, fromTime, result))
+			return result;
+	}
+	return safe_query_read("SELECT %s FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", szColumns.c_str(), szTable.c_str(), DeviceRowID);
+}
+
+void CSQLHelper::BeginGroupCommit()
+{
+	//m_sqlQueryMutex should be locked by the caller
+	if ((!m_bGroupCommitEnabled) || (!m_dbase))
+		return;
+	if (!sqlite3_get_autocommit(m_dbase))
+		return; //already inside a transaction
+	if (sqlite3_exec(m_dbase, "BEGIN TRANSACTION", nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		_log.Log(LOG_ERROR, "SQL: Could not start group commit transaction: %s", sqlite3_errmsg(m_dbase));
+		return;
+	}
+	m_bGroupTransactionOpen = true;
+	m_group_commit_start = std::chrono::steady_clock::now();
+}
+
+void CSQLHelper::CommitGroupTransaction()
+{
+	//m_sqlQueryMutex should be locked by the caller
+	if ((!m_bGroupCommitEnabled) || (!m_dbase))
+		return;
+	if (sqlite3_get_autocommit(m_dbase))
+		return; //nothing pending
+	if (sqlite3_exec(m_dbase, "COMMIT TRANSACTION", nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		//Transaction stays open, we try again on the next check
+		_log.Log(LOG_ERROR, "SQL: Group commit failed: %s", sqlite3_errmsg(m_dbase));
+		return;
+	}
+	m_bGroupTransactionOpen = false;
+}
+
+void CSQLHelper::CheckGroupCommit()
+{
+	if (!m_bGroupCommitEnabled)
+		return;
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if ((!m_dbase) || (sqlite3_get_autocommit(m_dbase)))
+		return;
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_group_commit_start).count();
+	if (elapsed >= m_group_commit_interval)
+		CommitGroupTransaction();
+}
+
+void CSQLHelper::FlushWrites()
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	CommitGroupTransaction();
+}
+
+sqlite3_stmt* CSQLHelper::GetCachedStatement(const char* szQuery)
+{
+	//m_sqlQueryMutex should be locked by the caller
+	auto itt = m_statement_cache.find(szQuery);
+	if (itt != m_statement_cache.end())
+		return itt->second;
+
+	sqlite3_stmt* statement = nullptr;
+	if (sqlite3_prepare_v2(m_dbase, szQuery, -1, &statement, nullptr) != SQLITE_OK)
+	{
+		_log.Log(LOG_ERROR, "SQL Prepare(\"%s\") : %s", szQuery, sqlite3_errmsg(m_dbase));
+		sqlite3_finalize(statement);
+		return nullptr;
+	}
+	m_statement_cache[szQuery] = statement;
+	return statement;
+}
+
+void CSQLHelper::ClearStatementCache()
+{
+	//m_sqlQueryMutex should be locked by the caller (or the database not in use anymore)
+	for (auto& itt : m_statement_cache)
+		sqlite3_finalize(itt.second);
+	m_statement_cache.clear();
+}
+
+CSQLStatement::CSQLStatement(CSQLHelper& sql, const char* szQuery)
+	: m_lock(sql.m_sqlQueryMutex)
+	, m_pSQL(&sql)
+	, m_szQuery(szQuery)
+{
+	if (!sql.m_dbase)
+	{
+		_log.Log(LOG_ERROR, "Database not open!!...Check your user rights!..");
+		return;
+	}
+	m_dbase = sql.m_dbase;
+	_log.Debug(DEBUG_SQL, "Statement:%s", szQuery);
+	m_stmt = sql.GetCachedStatement(szQuery);
+}
+
+CSQLStatement::~CSQLStatement()
+{
+	if (m_stmt)
+	{
+		sqlite3_reset(m_stmt);
+		sqlite3_clear_bindings(m_stmt);
+	}
+}
+
+void CSQLStatement::LogError(const char* szAction)
+{
+	_log.Log(LOG_ERROR, "SQL %s(\"%s\") : %s", szAction, m_szQuery, sqlite3_errmsg(m_dbase));
+}
+
+CSQLStatement& CSQLStatement::Bind(const int Value)
+{
+	if (m_stmt && (sqlite3_bind_int(m_stmt, ++m_bindIndex, Value) != SQLITE_OK))
+		LogError("Bind");
+	return *this;
+}
+
+CSQLStatement& CSQLStatement::Bind(const int64_t Value)
+{
+	if (m_stmt && (sqlite3_bind_int64(m_stmt, ++m_bindIndex, Value) != SQLITE_OK))
+		LogError("Bind");
+	return *this;
+}
+
+CSQLStatement& CSQLStatement::Bind(const uint64_t Value)
+{
+	return Bind(static_cast<int64_t>(Value));
+}
+
+CSQLStatement& CSQLStatement::Bind(const double Value)
+{
+	if (m_stmt && (sqlite3_bind_double(m_stmt, ++m_bindIndex, Value) != SQLITE_OK))
+		LogError("Bind");
+	return *this;
+}
+
+CSQLStatement& CSQLStatement::Bind(const char* Value)
+{
+	if (Value == nullptr)
+		return BindNull();
+	if (m_stmt && (sqlite3_bind_text(m_stmt, ++m_bindIndex, Value, -1, SQLITE_TRANSIENT) != SQLITE_OK))
+		LogError("Bind");
+	return *this;
+}
+
+CSQLStatement& CSQLStatement::Bind(const std::string& Value)
+{
+	if (m_stmt && (sqlite3_bind_text(m_stmt, ++m_bindIndex, Value.c_str(), static_cast<int>(Value.size()), SQLITE_TRANSIENT) != SQLITE_OK))
+		LogError("Bind");
+	return *this;
+}
+
+CSQLStatement& CSQLStatement::BindNull()
+{
+	if (m_stmt && (sqlite3_bind_null(m_stmt, ++m_bindIndex) != SQLITE_OK))
+		LogError("Bind");
+	return *this;
+}
+
+bool CSQLStatement::Step()
+{
+	if ((!m_stmt) || (m_bDone))
+		return false;
+	int rc = sqlite3_step(m_stmt);
+	if (rc == SQLITE_ROW)
+		return true;
+	m_bDone = true;
+	if (rc != SQLITE_DONE)
+		LogError("Query");
+	return false;
+}
+
+bool CSQLStatement::Execute()
+{
+	if (!m_stmt)
+		return false;
+	if (!sqlite3_stmt_readonly(m_stmt))
+		m_pSQL->BeginGroupCommit();
+	int rc;
+	do
+	{
+		rc = sqlite3_step(m_stmt);
+	} while (rc == SQLITE_ROW);
+	m_bDone = true;
+	if (rc != SQLITE_DONE)
+	{
+		LogError("Query");
+		return false;
+	}
+	return true;
+}
+
+int CSQLStatement::ColumnCount() const
+{
+	return (m_stmt) ? sqlite3_column_count(m_stmt) : 0;
+}
+
+bool CSQLStatement::IsNull(const int col) const
+{
+	return (sqlite3_column_type(m_stmt, col) == SQLITE_NULL);
+}
+
+int CSQLStatement::GetInt(const int col) const
+{
+	return sqlite3_column_int(m_stmt, col);
+}
+
+int64_t CSQLStatement::GetInt64(const int col) const
+{
+	return sqlite3_column_int64(m_stmt, col);
+}
+
+uint64_t CSQLStatement::GetUInt64(const int col) const
+{
+	return static_cast<uint64_t>(sqlite3_column_int64(m_stmt, col));
+}
+
+double CSQLStatement::GetDouble(const int col) const
+{
+	return sqlite3_column_double(m_stmt, col);
+}
+
+boost::string_view CSQLStatement::GetText(const int col) const
+{
+	const char* value = (const char*)sqlite3_column_text(m_stmt, col);
+	if (value == nullptr)
+		return boost::string_view();
+	return boost::string_view(value, sqlite3_column_bytes(m_stmt, col));
+}
+
+std::string CSQLStatement::GetString(const int col) const
+{
+	return GetText(col).to_string();
+}
+
+uint64_t CSQLHelper::CreateDevice(const int HardwareID, const int SensorType, const int SensorSubType, std::string &devname, const unsigned long nid, const std::string &soptions,
+				  const std::string &userName)
+{
+	uint64_t DeviceRowIdx = (uint64_t)-1;
+	char ID[20];
+	sprintf(ID, "%lu", nid);
+
+#ifdef ENABLE_PYTHON
+	{
+		std::vector<std::vector<std::string> > result;
+		result = safe_query("SELECT Type FROM Hardware WHERE (ID == %d)", HardwareID);
+		if (!result.empty())
+		{
+			std::vector<std::string> sd = result[0];
+			_eHardwareTypes Type = (_eHardwareTypes)atoi(sd[0].c_str());
+			if (Type == HTYPE_PythonPlugin)
+			{
+				// Not allowed to add device to plugin HW (plugin framework does not use key column "ID" but instead uses column "unit" as key)
+				_log.Log(LOG_ERROR, "CSQLHelper::CreateDevice: Not allowed to add device owned by plugin %u!", HardwareID);
+				return DeviceRowIdx;
+			}
+		}
+	}
+#endif
+
+	switch (SensorType)
+	{
+	case pTypeTEMP:
+	case pTypeWEIGHT:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0", devname, true, userName.c_str());
+		break;
+	case pTypeUV:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;0.0", devname, true, userName.c_str());
+		break;
+	case pTypeRAIN:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0;0", devname, true, userName.c_str());
+		break;
+	case pTypeTEMP_BARO:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;1038.0;0;188.0", devname, true, userName.c_str());
+		break;
+	case pTypeHUM:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 50, "1", devname, true, userName.c_str());
+		break;
+	case pTypeTEMP_HUM:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;50;1", devname, true, userName.c_str());
+		break;
+	case pTypeTEMP_HUM_BARO:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;50;1;1010;1", devname, true, userName.c_str());
+		break;
+	case pTypeRFXMeter:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 10, 255, 0, "0", devname, true, userName.c_str());
+		break;
+	case pTypeUsage:
+	case pTypeLux:
+	case pTypeP1Gas:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0", devname, true, userName.c_str());
+		break;
+	case pTypeP1Power:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0;0;0;0;0;0", devname, true, userName.c_str());
+		break;
+	case pTypeAirQuality:
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, devname, true, userName.c_str());
+		break;
+	case pTypeCURRENT:
+		//Current/Ampere
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0.0;0.0;0.0", devname, true, userName.c_str());
+		break;
+	case pTypeSetpoint: //Thermostat Setpoint
+	{
+		unsigned char ID1 = (unsigned char)((nid & 0xFF000000) >> 24);
+		unsigned char ID2 = (unsigned char)((nid & 0x00FF0000) >> 16);
+		unsigned char ID3 = (unsigned char)((nid & 0x0000FF00) >> 8);
+		unsigned char ID4 = (unsigned char)((nid & 0x000000FF));
+		sprintf(ID, "%X%02X%02X%02X", ID1, ID2, ID3, ID4);
+
+		DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "20.5", devname, true, userName.c_str());
+		break;
+	}
+
+	case pTypeGeneral:
+	{
+		switch (SensorSubType)
+		{
+		case sTypePressure: //Pressure (Bar)
+		case sTypePercentage: //Percentage
+		case sTypeWaterflow: //Waterflow
+		{
+			std::string rID = std::string(ID);
+			padLeft(rID, 8, '0');
+			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "0.0", devname, true, userName.c_str());
+		}
+		break;
+		case sTypeCounterIncremental:
+			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "0", devname, true, userName.c_str());
+			break;
+		case sTypeManagedCounter:
+			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "-1;0", devname, true, userName.c_str());
+			break;
+		case sTypeVoltage:		//Voltage
+		{
+			std::string rID = std::string(ID);
+			padLeft(rID, 8, '0');
+			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "0.000", devname, true, userName.c_str());
+		}
+		break;
+		case sTypeTextStatus:		//Text
+		{
+			std::string rID = std::string(ID);
+			padLeft(rID, 8, '0');
+			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "Hello World", devname, true, userName.c_str());
+		}
+		break;
+		case sTypeAlert:		//Alert
+			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "No Alert!", devname, true, userName.c_str());
+			break;
+		case sTypeSoundLevel:		//Sound Level
+		{
+			std::string rID = std::string(ID);
+			padLeft(rID, 8, '0');
+			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "65", devname, true, userName.c_str());
+		}
+		break;
+		case sTypeBaro:		//Barometer (hPa)
+		{
+			std::string rID = std::string(ID);
+			padLeft(rID, 8, '0');
+			DeviceRowIdx = UpdateValue(HardwareID, 0, rID.c_str(), 1, SensorType, SensorSubType, 12, 255, 0, "1021.34;0", devname, true, userName.c_str());
+		}
+		break;
+		case sTypeVisibility:		//Visibility (km)
 			DeviceRowIdx = UpdateValue(HardwareID, 0, ID, 1, SensorType, SensorSubType, 12, 255, 0, "10.3", devname, true, userName.c_str());
 			break;
 		case sTypeDistance:		//Distance (cm)
@@ -5194,6 +5788,8 @@ uint64_t CSQLHelper::UpdateValueInt(
 	if (!m_dbase)
 		return -1;
 
+	CLatencyTimer latencyTimer(m_latencystats.Get(CLatencyStats::STAGE_SQL_UPDATE_VALUE));
+
 	CDomoticzHardwareBase* pHardware = m_mainworker.GetHardware(HardwareID);
 	if (pHardware != nullptr)
 	{
@@ -5201,19 +5797,44 @@ uint64_t CSQLHelper::UpdateValueInt(
 	}
 
 	uint64_t ulID = 0;
-	std::map<std::string, std::string> options;
 
 	bool bIsManagedCounter = (devType == pTypeGeneral && subType == sTypeManagedCounter);
 
-	std::vector<std::vector<std::string> > result;
-	result = safe_query("SELECT ID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options FROM DeviceStatus WHERE (HardwareID=%d AND OrgHardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)", HardwareID, OrgHardwareID, ID, unit, devType, subType);
+	const _tDeviceCacheKey cacheKey{ HardwareID, OrgHardwareID, ID, unit, devType, subType };
+	_tDeviceCacheItem cItem;
+	uint64_t cacheGeneration = 0;
 
-	if (!result.empty())
+	bool bDeviceFound = GetCachedDevice(cacheKey, cItem, cacheGeneration);
+	if (!bDeviceFound)
 	{
-		std::string sOption = result[0][7];
-		options = BuildDeviceOptions(sOption);
+		CSQLStatement stmt(*this, "SELECT ID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options FROM DeviceStatus WHERE (HardwareID=? AND OrgHardwareID=? AND DeviceID=? AND Unit=? AND Type=? AND SubType=?)");
+		stmt.Bind(HardwareID).Bind(OrgHardwareID).Bind(ID).Bind(unit).Bind(devType).Bind(subType);
+		if (stmt.Step())
+		{
+			bDeviceFound = true;
+			cItem.ID = stmt.GetUInt64(0);
+			cItem.Name = stmt.GetString(1);
+			cItem.bUsed = stmt.GetInt(2) != 0;
+			cItem.SwitchType = (_eSwitchType)stmt.GetInt(3);
+			cItem.nValue = stmt.GetInt(4);
+			cItem.sValue = stmt.GetString(5);
+			cItem.LastUpdate = stmt.GetString(6);
+			boost::string_view sOption = stmt.GetText(7);
+			cItem.Options = std::make_shared<const std::map<std::string, std::string>>(BuildDeviceOptions(sOption.to_string()));
+			SetCachedDevice(cacheKey, cItem, cacheGeneration);
+		}
+	}
+
+	auto GetOption = [&cItem](const char *szKey) {
+		if (!cItem.Options)
+			return std::string();
+		auto itt = cItem.Options->find(szKey);
+		return (itt != cItem.Options->end()) ? itt->second : std::string();
+	};
 
-		if (options["AddDBLogEntry"] == "true")
+	if (bDeviceFound)
+	{
+		if (GetOption("AddDBLogEntry") == "true")
 		{
 			bIsManagedCounter = true;
 		}
@@ -5221,14 +5842,15 @@ uint64_t CSQLHelper::UpdateValueInt(
 	if (bIsManagedCounter)
 		return UpdateManagedValueInt(HardwareID, OrgHardwareID, ID, unit, devType, subType, signallevel, batterylevel, nValue, sValue, devname, bUseOnOffAction, User);
 
-
 	bool bDeviceUsed = false;
 	bool bSameDeviceStatusValue = false;
 	int nValueBeforeUpdate = -1;
 	std::string sValueBeforeUpdate;
 	_eSwitchType stype = STYPE_OnOff;
 
-	if (result.empty())
+	std::vector<std::vector<std::string> > result;
+
+	if (!bDeviceFound)
 	{
 		//Insert
 		ulID = InsertDevice(HardwareID, OrgHardwareID, ID, unit, devType, subType, 0, nValue, sValue, devname, signallevel, batterylevel);
@@ -5251,22 +5873,22 @@ uint64_t CSQLHelper::UpdateValueInt(
 	else
 	{
 		//Update
-		ulID = std::stoull(result[0][0]);
-		devname = result[0][1];
-		bDeviceUsed = atoi(result[0][2].c_str()) != 0;
-		stype = (_eSwitchType)atoi(result[0][3].c_str());
-		nValueBeforeUpdate = atoi(result[0][4].c_str());
-		sValueBeforeUpdate = result[0][5];
+		ulID = cItem.ID;
+		devname = cItem.Name;
+		bDeviceUsed = cItem.bUsed;
+		stype = cItem.SwitchType;
+		nValueBeforeUpdate = cItem.nValue;
+		sValueBeforeUpdate = cItem.sValue;
 
 		std::string sLastUpdate = TimeToString(nullptr, TF_DateTime);
 
 		//Commit: If Option 1: energy is computed as usage*time
 		//Default is option 0, read from device
-		if (options["EnergyMeterMode"] == "1" && devType == pTypeGeneral && subType == sTypeKwh)
+		if (GetOption("EnergyMeterMode") == "1" && devType == pTypeGeneral && subType == sTypeKwh)
 		{
             double intervalSeconds;
             struct tm ntime;
-			std::string sLastUpdate = result[0][6];
+			std::string sLastUpdate = cItem.LastUpdate;
 
 			time_t now = time(nullptr);
 			struct tm ltime;
@@ -5307,13 +5929,11 @@ uint64_t CSQLHelper::UpdateValueInt(
 		//~ use different update queries based on the device type
 		if (devType == pTypeGeneral && subType == sTypeCounterIncremental)
 		{
-			result = safe_query(
-				"UPDATE DeviceStatus SET SignalLevel=%d, BatteryLevel=%d, nValue= nValue + %d, sValue= sValue + '%q', LastUpdate='%q' "
-				"WHERE (ID = %" PRIu64 ")",
-				signallevel, batterylevel,
-				nValue, sValue,
-				sLastUpdate.c_str(),
-				ulID);
+			CSQLStatement stmt(*this,
+				"UPDATE DeviceStatus SET SignalLevel=?, BatteryLevel=?, nValue= nValue + ?, sValue= sValue + ?, LastUpdate=? "
+				"WHERE (ID = ?)");
+			stmt.Bind(signallevel).Bind(batterylevel).Bind(nValue).Bind(sValue).Bind(sLastUpdate).Bind(ulID);
+			stmt.Execute();
 		}
 		else
 		{
@@ -5334,13 +5954,17 @@ uint64_t CSQLHelper::UpdateValueInt(
 					);
 			}
 
-			result = safe_query(
-				"UPDATE DeviceStatus SET SignalLevel=%d, BatteryLevel=%d, nValue=%d, sValue='%q', LastUpdate='%q' "
-				"WHERE (ID = %" PRIu64 ")",
-				signallevel, batterylevel,
-				nValue, sValue,
-				sLastUpdate.c_str(),
-				ulID);
+			CSQLStatement stmt(*this,
+				"UPDATE DeviceStatus SET SignalLevel=?, BatteryLevel=?, nValue=?, sValue=?, LastUpdate=? "
+				"WHERE (ID = ?)");
+			stmt.Bind(signallevel).Bind(batterylevel).Bind(nValue).Bind(sValue).Bind(sLastUpdate).Bind(ulID);
+			//Write-through, only the value columns of an entry that is still cached are updated,
+			//so a change of the row by another thread (name, used, type, options) is not overwritten
+			g_ulDeviceValueWrite = ulID;
+			bool bWritten = stmt.Execute();
+			g_ulDeviceValueWrite = 0;
+			if (bWritten)
+				UpdateCachedDeviceValue(cacheKey, ulID, nValue, sValue, sLastUpdate);
 		}
 	}
 
@@ -5387,8 +6011,11 @@ uint64_t CSQLHelper::UpdateValueInt(
 	case pTypeDDxxxx:
 		if ((devType == pTypeRadiator1) && (subType != sTypeSmartwaresSwitchRadiator))
 			break;
-		m_LastSwitchID = ID;
-		m_LastSwitchRowID = ulID;
+		{
+			std::lock_guard<std::mutex> l(m_lastswitch_mutex);
+			m_LastSwitchID = ID;
+			m_LastSwitchRowID = ulID;
+		}
 
 		//Add Lighting log (Skip duplicates)
 		if (
@@ -5400,13 +6027,11 @@ uint64_t CSQLHelper::UpdateValueInt(
 			|| (devType == pTypeSecurity1)
 			)
 		{
-			result = safe_query(
+			CSQLStatement stmt(*this,
 				"INSERT INTO LightingLog (DeviceRowID, nValue, sValue, User) "
-				"VALUES ('%" PRIu64 "', '%d', '%q', '%q')",
-				ulID,
-				nValue, sValue,
-				(User != nullptr) ? User : ""
-			);
+				"VALUES (?, ?, ?, ?)");
+			stmt.Bind(ulID).Bind(nValue).Bind(sValue).Bind((User != nullptr) ? User : "");
+			stmt.Execute();
 		}
 		if (!bDeviceUsed)
 			return ulID;	//don't process further as the device is not used
@@ -5670,6 +6295,37 @@ uint64_t CSQLHelper::UpdateValueInt(
 	return ulID;
 }
 
+void CSQLHelper::ClearLastSwitch()
+{
+	std::lock_guard<std::mutex> l(m_lastswitch_mutex);
+	m_LastSwitchID.clear();
+	m_LastSwitchRowID = 0;
+}
+
+bool CSQLHelper::GetLastSwitch(std::string &ID, uint64_t &RowID)
+{
+	std::lock_guard<std::mutex> l(m_lastswitch_mutex);
+	if (m_LastSwitchID.empty())
+		return false;
+	ID = m_LastSwitchID;
+	RowID = m_LastSwitchRowID;
+	return true;
+}
+
+bool CSQLHelper::UpdateBatteryLevel(const uint64_t idx, const int BatteryLevel)
+{
+	if (!m_dbase)
+		return false;
+
+	// the battery level is not cached, the cache entry of the device stays valid
+	CSQLStatement stmt(*this, "UPDATE DeviceStatus SET BatteryLevel=? WHERE (ID==?)");
+	stmt.Bind(BatteryLevel).Bind(idx);
+	g_ulDeviceValueWrite = idx;
+	bool bWritten = stmt.Execute();
+	g_ulDeviceValueWrite = 0;
+	return bWritten;
+}
+
 bool CSQLHelper::UpdateLastUpdate(const std::string& sidx)
 {
 	return UpdateLastUpdate(std::stoull(sidx));
@@ -5799,13 +6455,11 @@ bool CSQLHelper::GetPreferencesVar(const std::string& Key, std::string& sValue)
 	if (!m_dbase)
 		return false;
 
-	std::vector<std::vector<std::string> > result;
-	result = safe_query("SELECT sValue FROM Preferences WHERE (Key='%q')",
-		Key.c_str());
-	if (result.empty())
+	CSQLStatement stmt(*this, "SELECT sValue FROM Preferences WHERE (Key=?)");
+	stmt.Bind(Key);
+	if (!stmt.Step())
 		return false;
-	std::vector<std::string> sd = result[0];
-	sValue = sd[0];
+	sValue = stmt.GetString(0);
 	return true;
 }
 
@@ -5825,14 +6479,12 @@ bool CSQLHelper::GetPreferencesVar(const std::string& Key, int& nValue, std::str
 	if (!m_dbase)
 		return false;
 
-	std::vector<std::vector<std::string> > result;
-	result = safe_query("SELECT nValue, sValue FROM Preferences WHERE (Key='%q')",
-		Key.c_str());
-	if (result.empty())
+	CSQLStatement stmt(*this, "SELECT nValue, sValue FROM Preferences WHERE (Key=?)");
+	stmt.Bind(Key);
+	if (!stmt.Step())
 		return false;
-	std::vector<std::string> sd = result[0];
-	nValue = atoi(sd[0].c_str());
-	sValue = sd[1];
+	nValue = stmt.GetInt(0);
+	sValue = stmt.GetString(1);
 	return true;
 }
 
@@ -5970,6 +6622,13 @@ void CSQLHelper::ScheduleShortlog()
 		//Force WAL flush
 		sqlite3_wal_checkpoint(m_dbase, nullptr);
 
+		//With group commit, write all short log entries in one transaction
+		{
+			std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+			BeginGroupCommit();
+		}
+
+		g_bDayTotalsWrite = true;
 		UpdateTemperatureLog();
 		UpdateRainLog();
 		UpdateWindLog();
@@ -5981,9 +6640,13 @@ void CSQLHelper::ScheduleShortlog()
 		//Removing the line below could cause a very large database,
 		//and slow(large) data transfer (specially when working remote!!)
 		CleanupShortLog();
+		g_bDayTotalsWrite = false;
+
+		FlushWrites();
 	}
 	catch (boost::exception& e)
 	{
+		g_bDayTotalsWrite = false;
 		_log.Log(LOG_ERROR, "Domoticz: Error running the shortlog schedule script!");
 #ifdef _DEBUG
 		_log.Log(LOG_ERROR, "-----------------\n%s\n----------------", boost::diagnostic_information(e).c_str());
@@ -6004,14 +6667,28 @@ void CSQLHelper::ScheduleDay()
 		//Force WAL flush
 		sqlite3_wal_checkpoint(m_dbase, nullptr);
 
-		AddCalendarTemperature();
-		AddCalendarUpdateRain();
-		AddCalendarUpdateUV();
-		AddCalendarUpdateWind();
-		AddCalendarUpdateMeter();
-		AddCalendarUpdateMultiMeter();
-		AddCalendarUpdatePercentage();
-		AddCalendarUpdateFan();
+		char szDateStart[40];
+		char szDateEnd[40];
+
+		time_t now = mytime(nullptr);
+		struct tm ltime;
+		localtime_r(&now, &ltime);
+		sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+
+		time_t yesterday;
+		struct tm tm2;
+		getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
+		sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
+
+		//With group commit, write all calendar rows in one transaction
+		{
+			std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+			BeginGroupCommit();
+		}
+		for (int ii = 0; szCalendarTables[ii] != nullptr; ii++)
+			AddCalendarDay(szCalendarTables[ii], szDateStart, szDateEnd, true);
+		FlushWrites();
+
 		CleanupLightSceneLog();
 	}
 	catch (boost::exception& e)
@@ -6026,6 +6703,79 @@ void CSQLHelper::ScheduleDay()
 	}
 }
 
+void CSQLHelper::AddCalendarDay(const char *szTable, const char *szDateStart, const char *szDateEnd, const bool bYesterday)
+{
+	std::lock_guard<std::mutex> l(m_calendar_mutex);
+	if (strcmp(szTable, "Temperature") == 0)
+		AddCalendarTemperature(szDateStart, szDateEnd);
+	else if (strcmp(szTable, "Rain") == 0)
+		AddCalendarUpdateRain(szDateStart, szDateEnd);
+	else if (strcmp(szTable, "UV") == 0)
+		AddCalendarUpdateUV(szDateStart, szDateEnd);
+	else if (strcmp(szTable, "Wind") == 0)
+		AddCalendarUpdateWind(szDateStart, szDateEnd);
+	else if (strcmp(szTable, "Meter") == 0)
+		AddCalendarUpdateMeter(szDateStart, szDateEnd, bYesterday);
+	else if (strcmp(szTable, "MultiMeter") == 0)
+		AddCalendarUpdateMultiMeter(szDateStart, szDateEnd, bYesterday);
+	else if (strcmp(szTable, "Percentage") == 0)
+		AddCalendarUpdatePercentage(szDateStart, szDateEnd);
+	else if (strcmp(szTable, "Fan") == 0)
+		AddCalendarUpdateFan(szDateStart, szDateEnd);
+}
+
+void CSQLHelper::CatchUpCalendar()
+{
+	try
+	{
+		time_t now = mytime(nullptr);
+		struct tm ltime;
+		localtime_r(&now, &ltime);
+		char szToday[40];
+		sprintf(szToday, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+
+		int nDays = 0;
+		for (int ii = 0; szCalendarTables[ii] != nullptr; ii++)
+		{
+			//Days before today that are still in the short log.
+			//The first one is skipped, its oldest samples are probably cleaned up already
+			std::vector<std::vector<std::string> > result;
+			result = safe_query("SELECT DISTINCT date(Date) FROM %s WHERE (Date<'%q') ORDER BY 1", szCalendarTables[ii], szToday);
+			for (size_t jj = 1; jj < result.size(); jj++)
+			{
+				if (IsStopRequested(0))
+					return;
+				const std::string &szDay = result[jj][0];
+				int year, month, day;
+				if (sscanf(szDay.c_str(), "%d-%d-%d", &year, &month, &day) != 3)
+					continue;
+
+				//only days we missed completely
+				std::string szCalendarTable = std::string(szCalendarTables[ii]) + "_Calendar";
+				std::vector<std::vector<std::string> > result2;
+				result2 = safe_query("SELECT COUNT(*) FROM %s WHERE (Date=='%q')", szCalendarTable.c_str(), szDay.c_str());
+				if ((result2.empty()) || (atoi(result2[0][0].c_str()) != 0))
+					continue;
+
+				time_t tomorrow;
+				struct tm tm2;
+				getNoon(tomorrow, tm2, year, month, day + 1);
+				char szDateEnd[40];
+				sprintf(szDateEnd, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
+
+				AddCalendarDay(szCalendarTables[ii], szDay.c_str(), szDateEnd, false);
+				nDays++;
+			}
+		}
+		if (nDays != 0)
+			_log.Log(LOG_STATUS, "SQLHelper: Added %d missed day(s) to the calendar tables", nDays);
+	}
+	catch (std::exception& e)
+	{
+		_log.Log(LOG_ERROR, "SQLHelper: Error adding missed days to the calendar tables (%s)", e.what());
+	}
+}
+
 void CSQLHelper::UpdateTemperatureLog()
 {
 	time_t now = mytime(nullptr);
@@ -6207,6 +6957,7 @@ void CSQLHelper::UpdateTemperatureLog()
 				dewpoint,
 				setpoint
 			);
+			AddShortLogSample(CShortLogStore::SLT_TEMPERATURE, ID, now, { temp, chill, static_cast<double>(humidity), static_cast<double>(barometer), dewpoint, setpoint });
 		}
 	}
 }
@@ -6264,6 +7015,7 @@ void CSQLHelper::UpdateRainLog()
 				total,
 				rate
 			);
+			AddShortLogSample(CShortLogStore::SLT_RAIN, ID, now, { total, static_cast<double>(rate) });
 		}
 	}
 }
@@ -6320,15 +7072,18 @@ void CSQLHelper::UpdateWindLog()
 			int speed = atoi(splitresults[2].c_str());
 			int gust = atoi(splitresults[3].c_str());
 
-			auto ittWC = m_mainworker.m_wind_calculator.find(DeviceID);
-			if (ittWC != m_mainworker.m_wind_calculator.end())
 			{
-				int speed_max, gust_max, speed_min, gust_min;
-				ittWC->second.GetMMSpeedGust(speed_min, speed_max, gust_min, gust_max);
-				if (speed_max != -1)
-					speed = speed_max;
-				if (gust_max != -1)
-					gust = gust_max;
+				std::lock_guard<std::mutex> l(m_mainworker.m_calculatormutex);
+				auto ittWC = m_mainworker.m_wind_calculator.find(DeviceID);
+				if (ittWC != m_mainworker.m_wind_calculator.end())
+				{
+					int speed_max, gust_max, speed_min, gust_min;
+					ittWC->second.GetMMSpeedGust(speed_min, speed_max, gust_min, gust_max);
+					if (speed_max != -1)
+						speed = speed_max;
+					if (gust_max != -1)
+						gust = gust_max;
+				}
 			}
 
 			//insert record
@@ -6340,6 +7095,7 @@ void CSQLHelper::UpdateWindLog()
 				speed,
 				gust
 			);
+			AddShortLogSample(CShortLogStore::SLT_WIND, ID, now, { direction, static_cast<double>(speed), static_cast<double>(gust) });
 		}
 	}
 }
@@ -6398,6 +7154,7 @@ void CSQLHelper::UpdateUVLog()
 				ID,
 				level
 			);
+			AddShortLogSample(CShortLogStore::SLT_UV, ID, now, { level });
 		}
 	}
 }
@@ -7056,6 +7813,7 @@ void CSQLHelper::UpdatePercentageLog()
 				ID,
 				percentage
 			);
+			AddShortLogSample(CShortLogStore::SLT_PERCENTAGE, ID, now, { percentage });
 		}
 	}
 }
@@ -7114,104 +7872,71 @@ void CSQLHelper::UpdateFanLog()
 				ID,
 				speed
 			);
+			AddShortLogSample(CShortLogStore::SLT_FAN, ID, now, { static_cast<double>(speed) });
 		}
 	}
 }
 
-void CSQLHelper::AddCalendarTemperature()
+void CSQLHelper::AddCalendarTemperature(const char *szDateStart, const char *szDateEnd)
 {
-	//Get All temperature devices in the Temperature Table
-	std::vector<std::vector<std::string> > resultdevices;
-	resultdevices = safe_query("SELECT DISTINCT(DeviceRowID) FROM Temperature ORDER BY DeviceRowID");
-	if (resultdevices.empty())
+	CDayAccumulator::_tDayDevices devices;
+	if (!GetDayTotals(CShortLogStore::SLT_TEMPERATURE, szDateStart, szDateEnd, devices))
 		return; //nothing to do
-
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
-
-	std::vector<std::vector<std::string> > result;
-
-	for (const auto &sddev : resultdevices)
-	{
-		uint64_t ID = std::stoull(sddev[0]);
-
-		result = safe_query("SELECT MIN(Temperature), MAX(Temperature), AVG(Temperature), MIN(Chill), MAX(Chill), AVG(Humidity), AVG(Barometer), MIN(DewPoint), MIN(SetPoint), MAX(SetPoint), AVG(SetPoint) FROM Temperature WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00')",
+	std::set<uint64_t> existing = GetCalendarDevices("Temperature_Calendar", szDateStart, devices);
+
+	for (const auto &itt : devices)
+	{
+		uint64_t ID = itt.first;
+		if (existing.find(ID) != existing.end())
+			continue; //already added
+		const auto &columns = itt.second.Columns;
+		const double count = static_cast<double>(itt.second.Count);
+
+		float temp_min = static_cast<float>(columns[0].Min);
+		float temp_max = static_cast<float>(columns[0].Max);
+		float temp_avg = static_cast<float>(columns[0].Sum / count);
+		float chill_min = static_cast<float>(columns[1].Min);
+		float chill_max = static_cast<float>(columns[1].Max);
+		int humidity = static_cast<int>(columns[2].Sum / count);
+		int barometer = static_cast<int>(columns[3].Sum / count);
+		float dewpoint = static_cast<float>(columns[4].Min);
+		float setpoint_min = static_cast<float>(columns[5].Min);
+		float setpoint_max = static_cast<float>(columns[5].Max);
+		float setpoint_avg = static_cast<float>(columns[5].Sum / count);
+		safe_query(
+			"INSERT INTO Temperature_Calendar (DeviceRowID, Temp_Min, Temp_Max, Temp_Avg, Chill_Min, Chill_Max, Humidity, Barometer, DewPoint, SetPoint_Min, SetPoint_Max, SetPoint_Avg, Date) "
+			"VALUES ('%" PRIu64 "', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%d', '%d', '%.2f', '%.2f', '%.2f', '%.2f', '%q')",
 			ID,
-			szDateStart,
-			szDateEnd
-		);
-		if (!result.empty())
-		{
-			std::vector<std::string> sd = result[0];
-
-			float temp_min = static_cast<float>(atof(sd[0].c_str()));
-			float temp_max = static_cast<float>(atof(sd[1].c_str()));
-			float temp_avg = static_cast<float>(atof(sd[2].c_str()));
-			float chill_min = static_cast<float>(atof(sd[3].c_str()));
-			float chill_max = static_cast<float>(atof(sd[4].c_str()));
-			int humidity = atoi(sd[5].c_str());
-			int barometer = atoi(sd[6].c_str());
-			float dewpoint = static_cast<float>(atof(sd[7].c_str()));
-			float setpoint_min = static_cast<float>(atof(sd[8].c_str()));
-			float setpoint_max = static_cast<float>(atof(sd[9].c_str()));
-			float setpoint_avg = static_cast<float>(atof(sd[10].c_str()));
-			result = safe_query(
-				"INSERT INTO Temperature_Calendar (DeviceRowID, Temp_Min, Temp_Max, Temp_Avg, Chill_Min, Chill_Max, Humidity, Barometer, DewPoint, SetPoint_Min, SetPoint_Max, SetPoint_Avg, Date) "
-				"VALUES ('%" PRIu64 "', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%d', '%d', '%.2f', '%.2f', '%.2f', '%.2f', '%q')",
-				ID,
-				temp_min,
-				temp_max,
-				temp_avg,
-				chill_min,
-				chill_max,
-				humidity,
-				barometer,
-				dewpoint,
-				setpoint_min,
-				setpoint_max,
-				setpoint_avg,
-				szDateStart
-			);
-		}
-	}
-}
-
-void CSQLHelper::AddCalendarUpdateRain()
-{
-	//Get All UV devices
-	std::vector<std::vector<std::string> > resultdevices;
-	resultdevices = safe_query("SELECT DISTINCT(DeviceRowID) FROM Rain ORDER BY DeviceRowID");
-	if (resultdevices.empty())
-		return; //nothing to do
-
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
+			temp_min,
+			temp_max,
+			temp_avg,
+			chill_min,
+			chill_max,
+			humidity,
+			barometer,
+			dewpoint,
+			setpoint_min,
+			setpoint_max,
+			setpoint_avg,
+			szDateStart
+		);
+	}
+}
 
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
+void CSQLHelper::AddCalendarUpdateRain(const char *szDateStart, const char *szDateEnd)
+{
+	CDayAccumulator::_tDayDevices devices;
+	if (!GetDayTotals(CShortLogStore::SLT_RAIN, szDateStart, szDateEnd, devices))
+		return; //nothing to do
+	std::set<uint64_t> existing = GetCalendarDevices("Rain_Calendar", szDateStart, devices);
 
 	std::vector<std::vector<std::string> > result;
 
-	for (const auto &sddev : resultdevices)
+	for (const auto &itt : devices)
 	{
-		uint64_t ID = std::stoull(sddev[0]);
+		uint64_t ID = itt.first;
+		if (existing.find(ID) != existing.end())
+			continue; //already added
 
 		//Get Device Information
 		result = safe_query("SELECT SubType FROM DeviceStatus WHERE (ID='%" PRIu64 "')", ID);
@@ -7221,57 +7946,49 @@ void CSQLHelper::AddCalendarUpdateRain()
 
 		unsigned char subType = atoi(sd[0].c_str());
 
+		const auto &columns = itt.second.Columns;
+		float total_min;
+		float total_max;
+		int rate;
 		if (subType == sTypeRAINWU || subType == sTypeRAINByRate)
 		{
-			result = safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00') ORDER BY ROWID DESC LIMIT 1",
-				ID,
-				szDateStart,
-				szDateEnd
-			);
+			//last sample of the day
+			total_min = static_cast<float>(columns[0].Last);
+			total_max = total_min;
+			rate = static_cast<int>(columns[1].Last);
 		}
 		else
 		{
-			result = safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00')",
-				ID,
-				szDateStart,
-				szDateEnd
-			);
+			total_min = static_cast<float>(columns[0].Min);
+			total_max = static_cast<float>(columns[0].Max);
+			rate = static_cast<int>(columns[1].Max);
 		}
 
-		if (!result.empty())
+		float total_real = 0;
+		if (subType == sTypeRAINWU || subType == sTypeRAINByRate)
 		{
-			std::vector<std::string> sd = result[0];
-
-			float total_min = static_cast<float>(atof(sd[0].c_str()));
-			float total_max = static_cast<float>(atof(sd[1].c_str()));
-			int rate = atoi(sd[2].c_str());
-
-			float total_real = 0;
-			if (subType == sTypeRAINWU || subType == sTypeRAINByRate)
-			{
-				total_real = total_max;
-			}
-			else
-			{
-				total_real = total_max - total_min;
-			}
+			total_real = total_max;
+		}
+		else
+		{
+			total_real = total_max - total_min;
+		}
 
-			if (total_real < 1000)
-			{
-				result = safe_query(
-					"INSERT INTO Rain_Calendar (DeviceRowID, Total, Rate, Date) "
-					"VALUES ('%" PRIu64 "', '%.2f', '%d', '%q')",
-					ID,
-					total_real,
-					rate,
-					szDateStart
-				);
-			}
+		if (total_real < 1000)
+		{
+			safe_query(
+				"INSERT INTO Rain_Calendar (DeviceRowID, Total, Rate, Date) "
+				"VALUES ('%" PRIu64 "', '%.2f', '%d', '%q')",
+				ID,
+				total_real,
+				rate,
+				szDateStart
+			);
 		}
 	}
 }
 
-void CSQLHelper::AddCalendarUpdateMeter()
+void CSQLHelper::AddCalendarUpdateMeter(const char *szDateStart, const char *szDateEnd, const bool bYesterday)
 {
 	float EnergyDivider = 1000.0F;
 	float GasDivider = 100.0F;
@@ -7297,24 +8014,21 @@ void CSQLHelper::AddCalendarUpdateMeter()
 	if (resultdevices.empty())
 		return; //nothing to do
 
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
+	std::vector<uint64_t> ids;
+	for (const auto &sddev : resultdevices)
+		ids.push_back(std::stoull(sddev[0]));
+	std::set<uint64_t> existing = GetCalendarDevices("Meter_Calendar", szDateStart, ids);
+	//some meter types are stored in the MultiMeter calendar
+	std::set<uint64_t> existingMulti = GetCalendarDevices("MultiMeter_Calendar", szDateStart, ids);
+	existing.insert(existingMulti.begin(), existingMulti.end());
 
 	std::vector<std::vector<std::string> > result;
 
 	for (const auto &sddev : resultdevices)
 	{
 		uint64_t ID = std::stoull(sddev[0]);
+		if (existing.find(ID) != existing.end())
+			continue; //already added
 
 		//Get Device Information
 		result = safe_query("SELECT Name, HardwareID, DeviceID, Unit, Type, SubType, SwitchType, Options FROM DeviceStatus WHERE (ID='%" PRIu64 "')", ID);
@@ -7424,35 +8138,38 @@ void CSQLHelper::AddCalendarUpdateMeter()
 					szDateStart
 				);
 
-				//Check for Notification
+				//Check for Notification (not when catching up an older day)
 				musage = 0;
-				switch (metertype)
+				if (bYesterday)
 				{
-				case MTYPE_ENERGY:
-				case MTYPE_ENERGY_GENERATED:
-					musage = float(total_real) / EnergyDivider;
-					if (musage != 0)
-						m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYENERGY, musage);
-					break;
-				case MTYPE_GAS:
-					musage = float(total_real) / tGasDivider;
-					if (musage != 0)
-						m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYGAS, musage);
-					break;
-				case MTYPE_WATER:
-					musage = float(total_real) / WaterDivider;
-					if (musage != 0)
-						m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYGAS, musage);
-					break;
-				case MTYPE_COUNTER:
-					musage = float(total_real);
-					if (musage != 0)
-						m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYCOUNTER, musage);
-					break;
-				default:
-					//Unhandled
-					musage = 0;
-					break;
+					switch (metertype)
+					{
+					case MTYPE_ENERGY:
+					case MTYPE_ENERGY_GENERATED:
+						musage = float(total_real) / EnergyDivider;
+						if (musage != 0)
+							m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYENERGY, musage);
+						break;
+					case MTYPE_GAS:
+						musage = float(total_real) / tGasDivider;
+						if (musage != 0)
+							m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYGAS, musage);
+						break;
+					case MTYPE_WATER:
+						musage = float(total_real) / WaterDivider;
+						if (musage != 0)
+							m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYGAS, musage);
+						break;
+					case MTYPE_COUNTER:
+						musage = float(total_real);
+						if (musage != 0)
+							m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYCOUNTER, musage);
+						break;
+					default:
+						//Unhandled
+						musage = 0;
+						break;
+					}
 				}
 			}
 			else
@@ -7463,7 +8180,7 @@ void CSQLHelper::AddCalendarUpdateMeter()
 						    ID, total_min, total_max, avg_value, 0.0F, 0.0F, 0.0F, szDateStart);
 			}
 			//Insert the last (max) counter value into the meter table to get the "today" value correct.
-			if (
+			if (bYesterday && (
 				(devType == pTypeRFXMeter)
 				|| (devType == pTypeP1Gas)
 				|| (devType == pTypeYouLess)
@@ -7472,7 +8189,7 @@ void CSQLHelper::AddCalendarUpdateMeter()
 				|| ((devType == pTypeRego6XXValue) && (subType == sTypeRego6XXCounter))
 				|| ((devType == pTypeGeneral) && (subType == sTypeCounterIncremental))
 				|| ((devType == pTypeGeneral) && (subType == sTypeKwh))
-				)
+				))
 			{
 				result = safe_query("SELECT Value, Usage FROM Meter WHERE (DeviceRowID='%" PRIu64 "') ORDER BY ROWID DESC LIMIT 1", ID);
 				if (!result.empty())
@@ -7500,7 +8217,7 @@ void CSQLHelper::AddCalendarUpdateMeter()
 	}
 }
 
-void CSQLHelper::AddCalendarUpdateMultiMeter()
+void CSQLHelper::AddCalendarUpdateMultiMeter(const char *szDateStart, const char *szDateEnd, const bool bYesterday)
 {
 	float EnergyDivider = 1000.0F;
 	int tValue;
@@ -7515,24 +8232,18 @@ void CSQLHelper::AddCalendarUpdateMultiMeter()
 	if (resultdevices.empty())
 		return; //nothing to do
 
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
+	std::vector<uint64_t> ids;
+	for (const auto &sddev : resultdevices)
+		ids.push_back(std::stoull(sddev[0]));
+	std::set<uint64_t> existing = GetCalendarDevices("MultiMeter_Calendar", szDateStart, ids);
 
 	std::vector<std::vector<std::string> > result;
 
 	for (const auto &sddev : resultdevices)
 	{
 		uint64_t ID = std::stoull(sddev[0]);
+		if (existing.find(ID) != existing.end())
+			continue; //already added
 
 		//Get Device Information
 		result = safe_query("SELECT Name, HardwareID, DeviceID, Unit, Type, SubType, SwitchType, Options FROM DeviceStatus WHERE (ID='%" PRIu64 "')", ID);
@@ -7618,7 +8329,7 @@ void CSQLHelper::AddCalendarUpdateMultiMeter()
 			);
 
 			//Check for Notification
-			if (devType == pTypeP1Power)
+			if ((bYesterday) && (devType == pTypeP1Power))
 			{
 				float musage = (total_real[0] + total_real[4]) / EnergyDivider;
 				m_notifications.CheckAndHandleNotification(ID, devname, devType, subType, NTYPE_TODAYENERGY, musage);
@@ -7643,213 +8354,120 @@ void CSQLHelper::AddCalendarUpdateMultiMeter()
 	}
 }
 
-void CSQLHelper::AddCalendarUpdateWind()
+void CSQLHelper::AddCalendarUpdateWind(const char *szDateStart, const char *szDateEnd)
 {
-	//Get All Wind devices
-	std::vector<std::vector<std::string> > resultdevices;
-	resultdevices = safe_query("SELECT DISTINCT(DeviceRowID) FROM Wind ORDER BY DeviceRowID");
-	if (resultdevices.empty())
+	CDayAccumulator::_tDayDevices devices;
+	if (!GetDayTotals(CShortLogStore::SLT_WIND, szDateStart, szDateEnd, devices))
 		return; //nothing to do
+	std::set<uint64_t> existing = GetCalendarDevices("Wind_Calendar", szDateStart, devices);
 
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
-
-	std::vector<std::vector<std::string> > result;
-
-	for (const auto &sddev : resultdevices)
+	for (const auto &itt : devices)
 	{
-		uint64_t ID = std::stoull(sddev[0]);
+		uint64_t ID = itt.first;
+		if (existing.find(ID) != existing.end())
+			continue; //already added
+		const auto &columns = itt.second.Columns;
 
-		result = safe_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed), MIN(Gust), MAX(Gust) FROM Wind WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00')",
+		float Direction = static_cast<float>(columns[0].Sum / static_cast<double>(itt.second.Count));
+		int speed_min = static_cast<int>(columns[1].Min);
+		int speed_max = static_cast<int>(columns[1].Max);
+		int gust_min = static_cast<int>(columns[2].Min);
+		int gust_max = static_cast<int>(columns[2].Max);
+
+		safe_query(
+			"INSERT INTO Wind_Calendar (DeviceRowID, Direction, Speed_Min, Speed_Max, Gust_Min, Gust_Max, Date) "
+			"VALUES ('%" PRIu64 "', '%.2f', '%d', '%d', '%d', '%d', '%q')",
 			ID,
-			szDateStart,
-			szDateEnd
+			Direction,
+			speed_min,
+			speed_max,
+			gust_min,
+			gust_max,
+			szDateStart
 		);
-		if (!result.empty())
-		{
-			std::vector<std::string> sd = result[0];
-
-			float Direction = static_cast<float>(atof(sd[0].c_str()));
-			int speed_min = atoi(sd[1].c_str());
-			int speed_max = atoi(sd[2].c_str());
-			int gust_min = atoi(sd[3].c_str());
-			int gust_max = atoi(sd[4].c_str());
-
-			result = safe_query(
-				"INSERT INTO Wind_Calendar (DeviceRowID, Direction, Speed_Min, Speed_Max, Gust_Min, Gust_Max, Date) "
-				"VALUES ('%" PRIu64 "', '%.2f', '%d', '%d', '%d', '%d', '%q')",
-				ID,
-				Direction,
-				speed_min,
-				speed_max,
-				gust_min,
-				gust_max,
-				szDateStart
-			);
-		}
 	}
 }
 
-void CSQLHelper::AddCalendarUpdateUV()
+void CSQLHelper::AddCalendarUpdateUV(const char *szDateStart, const char *szDateEnd)
 {
-	//Get All UV devices
-	std::vector<std::vector<std::string> > resultdevices;
-	resultdevices = safe_query("SELECT DISTINCT(DeviceRowID) FROM UV ORDER BY DeviceRowID");
-	if (resultdevices.empty())
+	CDayAccumulator::_tDayDevices devices;
+	if (!GetDayTotals(CShortLogStore::SLT_UV, szDateStart, szDateEnd, devices))
 		return; //nothing to do
+	std::set<uint64_t> existing = GetCalendarDevices("UV_Calendar", szDateStart, devices);
 
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
-
-	std::vector<std::vector<std::string> > result;
-
-	for (const auto &sddev : resultdevices)
+	for (const auto &itt : devices)
 	{
-		uint64_t ID = std::stoull(sddev[0]);
+		uint64_t ID = itt.first;
+		if (existing.find(ID) != existing.end())
+			continue; //already added
 
-		result = safe_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00')",
+		float level = static_cast<float>(itt.second.Columns[0].Max);
+
+		safe_query(
+			"INSERT INTO UV_Calendar (DeviceRowID, Level, Date) "
+			"VALUES ('%" PRIu64 "', '%g', '%q')",
 			ID,
-			szDateStart,
-			szDateEnd
+			level,
+			szDateStart
 		);
-		if (!result.empty())
-		{
-			std::vector<std::string> sd = result[0];
-
-			float level = static_cast<float>(atof(sd[0].c_str()));
-
-			result = safe_query(
-				"INSERT INTO UV_Calendar (DeviceRowID, Level, Date) "
-				"VALUES ('%" PRIu64 "', '%g', '%q')",
-				ID,
-				level,
-				szDateStart
-			);
-		}
 	}
 }
 
-void CSQLHelper::AddCalendarUpdatePercentage()
+void CSQLHelper::AddCalendarUpdatePercentage(const char *szDateStart, const char *szDateEnd)
 {
-	//Get All Percentage devices in the Percentage Table
-	std::vector<std::vector<std::string> > resultdevices;
-	resultdevices = safe_query("SELECT DISTINCT(DeviceRowID) FROM Percentage ORDER BY DeviceRowID");
-	if (resultdevices.empty())
+	CDayAccumulator::_tDayDevices devices;
+	if (!GetDayTotals(CShortLogStore::SLT_PERCENTAGE, szDateStart, szDateEnd, devices))
 		return; //nothing to do
+	std::set<uint64_t> existing = GetCalendarDevices("Percentage_Calendar", szDateStart, devices);
 
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
-
-	std::vector<std::vector<std::string> > result;
-
-	for (const auto &sddev : resultdevices)
+	for (const auto &itt : devices)
 	{
-		uint64_t ID = std::stoull(sddev[0]);
+		uint64_t ID = itt.first;
+		if (existing.find(ID) != existing.end())
+			continue; //already added
+		const auto &columns = itt.second.Columns;
 
-		result = safe_query("SELECT MIN(Percentage), MAX(Percentage), AVG(Percentage) FROM Percentage WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00')",
+		float percentage_min = static_cast<float>(columns[0].Min);
+		float percentage_max = static_cast<float>(columns[0].Max);
+		float percentage_avg = static_cast<float>(columns[0].Sum / static_cast<double>(itt.second.Count));
+		safe_query(
+			"INSERT INTO Percentage_Calendar (DeviceRowID, Percentage_Min, Percentage_Max, Percentage_Avg, Date) "
+			"VALUES ('%" PRIu64 "', '%g', '%g', '%g','%q')",
 			ID,
-			szDateStart,
-			szDateEnd
+			percentage_min,
+			percentage_max,
+			percentage_avg,
+			szDateStart
 		);
-		if (!result.empty())
-		{
-			std::vector<std::string> sd = result[0];
-
-			float percentage_min = static_cast<float>(atof(sd[0].c_str()));
-			float percentage_max = static_cast<float>(atof(sd[1].c_str()));
-			float percentage_avg = static_cast<float>(atof(sd[2].c_str()));
-			result = safe_query(
-				"INSERT INTO Percentage_Calendar (DeviceRowID, Percentage_Min, Percentage_Max, Percentage_Avg, Date) "
-				"VALUES ('%" PRIu64 "', '%g', '%g', '%g','%q')",
-				ID,
-				percentage_min,
-				percentage_max,
-				percentage_avg,
-				szDateStart
-			);
-		}
 	}
 }
 
-void CSQLHelper::AddCalendarUpdateFan()
+void CSQLHelper::AddCalendarUpdateFan(const char *szDateStart, const char *szDateEnd)
 {
-	//Get All FAN devices in the Fan Table
-	std::vector<std::vector<std::string> > resultdevices;
-	resultdevices = safe_query("SELECT DISTINCT(DeviceRowID) FROM Fan ORDER BY DeviceRowID");
-	if (resultdevices.empty())
+	CDayAccumulator::_tDayDevices devices;
+	if (!GetDayTotals(CShortLogStore::SLT_FAN, szDateStart, szDateEnd, devices))
 		return; //nothing to do
+	std::set<uint64_t> existing = GetCalendarDevices("Fan_Calendar", szDateStart, devices);
 
-	char szDateStart[40];
-	char szDateEnd[40];
-
-	time_t now = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&now, &ltime);
-	sprintf(szDateEnd, "%04d-%02d-%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday);
-
-	time_t yesterday;
-	struct tm tm2;
-	getNoon(yesterday, tm2, ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday - 1); // we only want the date
-	sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
-
-	std::vector<std::vector<std::string> > result;
-
-	for (const auto &sddev : resultdevices)
+	for (const auto &itt : devices)
 	{
-		uint64_t ID = std::stoull(sddev[0]);
+		uint64_t ID = itt.first;
+		if (existing.find(ID) != existing.end())
+			continue; //already added
+		const auto &columns = itt.second.Columns;
 
-		result = safe_query("SELECT MIN(Speed), MAX(Speed), AVG(Speed) FROM Fan WHERE (DeviceRowID='%" PRIu64 "' AND Date>='%q' AND Date<='%q 00:00:00')",
+		int speed_min = static_cast<int>(columns[0].Min);
+		int speed_max = static_cast<int>(columns[0].Max);
+		int speed_avg = static_cast<int>(columns[0].Sum / static_cast<double>(itt.second.Count));
+		safe_query(
+			"INSERT INTO Fan_Calendar (DeviceRowID, Speed_Min, Speed_Max, Speed_Avg, Date) "
+			"VALUES ('%" PRIu64 "', '%d', '%d', '%d','%q')",
 			ID,
-			szDateStart,
-			szDateEnd
+			speed_min,
+			speed_max,
+			speed_avg,
+			szDateStart
 		);
-		if (!result.empty())
-		{
-			std::vector<std::string> sd = result[0];
-
-			int speed_min = (int)atoi(sd[0].c_str());
-			int speed_max = (int)atoi(sd[1].c_str());
-			int speed_avg = (int)atoi(sd[2].c_str());
-			result = safe_query(
-				"INSERT INTO Fan_Calendar (DeviceRowID, Speed_Min, Speed_Max, Speed_Avg, Date) "
-				"VALUES ('%" PRIu64 "', '%d', '%d', '%d','%q')",
-				ID,
-				speed_min,
-				speed_max,
-				speed_avg,
-				szDateStart
-			);
-		}
 	}
 }
 
@@ -7899,6 +8517,8 @@ void CSQLHelper::CleanupShortLog()
 
 		sprintf(szQuery, "DELETE FROM Fan WHERE %s", szQueryFilter.c_str());
 		query(szQuery);
+
+		m_shortlogstore.Cleanup(mytime(nullptr) - (n5MinuteHistoryDays * 86400));
 	}
 }
 
@@ -7912,12 +8532,19 @@ void CSQLHelper::ClearShortLog()
 	query("DELETE FROM MultiMeter");
 	query("DELETE FROM Percentage");
 	query("DELETE FROM Fan");
+	m_shortlogstore.Clear();
 	VacuumDatabase();
 }
 
 void CSQLHelper::VacuumDatabase()
 {
-	query("VACUUM");
+	if (!m_dbase)
+		return;
+	//VACUUM can not run inside a (group commit) transaction
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	CommitGroupTransaction();
+	if (sqlite3_exec(m_dbase, "VACUUM", nullptr, nullptr, nullptr) != SQLITE_OK)
+		_log.Log(LOG_ERROR, "SQL Query(\"VACUUM\") : %s", sqlite3_errmsg(m_dbase));
 }
 
 void CSQLHelper::OptimizeDatabase(sqlite3* dbase)
@@ -8001,6 +8628,7 @@ void CSQLHelper::DeleteDevices(const std::string& idx)
 		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 
 		char* errorMessage;
+		CommitGroupTransaction();
 		sqlite3_exec(m_dbase, "BEGIN TRANSACTION", nullptr, nullptr, &errorMessage);
 
 		for (const auto &str : _idx)
@@ -8027,6 +8655,7 @@ void CSQLHelper::DeleteDevices(const std::string& idx)
 			safe_exec_no_return("DELETE FROM Percentage_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
 			safe_exec_no_return("DELETE FROM Fan WHERE (DeviceRowID == '%q')", str.c_str());
 			safe_exec_no_return("DELETE FROM Fan_Calendar WHERE (DeviceRowID == '%q')", str.c_str());
+			m_shortlogstore.DeleteDevice(std::strtoull(str.c_str(), nullptr, 10));
 			safe_exec_no_return("DELETE FROM SceneDevices WHERE (DeviceRowID == '%q')", str.c_str());
 			safe_exec_no_return("DELETE FROM DeviceToPlansMap WHERE (DeviceRowID == '%q')", str.c_str());
 			safe_exec_no_return("DELETE FROM CamerasActiveDevices WHERE (DevSceneType==0) AND (DevSceneRowID == '%q')",
@@ -8073,6 +8702,7 @@ void CSQLHelper::DeleteScenes(const std::string& idx)
 		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 
 		char* errorMessage;
+		CommitGroupTransaction();
 		sqlite3_exec(m_dbase, "BEGIN TRANSACTION", nullptr, nullptr, &errorMessage);
 
 		for (const auto &str : _idx)
@@ -8265,6 +8895,22 @@ void CSQLHelper::DeleteDateRange(const char *ID, const std::string &fromDate, co
 		safe_query("DELETE FROM %q WHERE (DeviceRowID=='%q') AND (Date>='%q') AND (Date<='%q')", historyTable.c_str(), ID, fromDate.c_str(), toDate.c_str() );
 		_log.Debug(DEBUG_NORM, "CSQLHelper::DeleteDateRange; delete from %s with idx: %s and Date >= %s and date <= %s " , historyTable.c_str(), std::string(ID).c_str(), fromDate.c_str(), toDate.c_str() );
 	}
+
+	//a date without time is compared as midnight, same as the queries above
+	time_t tFrom, tTo;
+	struct tm tmTmp;
+	std::string szFrom = (fromDate.size() == 10) ? fromDate + " 00:00:00" : fromDate;
+	std::string szTo = (toDate.size() == 10) ? toDate + " 00:00:00" : toDate;
+	if ((ParseSQLdatetime(tFrom, tmTmp, szFrom)) && (ParseSQLdatetime(tTo, tmTmp, szTo)))
+		m_shortlogstore.DeleteRange(std::strtoull(ID, nullptr, 10), tFrom, tTo);
+}
+
+void CSQLHelper::TransferShortLogs(const uint64_t fromRowID, const uint64_t toRowID, const std::string &szAfterDate)
+{
+	time_t tAfter;
+	struct tm tmTmp;
+	if (ParseSQLdatetime(tAfter, tmTmp, szAfterDate))
+		m_shortlogstore.MoveDevice(fromRowID, toRowID, tAfter);
 }
 
 void CSQLHelper::DeleteDataPoint(const char* ID, const std::string& Date)
@@ -8386,10 +9032,23 @@ bool CSQLHelper::RestoreDatabase(const std::string& dbase)
 	std::remove(outputfile.c_str());
 
 	StopThread();
+	m_readpool.Close();
 
 	//stop database
-	sqlite3_close(m_dbase);
-	m_dbase = nullptr;
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+		m_bGroupCommitEnabled = false;
+		ClearStatementCache();
+		ClearDeviceCache();
+		m_graphrollups.Clear();
+		m_dayaccumulator.Clear();
+		sqlite3_close(m_dbase);
+		m_dbase = nullptr;
+	}
+	//the store is filled again from the restored database
+	m_shortlogstore.Close();
+	CShortLogStore::Remove(m_dbase_name + "-shortlog/");
 	std::ofstream outfile2;
 	outfile2.open(m_dbase_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
 	if (!outfile2.is_open())
@@ -8424,38 +9083,134 @@ bool CSQLHelper::RestoreDatabase(const std::string& dbase)
 	return true;
 }
 
-bool CSQLHelper::BackupDatabase(const std::string& OutputFile)
+namespace
+{
+	bool GZipFile(const std::string &szInput, const std::string &szOutput)
+	{
+		FILE *fIn = fopen(szInput.c_str(), "rb");
+		if (!fIn)
+			return false;
+		gzFile gz = gzopen(szOutput.c_str(), "wb6");
+		if (!gz)
+		{
+			fclose(fIn);
+			return false;
+		}
+		bool bOK = true;
+		std::vector<char> buffer(64 * 1024);
+		size_t nRead;
+		while ((nRead = fread(buffer.data(), 1, buffer.size(), fIn)) > 0)
+		{
+			if (gzwrite(gz, buffer.data(), (unsigned int)nRead) != (int)nRead)
+			{
+				bOK = false;
+				break;
+			}
+		}
+		if (ferror(fIn))
+			bOK = false;
+		fclose(fIn);
+		if (gzclose(gz) != Z_OK)
+			bOK = false;
+		return bOK;
+	}
+} // namespace
+
+void CSQLHelper::EnableBackupCompression(const bool bEnable)
+{
+	m_bBackupCompression = bEnable;
+}
+
+bool CSQLHelper::BackupDatabase(const std::string& OutputFile, const bool bCompress, _tBackupResult *pResult)
 {
 	if (!m_dbase)
 		return false; //database not open!
 
-	//First cleanup the database
-	OptimizeDatabase(m_dbase);
-	VacuumDatabase();
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		CommitGroupTransaction();
+		OptimizeDatabase(m_dbase);
+	}
 
-	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	//In WAL mode the pages are read from a snapshot on a separate read-only connection, so writers are never blocked.
+	//Otherwise our own connection is the source, and the query mutex is only held for each step
+	sqlite3* pSource = nullptr;
+	if (m_journal_mode == "WAL")
+	{
+		if (sqlite3_open_v2(m_dbase_name.c_str(), &pSource, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK)
+		{
+			sqlite3_busy_timeout(pSource, 1000);
+			//start the read transaction (and take the snapshot) now
+			if ((sqlite3_exec(pSource, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK)
+				|| (sqlite3_exec(pSource, "SELECT COUNT(*) FROM sqlite_master", nullptr, nullptr, nullptr) != SQLITE_OK))
+			{
+				sqlite3_close(pSource);
+				pSource = nullptr;
+			}
+		}
+		else
+		{
+			sqlite3_close(pSource);
+			pSource = nullptr;
+		}
+		if (!pSource)
+			_log.Log(LOG_ERROR, "SQLHelper: Could not open a read connection for the backup, copying from the main connection");
+	}
+
+	//A compressed backup is made next to the output file first
+	const std::string szBackupFile = (bCompress) ? OutputFile + ".tmp" : OutputFile;
 
 	int rc;					 // Function return code
 	sqlite3* pFile;			 // Database connection opened on zFilename
 	sqlite3_backup* pBackup;	// Backup handle used to copy data
 
 	// Open the database file identified by zFilename.
-	rc = sqlite3_open(OutputFile.c_str(), &pFile);
+	rc = sqlite3_open(szBackupFile.c_str(), &pFile);
 	if (rc != SQLITE_OK)
+	{
+		sqlite3_close(pFile);
+		if (pSource)
+			sqlite3_close(pSource);
 		return false;
+	}
 
 	// Open the sqlite3_backup object used to accomplish the transfer
-	pBackup = sqlite3_backup_init(pFile, "main", m_dbase, "main");
+	if (pSource)
+		pBackup = sqlite3_backup_init(pFile, "main", pSource, "main");
+	else
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		pBackup = sqlite3_backup_init(pFile, "main", m_dbase, "main");
+	}
 
 	time_t startTime = time(nullptr);
+	auto tStart = std::chrono::steady_clock::now();
+	int iPageCount = 0;
 
 	if (pBackup)
 	{
-		// Each iteration of this loop copies 5 database pages from database
-		// pDb to the backup database.
+		int iLastPercent = 0;
+		// Each iteration of this loop copies 256 database pages to the backup database.
 		do {
-			rc = sqlite3_backup_step(pBackup, 256);
-			//xProgress(  sqlite3_backup_remaining(pBackup), sqlite3_backup_pagecount(pBackup) );
+			if (pSource)
+				rc = sqlite3_backup_step(pBackup, 256);
+			else
+			{
+				std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+				//writes of an open group transaction would restart the backup
+				CommitGroupTransaction();
+				rc = sqlite3_backup_step(pBackup, 256);
+			}
+			iPageCount = sqlite3_backup_pagecount(pBackup);
+			if (iPageCount > 0)
+			{
+				int iPercent = (100 * (iPageCount - sqlite3_backup_remaining(pBackup))) / iPageCount;
+				if (iPercent / 10 > iLastPercent / 10)
+				{
+					_log.Debug(DEBUG_SQL, "SQLHelper: Backup %d%% (%d pages)", iPercent, iPageCount);
+					iLastPercent = iPercent;
+				}
+			}
 			if( rc==SQLITE_BUSY || rc==SQLITE_LOCKED ){
 			  sqlite3_sleep(250);
 			}
@@ -8474,11 +9229,58 @@ bool CSQLHelper::BackupDatabase(const std::string& OutputFile)
 		sqlite3_backup_finish(pBackup);
 	}
 	rc = sqlite3_errcode(pFile);
+
+	if (pSource)
+	{
+		sqlite3_exec(pSource, "COMMIT", nullptr, nullptr, nullptr);
+		sqlite3_close(pSource);
+	}
+
+	int iPageSize = 0;
+	sqlite3_stmt *stmt = nullptr;
+	if (sqlite3_prepare_v2(pFile, "PRAGMA page_size", -1, &stmt, nullptr) == SQLITE_OK)
+	{
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+			iPageSize = sqlite3_column_int(stmt, 0);
+		sqlite3_finalize(stmt);
+	}
+
+	//Cleanup the copy instead of the live database
+	if (rc == SQLITE_OK)
+		sqlite3_exec(pFile, "VACUUM", nullptr, nullptr, nullptr);
+
 	// Close the database connection opened on database file zFilename
 	// and return the result of this function.
 	sqlite3_close(pFile);
 
-	return (rc == SQLITE_OK);
+	if ((rc == SQLITE_OK) && (bCompress))
+	{
+		if (!GZipFile(szBackupFile, OutputFile))
+		{
+			_log.Log(LOG_ERROR, "SQLHelper: Problem compressing backup file: %s", OutputFile.c_str());
+			rc = SQLITE_IOERR;
+		}
+	}
+	if (bCompress)
+		std::remove(szBackupFile.c_str());
+	if (rc != SQLITE_OK)
+		return false;
+
+	const double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+	std::ifstream is(OutputFile.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	const std::streamoff iFileSize = (is.is_open()) ? (std::streamoff)is.tellg() : 0;
+	const double dMB = (double)iPageCount * iPageSize / (1024.0 * 1024.0);
+	const double dRate = (dSeconds > 0) ? dMB / dSeconds : 0;
+	_log.Log(LOG_STATUS, "SQLHelper: Backup done, %d pages (%.1f MB) in %.1f seconds (%.1f MB/s), file size %.1f MB", iPageCount, dMB, dSeconds, dRate,
+		 (double)iFileSize / (1024.0 * 1024.0));
+	if (pResult)
+	{
+		pResult->Pages = iPageCount;
+		pResult->FileSize = (uint64_t)iFileSize;
+		pResult->Seconds = dSeconds;
+		pResult->MBPerSecond = dRate;
+	}
+	return true;
 }
 
 uint64_t CSQLHelper::UpdateValueLighting2GroupCmd(const int HardwareID, const char* ID, const unsigned char unit,
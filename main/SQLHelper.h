@@ -1,7 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <boost/utility/string_view.hpp>
 #include "RFXNames.h"
+#include "ShortLogStore.h"
+#include "GraphRollups.h"
+#include "DayAccumulator.h"
+#include "SQLReadPool.h"
 #include "../hardware/hardwaretypes.h"
 #include "Helper.h"
 #include "../httpclient/UrlEncode.h"
@@ -315,6 +324,59 @@ struct _tTaskItem
 	}
 };
 
+class CSQLHelper;
+
+// Typed cursor over a cached prepared statement
+// Parameters are bound in order with Bind(), rows are fetched with Step()
+// The query mutex is held for the lifetime of the cursor, so no other query may be issued from the same thread until it goes out of scope
+class CSQLStatement
+{
+      public:
+	CSQLStatement(CSQLHelper &sql, const char *szQuery);
+	~CSQLStatement();
+	CSQLStatement(const CSQLStatement &) = delete;
+	CSQLStatement &operator=(const CSQLStatement &) = delete;
+
+	bool IsValid() const
+	{
+		return (m_stmt != nullptr);
+	}
+
+	CSQLStatement &Bind(int Value);
+	CSQLStatement &Bind(int64_t Value);
+	CSQLStatement &Bind(uint64_t Value);
+	CSQLStatement &Bind(double Value);
+	CSQLStatement &Bind(const char *Value);
+	CSQLStatement &Bind(const std::string &Value);
+	CSQLStatement &BindNull();
+
+	// Returns true when a row is available
+	bool Step();
+	// Runs the statement to completion (INSERT/UPDATE/DELETE), returns false on error
+	bool Execute();
+
+	int ColumnCount() const;
+	bool IsNull(int col) const;
+	int GetInt(int col) const;
+	int64_t GetInt64(int col) const;
+	uint64_t GetUInt64(int col) const;
+	double GetDouble(int col) const;
+	// Only valid until the next Step() or until the cursor is destroyed
+	boost::string_view GetText(int col) const;
+	std::string GetString(int col) const;
+
+      private:
+	void LogError(const char *szAction);
+
+	std::unique_lock<std::mutex> m_lock;
+	CSQLHelper *m_pSQL;
+	sqlite3 *m_dbase = nullptr;
+	sqlite3_stmt *m_stmt = nullptr;
+	const char *m_szQuery;
+	int m_bindIndex = 0;
+	bool m_bDone = false;
+};
+
 class CSQLHelper : public StoppableTask
 {
       public:
@@ -323,11 +385,36 @@ class CSQLHelper : public StoppableTask
 
 	void SetDatabaseName(const std::string &DBName);
 	void SetJournalMode(const std::string &mode);
+	// Collect all writes in one transaction that is committed every iMilliseconds (0 = disabled)
+	void SetGroupCommitInterval(int iMilliseconds);
+	// Commit pending group-commit writes now (for logic that needs the data on disk)
+	void FlushWrites();
+	// Also keep the Temperature/Rain/Wind/UV/Percentage/Fan short logs in a compressed columnar store (used for the day graphs)
+	void EnableShortLogStore(bool bEnable);
+	// Number of read-only connections used by safe_query_read, only in WAL mode (0 = disabled)
+	void SetReadPoolSize(int iConnections);
+	// Wait and busy times of the primary connection, followed by the read connections
+	std::vector<CSQLReadPool::_tConnectionStats> GetConnectionStats();
 
 	bool OpenDatabase();
 	void CloseDatabase();
 
-	bool BackupDatabase(const std::string &OutputFile);
+	struct _tBackupResult
+	{
+		int Pages = 0;
+		uint64_t FileSize = 0;
+		double Seconds = 0;
+		double MBPerSecond = 0;
+	};
+	// Copies the database without holding the query mutex for the whole copy (in WAL mode the copy is read from a snapshot),
+	// with bCompress the output file is gzip compressed
+	bool BackupDatabase(const std::string &OutputFile, bool bCompress = false, _tBackupResult *pResult = nullptr);
+	// Write the automatic backups gzip compressed
+	void EnableBackupCompression(bool bEnable);
+	bool IsBackupCompressionEnabled() const
+	{
+		return m_bBackupCompression;
+	}
 	bool RestoreDatabase(const std::string &dbase);
 
 	// Returns DeviceRowID
@@ -344,6 +431,7 @@ class CSQLHelper : public StoppableTask
 
 	bool UpdateLastUpdate(const int64_t idx);
 	bool UpdateLastUpdate(const std::string& sidx);
+	bool UpdateBatteryLevel(uint64_t idx, int BatteryLevel);
 
 	uint64_t GetDeviceIndex(int HardwareID, int OrgHardwareID, const std::string &ID, unsigned char unit, unsigned char devType, unsigned char subType, std::string &devname);
 
@@ -388,8 +476,12 @@ class CSQLHelper : public StoppableTask
 
 	void ScheduleShortlog();
 	void ScheduleDay();
+	// Short log rows were changed by another query than the short log schedule
+	void InvalidateDayTotals(CShortLogStore::_eShortLogTable table);
 
 	void ClearShortLog();
+	// Short log rows of a device ordered by date, from the short log store when enabled
+	std::vector<std::vector<std::string>> GetShortLog(const std::string &szTable, const std::string &szColumns, uint64_t DeviceRowID);
 	void VacuumDatabase();
 	void OptimizeDatabase(sqlite3 *dbase);
 	void DeleteHardware(const std::string &idx);
@@ -401,6 +493,8 @@ class CSQLHelper : public StoppableTask
 	void DeleteEvent(const std::string &idx);
 
 	void DeleteDevices(const std::string &idx);
+	// Moves the short log samples of the store after szAfterDate to another device, as the device transfer does for the tables
+	void TransferShortLogs(uint64_t fromRowID, uint64_t toRowID, const std::string &szAfterDate);
 	void DeleteScenes(const std::string &idx);
 
 	bool DoesSceneByNameExits(const std::string &SceneName);
@@ -419,6 +513,9 @@ class CSQLHelper : public StoppableTask
 	std::vector<std::vector<std::string>> safe_query(const char *fmt, ...);
 	std::vector<std::vector<std::string>> safe_queryBlob(const char *fmt, ...);
 	std::vector<std::vector<std::string>> unsafe_query(const std::string& szQuery);
+	// For SELECT-only callers, runs on the read connection pool when it is open.
+	// While group commit writes are pending the primary connection is used, so the caller always sees its own writes
+	std::vector<std::vector<std::string>> safe_query_read(const char *fmt, ...);
 
 	void safe_exec_no_return(const char *fmt, ...);
 	bool safe_UpdateBlobInTableWithID(const std::string &Table, const std::string &Column, const std::string &sID, const std::string &BlobData);
@@ -454,10 +551,25 @@ class CSQLHelper : public StoppableTask
 
 	float GetCounterDivider(int metertype, int dType, float DefaultValue);
 
+	void InvalidateDeviceCache(uint64_t idx);
+	void ClearDeviceCache();
+
+	// Changes whenever a table that is used to present devices (hardware, users, plans, timers, ...) is modified
+	uint64_t GetConfigurationGeneration() const
+	{
+		return m_configuration_generation;
+	}
+	void OnConfigurationChanged()
+	{
+		m_configuration_generation++;
+	}
+
       public:
-	std::string m_LastSwitchID; // for learning command
+	// last received switch, for the learning command (written by the RX workers)
+	void ClearLastSwitch();
+	bool GetLastSwitch(std::string &ID, uint64_t &RowID);
 	std::string m_UniqueID;
-	uint64_t m_LastSwitchRowID;
+	CGraphRollups m_graphrollups;
 	_eWindUnit m_windunit;
 	std::string m_windsign;
 	float m_windscale;
@@ -479,9 +591,96 @@ class CSQLHelper : public StoppableTask
 	double m_max_kwh_usage;
 
       private:
+	friend class CSQLStatement;
+
 	std::mutex m_executeThreadMutex;
 	std::mutex m_sqlQueryMutex;
 	sqlite3 *m_dbase;
+	std::map<std::string, sqlite3_stmt *> m_statement_cache; // protected by m_sqlQueryMutex
+	sqlite3_stmt *GetCachedStatement(const char *szQuery);
+	void ClearStatementCache();
+
+	// Group commit, all protected by m_sqlQueryMutex
+	int m_group_commit_interval = 0;
+	bool m_bGroupCommitEnabled = false;
+	std::chrono::steady_clock::time_point m_group_commit_start;
+	void BeginGroupCommit();
+	void CommitGroupTransaction();
+	void CheckGroupCommit();
+	std::atomic<bool> m_bGroupTransactionOpen{ false };
+
+	int m_read_pool_size = 0;
+	CSQLReadPool m_readpool;
+	std::mutex m_primary_stats_mutex;
+	CSQLReadPool::_tConnectionStats m_primary_stats;
+
+	bool m_bShortLogStoreEnabled = false;
+	bool m_bBackupCompression = false;
+	CShortLogStore m_shortlogstore;
+	void OpenShortLogStore();
+	void AddShortLogSample(CShortLogStore::_eShortLogTable table, uint64_t DeviceRowID, time_t sampleTime, const std::vector<double> &values);
+
+	// totals of the short log samples per day, so the daily schedule does not have to read the short log tables
+	CDayAccumulator m_dayaccumulator;
+	void StartDayAccumulator();
+	bool GetDayTotals(CShortLogStore::_eShortLogTable table, const char *szDateStart, const char *szDateEnd, CDayAccumulator::_tDayDevices &devices);
+	// devices that already have a calendar row for szDate
+	std::set<uint64_t> GetCalendarDevices(const char *szTable, const char *szDate, const std::vector<uint64_t> &DeviceRowIDs);
+	std::set<uint64_t> GetCalendarDevices(const char *szTable, const char *szDate, const CDayAccumulator::_tDayDevices &devices);
+
+	// adds the calendar rows of days that were missed while we were not running
+	std::mutex m_calendar_mutex;
+	std::shared_ptr<std::thread> m_calendar_thread;
+	void CatchUpCalendar();
+	void AddCalendarDay(const char *szTable, const char *szDateStart, const char *szDateEnd, bool bYesterday);
+
+	// Write-through cache of the DeviceStatus columns UpdateValueInt needs, so a sensor update does not need a read query
+	// Entries are dropped by the sqlite update hook whenever a DeviceStatus row is changed or deleted outside of UpdateValueInt
+	struct _tDeviceCacheKey
+	{
+		int HardwareID;
+		int OrgHardwareID;
+		std::string DeviceID;
+		unsigned char unit;
+		unsigned char devType;
+		unsigned char subType;
+		bool operator==(const _tDeviceCacheKey &other) const
+		{
+			return (HardwareID == other.HardwareID) && (OrgHardwareID == other.OrgHardwareID) && (unit == other.unit) && (devType == other.devType) && (subType == other.subType) &&
+			       (DeviceID == other.DeviceID);
+		}
+	};
+	struct _tDeviceCacheKeyHash
+	{
+		size_t operator()(const _tDeviceCacheKey &key) const;
+	};
+	struct _tDeviceCacheItem
+	{
+		uint64_t ID = 0;
+		std::string Name;
+		bool bUsed = false;
+		_eSwitchType SwitchType = STYPE_OnOff;
+		int nValue = 0;
+		std::string sValue;
+		std::string LastUpdate;
+		std::shared_ptr<const std::map<std::string, std::string>> Options;
+	};
+	std::atomic<uint64_t> m_configuration_generation{ 0 };
+	std::mutex m_device_cache_mutex;
+	std::unordered_map<_tDeviceCacheKey, _tDeviceCacheItem, _tDeviceCacheKeyHash> m_device_cache;
+	std::unordered_map<uint64_t, _tDeviceCacheKey> m_device_cache_ids;
+	// Bumped by every invalidation, a device read at an older generation is not cached when it was invalidated since
+	uint64_t m_device_cache_generation = 0;
+	uint64_t m_device_cache_cleared = 0;
+	std::unordered_map<uint64_t, uint64_t> m_device_cache_invalidated; // device ID -> generation of its last invalidation
+	// Returns false on a miss, generation is then the generation to pass to SetCachedDevice
+	bool GetCachedDevice(const _tDeviceCacheKey &key, _tDeviceCacheItem &item, uint64_t &generation);
+	void SetCachedDevice(const _tDeviceCacheKey &key, const _tDeviceCacheItem &item, uint64_t generation);
+	// Updates the value of a cached entry in place, nothing when it was dropped meanwhile
+	void UpdateCachedDeviceValue(const _tDeviceCacheKey &key, uint64_t idx, int nValue, const std::string &sValue, const std::string &sLastUpdate);
+	std::mutex m_lastswitch_mutex;
+	std::string m_LastSwitchID;
+	uint64_t m_LastSwitchRowID;
 	std::string m_dbase_name;
 	std::string m_journal_mode;
 	unsigned char m_sensortimeoutcounter;
@@ -531,14 +730,14 @@ class CSQLHelper : public StoppableTask
 	void UpdateMultiMeter();
 	void UpdatePercentageLog();
 	void UpdateFanLog();
-	void AddCalendarTemperature();
-	void AddCalendarUpdateRain();
-	void AddCalendarUpdateWind();
-	void AddCalendarUpdateUV();
-	void AddCalendarUpdateMeter();
-	void AddCalendarUpdateMultiMeter();
-	void AddCalendarUpdatePercentage();
-	void AddCalendarUpdateFan();
+	void AddCalendarTemperature(const char *szDateStart, const char *szDateEnd);
+	void AddCalendarUpdateRain(const char *szDateStart, const char *szDateEnd);
+	void AddCalendarUpdateWind(const char *szDateStart, const char *szDateEnd);
+	void AddCalendarUpdateUV(const char *szDateStart, const char *szDateEnd);
+	void AddCalendarUpdateMeter(const char *szDateStart, const char *szDateEnd, bool bYesterday);
+	void AddCalendarUpdateMultiMeter(const char *szDateStart, const char *szDateEnd, bool bYesterday);
+	void AddCalendarUpdatePercentage(const char *szDateStart, const char *szDateEnd);
+	void AddCalendarUpdateFan(const char *szDateStart, const char *szDateEnd);
 	void CleanupShortLog();
 	bool CheckDate(const std::string &sDate, int &d, int &m, int &y);
 	bool CheckDateSQL(const std::string &sDate);
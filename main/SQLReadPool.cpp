@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "SQLReadPool.h"
+#include "Logger.h"
+#include <sqlite3.h>
+#include <chrono>
+
+CSQLReadPool::~CSQLReadPool()
+{
+	Close();
+}
+
+bool CSQLReadPool::Open(const std::string &szDatabase, const int iConnections)
+{
+	Close();
+	std::vector<_tConnection> connections;
+	for (int ii = 0; ii < iConnections; ii++)
+	{
+		_tConnection connection;
+		if (sqlite3_open_v2(szDatabase.c_str(), &connection.pDB, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+		{
+			_log.Log(LOG_ERROR, "SQL: Could not open read connection: %s", sqlite3_errmsg(connection.pDB));
+			sqlite3_close(connection.pDB);
+			for (auto &itt : connections)
+				sqlite3_close(itt.pDB);
+			return false;
+		}
+		sqlite3_busy_timeout(connection.pDB, 1000);
+		connections.push_back(connection);
+	}
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_connections = std::move(connections);
+	m_bClosing = false;
+	return true;
+}
+
+void CSQLReadPool::Close()
+{
+	std::unique_lock<std::mutex> l(m_mutex);
+	m_bClosing = true;
+	// wait for the running queries
+	m_cond.wait(l, [this] {
+		for (const auto &connection : m_connections)
+		{
+			if (connection.bInUse)
+				return false;
+		}
+		return true;
+	});
+	for (auto &connection : m_connections)
+		sqlite3_close(connection.pDB);
+	m_connections.clear();
+	m_cond.notify_all();
+}
+
+bool CSQLReadPool::IsOpen()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return ((!m_bClosing) && (!m_connections.empty()));
+}
+
+bool CSQLReadPool::Query(const std::string &szQuery, std::vector<std::vector<std::string>> &results)
+{
+	const auto tStart = std::chrono::steady_clock::now();
+	size_t iConnection = 0;
+	sqlite3 *pDB = nullptr;
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		while (!pDB)
+		{
+			if ((m_bClosing) || (m_connections.empty()))
+				return false;
+			for (iConnection = 0; iConnection < m_connections.size(); iConnection++)
+			{
+				if (!m_connections[iConnection].bInUse)
+				{
+					m_connections[iConnection].bInUse = true;
+					pDB = m_connections[iConnection].pDB;
+					break;
+				}
+			}
+			if (!pDB)
+				m_cond.wait(l);
+		}
+	}
+	const auto tAcquired = std::chrono::steady_clock::now();
+
+	results.clear();
+	sqlite3_stmt *statement;
+	if (sqlite3_prepare_v2(pDB, szQuery.c_str(), -1, &statement, nullptr) == SQLITE_OK)
+	{
+		int cols = sqlite3_column_count(statement);
+		while (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			std::vector<std::string> values;
+			for (int col = 0; col < cols; col++)
+			{
+				char *value = (char *)sqlite3_column_text(statement, col);
+				if ((value == nullptr) && (col == 0))
+					break;
+				if (value == nullptr)
+					values.push_back(std::string("")); // insert empty string
+				else
+					values.push_back(value);
+			}
+			if (!values.empty())
+				results.push_back(values);
+		}
+		sqlite3_finalize(statement);
+	}
+
+	std::string error = sqlite3_errmsg(pDB);
+	if (error != "not an error")
+		_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", szQuery.c_str(), error.c_str());
+
+	const auto tDone = std::chrono::steady_clock::now();
+	const uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(tAcquired - tStart).count();
+	const uint64_t busyUs = std::chrono::duration_cast<std::chrono::microseconds>(tDone - tAcquired).count();
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	_tConnection &connection = m_connections[iConnection];
+	connection.bInUse = false;
+	connection.Stats.Queries++;
+	connection.Stats.WaitTotalUs += waitUs;
+	if (waitUs > connection.Stats.WaitMaxUs)
+		connection.Stats.WaitMaxUs = waitUs;
+	connection.Stats.BusyTotalUs += busyUs;
+	m_cond.notify_all();
+	return true;
+}
+
+std::vector<CSQLReadPool::_tConnectionStats> CSQLReadPool::GetStats()
+{
+	std::vector<_tConnectionStats> stats;
+	std::lock_guard<std::mutex> l(m_mutex);
+	for (const auto &connection : m_connections)
+		stats.push_back(connection.Stats);
+	return stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+// Pool of read-only connections on a WAL mode database
+//
+// SELECT-only callers (web handlers, graphs) run their query on a free connection of the pool, so a slow query does not
+// hold the primary connection that all writers use. Every query reads the last committed state of the database.
+class CSQLReadPool
+{
+public:
+	struct _tConnectionStats
+	{
+		uint64_t Queries = 0;
+		uint64_t WaitTotalUs = 0; // time spent waiting for the connection
+		uint64_t WaitMaxUs = 0;
+		uint64_t BusyTotalUs = 0; // time spent running queries
+	};
+
+	~CSQLReadPool();
+
+	bool Open(const std::string &szDatabase, int iConnections);
+	void Close();
+	bool IsOpen();
+
+	// Returns false when the pool is not open (the caller should use the primary connection)
+	bool Query(const std::string &szQuery, std::vector<std::vector<std::string>> &results);
+
+	std::vector<_tConnectionStats> GetStats();
+
+private:
+	struct _tConnection
+	{
+		sqlite3 *pDB = nullptr;
+		bool bInUse = false;
+		_tConnectionStats Stats;
+	};
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::vector<_tConnection> m_connections;
+	bool m_bClosing = false;
+};
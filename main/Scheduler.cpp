@@ -822,6 +822,9 @@ void CScheduler::CheckSchedules()
 			}
 			if (bOkToFire)
 			{
+				//Timers should work on committed device states
+				m_sql.FlushWrites();
+
 				char ltimeBuf[30];
 				strftime(ltimeBuf, sizeof(ltimeBuf), "%Y-%m-%d %H:%M:%S", &ltime);
 
@@ -0,0 +1,196 @@
+#include "stdafx.h"
+#include "SessionCache.h"
+#include "Helper.h"
+#include "Logger.h"
+#include "SQLHelper.h"
+#include "localtime_r.h"
+#include "../webserver/Base64.h"
+
+#define SESSION_TABLE_CLEAN_INTERVAL 3600
+
+using http::server::WebEmStoredSession;
+
+static std::string FormatSessionTime(const time_t tTime)
+{
+	char szTime[30];
+	struct tm ltime;
+	localtime_r(&tTime, &ltime);
+	strftime(szTime, sizeof(szTime), "%Y-%m-%d %H:%M:%S", &ltime);
+	return szTime;
+}
+
+CSessionCache::CSessionCache(const size_t maxSessions)
+	: m_maxSessions(maxSessions)
+{
+}
+
+WebEmStoredSession CSessionCache::GetSession(const std::string &sessionId)
+{
+	// The table is read with the mutex locked, so a session removed meanwhile cannot be cached again
+	std::lock_guard<std::mutex> l(m_mutex);
+	auto itt = m_index.find(sessionId);
+	if (itt != m_index.end())
+	{
+		m_sessions.splice(m_sessions.begin(), m_sessions, itt->second);
+		return itt->second->Session;
+	}
+	_tCachedSession cached;
+	if (!LoadSession(sessionId, cached))
+		return WebEmStoredSession();
+	return Put(cached).Session;
+}
+
+void CSessionCache::StoreSession(const WebEmStoredSession &session)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	time_t now = mytime(nullptr);
+
+	auto itt = m_index.find(session.id);
+	if (itt == m_index.end())
+	{
+		_tCachedSession cached;
+		if (!LoadSession(session.id, cached))
+		{
+			// new sessions are written through, they have to survive a restart
+			m_sql.safe_query("INSERT INTO UserSessions (SessionID, Username, AuthToken, ExpirationDate, RemoteHost) VALUES ('%q', '%q', '%q', '%q', '%q')", session.id.c_str(),
+				base64_encode(session.username).c_str(), session.auth_token.c_str(), FormatSessionTime(session.expires).c_str(), session.remote_host.c_str());
+			cached.Session = session;
+			cached.LastUpdate = now;
+			Put(cached);
+			return;
+		}
+		Put(cached);
+		itt = m_index.find(session.id);
+	}
+	else
+		m_sessions.splice(m_sessions.begin(), m_sessions, itt->second);
+
+	_tCachedSession &cached = *itt->second;
+	if (cached.Session.auth_token != session.auth_token)
+	{
+		// a new token is written through, only the expiration, remote host and last update are deferred
+		m_sql.safe_query("UPDATE UserSessions set AuthToken = '%q' WHERE SessionID = '%q'", session.auth_token.c_str(), session.id.c_str());
+		cached.Session.auth_token = session.auth_token;
+	}
+	cached.Session.expires = session.expires;
+	cached.Session.remote_host = session.remote_host;
+	cached.LastUpdate = now;
+	cached.bDirty = true;
+}
+
+void CSessionCache::RemoveSession(const std::string &sessionId)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	auto itt = m_index.find(sessionId);
+	if (itt != m_index.end())
+	{
+		m_sessions.erase(itt->second);
+		m_index.erase(itt);
+	}
+	m_sql.safe_query("DELETE FROM UserSessions WHERE SessionID = '%q'", sessionId.c_str());
+}
+
+void CSessionCache::RemoveUsersSessions(const std::string &szUsername, const std::string &exceptSessionId)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	auto itt = m_sessions.begin();
+	while (itt != m_sessions.end())
+	{
+		if ((itt->Session.id != exceptSessionId) && (base64_encode(itt->Session.username) == szUsername))
+		{
+			m_index.erase(itt->Session.id);
+			itt = m_sessions.erase(itt);
+		}
+		else
+			++itt;
+	}
+	m_sql.safe_query("DELETE FROM UserSessions WHERE (Username=='%q') and (SessionID!='%q')", szUsername.c_str(), exceptSessionId.c_str());
+}
+
+void CSessionCache::CleanSessions()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	time_t now = mytime(nullptr);
+
+	std::vector<_tCachedSession> dirty;
+	auto itt = m_sessions.begin();
+	while (itt != m_sessions.end())
+	{
+		if (itt->Session.expires < now)
+		{
+			// the row is deleted with the other expired rows
+			m_index.erase(itt->Session.id);
+			itt = m_sessions.erase(itt);
+			continue;
+		}
+		if (itt->bDirty)
+		{
+			dirty.push_back(*itt);
+			itt->bDirty = false;
+		}
+		++itt;
+	}
+	WriteSessions(dirty);
+
+	if (now - m_lastTableClean >= SESSION_TABLE_CLEAN_INTERVAL)
+	{
+		m_sql.safe_query("DELETE FROM UserSessions WHERE ExpirationDate < datetime('now', 'localtime')");
+		m_lastTableClean = now;
+	}
+}
+
+void CSessionCache::Flush()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	std::vector<_tCachedSession> dirty;
+	for (auto &cached : m_sessions)
+	{
+		if (cached.bDirty)
+		{
+			dirty.push_back(cached);
+			cached.bDirty = false;
+		}
+	}
+	WriteSessions(dirty);
+}
+
+bool CSessionCache::LoadSession(const std::string &sessionId, _tCachedSession &cached)
+{
+	auto result = m_sql.safe_query("SELECT SessionID, Username, AuthToken, ExpirationDate FROM UserSessions WHERE SessionID = '%q'", sessionId.c_str());
+	if (result.empty())
+		return false;
+	cached.Session.id = result[0][0];
+	cached.Session.username = base64_decode(result[0][1]);
+	cached.Session.auth_token = result[0][2];
+	struct tm tExpirationDate;
+	ParseSQLdatetime(cached.Session.expires, tExpirationDate, result[0][3]);
+	// RemoteHost and LastUpdate are not used to restore the session
+	cached.LastUpdate = 0;
+	cached.bDirty = false;
+	return true;
+}
+
+CSessionCache::_tCachedSession &CSessionCache::Put(const _tCachedSession &cached)
+{
+	m_sessions.push_front(cached);
+	m_index[cached.Session.id] = m_sessions.begin();
+	while (m_sessions.size() > m_maxSessions)
+	{
+		// the least recently used session is written before it is dropped, it is read back on its next use
+		_tCachedSession &last = m_sessions.back();
+		if (last.bDirty)
+			WriteSessions(std::vector<_tCachedSession>(1, last));
+		m_index.erase(last.Session.id);
+		m_sessions.pop_back();
+	}
+	return m_sessions.front();
+}
+
+void CSessionCache::WriteSessions(const std::vector<_tCachedSession> &sessions)
+{
+	for (const auto &cached : sessions)
+	{
+		m_sql.safe_query("UPDATE UserSessions set AuthToken = '%q', ExpirationDate = '%q', RemoteHost = '%q', LastUpdate = '%q' WHERE SessionID = '%q'", cached.Session.auth_token.c_str(),
+			FormatSessionTime(cached.Session.expires).c_str(), cached.Session.remote_host.c_str(), FormatSessionTime(cached.LastUpdate).c_str(), cached.Session.id.c_str());
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../webserver/session_store.hpp"
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// LRU cache of the user sessions in front of the UserSessions table
+//
+// Sessions are served from memory, the table is only read on a miss. New and removed sessions are written through,
+// renewed sessions (auth token, expiration, last update) are written behind by Flush(), which runs with the periodic
+// clean up and when a web server stops. The plain and secure web servers share one cache, as they share the table.
+class CSessionCache
+{
+public:
+	explicit CSessionCache(size_t maxSessions);
+
+	http::server::WebEmStoredSession GetSession(const std::string &sessionId);
+	void StoreSession(const http::server::WebEmStoredSession &session);
+	void RemoveSession(const std::string &sessionId);
+	// szUsername is base64 encoded, as in the table
+	void RemoveUsersSessions(const std::string &szUsername, const std::string &exceptSessionId);
+
+	// Drops the expired sessions and writes the renewed ones. The expired rows of the table are deleted at most once an hour
+	void CleanSessions();
+	void Flush();
+
+private:
+	struct _tCachedSession
+	{
+		http::server::WebEmStoredSession Session;
+		time_t LastUpdate = 0;
+		bool bDirty = false;
+	};
+	typedef std::list<_tCachedSession> _tSessionList;
+
+	bool LoadSession(const std::string &sessionId, _tCachedSession &cached);
+	// Adds an entry as the most recently used one (mutex locked), the least recently used entries are written and evicted
+	_tCachedSession &Put(const _tCachedSession &cached);
+	static void WriteSessions(const std::vector<_tCachedSession> &sessions);
+
+	size_t m_maxSessions;
+	std::mutex m_mutex;
+	_tSessionList m_sessions; // most recently used first
+	std::unordered_map<std::string, _tSessionList::iterator> m_index;
+	time_t m_lastTableClean = 0;
+};
@@ -0,0 +1,957 @@
+#include "stdafx.h"
+#include "ShortLogStore.h"
+#include "Helper.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#define SHORTLOG_CHUNK_SECONDS (4 * 3600) // must divide a day, a chunk never spans two segments
+#define SHORTLOG_DAY_SECONDS 86400
+#define SHORTLOG_MAX_CHUNK_SAMPLES 4096
+#define SHORTLOG_CHUNK_MAGIC 0x53544C44
+#define SHORTLOG_HEADER_SIZE 40
+#define SHORTLOG_INFO_FILE "shortlog.info"
+#define SHORTLOG_TOMBSTONE_FILE "tombstones.txt"
+
+namespace
+{
+	struct _tShortLogColumn
+	{
+		const char *szName;
+		bool bInteger;
+		const char *szFormat; // as used by the INSERT of the database table, values are rounded the same way
+	};
+
+	struct _tShortLogTable
+	{
+		const char *szName;
+		std::vector<_tShortLogColumn> columns;
+	};
+
+	const _tShortLogTable ShortLogTables[CShortLogStore::SLT_COUNT] = {
+		{ "Temperature", { { "Temperature", false, "%.2f" }, { "Chill", false, "%.2f" }, { "Humidity", true, "%.0f" }, { "Barometer", true, "%.0f" }, { "DewPoint", false, "%.2f" }, { "SetPoint", false, "%.2f" } } },
+		{ "Rain", { { "Total", false, "%.2f" }, { "Rate", true, "%.0f" } } },
+		{ "Wind", { { "Direction", false, "%.2f" }, { "Speed", true, "%.0f" }, { "Gust", true, "%.0f" } } },
+		{ "UV", { { "Level", false, "%g" } } },
+		{ "Percentage", { { "Percentage", false, "%g" } } },
+		{ "Fan", { { "Speed", true, "%.0f" } } },
+	};
+
+	int64_t FloorDiv(const int64_t value, const int64_t divider)
+	{
+		return (value >= 0) ? (value / divider) : -((-value + divider - 1) / divider);
+	}
+
+	int CountLeadingZeros(uint64_t value)
+	{
+		int count = 0;
+		for (uint64_t mask = 0x8000000000000000ULL; (mask != 0) && ((value & mask) == 0); mask >>= 1)
+			count++;
+		return count;
+	}
+
+	int CountTrailingZeros(uint64_t value)
+	{
+		if (value == 0)
+			return 64;
+		int count = 0;
+		while ((value & 1) == 0)
+		{
+			value >>= 1;
+			count++;
+		}
+		return count;
+	}
+
+	uint64_t DoubleToBits(const double value)
+	{
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	double BitsToDouble(const uint64_t bits)
+	{
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	class CBitWriter
+	{
+	public:
+		void Write(const uint64_t value, const int nbits)
+		{
+			for (int ii = nbits - 1; ii >= 0; ii--)
+			{
+				if ((m_bitpos & 7) == 0)
+					m_buffer.push_back(0);
+				if ((value >> ii) & 1)
+					m_buffer.back() |= static_cast<uint8_t>(0x80 >> (m_bitpos & 7));
+				m_bitpos++;
+			}
+		}
+		// zigzag encoded signed value, small values take few bits
+		void WriteSigned(const int64_t value)
+		{
+			uint64_t zz = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+			if (zz == 0)
+				Write(0, 1);
+			else if (zz < (1 << 7))
+			{
+				Write(0x2, 2);
+				Write(zz, 7);
+			}
+			else if (zz < (1 << 9))
+			{
+				Write(0x6, 3);
+				Write(zz, 9);
+			}
+			else if (zz < (1 << 12))
+			{
+				Write(0xE, 4);
+				Write(zz, 12);
+			}
+			else
+			{
+				Write(0xF, 4);
+				Write(zz, 64);
+			}
+		}
+		const std::vector<uint8_t> &GetBuffer() const
+		{
+			return m_buffer;
+		}
+
+	private:
+		std::vector<uint8_t> m_buffer;
+		uint64_t m_bitpos = 0;
+	};
+
+	class CBitReader
+	{
+	public:
+		CBitReader(const uint8_t *pData, const size_t size)
+			: m_pData(pData)
+			, m_bitsize(static_cast<uint64_t>(size) * 8)
+		{
+		}
+		uint64_t Read(const int nbits)
+		{
+			uint64_t value = 0;
+			for (int ii = 0; ii < nbits; ii++)
+			{
+				if (m_bitpos >= m_bitsize)
+				{
+					m_bError = true;
+					return 0;
+				}
+				value = (value << 1) | ((m_pData[m_bitpos >> 3] >> (7 - (m_bitpos & 7))) & 1);
+				m_bitpos++;
+			}
+			return value;
+		}
+		int64_t ReadSigned()
+		{
+			uint64_t zz;
+			if (Read(1) == 0)
+				zz = 0;
+			else if (Read(1) == 0)
+				zz = Read(7);
+			else if (Read(1) == 0)
+				zz = Read(9);
+			else if (Read(1) == 0)
+				zz = Read(12);
+			else
+				zz = Read(64);
+			return static_cast<int64_t>(zz >> 1) ^ -static_cast<int64_t>(zz & 1);
+		}
+		bool HasError() const
+		{
+			return m_bError;
+		}
+
+	private:
+		const uint8_t *m_pData;
+		uint64_t m_bitsize;
+		uint64_t m_bitpos = 0;
+		bool m_bError = false;
+	};
+
+	struct _tChunkHeader
+	{
+		uint32_t magic;
+		uint32_t payloadSize;
+		uint64_t DeviceRowID;
+		int64_t firstTime;
+		int64_t lastTime;
+		uint32_t count;
+		uint32_t ncols;
+	};
+
+	void WriteHeader(uint8_t *pDest, const _tChunkHeader &header)
+	{
+		memcpy(pDest, &header.magic, 4);
+		memcpy(pDest + 4, &header.payloadSize, 4);
+		memcpy(pDest + 8, &header.DeviceRowID, 8);
+		memcpy(pDest + 16, &header.firstTime, 8);
+		memcpy(pDest + 24, &header.lastTime, 8);
+		memcpy(pDest + 32, &header.count, 4);
+		memcpy(pDest + 36, &header.ncols, 4);
+	}
+
+	// returns false when there is no complete chunk at pData
+	bool ReadHeader(const uint8_t *pData, const size_t available, _tChunkHeader &header)
+	{
+		if (available < SHORTLOG_HEADER_SIZE)
+			return false;
+		memcpy(&header.magic, pData, 4);
+		memcpy(&header.payloadSize, pData + 4, 4);
+		memcpy(&header.DeviceRowID, pData + 8, 8);
+		memcpy(&header.firstTime, pData + 16, 8);
+		memcpy(&header.lastTime, pData + 24, 8);
+		memcpy(&header.count, pData + 32, 4);
+		memcpy(&header.ncols, pData + 36, 4);
+		if (header.magic != SHORTLOG_CHUNK_MAGIC)
+			return false;
+		return (static_cast<uint64_t>(header.payloadSize) + SHORTLOG_HEADER_SIZE <= available);
+	}
+
+	// Timestamps (delta of delta) followed by each column (XOR with the previous value)
+	std::vector<uint8_t> EncodeChunk(const std::vector<int64_t> &times, const std::vector<std::vector<double>> &columns)
+	{
+		CBitWriter writer;
+		int64_t prevTime = times[0];
+		int64_t prevDelta = 0;
+		writer.Write(static_cast<uint64_t>(prevTime), 64);
+		for (size_t ii = 1; ii < times.size(); ii++)
+		{
+			int64_t delta = times[ii] - prevTime;
+			writer.WriteSigned(delta - prevDelta);
+			prevDelta = delta;
+			prevTime = times[ii];
+		}
+		for (const auto &column : columns)
+		{
+			uint64_t prevBits = DoubleToBits(column[0]);
+			int prevLeading = -1;
+			int prevTrailing = 0;
+			writer.Write(prevBits, 64);
+			for (size_t ii = 1; ii < column.size(); ii++)
+			{
+				uint64_t bits = DoubleToBits(column[ii]);
+				uint64_t xorValue = bits ^ prevBits;
+				prevBits = bits;
+				if (xorValue == 0)
+				{
+					writer.Write(0, 1);
+					continue;
+				}
+				writer.Write(1, 1);
+				int leading = std::min(CountLeadingZeros(xorValue), 31);
+				int trailing = CountTrailingZeros(xorValue);
+				if ((prevLeading != -1) && (leading >= prevLeading) && (trailing >= prevTrailing))
+				{
+					// fits in the window of the previous value
+					writer.Write(0, 1);
+					writer.Write(xorValue >> prevTrailing, 64 - prevLeading - prevTrailing);
+					continue;
+				}
+				int significant = 64 - leading - trailing;
+				writer.Write(1, 1);
+				writer.Write(static_cast<uint64_t>(leading), 5);
+				writer.Write(static_cast<uint64_t>(significant - 1), 6);
+				writer.Write(xorValue >> trailing, significant);
+				prevLeading = leading;
+				prevTrailing = trailing;
+			}
+		}
+		return writer.GetBuffer();
+	}
+
+	bool DecodeChunk(const uint8_t *pData, const size_t size, const uint32_t count, const uint32_t ncols, std::vector<int64_t> &times, std::vector<std::vector<double>> &columns)
+	{
+		if (count == 0)
+			return false;
+		CBitReader reader(pData, size);
+		times.resize(count);
+		times[0] = static_cast<int64_t>(reader.Read(64));
+		int64_t prevDelta = 0;
+		for (uint32_t ii = 1; ii < count; ii++)
+		{
+			prevDelta += reader.ReadSigned();
+			times[ii] = times[ii - 1] + prevDelta;
+		}
+		columns.resize(ncols);
+		for (auto &column : columns)
+		{
+			column.resize(count);
+			uint64_t prevBits = reader.Read(64);
+			int prevLeading = 0;
+			int prevTrailing = 0;
+			column[0] = BitsToDouble(prevBits);
+			for (uint32_t ii = 1; ii < count; ii++)
+			{
+				if (reader.Read(1) != 0)
+				{
+					if (reader.Read(1) != 0)
+					{
+						prevLeading = static_cast<int>(reader.Read(5));
+						int significant = static_cast<int>(reader.Read(6)) + 1;
+						prevTrailing = 64 - prevLeading - significant;
+					}
+					prevBits ^= (reader.Read(64 - prevLeading - prevTrailing) << prevTrailing);
+				}
+				column[ii] = BitsToDouble(prevBits);
+			}
+		}
+		return !reader.HasError();
+	}
+
+	// Same text as sqlite returns for a REAL (%!.15g) or INTEGER value
+	std::string FormatValue(const double value, const bool bInteger)
+	{
+		char szTmp[40];
+		if ((bInteger) && (value == std::floor(value)) && (std::fabs(value) < 9.2e18))
+		{
+			snprintf(szTmp, sizeof(szTmp), "%" PRId64, static_cast<int64_t>(value));
+			return szTmp;
+		}
+		snprintf(szTmp, sizeof(szTmp), "%.15g", value);
+		if (strpbrk(szTmp, ".eni") == nullptr)
+			strcat(szTmp, ".0");
+		return szTmp;
+	}
+} // namespace
+
+CShortLogStore::CShortLogStore()
+{
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+	{
+		m_currentBucket[ii] = INT64_MIN;
+		m_wal[ii] = nullptr;
+	}
+}
+
+CShortLogStore::~CShortLogStore()
+{
+	Close();
+}
+
+bool CShortLogStore::GetTable(const std::string &szTableName, _eShortLogTable &table)
+{
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+	{
+		if (szTableName == ShortLogTables[ii].szName)
+		{
+			table = static_cast<_eShortLogTable>(ii);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *CShortLogStore::GetTableName(const _eShortLogTable table)
+{
+	return ShortLogTables[table].szName;
+}
+
+std::vector<std::string> CShortLogStore::GetColumns(const _eShortLogTable table)
+{
+	std::vector<std::string> columns;
+	for (const auto &column : ShortLogTables[table].columns)
+		columns.push_back(column.szName);
+	return columns;
+}
+
+std::string CShortLogStore::GetSegmentFile(const _eShortLogTable table, const int64_t day) const
+{
+	return m_szFolder + ShortLogTables[table].szName + "_" + std::to_string(day) + ".seg";
+}
+
+std::string CShortLogStore::GetWALFile(const _eShortLogTable table) const
+{
+	return m_szFolder + ShortLogTables[table].szName + ".wal";
+}
+
+bool CShortLogStore::Open(const std::string &szFolder)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_bOpen)
+		return true;
+	m_szFolder = szFolder;
+	if ((!m_szFolder.empty()) && (m_szFolder.back() != '/') && (m_szFolder.back() != '\\'))
+		m_szFolder += "/";
+
+	createdir(m_szFolder.c_str(), 0755);
+	std::string szInfoFile = m_szFolder + SHORTLOG_INFO_FILE;
+	FILE *fInfo = fopen(szInfoFile.c_str(), "rb");
+	m_bNew = (fInfo == nullptr);
+	if (fInfo)
+		fclose(fInfo);
+	if (m_bNew)
+	{
+		// never (completely) filled, start over
+		ClearFiles();
+	}
+
+	std::vector<std::string> files;
+	DirectoryListing(files, m_szFolder, false, true);
+	for (const auto &file : files)
+	{
+		size_t pos = file.rfind('_');
+		if ((pos == std::string::npos) || (file.size() < 5) || (file.compare(file.size() - 4, 4, ".seg") != 0))
+			continue;
+		_eShortLogTable table;
+		if (!GetTable(file.substr(0, pos), table))
+			continue;
+		IndexSegment(table, std::stoll(file.substr(pos + 1, file.size() - pos - 5)));
+	}
+
+	ReadTombstones();
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+		ReplayWAL(static_cast<_eShortLogTable>(ii));
+
+	m_bOpen = true;
+	return true;
+}
+
+void CShortLogStore::Close()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+	{
+		SealAll(static_cast<_eShortLogTable>(ii));
+		if (m_wal[ii])
+		{
+			fclose(m_wal[ii]);
+			m_wal[ii] = nullptr;
+		}
+		m_index[ii].clear();
+		m_currentBucket[ii] = INT64_MIN;
+	}
+	m_tombstones.clear();
+	m_bOpen = false;
+}
+
+bool CShortLogStore::IsOpen()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return m_bOpen;
+}
+
+bool CShortLogStore::IsNew()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return m_bNew;
+}
+
+void CShortLogStore::SetImported()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	std::string szInfoFile = m_szFolder + SHORTLOG_INFO_FILE;
+	FILE *fInfo = fopen(szInfoFile.c_str(), "wb");
+	if (!fInfo)
+	{
+		_log.Log(LOG_ERROR, "ShortLogStore: Unable to write %s", szInfoFile.c_str());
+		return;
+	}
+	fputs("version=1\n", fInfo);
+	fclose(fInfo);
+	m_bNew = false;
+}
+
+// Builds the index of a segment, a chunk that was not completely written (crash) is cut off
+void CShortLogStore::IndexSegment(const _eShortLogTable table, const int64_t day)
+{
+	std::string szFile = GetSegmentFile(table, day);
+	std::vector<uint8_t> validData;
+	bool bTruncated = false;
+	try
+	{
+		boost::interprocess::file_mapping fmap(szFile.c_str(), boost::interprocess::read_only);
+		boost::interprocess::mapped_region region(fmap, boost::interprocess::read_only);
+		const uint8_t *pData = static_cast<const uint8_t *>(region.get_address());
+		size_t size = region.get_size();
+		size_t offset = 0;
+		_tChunkHeader header;
+		auto &dayIndex = m_index[table][day];
+		while (ReadHeader(pData + offset, size - offset, header))
+		{
+			dayIndex.insert(std::make_pair(header.DeviceRowID, _tChunkRef{ offset, header.firstTime, header.lastTime }));
+			offset += SHORTLOG_HEADER_SIZE + header.payloadSize;
+		}
+		if (offset != size)
+		{
+			bTruncated = true;
+			validData.assign(pData, pData + offset);
+		}
+	}
+	catch (...)
+	{
+		// empty file (can not be mapped) or unreadable
+		return;
+	}
+	if (bTruncated)
+	{
+		_log.Log(LOG_ERROR, "ShortLogStore: Removing incomplete data at the end of %s", szFile.c_str());
+		std::string szTmpFile = szFile + ".tmp";
+		FILE *fOut = fopen(szTmpFile.c_str(), "wb");
+		if (fOut)
+		{
+			if (!validData.empty())
+				fwrite(validData.data(), 1, validData.size(), fOut);
+			fclose(fOut);
+			std::remove(szFile.c_str());
+			std::rename(szTmpFile.c_str(), szFile.c_str());
+		}
+	}
+}
+
+void CShortLogStore::ReplayWAL(const _eShortLogTable table)
+{
+	const size_t ncols = ShortLogTables[table].columns.size();
+	std::string szWAL = GetWALFile(table);
+	FILE *fWAL = fopen(szWAL.c_str(), "rb");
+	if (fWAL)
+	{
+		std::vector<uint8_t> record(16 + ncols * sizeof(double));
+		std::vector<double> values(ncols);
+		while (fread(record.data(), 1, record.size(), fWAL) == record.size())
+		{
+			uint64_t DeviceRowID;
+			int64_t sampleTime;
+			memcpy(&DeviceRowID, record.data(), 8);
+			memcpy(&sampleTime, record.data() + 8, 8);
+			memcpy(values.data(), record.data() + 16, ncols * sizeof(double));
+			m_currentBucket[table] = std::max(m_currentBucket[table], FloorDiv(sampleTime, SHORTLOG_CHUNK_SECONDS));
+			AddToHead(table, DeviceRowID, sampleTime, values);
+		}
+		fclose(fWAL);
+	}
+	m_wal[table] = fopen(szWAL.c_str(), "ab");
+	if (!m_wal[table])
+		_log.Log(LOG_ERROR, "ShortLogStore: Unable to open %s", szWAL.c_str());
+}
+
+void CShortLogStore::AddToHead(const _eShortLogTable table, const uint64_t DeviceRowID, const int64_t sampleTime, const std::vector<double> &values)
+{
+	int64_t bucket = FloorDiv(sampleTime, SHORTLOG_CHUNK_SECONDS);
+	auto &head = m_heads[table][DeviceRowID];
+	if ((!head.times.empty()) && ((head.bucket != bucket) || (head.times.size() >= SHORTLOG_MAX_CHUNK_SAMPLES)))
+	{
+		SealChunk(table, DeviceRowID, head);
+		head = _tHeadChunk();
+	}
+	if (head.times.empty())
+	{
+		head.bucket = bucket;
+		head.columns.resize(values.size());
+	}
+	head.times.push_back(sampleTime);
+	for (size_t ii = 0; ii < values.size(); ii++)
+		head.columns[ii].push_back(values[ii]);
+}
+
+void CShortLogStore::SealChunk(const _eShortLogTable table, const uint64_t DeviceRowID, const _tHeadChunk &chunk)
+{
+	if (chunk.times.empty())
+		return;
+	std::vector<uint8_t> payload = EncodeChunk(chunk.times, chunk.columns);
+
+	_tChunkHeader header;
+	header.magic = SHORTLOG_CHUNK_MAGIC;
+	header.payloadSize = static_cast<uint32_t>(payload.size());
+	header.DeviceRowID = DeviceRowID;
+	header.firstTime = *std::min_element(chunk.times.begin(), chunk.times.end());
+	header.lastTime = *std::max_element(chunk.times.begin(), chunk.times.end());
+	header.count = static_cast<uint32_t>(chunk.times.size());
+	header.ncols = static_cast<uint32_t>(chunk.columns.size());
+	uint8_t headerData[SHORTLOG_HEADER_SIZE];
+	WriteHeader(headerData, header);
+
+	int64_t day = FloorDiv(chunk.bucket * SHORTLOG_CHUNK_SECONDS, SHORTLOG_DAY_SECONDS);
+	std::string szFile = GetSegmentFile(table, day);
+	FILE *fSeg = fopen(szFile.c_str(), "ab");
+	if (!fSeg)
+	{
+		_log.Log(LOG_ERROR, "ShortLogStore: Unable to write %s", szFile.c_str());
+		return;
+	}
+	fseek(fSeg, 0, SEEK_END);
+	uint64_t offset = static_cast<uint64_t>(ftell(fSeg));
+	bool bOK = (fwrite(headerData, 1, SHORTLOG_HEADER_SIZE, fSeg) == SHORTLOG_HEADER_SIZE);
+	bOK = bOK && (fwrite(payload.data(), 1, payload.size(), fSeg) == payload.size());
+	fclose(fSeg);
+	if (!bOK)
+	{
+		_log.Log(LOG_ERROR, "ShortLogStore: Unable to write %s", szFile.c_str());
+		return;
+	}
+	m_index[table][day].insert(std::make_pair(DeviceRowID, _tChunkRef{ offset, header.firstTime, header.lastTime }));
+}
+
+void CShortLogStore::SealAll(const _eShortLogTable table)
+{
+	for (const auto &itt : m_heads[table])
+		SealChunk(table, itt.first, itt.second);
+	m_heads[table].clear();
+	if (m_wal[table])
+	{
+		fclose(m_wal[table]);
+		m_wal[table] = fopen(GetWALFile(table).c_str(), "wb");
+	}
+}
+
+std::vector<double> CShortLogStore::RoundValues(const _eShortLogTable table, const std::vector<double> &values)
+{
+	const auto &tableDef = ShortLogTables[table];
+	std::vector<double> rounded(values.size());
+	char szTmp[64];
+	for (size_t ii = 0; (ii < values.size()) && (ii < tableDef.columns.size()); ii++)
+	{
+		snprintf(szTmp, sizeof(szTmp), tableDef.columns[ii].szFormat, values[ii]);
+		rounded[ii] = atof(szTmp);
+	}
+	return rounded;
+}
+
+void CShortLogStore::Append(const _eShortLogTable table, const uint64_t DeviceRowID, const time_t sampleTime, const std::vector<double> &values)
+{
+	if (values.size() != ShortLogTables[table].columns.size())
+		return;
+
+	// round as the database INSERT does, so both return the same values
+	std::vector<double> rounded = RoundValues(table, values);
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	int64_t bucket = FloorDiv(sampleTime, SHORTLOG_CHUNK_SECONDS);
+	if (bucket > m_currentBucket[table])
+	{
+		SealAll(table);
+		m_currentBucket[table] = bucket;
+	}
+	AddToHead(table, DeviceRowID, sampleTime, rounded);
+
+	if (m_wal[table])
+	{
+		std::vector<uint8_t> record(16 + rounded.size() * sizeof(double));
+		int64_t itime = sampleTime;
+		memcpy(record.data(), &DeviceRowID, 8);
+		memcpy(record.data() + 8, &itime, 8);
+		memcpy(record.data() + 16, rounded.data(), rounded.size() * sizeof(double));
+		fwrite(record.data(), 1, record.size(), m_wal[table]);
+		fflush(m_wal[table]);
+	}
+}
+
+bool CShortLogStore::GetRows(const _eShortLogTable table, const uint64_t DeviceRowID, const std::vector<std::string> &columns, const time_t fromTime, std::vector<std::vector<std::string>> &result)
+{
+	const auto &tableDef = ShortLogTables[table];
+	std::vector<int> columnIndexes;
+	for (const auto &column : columns)
+	{
+		if (column == "Date")
+		{
+			columnIndexes.push_back(-1);
+			continue;
+		}
+		auto itt = std::find_if(tableDef.columns.begin(), tableDef.columns.end(), [&](const _tShortLogColumn &def) { return column == def.szName; });
+		if (itt == tableDef.columns.end())
+			return false;
+		columnIndexes.push_back(static_cast<int>(itt - tableDef.columns.begin()));
+	}
+
+	std::vector<int64_t> times;
+	std::vector<std::vector<double>> values(tableDef.columns.size());
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		if (!m_bOpen)
+			return false;
+
+		std::vector<size_t> order;
+		ReadSamples(table, DeviceRowID, fromTime, times, values, order);
+
+		result.clear();
+		result.reserve(order.size());
+		char szDate[40];
+		for (const auto idx : order)
+		{
+			std::vector<std::string> row;
+			row.reserve(columnIndexes.size());
+			for (const auto column : columnIndexes)
+			{
+				if (column == -1)
+				{
+					time_t sampleTime = static_cast<time_t>(times[idx]);
+					struct tm ltime;
+					localtime_r(&sampleTime, &ltime);
+					snprintf(szDate, sizeof(szDate), "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday, ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
+					row.push_back(szDate);
+				}
+				else
+					row.push_back(FormatValue(values[column][idx], tableDef.columns[column].bInteger));
+			}
+			result.push_back(std::move(row));
+		}
+	}
+	return true;
+}
+
+void CShortLogStore::ReadSamples(const _eShortLogTable table, const uint64_t DeviceRowID, const int64_t fromTime, std::vector<int64_t> &times, std::vector<std::vector<double>> &values,
+				 std::vector<size_t> &order)
+{
+	const size_t ncols = ShortLogTables[table].columns.size();
+	std::vector<int64_t> chunkTimes;
+	std::vector<std::vector<double>> chunkColumns;
+	for (auto itt = m_index[table].lower_bound(FloorDiv(fromTime, SHORTLOG_DAY_SECONDS)); itt != m_index[table].end(); ++itt)
+	{
+		auto range = itt->second.equal_range(DeviceRowID);
+		if (range.first == range.second)
+			continue;
+		try
+		{
+			boost::interprocess::file_mapping fmap(GetSegmentFile(table, itt->first).c_str(), boost::interprocess::read_only);
+			boost::interprocess::mapped_region region(fmap, boost::interprocess::read_only);
+			const uint8_t *pData = static_cast<const uint8_t *>(region.get_address());
+			size_t size = region.get_size();
+			for (auto ittChunk = range.first; ittChunk != range.second; ++ittChunk)
+			{
+				const _tChunkRef &ref = ittChunk->second;
+				_tChunkHeader header;
+				if ((ref.lastTime < fromTime) || (ref.offset >= size) || (!ReadHeader(pData + ref.offset, size - ref.offset, header)))
+					continue;
+				if (header.ncols != ncols)
+					continue;
+				if (!DecodeChunk(pData + ref.offset + SHORTLOG_HEADER_SIZE, header.payloadSize, header.count, header.ncols, chunkTimes, chunkColumns))
+					continue;
+				times.insert(times.end(), chunkTimes.begin(), chunkTimes.end());
+				for (size_t ii = 0; ii < values.size(); ii++)
+					values[ii].insert(values[ii].end(), chunkColumns[ii].begin(), chunkColumns[ii].end());
+			}
+		}
+		catch (...)
+		{
+			_log.Log(LOG_ERROR, "ShortLogStore: Unable to read %s", GetSegmentFile(table, itt->first).c_str());
+		}
+	}
+	auto ittHead = m_heads[table].find(DeviceRowID);
+	if (ittHead != m_heads[table].end())
+	{
+		times.insert(times.end(), ittHead->second.times.begin(), ittHead->second.times.end());
+		for (size_t ii = 0; ii < values.size(); ii++)
+			values[ii].insert(values[ii].end(), ittHead->second.columns[ii].begin(), ittHead->second.columns[ii].end());
+	}
+
+	// ordered by time, a sample that is stored twice (replayed write-ahead file) is returned once
+	order.resize(times.size());
+	for (size_t ii = 0; ii < order.size(); ii++)
+		order[ii] = ii;
+	std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return times[a] < times[b]; });
+	std::vector<size_t> selected;
+	for (size_t ii = 0; ii < order.size(); ii++)
+	{
+		int64_t sampleTime = times[order[ii]];
+		if ((sampleTime < fromTime) || ((ii > 0) && (sampleTime == times[order[ii - 1]])) || (IsDeleted(DeviceRowID, sampleTime)))
+			continue;
+		selected.push_back(order[ii]);
+	}
+	order.swap(selected);
+}
+
+bool CShortLogStore::IsDeleted(const uint64_t DeviceRowID, const int64_t sampleTime) const
+{
+	return std::any_of(m_tombstones.begin(), m_tombstones.end(),
+			   [&](const _tTombstone &tomb) { return (tomb.DeviceRowID == DeviceRowID) && (sampleTime >= tomb.fromTime) && (sampleTime <= tomb.toTime); });
+}
+
+void CShortLogStore::DeleteRange(const uint64_t DeviceRowID, const time_t fromTime, const time_t toTime)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	m_tombstones.push_back(_tTombstone{ DeviceRowID, static_cast<int64_t>(fromTime), static_cast<int64_t>(toTime), static_cast<int64_t>(mytime(nullptr)) });
+	WriteTombstones();
+}
+
+void CShortLogStore::DeleteDevice(const uint64_t DeviceRowID)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	for (auto &heads : m_heads)
+		heads.erase(DeviceRowID);
+	for (auto &index : m_index)
+	{
+		for (auto &day : index)
+			day.second.erase(DeviceRowID);
+	}
+	// the ID can be given to a new device, its samples (after now) stay visible.
+	// The index is rebuilt from the segment files on open, so the tombstone is still needed
+	m_tombstones.push_back(_tTombstone{ DeviceRowID, INT64_MIN, static_cast<int64_t>(mytime(nullptr)), static_cast<int64_t>(mytime(nullptr)) });
+	WriteTombstones();
+}
+
+void CShortLogStore::MoveDevice(const uint64_t fromRowID, const uint64_t toRowID, const time_t afterTime)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+	{
+		const _eShortLogTable table = static_cast<_eShortLogTable>(ii);
+		std::vector<int64_t> times;
+		std::vector<std::vector<double>> values(ShortLogTables[table].columns.size());
+		std::vector<size_t> order;
+		ReadSamples(table, fromRowID, static_cast<int64_t>(afterTime) + 1, times, values, order);
+		if (order.empty())
+			continue;
+
+		// sealed samples are written as new chunks of the target device, samples of the current bucket go to its head
+		_tHeadChunk chunk;
+		for (const auto idx : order)
+		{
+			const int64_t bucket = FloorDiv(times[idx], SHORTLOG_CHUNK_SECONDS);
+			std::vector<double> sample(values.size());
+			for (size_t jj = 0; jj < values.size(); jj++)
+				sample[jj] = values[jj][idx];
+			if (bucket == m_currentBucket[table])
+			{
+				AddToHead(table, toRowID, times[idx], sample);
+				if (m_wal[table])
+				{
+					std::vector<uint8_t> record(16 + sample.size() * sizeof(double));
+					memcpy(record.data(), &toRowID, 8);
+					memcpy(record.data() + 8, &times[idx], 8);
+					memcpy(record.data() + 16, sample.data(), sample.size() * sizeof(double));
+					fwrite(record.data(), 1, record.size(), m_wal[table]);
+				}
+				continue;
+			}
+			if ((!chunk.times.empty()) && ((chunk.bucket != bucket) || (chunk.times.size() >= SHORTLOG_MAX_CHUNK_SAMPLES)))
+			{
+				SealChunk(table, toRowID, chunk);
+				chunk = _tHeadChunk();
+			}
+			if (chunk.times.empty())
+			{
+				chunk.bucket = bucket;
+				chunk.columns.resize(sample.size());
+			}
+			chunk.times.push_back(times[idx]);
+			for (size_t jj = 0; jj < sample.size(); jj++)
+				chunk.columns[jj].push_back(sample[jj]);
+		}
+		SealChunk(table, toRowID, chunk);
+		if (m_wal[table])
+			fflush(m_wal[table]);
+	}
+}
+
+void CShortLogStore::Cleanup(const time_t olderThan)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+	{
+		auto &index = m_index[ii];
+		while ((!index.empty()) && ((index.begin()->first + 1) * SHORTLOG_DAY_SECONDS <= static_cast<int64_t>(olderThan)))
+		{
+			std::remove(GetSegmentFile(static_cast<_eShortLogTable>(ii), index.begin()->first).c_str());
+			index.erase(index.begin());
+		}
+	}
+	// a tombstone is not needed anymore when all segments written before it are dropped
+	size_t oldSize = m_tombstones.size();
+	m_tombstones.erase(std::remove_if(m_tombstones.begin(), m_tombstones.end(),
+					  [&](const _tTombstone &tomb) { return tomb.created + SHORTLOG_DAY_SECONDS < static_cast<int64_t>(olderThan); }),
+			   m_tombstones.end());
+	if (m_tombstones.size() != oldSize)
+		WriteTombstones();
+}
+
+void CShortLogStore::Clear()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_bOpen)
+		return;
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+	{
+		m_heads[ii].clear();
+		m_index[ii].clear();
+		m_currentBucket[ii] = INT64_MIN;
+		if (m_wal[ii])
+		{
+			fclose(m_wal[ii]);
+			m_wal[ii] = nullptr;
+		}
+	}
+	m_tombstones.clear();
+	ClearFiles();
+	m_bNew = false;
+	std::string szInfoFile = m_szFolder + SHORTLOG_INFO_FILE;
+	FILE *fInfo = fopen(szInfoFile.c_str(), "wb");
+	if (fInfo)
+	{
+		fputs("version=1\n", fInfo);
+		fclose(fInfo);
+	}
+	for (int ii = 0; ii < SLT_COUNT; ii++)
+		m_wal[ii] = fopen(GetWALFile(static_cast<_eShortLogTable>(ii)).c_str(), "ab");
+}
+
+void CShortLogStore::ClearFiles()
+{
+	std::vector<std::string> files;
+	DirectoryListing(files, m_szFolder, false, true);
+	for (const auto &file : files)
+		std::remove((m_szFolder + file).c_str());
+}
+
+void CShortLogStore::ReadTombstones()
+{
+	m_tombstones.clear();
+	FILE *fIn = fopen((m_szFolder + SHORTLOG_TOMBSTONE_FILE).c_str(), "r");
+	if (!fIn)
+		return;
+	_tTombstone tomb;
+	while (fscanf(fIn, "%" SCNu64 " %" SCNd64 " %" SCNd64 " %" SCNd64, &tomb.DeviceRowID, &tomb.fromTime, &tomb.toTime, &tomb.created) == 4)
+		m_tombstones.push_back(tomb);
+	fclose(fIn);
+}
+
+void CShortLogStore::WriteTombstones()
+{
+	std::string szFile = m_szFolder + SHORTLOG_TOMBSTONE_FILE;
+	std::string szTmpFile = szFile + ".tmp";
+	FILE *fOut = fopen(szTmpFile.c_str(), "w");
+	if (!fOut)
+	{
+		_log.Log(LOG_ERROR, "ShortLogStore: Unable to write %s", szFile.c_str());
+		return;
+	}
+	for (const auto &tomb : m_tombstones)
+		fprintf(fOut, "%" PRIu64 " %" PRId64 " %" PRId64 " %" PRId64 "\n", tomb.DeviceRowID, tomb.fromTime, tomb.toTime, tomb.created);
+	fclose(fOut);
+	std::remove(szFile.c_str());
+	std::rename(szTmpFile.c_str(), szFile.c_str());
+}
+
+void CShortLogStore::Remove(const std::string &szFolder)
+{
+	if (!file_exist(szFolder.c_str()))
+		return;
+	std::string errorPath;
+	if (RemoveDir(szFolder, errorPath) != 0)
+		_log.Log(LOG_ERROR, "ShortLogStore: Unable to remove %s", errorPath.c_str());
+}
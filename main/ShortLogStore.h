@@ -0,0 +1,107 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Append-only columnar store for the short log tables (the 5 minute history)
+//
+// Samples of a device are collected in a chunk of 4 hours. When a chunk is sealed it is appended
+// to the segment file of its (UTC) day, there is one segment file per table and day.
+// In a chunk the timestamps are delta-of-delta encoded and every column is XOR (Gorilla) compressed.
+// Samples of chunks that are not sealed yet are also written to a write-ahead file, so they survive a crash.
+// Segment files are memory mapped for reading, removing old data is deleting whole segment files.
+class CShortLogStore
+{
+public:
+	enum _eShortLogTable
+	{
+		SLT_TEMPERATURE = 0,
+		SLT_RAIN,
+		SLT_WIND,
+		SLT_UV,
+		SLT_PERCENTAGE,
+		SLT_FAN,
+		SLT_COUNT
+	};
+
+	CShortLogStore();
+	~CShortLogStore();
+
+	bool Open(const std::string &szFolder);
+	void Close();
+	bool IsOpen();
+	// True when Open created an empty store that should be filled from the database tables
+	bool IsNew();
+	void SetImported();
+
+	static bool GetTable(const std::string &szTableName, _eShortLogTable &table);
+	static const char *GetTableName(_eShortLogTable table);
+	static std::vector<std::string> GetColumns(_eShortLogTable table);
+
+	// Rounds the values as the INSERT into the database table does
+	static std::vector<double> RoundValues(_eShortLogTable table, const std::vector<double> &values);
+
+	// values in the column order of GetColumns
+	void Append(_eShortLogTable table, uint64_t DeviceRowID, time_t sampleTime, const std::vector<double> &values);
+	// Rows ordered by time, with the requested columns ('Date' for the time) formatted like the database would return them
+	bool GetRows(_eShortLogTable table, uint64_t DeviceRowID, const std::vector<std::string> &columns, time_t fromTime, std::vector<std::vector<std::string>> &result);
+
+	void DeleteRange(uint64_t DeviceRowID, time_t fromTime, time_t toTime);
+	void DeleteDevice(uint64_t DeviceRowID);
+	// Copies the samples after afterTime of a device to another device (device transfer), the source is deleted afterwards
+	void MoveDevice(uint64_t fromRowID, uint64_t toRowID, time_t afterTime);
+	// Drops the segments that only contain samples older than olderThan
+	void Cleanup(time_t olderThan);
+	void Clear();
+
+	static void Remove(const std::string &szFolder);
+
+private:
+	struct _tHeadChunk
+	{
+		int64_t bucket = 0;
+		std::vector<int64_t> times;
+		std::vector<std::vector<double>> columns;
+	};
+	struct _tTombstone
+	{
+		uint64_t DeviceRowID;
+		int64_t fromTime;
+		int64_t toTime;
+		int64_t created;
+	};
+	struct _tChunkRef
+	{
+		uint64_t offset;
+		int64_t firstTime;
+		int64_t lastTime;
+	};
+
+	std::string GetSegmentFile(_eShortLogTable table, int64_t day) const;
+	std::string GetWALFile(_eShortLogTable table) const;
+	void SealChunk(_eShortLogTable table, uint64_t DeviceRowID, const _tHeadChunk &chunk);
+	void SealAll(_eShortLogTable table);
+	void ReplayWAL(_eShortLogTable table);
+	void IndexSegment(_eShortLogTable table, int64_t day);
+	void AddToHead(_eShortLogTable table, uint64_t DeviceRowID, int64_t sampleTime, const std::vector<double> &values);
+	void ReadTombstones();
+	void WriteTombstones();
+	bool IsDeleted(uint64_t DeviceRowID, int64_t sampleTime) const;
+	// Samples of a device from fromTime (m_mutex locked), order holds the indexes of the selected samples ordered by time
+	void ReadSamples(_eShortLogTable table, uint64_t DeviceRowID, int64_t fromTime, std::vector<int64_t> &times, std::vector<std::vector<double>> &values, std::vector<size_t> &order);
+	void ClearFiles();
+
+	std::mutex m_mutex;
+	std::string m_szFolder;
+	bool m_bOpen = false;
+	bool m_bNew = false;
+
+	std::map<uint64_t, _tHeadChunk> m_heads[SLT_COUNT];
+	int64_t m_currentBucket[SLT_COUNT];
+	FILE *m_wal[SLT_COUNT];
+	// per table: day -> device -> chunks in that segment
+	std::map<int64_t, std::multimap<uint64_t, _tChunkRef>> m_index[SLT_COUNT];
+	std::vector<_tTombstone> m_tombstones;
+};
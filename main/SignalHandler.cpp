@@ -405,7 +405,7 @@ void signal_handler(int sig_num
 #ifndef WIN32
 	case SIGHUP:
 		if (!logfile.empty())
-			_log.SetOutputFile(logfile.c_str());
+			_log.ReopenOutputFile();
 		break;
 #endif
 	case SIGINT:
@@ -450,6 +450,7 @@ void signal_handler(int sig_num
 			}
 #endif
 			dumpstack_backtrace(info, ucontext);
+			_log.Flush();
 			// re-raise signal to enforce core dump
 			signal(sig_num, SIG_DFL);
 			raise(sig_num);
@@ -468,6 +469,7 @@ void signal_handler(int sig_num
 		printRegInfo(info, ((ucontext_t *)ucontext));
 #endif
 		dumpstack(info, ucontext);
+		_log.Flush();
 		// re-raise signal to enforce core dump
 		signal(sig_num, SIG_DFL);
 		raise(sig_num);
@@ -482,6 +484,7 @@ void signal_handler(int sig_num
 		g_bStopApplication = true;
 		// Give main thread a few seconds to shut down
 		sleep_milliseconds(5000);
+		_log.Flush();
 		// re-raise signal to enforce core dump
 		signal(sig_num, SIG_DFL);
 		raise(sig_num);
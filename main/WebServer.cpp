@@ -15,9 +15,12 @@
 #include "LuaHandler.h"
 #include "Logger.h"
 #include "SQLHelper.h"
+#include "LatencyStats.h"
+#include "SessionCache.h"
 #include "../httpclient/HTTPClient.h"
 #include "../hardware/hardwaretypes.h"
 #include "../webserver/Base64.h"
+#include "../webserver/JSonStreamWriter.h"
 #include "../smtpclient/SMTPClient.h"
 #include "../push/BasePush.h"
 #include "../notifications/NotificationHelper.h"
@@ -53,6 +56,10 @@
 
 #define round(a) (int)(a + .5)
 
+#define DEVICE_JSON_CACHE_SECONDS 300 // rendered devices are refreshed at least this often
+#define DEVICE_JSON_CACHE_VIEWS 4
+#define WEB_SESSION_CACHE_SIZE 1000
+
 extern std::string szStartupFolder;
 extern std::string szUserDataFolder;
 extern std::string szWWWFolder;
@@ -77,6 +84,9 @@ namespace http
 			std::string Mode2; // Used to flag DimmerType as relative for some old LimitLessLight type bulbs
 		};
 
+		// shared by the plain and secure web servers, they use the same UserSessions table
+		static CSessionCache g_sessionCache(WEB_SESSION_CACHE_SIZE);
+
 		CWebServer::CWebServer()
 		{
 			m_pWebEm = nullptr;
@@ -236,6 +246,7 @@ namespace http
 			// Maybe handle these differently? (Or remove)
 			m_pWebEm->RegisterPageCode("/images/floorplans/plan", [this](auto&& session, auto&& req, auto&& rep) { GetFloorplanImage(session, req, rep); });
 			m_pWebEm->RegisterPageCode("/service-worker.js", [this](auto&& session, auto&& req, auto&& rep) { GetServiceWorker(session, req, rep); });
+			m_pWebEm->RegisterPageCode("/metrics", [this](auto&& session, auto&& req, auto&& rep) { GetMetrics(session, req, rep); });
 
 			// End of 'Pages' to be moved...
 
@@ -264,6 +275,9 @@ namespace http
 			RegisterCommandCode("getversion", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetVersion(session, req, root); }, true);
 			RegisterCommandCode("getauth", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetAuth(session, req, root); }, true);
 			RegisterCommandCode("getuptime", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetUptime(session, req, root); }, true);
+			RegisterCommandCode("getrxqueuestats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetRxQueueStats(session, req, root); });
+			RegisterCommandCode("getdbconnectionstats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetDBConnectionStats(session, req, root); });
+			RegisterCommandCode("getlatencystats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetLatencyStats(session, req, root); });
 			RegisterCommandCode("getconfig", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetConfig(session, req, root); }, true);
 
 			// Commands that require authentication
@@ -352,6 +366,7 @@ namespace http
 			RegisterCommandCode("getinfluxlinks", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetInfluxLinks(session, req, root); });
 			RegisterCommandCode("saveinfluxlink", [this](auto&& session, auto&& req, auto&& root) { Cmd_SaveInfluxLink(session, req, root); });
 			RegisterCommandCode("deleteinfluxlink", [this](auto&& session, auto&& req, auto&& root) { Cmd_DeleteInfluxLink(session, req, root); });
+			RegisterCommandCode("getinfluxstats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetInfluxStats(session, req, root); });
 
 			RegisterCommandCode("savehttplinkconfig", [this](auto&& session, auto&& req, auto&& root) { Cmd_SaveHttpLinkConfig(session, req, root); });
 			RegisterCommandCode("gethttplinkconfig", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetHttpLinkConfig(session, req, root); });
@@ -484,6 +499,8 @@ namespace http
 			// Migrated RTypes to regular commands
 			RegisterCommandCode("getusers", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetUsers(session, req, root); });
 			RegisterCommandCode("getsettings", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetSettings(session, req, root); });
+			// getdevices is not streamed: GetJSonDevices is shared with the event system and the web server helper, keeps the rendered
+			// devices as Json::Value in its cache and adds to earlier entries (PlanIDs of a device in several plans) while it goes
 			RegisterCommandCode("getdevices", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetDevices(session, req, root); });
 			RegisterCommandCode("gethardware", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetHardware(session, req, root); });
 			RegisterCommandCode("events", [this](auto&& session, auto&& req, auto&& root) { Cmd_Events(session, req, root); });
@@ -496,7 +513,7 @@ namespace http
 			RegisterCommandCode("createvirtualsensor", [this](auto&& session, auto&& req, auto&& root) { Cmd_CreateMappedSensor(session, req, root); });
 			RegisterCommandCode("createdevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_CreateDevice(session, req, root); });
 
-			RegisterCommandCode("getscenelog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetSceneLog(session, req, root); });
+			RegisterStreamingCommandCode("getscenelog", [this](auto&& session, auto&& req, auto&& writer) { Cmd_GetSceneLog(session, req, writer); });
 			RegisterCommandCode("getscenes", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetScenes(session, req, root); });
 			RegisterCommandCode("addscene", [this](auto&& session, auto&& req, auto&& root) { Cmd_AddScene(session, req, root); });
 			RegisterCommandCode("deletescene", [this](auto&& session, auto&& req, auto&& root) { Cmd_DeleteScene(session, req, root); });
@@ -510,8 +527,8 @@ namespace http
 			RegisterCommandCode("getsetpointtimers", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetSetpointTimers(session, req, root); });
 			RegisterCommandCode("getplans", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetPlans(session, req, root); });
 			RegisterCommandCode("getfloorplans", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetFloorPlans(session, req, root); });
-			RegisterCommandCode("getlightlog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetLightLog(session, req, root); });
-			RegisterCommandCode("gettextlog", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetTextLog(session, req, root); });
+			RegisterStreamingCommandCode("getlightlog", [this](auto&& session, auto&& req, auto&& writer) { Cmd_GetLightLog(session, req, writer); });
+			RegisterStreamingCommandCode("gettextlog", [this](auto&& session, auto&& req, auto&& writer) { Cmd_GetTextLog(session, req, writer); });
 			RegisterCommandCode("gettransfers", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetTransfers(session, req, root); });
 			RegisterCommandCode("dotransferdevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_DoTransferDevice(session, req, root); });
 			RegisterCommandCode("createrflinkdevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_CreateRFLinkDevice(session, req, root); });
@@ -519,6 +536,8 @@ namespace http
 			RegisterCommandCode("bindevohome", [this](auto&& session, auto&& req, auto&& root) { Cmd_BindEvohome(session, req, root); });
 			RegisterCommandCode("custom_light_icons", [this](auto&& session, auto&& req, auto&& root) { Cmd_CustomLightIcons(session, req, root); });
 			RegisterCommandCode("deletedevice", [this](auto&& session, auto&& req, auto&& root) { Cmd_DeleteDevice(session, req, root); });
+			// graph is not streamed: several sensor types set members of the reply (such as delivered) only after their result, and GroupBy
+			// appends to a result that is continued afterwards, so the reply is not written in document order
 			RegisterCommandCode("graph", [this](auto&& session, auto&& req, auto&& root) { Cmd_HandleGraph(session, req, root); });
 			RegisterCommandCode("rclientslog", [this](auto&& session, auto&& req, auto&& root) { Cmd_RemoteWebClientsLog(session, req, root); });
 			RegisterCommandCode("setused", [this](auto&& session, auto&& req, auto&& root) { Cmd_SetUsed(session, req, root); });
@@ -614,7 +633,7 @@ namespace http
 			//Whitelist
 			m_pWebEm->RegisterWhitelistURLString("/images/floorplans/plan");
 
-			_log.Debug(DEBUG_WEBSERVER, "WebServer(%s) started with %d Registered Commands", m_server_alias.c_str(), (int)m_webcommands.size());
+			_log.Debug(DEBUG_WEBSERVER, "WebServer(%s) started with %d Registered Commands", m_server_alias.c_str(), (int)(m_webcommands.size() + m_webstreamcommands.size()));
 			m_pWebEm->DebugRegistrations();
 
 			// Start normal worker thread
@@ -640,6 +659,8 @@ namespace http
 				}
 				delete m_pWebEm;
 				m_pWebEm = nullptr;
+				// write the renewed sessions
+				g_sessionCache.Flush();
 			}
 			catch (...)
 			{
@@ -686,13 +707,25 @@ namespace http
 				_log.Debug(DEBUG_WEBSERVER, "CWebServer::RegisterCommandCode :%s already registered", idname);
 				return;
 			}
-			m_webcommands.insert(std::pair<std::string, webserver_response_function>(std::string(idname), ResponseFunction));
+			_tWebCommand command{ ResponseFunction, m_latencystats.Get(CLatencyStats::STAGE_WEB_COMMAND, idname) };
+			m_webcommands.insert(std::pair<std::string, _tWebCommand>(std::string(idname), command));
 			if (bypassAuthentication)
 			{
 				m_pWebEm->RegisterWhitelistCommandsString(idname);
 			}
 		}
 
+		void CWebServer::RegisterStreamingCommandCode(const char* idname, const webserver_stream_function& StreamFunction)
+		{
+			if ((m_webcommands.find(idname) != m_webcommands.end()) || (m_webstreamcommands.find(idname) != m_webstreamcommands.end()))
+			{
+				_log.Debug(DEBUG_WEBSERVER, "CWebServer::RegisterStreamingCommandCode :%s already registered", idname);
+				return;
+			}
+			_tWebStreamCommand command{ StreamFunction, m_latencystats.Get(CLatencyStats::STAGE_WEB_COMMAND, idname) };
+			m_webstreamcommands.insert(std::pair<std::string, _tWebStreamCommand>(std::string(idname), command));
+		}
+
 		bool CWebServer::IsIdxForUser(const WebEmSession* pSession, const int Idx)
 		{
 			if (pSession->rights == 2)
@@ -928,7 +961,7 @@ namespace http
 
 			// Get All Hardware ID's/Names, need them later
 			std::map<int, _tHardwareListInt> _hardwareNames;
-			result = m_sql.safe_query("SELECT ID, Name, Enabled, Type, Mode1, Mode2 FROM Hardware");
+			result = m_sql.safe_query_read("SELECT ID, Name, Enabled, Type, Mode1, Mode2 FROM Hardware");
 			if (!result.empty())
 			{
 				for (const auto& sd : result)
@@ -1024,7 +1057,7 @@ namespace http
 						}
 						if (!bSkipSelectedDevices)
 						{
-							result = m_sql.safe_query("SELECT COUNT(*) FROM SharedDevices WHERE (SharedUserID == %lu)", m_users[iUser].ID);
+							result = m_sql.safe_query_read("SELECT COUNT(*) FROM SharedDevices WHERE (SharedUserID == %lu)", m_users[iUser].ID);
 							if (!result.empty())
 							{
 								totUserDevices = (unsigned int)std::stoi(result[0][0]);
@@ -1045,20 +1078,20 @@ namespace http
 				{
 					// add scenes
 					if (!rowid.empty())
-						result = m_sql.safe_query("SELECT A.ID, A.Name, A.nValue, A.LastUpdate, A.Favorite, A.SceneType,"
+						result = m_sql.safe_query_read("SELECT A.ID, A.Name, A.nValue, A.LastUpdate, A.Favorite, A.SceneType,"
 							" A.Protected, B.XOffset, B.YOffset, B.PlanID, A.Description"
 							" FROM Scenes as A"
 							" LEFT OUTER JOIN DeviceToPlansMap as B ON (B.DeviceRowID==a.ID) AND (B.DevSceneType==1)"
 							" WHERE (A.ID=='%q')",
 							rowid.c_str());
 					else if ((!planID.empty()) && (planID != "0"))
-						result = m_sql.safe_query("SELECT A.ID, A.Name, A.nValue, A.LastUpdate, A.Favorite, A.SceneType,"
+						result = m_sql.safe_query_read("SELECT A.ID, A.Name, A.nValue, A.LastUpdate, A.Favorite, A.SceneType,"
 							" A.Protected, B.XOffset, B.YOffset, B.PlanID, A.Description"
 							" FROM Scenes as A, DeviceToPlansMap as B WHERE (B.PlanID=='%q')"
 							" AND (B.DeviceRowID==a.ID) AND (B.DevSceneType==1) ORDER BY B.[Order]",
 							planID.c_str());
 					else if ((!floorID.empty()) && (floorID != "0"))
-						result = m_sql.safe_query("SELECT A.ID, A.Name, A.nValue, A.LastUpdate, A.Favorite, A.SceneType,"
+						result = m_sql.safe_query_read("SELECT A.ID, A.Name, A.nValue, A.LastUpdate, A.Favorite, A.SceneType,"
 							" A.Protected, B.XOffset, B.YOffset, B.PlanID, A.Description"
 							" FROM Scenes as A, DeviceToPlansMap as B, Plans as C"
 							" WHERE (C.FloorplanID=='%q') AND (C.ID==B.PlanID) AND (B.DeviceRowID==a.ID)"
@@ -1072,7 +1105,7 @@ namespace http
 							" LEFT OUTER JOIN DeviceToPlansMap as B ON (B.DeviceRowID==a.ID) AND (B.DevSceneType==1)"
 							" ORDER BY ");
 						szQuery += szOrderBy;
-						result = m_sql.safe_query(szQuery.c_str(), order.c_str());
+						result = m_sql.safe_query_read(szQuery.c_str(), order.c_str());
 					}
 
 					if (!result.empty())
@@ -1174,7 +1207,7 @@ namespace http
 				if (!rowid.empty())
 				{
 					//_log.Log(LOG_STATUS, "Getting device with id: %s", rowid.c_str());
-					result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used, A.Type, A.SubType,"
+					result = m_sql.safe_query_read("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used, A.Type, A.SubType,"
 						" A.SignalLevel, A.BatteryLevel, A.nValue, A.sValue,"
 						" A.LastUpdate, A.Favorite, A.SwitchType, A.HardwareID,"
 						" A.AddjValue, A.AddjMulti, A.AddjValue2, A.AddjMulti2,"
@@ -1186,7 +1219,7 @@ namespace http
 						rowid.c_str());
 				}
 				else if ((!planID.empty()) && (planID != "0"))
-					result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
+					result = m_sql.safe_query_read("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
 						" A.Type, A.SubType, A.SignalLevel, A.BatteryLevel,"
 						" A.nValue, A.sValue, A.LastUpdate, A.Favorite,"
 						" A.SwitchType, A.HardwareID, A.AddjValue,"
@@ -1200,7 +1233,7 @@ namespace http
 						" AND (B.DevSceneType==0) ORDER BY B.[Order]",
 						planID.c_str());
 				else if ((!floorID.empty()) && (floorID != "0"))
-					result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
+					result = m_sql.safe_query_read("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
 						" A.Type, A.SubType, A.SignalLevel, A.BatteryLevel,"
 						" A.nValue, A.sValue, A.LastUpdate, A.Favorite,"
 						" A.SwitchType, A.HardwareID, A.AddjValue,"
@@ -1220,11 +1253,11 @@ namespace http
 					if (!bDisplayHidden)
 					{
 						// Build a list of Hidden Devices
-						result = m_sql.safe_query("SELECT ID FROM Plans WHERE (Name=='$Hidden Devices')");
+						result = m_sql.safe_query_read("SELECT ID FROM Plans WHERE (Name=='$Hidden Devices')");
 						if (!result.empty())
 						{
 							std::string pID = result[0][0];
-							result = m_sql.safe_query("SELECT DeviceRowID FROM DeviceToPlansMap WHERE (PlanID=='%q') AND (DevSceneType==0)", pID.c_str());
+							result = m_sql.safe_query_read("SELECT DeviceRowID FROM DeviceToPlansMap WHERE (PlanID=='%q') AND (DevSceneType==0)", pID.c_str());
 							if (!result.empty())
 							{
 								for (const auto& r : result)
@@ -1257,7 +1290,7 @@ namespace http
 							"WHERE (A.HardwareID == %q) "
 							"ORDER BY ");
 						szQuery += szOrderBy;
-						result = m_sql.safe_query(szQuery.c_str(), hardwareid.c_str(), order.c_str());
+						result = m_sql.safe_query_read(szQuery.c_str(), hardwareid.c_str(), order.c_str());
 					}
 					else
 					{
@@ -1272,7 +1305,7 @@ namespace http
 							"ON (B.DeviceRowID==a.ID) AND (B.DevSceneType==0) "
 							"ORDER BY ");
 						szQuery += szOrderBy;
-						result = m_sql.safe_query(szQuery.c_str(), order.c_str());
+						result = m_sql.safe_query_read(szQuery.c_str(), order.c_str());
 					}
 				}
 			}
@@ -1286,7 +1319,7 @@ namespace http
 				if (!rowid.empty())
 				{
 					//_log.Log(LOG_STATUS, "Getting device with id: %s for user %lu", rowid.c_str(), m_users[iUser].ID);
-					result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
+					result = m_sql.safe_query_read("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
 						" A.Type, A.SubType, A.SignalLevel, A.BatteryLevel,"
 						" A.nValue, A.sValue, A.LastUpdate, B.Favorite,"
 						" A.SwitchType, A.HardwareID, A.AddjValue,"
@@ -1301,7 +1334,7 @@ namespace http
 						m_users[iUser].ID, rowid.c_str());
 				}
 				else if ((!planID.empty()) && (planID != "0"))
-					result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
+					result = m_sql.safe_query_read("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
 						" A.Type, A.SubType, A.SignalLevel, A.BatteryLevel,"
 						" A.nValue, A.sValue, A.LastUpdate, B.Favorite,"
 						" A.SwitchType, A.HardwareID, A.AddjValue,"
@@ -1317,7 +1350,7 @@ namespace http
 						"AND (B.SharedUserID==%lu) ORDER BY C.[Order]",
 						planID.c_str(), m_users[iUser].ID);
 				else if ((!floorID.empty()) && (floorID != "0"))
-					result = m_sql.safe_query("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
+					result = m_sql.safe_query_read("SELECT A.ID, A.DeviceID, A.Unit, A.Name, A.Used,"
 						" A.Type, A.SubType, A.SignalLevel, A.BatteryLevel,"
 						" A.nValue, A.sValue, A.LastUpdate, B.Favorite,"
 						" A.SwitchType, A.HardwareID, A.AddjValue,"
@@ -1337,11 +1370,11 @@ namespace http
 					if (!bDisplayHidden)
 					{
 						// Build a list of Hidden Devices
-						result = m_sql.safe_query("SELECT ID FROM Plans WHERE (Name=='$Hidden Devices')");
+						result = m_sql.safe_query_read("SELECT ID FROM Plans WHERE (Name=='$Hidden Devices')");
 						if (!result.empty())
 						{
 							std::string pID = result[0][0];
-							result = m_sql.safe_query("SELECT DeviceRowID FROM DeviceToPlansMap WHERE (PlanID=='%q')  AND (DevSceneType==0)", pID.c_str());
+							result = m_sql.safe_query_read("SELECT DeviceRowID FROM DeviceToPlansMap WHERE (PlanID=='%q')  AND (DevSceneType==0)", pID.c_str());
 							if (!result.empty())
 							{
 								for (const auto& r : result)
@@ -1376,7 +1409,7 @@ namespace http
 						"WHERE (B.DeviceRowID==A.ID)"
 						" AND (B.SharedUserID==%lu) ORDER BY ");
 					szQuery += szOrderBy;
-					result = m_sql.safe_query(szQuery.c_str(), m_users[iUser].ID, order.c_str());
+					result = m_sql.safe_query_read(szQuery.c_str(), m_users[iUser].ID, order.c_str());
 				}
 			}
 
@@ -1536,6 +1569,15 @@ namespace http
 						}
 					}
 
+					CDomoticzHardwareBase* pHardware = m_mainworker.GetHardware(hardwareID);
+
+					std::string szJsonSignature = GetDeviceJsonSignature(sd, sDeviceName, bHaveTimeout, pHardware, now);
+					if ((!szJsonSignature.empty()) && (GetCachedDeviceJson(thisIdx, szJsonSignature, root["result"][ii])))
+					{
+						ii++;
+						continue;
+					}
+
 					root["result"][ii]["HardwareID"] = hardwareID;
 					if (_hardwareNames.find(hardwareID) == _hardwareNames.end())
 					{
@@ -1554,7 +1596,6 @@ namespace http
 					root["result"][ii]["idx"] = sd[0];
 					root["result"][ii]["Protected"] = (iProtected != 0);
 
-					CDomoticzHardwareBase* pHardware = m_mainworker.GetHardware(hardwareID);
 					if (pHardware != nullptr)
 					{
 						if (pHardware->HwdType == HTYPE_SolarEdgeAPI)
@@ -1823,7 +1864,7 @@ namespace http
 
 						bool bIsSubDevice = false;
 						std::vector<std::vector<std::string>> resultSD;
-						resultSD = m_sql.safe_query("SELECT ID FROM LightSubDevices WHERE (DeviceRowID=='%q')", sd[0].c_str());
+						resultSD = m_sql.safe_query_read("SELECT ID FROM LightSubDevices WHERE (DeviceRowID=='%q')", sd[0].c_str());
 						bIsSubDevice = (!resultSD.empty());
 
 						root["result"][ii]["IsSubDevice"] = bIsSubDevice;
@@ -2188,12 +2229,8 @@ namespace http
 						root["result"][ii]["Data"] = szData;
 						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
 
-						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-						if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-						{
-							tstate = m_mainworker.m_trend_calculator[tID].m_state;
-						}
+						_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 						root["result"][ii]["trend"] = (int)tstate;
 					}
 					else if (dType == pTypeThermostat1)
@@ -2217,12 +2254,8 @@ namespace http
 						root["result"][ii]["Data"] = szData;
 						root["result"][ii]["TypeImg"] = "temperature";
 						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
-						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-						if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-						{
-							tstate = m_mainworker.m_trend_calculator[tID].m_state;
-						}
+						_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 						root["result"][ii]["trend"] = (int)tstate;
 					}
 					else if (dType == pTypeHUM)
@@ -2255,12 +2288,8 @@ namespace http
 							sprintf(szTmp, "%.2f", ConvertTemperature(CalculateDewPoint(tempCelcius, round(humidity)), tempsign));
 							root["result"][ii]["DewPoint"] = szTmp;
 
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 					}
@@ -2303,12 +2332,8 @@ namespace http
 							root["result"][ii]["Data"] = szData;
 							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
 
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 					}
@@ -2329,12 +2354,8 @@ namespace http
 							root["result"][ii]["Data"] = szData;
 							root["result"][ii]["HaveTimeout"] = bHaveTimeout;
 
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 					}
@@ -2353,12 +2374,8 @@ namespace http
 								root["result"][ii]["Temp"] = tvalue;
 								sprintf(szData, "%.1f UVI, %.1f&deg; %c", UVI, tvalue, tempsign);
 
-								_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 								uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-								if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-								{
-									tstate = m_mainworker.m_trend_calculator[tID].m_state;
-								}
+								_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 								root["result"][ii]["trend"] = (int)tstate;
 							}
 							else
@@ -2417,12 +2434,8 @@ namespace http
 								double tvalue = ConvertTemperature(atof(strarray[5].c_str()), tempsign);
 								root["result"][ii]["Chill"] = tvalue;
 
-								_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 								uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-								if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-								{
-									tstate = m_mainworker.m_trend_calculator[tID].m_state;
-								}
+								_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 								root["result"][ii]["trend"] = (int)tstate;
 							}
 							root["result"][ii]["Data"] = sValue;
@@ -2446,12 +2459,12 @@ namespace http
 
 							if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 							{
-								result2 = m_sql.safe_query("SELECT Total, Rate FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY ROWID DESC LIMIT 1",
+								result2 = m_sql.safe_query_read("SELECT Total, Rate FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY ROWID DESC LIMIT 1",
 									sd[0].c_str(), szDate);
 							}
 							else
 							{
-								result2 = m_sql.safe_query("SELECT MIN(Total), MAX(Total) FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+								result2 = m_sql.safe_query_read("SELECT MIN(Total), MAX(Total) FROM Rain WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
 							}
 
 							if (!result2.empty())
@@ -2517,7 +2530,7 @@ namespace http
 
 						std::vector<std::vector<std::string>> result2;
 						strcpy(szTmp, "0");
-						result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
+						result2 = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
 						if (!result2.empty())
 						{
 							std::vector<std::string> sd2 = result2[0];
@@ -2625,7 +2638,7 @@ namespace http
 
 						std::vector<std::vector<std::string>> result2;
 						strcpy(szTmp, "0");
-						result2 = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+						result2 = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
 						if (!result2.empty())
 						{
 							std::vector<std::string> sd2 = result2[0];
@@ -2825,7 +2838,7 @@ namespace http
 
 							std::vector<std::vector<std::string>> result2;
 							strcpy(szTmp, "0");
-							result2 = m_sql.safe_query("SELECT MIN(Value1), MIN(Value2), MIN(Value5), MIN(Value6) FROM MultiMeter WHERE (DeviceRowID='%q' AND Date>='%q')",
+							result2 = m_sql.safe_query_read("SELECT MIN(Value1), MIN(Value2), MIN(Value5), MIN(Value6) FROM MultiMeter WHERE (DeviceRowID='%q' AND Date>='%q')",
 								sd[0].c_str(), szDate);
 							if (!result2.empty())
 							{
@@ -2877,7 +2890,7 @@ namespace http
 						float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
 
 						strcpy(szTmp, "0");
-						result2 = m_sql.safe_query("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+						result2 = m_sql.safe_query_read("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
 						if (!result2.empty())
 						{
 							std::vector<std::string> sd2 = result2[0];
@@ -3001,7 +3014,7 @@ namespace http
 							strcpy(szTmp, "0");
 							// get the first value of the day instead of the minimum value, because counter can also decrease
 							// result2 = m_sql.safe_query("SELECT MIN(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')",
-							result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
+							result2 = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
 							if (!result2.empty())
 							{
 								float divider = m_sql.GetCounterDivider(int(metertype), int(dType), float(AddjValue2));
@@ -3206,12 +3219,8 @@ namespace http
 								root["result"][ii]["Image"] = "Computer";
 							root["result"][ii]["TypeImg"] = "temperature";
 							root["result"][ii]["Type"] = "temperature";
-							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							_tTrendCalculator::_eTendencyType tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 						else if (dSubType == sTypePercentage)
@@ -3457,7 +3466,7 @@ namespace http
 
 							std::vector<std::vector<std::string>> result2;
 							strcpy(szTmp, "0");
-							result2 = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
+							result2 = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q') ORDER BY Date LIMIT 1", sd[0].c_str(), szDate);
 							if (!result2.empty())
 							{
 								std::vector<std::string> sd2 = result2[0];
@@ -3707,7 +3716,7 @@ namespace http
 
 							std::vector<std::vector<std::string>> result2;
 							strcpy(szTmp, "0");
-							result2 = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
+							result2 = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID='%q' AND Date>='%q')", sd[0].c_str(), szDate);
 							if (!result2.empty())
 							{
 								std::vector<std::string> sd2 = result2[0];
@@ -3739,6 +3748,8 @@ namespace http
 					}
 #endif
 					root["result"][ii]["Timers"] = (bHasTimers == true) ? "true" : "false";
+					if (!szJsonSignature.empty())
+						StoreCachedDeviceJson(thisIdx, szJsonSignature, root["result"][ii]);
 					ii++;
 				}
 				catch (const std::exception& e)
@@ -3749,38 +3760,88 @@ namespace http
 			}
 		}
 
+		std::string CWebServer::GetDeviceJsonSignature(const std::vector<std::string>& sd, const std::string& sDeviceName, const bool bHaveTimeout, CDomoticzHardwareBase* pHardware, const time_t now)
+		{
+			bool bNodeFailed = false;
+			if (pHardware != nullptr)
+			{
+#ifdef WITH_OPENZWAVE
+				if (pHardware->HwdType == HTYPE_OpenZWave)
+					return ""; // node state is not known here
+#endif
+#ifdef ENABLE_PYTHON
+				if (pHardware->HwdType == HTYPE_PythonPlugin)
+					bNodeFailed = ((Plugins::CPlugin*)pHardware)->HasNodeFailed(sd[1].c_str(), atoi(sd[2].c_str()));
+#endif
+			}
+			// The rendered device also depends on the time (timeouts, counters of today) and on other tables (hardware, timers,
+			// preferences, ...), it is rendered again at least every DEVICE_JSON_CACHE_SECONDS
+			std::string szSignature = std_format("%d;%d;%d;%" PRId64 ";", pHardware != nullptr, bHaveTimeout, bNodeFailed, static_cast<int64_t>(now / DEVICE_JSON_CACHE_SECONDS));
+			szSignature += sDeviceName;
+			for (const auto& field : sd)
+			{
+				szSignature += '\x1f';
+				szSignature += field;
+			}
+			return szSignature;
+		}
+
+		bool CWebServer::GetCachedDeviceJson(const std::string& idx, const std::string& szSignature, Json::Value& item)
+		{
+			std::lock_guard<std::mutex> l(m_device_json_mutex);
+			uint64_t generation = m_sql.GetConfigurationGeneration();
+			if (generation != m_device_json_generation)
+			{
+				m_device_json_cache.clear();
+				m_device_json_generation = generation;
+				return false;
+			}
+			auto itt = m_device_json_cache.find(idx);
+			if (itt == m_device_json_cache.end())
+				return false;
+			for (const auto& cached : itt->second)
+			{
+				if (cached.Signature == szSignature)
+				{
+					item = *cached.Item;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void CWebServer::StoreCachedDeviceJson(const std::string& idx, const std::string& szSignature, const Json::Value& item)
+		{
+			std::lock_guard<std::mutex> l(m_device_json_mutex);
+			if (m_sql.GetConfigurationGeneration() != m_device_json_generation)
+				return;
+			// a device can be shown in a few views at the same time (plans, users), keep the latest of them
+			auto& items = m_device_json_cache[idx];
+			if (items.size() >= DEVICE_JSON_CACHE_VIEWS)
+				items.erase(items.begin());
+			items.push_back({ szSignature, std::make_shared<Json::Value>(item) });
+		}
+
 		void CWebServer::MakeCompareDataSensor(Json::Value& root, const std::string& sgroupby, const std::string& dbasetable, uint64_t deviceidx, const std::string& dfield, const double divider, const bool isCounter)
 		{
-			std::string queryString;
-			queryString.append("SELECT strftime('%Y', Date) as y,");
-			if ((sgroupby == "month") || (sgroupby == "year"))
-				queryString.append("strftime('%m', Date) as m");
-			else if (sgroupby == "quarter")
-				queryString.append("case when cast(strftime('%m', Date) as integer) between 1 and 3 then 'Q1' when cast(strftime('%m', Date) as integer) between 4 and 6 then 'Q2' when cast(strftime('%m', Date) as integer) between 7 and 9 then 'Q3' else 'Q4' end as Q");
-
-			queryString.append(", ");
-			if (!isCounter)
-				queryString.append("AVG(" + dfield + ")");
-			else
-				queryString.append("SUM(" + dfield + ")");
-			queryString.append("/" + std::to_string(divider));
-			queryString.append(" as s FROM " + dbasetable + " WHERE DeviceRowID == " + std::to_string(deviceidx) + " GROUP BY strftime('%Y', Date), ");
-			if ((sgroupby == "month") || (sgroupby == "year"))
-				queryString.append("strftime('%m', Date)");
-			else if (sgroupby == "quarter")
-				queryString.append("case when cast(strftime('%m', Date) as integer) between 1 and 3 then 'Q1' when cast(strftime('%m', Date) as integer) between 4 and 6 then 'Q2' when cast(strftime('%m', Date) as integer) between 7 and 9 then 'Q3' else 'Q4' end");
-			auto result = m_sql.unsafe_query(queryString.c_str());
+			CGraphRollups::_eGroupBy groupBy;
+			if (!CGraphRollups::GetGroupBy(sgroupby, groupBy))
+				return;
+			// the year comparison is made from the monthly values
+			std::vector<CGraphRollups::_tRollupItem> result;
+			if (!m_sql.m_graphrollups.GetColumnTotals(m_sql, dbasetable, deviceidx, dfield, isCounter, (groupBy == CGraphRollups::GB_QUARTER) ? groupBy : CGraphRollups::GB_MONTH, result))
+				return;
 
 			int firstYearCounting = 0;
 			double yearSumPrevious[12] = { 0 };
 			int yearPrevious[12] = { 0 };
 
-			for (const auto& sd : result)
+			for (const auto& item : result)
 			{
-				const int year = atoi(sd[0].c_str());
-				const double value = atof(sd[2].c_str());
+				const int year = item.Year;
+				const double value = item.Value / divider;
 
-				const int previousIndex = sgroupby == "year" ? 0 : sgroupby == "quarter" ? sd[1][1] - '0' - 1 : atoi(sd[1].c_str()) - 1;
+				const int previousIndex = (groupBy == CGraphRollups::GB_YEAR) ? 0 : item.Category - 1;
 				const double* sumPrevious = year - 1 != yearPrevious[previousIndex] ? NULL : &yearSumPrevious[previousIndex];
 				const char* trend = !sumPrevious ? "" : *sumPrevious < value ? "up" : *sumPrevious > value ? "down" : "equal";
 				const int ii = root["result"].size();
@@ -3790,7 +3851,12 @@ namespace http
 				}
 
 				root["result"][ii]["y"] = year;
-				root["result"][ii]["c"] = (sgroupby == "year") ? sd[0] : sd[1];
+				if (groupBy == CGraphRollups::GB_YEAR)
+					root["result"][ii]["c"] = std::to_string(year);
+				else if (groupBy == CGraphRollups::GB_QUARTER)
+					root["result"][ii]["c"] = std_format("Q%d", item.Category);
+				else
+					root["result"][ii]["c"] = std_format("%02d", item.Category);
 				root["result"][ii]["s"] = value;
 				root["result"][ii]["t"] = trend;
 				yearSumPrevious[previousIndex] = value;
@@ -3808,8 +3874,7 @@ namespace http
 			std::function<std::string(std::string)> value, std::function<std::string(double)> sumToResult)
 		{
 			/*
-			 * This query selects all records (in mc0) that belong to DeviceRowID, each with the record before it (in mc1), and calculates for each record
-			 * the "usage" by subtracting the previous counter from its counter.
+			 * The "usage" of each day is its counter minus the counter of the day before it, see CGraphRollups::GetCounterUsage.
 			 * - It does not take into account records that have a 0-valued counter, to prevent one falling between two categories, which would cause the
 			 *   value for one category to be extremely low and the value for the other extremely high.
 			 * - When the previous counter is greater than its counter, assumed is that a meter change has taken place; the previous counter is ignored
@@ -3817,114 +3882,24 @@ namespace http
 			 * - The reason why not simply the record values are summed, but instead the differences between all the individual counters are summed, is that
 			 *   records for some days are not recorded or sometimes disappear, hence values would be missing and that would result in an incomplete total.
 			 *   Plus it seems that the value is not always the same as the difference between the counters. Counters are more often reliable.
+			 * If bUseValuesOrCounter is true and there are no Counter values in the table, the values are summed instead.
 			 */
-			std::string queryString;
-			std::vector<std::vector<std::string>> result;
-			bool bUseValues = false;
-
-			/* if bUseValuesOrCounter is true, then find out if there are any Counter values in the table, if not: use Value instead of Counter */
-			if (bUseValuesOrCounter)
-			{
-				queryString = "select count(*) from " + dbasetable + " where DeviceRowID = " + std::to_string(idx) + " and " + counter("") + " != 0 ";
-				result = m_sql.safe_query(queryString.c_str(), idx, idx, idx, idx, idx);
-				if (atoi(result[0][0].c_str()) == 0)
-				{
-					bUseValues = true;
-				}
-			}
-
-			/* get the data */
-			queryString = "";
-			queryString.append(" select");
-			queryString.append("  strftime('%%Y',Date) as Year,");
-
-			if (!bUseValues)
-			{
-				queryString.append("  sum(Difference) as Sum");
-			}
-			else
-			{
-				queryString.append("  sum(Value) as Sum");
-			}
-
-			if (sgroupby == "quarter")
-			{
-				queryString.append(",case");
-				queryString.append("   when cast(strftime('%%m',Date) as integer) between 1 and 3 then 'Q1'");
-				queryString.append("   when cast(strftime('%%m',Date) as integer) between 4 and 6 then 'Q2'");
-				queryString.append("   when cast(strftime('%%m',Date) as integer) between 7 and 9 then 'Q3'");
-				queryString.append("                                                              else 'Q4'");
-				queryString.append("   end as Quarter");
-			}
-			else if (sgroupby == "month")
-			{
-				queryString.append(",strftime('%%m',Date) as Month");
-			}
-
-			if (!bUseValues)
-			{
-				queryString.append(" from (");
-				queryString.append(" 	select");
-				queryString.append("         mc0.DeviceRowID,");
-				queryString.append("         date(mc0.Date) as Date,");
-				queryString.append("         case");
-				queryString.append("            when (" + counter("mc1") + ") <= (" + counter("mc0") + ")");
-				queryString.append("            then (" + counter("mc0") + ") - (" + counter("mc1") + ")");
-				queryString.append("            else (" + value("mc0") + ")");
-				queryString.append("         end as Difference");
-				queryString.append(" 	from " + dbasetable + " mc0");
-				queryString.append(" 	inner join " + dbasetable + " mc1 on mc1.DeviceRowID = mc0.DeviceRowID");
-				queryString.append("         and mc1.Date = (");
-				queryString.append("             select max(mcm.Date)");
-				queryString.append("             from " + dbasetable + " mcm");
-				queryString.append("             where mcm.DeviceRowID = mc0.DeviceRowID and mcm.Date < mc0.Date and (" + counter("mcm") + ") > 0");
-				queryString.append("         )");
-				queryString.append(" 	where");
-				queryString.append("         mc0.DeviceRowID = %" PRIu64 "");
-				queryString.append("         and (" + counter("mc0") + ") > 0");
-				queryString.append("         and (select min(Date) from " + dbasetable + " where DeviceRowID = %" PRIu64 " and (" + counter("") + ") > 0) <= mc1.Date");
-				queryString.append("         and mc0.Date <= (select max(Date) from " + dbasetable + " where DeviceRowID = %" PRIu64 " and (" + counter("") + ") > 0)");
-				queryString.append("    union all");
-				queryString.append("    select");
-				queryString.append("         DeviceRowID,");
-				queryString.append("         date(Date) as Date,");
-				queryString.append("         " + value(""));
-			}
-
-			queryString.append(" 	from " + dbasetable);
-			queryString.append(" 	where");
-			queryString.append("         DeviceRowID = %" PRIu64 "");
-			if (!bUseValues)
-			{
-				queryString.append("         and (select min(Date) from " + dbasetable + " where DeviceRowID = %" PRIu64 " and (" + counter("") + ") > 0) = Date");
-				queryString.append(" )");
-			}
-			
-			queryString.append(" group by strftime('%%Y',Date)");
-			if (sgroupby == "quarter")
-			{
-				queryString.append(",case");
-				queryString.append("   when cast(strftime('%%m',Date) as integer) between 1 and 3 then 'Q1'");
-				queryString.append("   when cast(strftime('%%m',Date) as integer) between 4 and 6 then 'Q2'");
-				queryString.append("   when cast(strftime('%%m',Date) as integer) between 7 and 9 then 'Q3'");
-				queryString.append("                                                              else 'Q4'");
-				queryString.append("   end");
-			}
-			else if (sgroupby == "month")
-			{
-				queryString.append(",strftime('%%m',Date)");
-			}
-			result = m_sql.safe_query(queryString.c_str(), idx, idx, idx, idx, idx);
+			CGraphRollups::_eGroupBy groupBy;
+			if (!CGraphRollups::GetGroupBy(sgroupby, groupBy))
+				return;
+			std::vector<CGraphRollups::_tRollupItem> result;
+			if (!m_sql.m_graphrollups.GetCounterUsage(m_sql, dbasetable, idx, counter(""), value(""), bUseValuesOrCounter, groupBy, result))
+				return;
 			if (!result.empty())
 			{
 				int firstYearCounting = 0;
-				double yearSumPrevious[12];
-				int yearPrevious[12];
-				for (const auto& sd : result)
+				double yearSumPrevious[12] = { 0 };
+				int yearPrevious[12] = { 0 };
+				for (const auto& item : result)
 				{
-					const int year = atoi(sd[0].c_str());
-					const double fsum = atof(sd[1].c_str());
-					const int previousIndex = sgroupby == "year" ? 0 : sgroupby == "quarter" ? sd[2][1] - '0' - 1 : atoi(sd[2].c_str()) - 1;
+					const int year = item.Year;
+					const double fsum = item.Value;
+					const int previousIndex = (groupBy == CGraphRollups::GB_YEAR) ? 0 : item.Category - 1;
 					const double* sumPrevious = year - 1 != yearPrevious[previousIndex] ? NULL : &yearSumPrevious[previousIndex];
 					const char* trend = !sumPrevious ? "" : *sumPrevious < fsum ? "up" : *sumPrevious > fsum ? "down" : "equal";
 					const int ii = root["result"].size();
@@ -3932,8 +3907,13 @@ namespace http
 					{
 						firstYearCounting = year;
 					}
-					root["result"][ii]["y"] = sd[0];
-					root["result"][ii]["c"] = sgroupby == "year" ? sd[0] : sd[2];
+					root["result"][ii]["y"] = std::to_string(year);
+					if (groupBy == CGraphRollups::GB_YEAR)
+						root["result"][ii]["c"] = std::to_string(year);
+					else if (groupBy == CGraphRollups::GB_QUARTER)
+						root["result"][ii]["c"] = std_format("Q%d", item.Category);
+					else
+						root["result"][ii]["c"] = std_format("%02d", item.Category);
 					root["result"][ii]["s"] = sumToResult(fsum);
 					root["result"][ii]["t"] = trend;
 					yearSumPrevious[previousIndex] = fsum;
@@ -4098,6 +4078,9 @@ namespace http
 			Json::Value root;
 			root["status"] = "ERR";
 
+			// the reply is written (and compressed) while it is serialized
+			const bool bAllowGZip = (m_pWebEm->m_gzipmode == WWW_USE_GZIP) && CJSonStreamWriter::AcceptsGZip(req);
+
 			std::string rtype = request::findValue(&req, "type");
 			if (rtype == "command")
 			{
@@ -4106,10 +4089,18 @@ namespace http
 				{
 					_log.Debug(DEBUG_WEBSERVER, "CWebServer::GetJSonPage :%s :%s ", cparam.c_str(), req.uri.c_str());
 
+					auto ps = m_webstreamcommands.find(cparam);
+					if (ps != m_webstreamcommands.end())
+					{
+						CLatencyTimer latencyTimer(ps->second.pLatency);
+						StreamCommand(ps->second.Function, session, req, rep, bAllowGZip);
+						return;
+					}
 					auto pf = m_webcommands.find(cparam);
 					if (pf != m_webcommands.end())
 					{
-						pf->second(session, req, root);
+						CLatencyTimer latencyTimer(pf->second.pLatency);
+						pf->second.Function(session, req, root);
 					}
 					else
 					{	// See if we still have a Param based version not converted to a proper command
@@ -4214,11 +4205,18 @@ namespace http
 
 				if (!altrtype.empty())
 				{
+					auto ps = m_webstreamcommands.find(altrtype);
+					if (ps != m_webstreamcommands.end())
+					{
+						_log.Log(LOG_NORM, "[WebServer] Deprecated RType (%s) for API request. Handled via fallback (%s), please use correct API Command! (%s)", rtype.c_str(), altrtype.c_str(), req.host_remote_address.c_str());
+						StreamCommand(ps->second.Function, session, req, rep, bAllowGZip);
+						return;
+					}
 					auto pf = m_webcommands.find(altrtype);
 					if (pf != m_webcommands.end())
 					{
 						_log.Log(LOG_NORM, "[WebServer] Deprecated RType (%s) for API request. Handled via fallback (%s), please use correct API Command! (%s)", rtype.c_str(), altrtype.c_str(), req.host_remote_address.c_str());
-						pf->second(session, req, root);
+						pf->second.Function(session, req, root);
 					}
 				}
 				else
@@ -4228,7 +4226,22 @@ namespace http
 
 			}
 
-			reply::set_content(&rep, root.toStyledString());
+			CJSonStreamWriter writer(rep, bAllowGZip);
+			writer.Value(root);
+			writer.Finish();
+		}
+
+		void CWebServer::StreamCommand(const webserver_stream_function& StreamFunction, WebEmSession& session, const request& req, reply& rep, const bool bAllowGZip)
+		{
+			CJSonStreamWriter writer(rep, bAllowGZip);
+			StreamFunction(session, req, writer);
+			if (writer.IsEmpty())
+			{
+				writer.StartObject();
+				writer.Member("status", "ERR");
+				writer.EndObject();
+			}
+			writer.Finish();
 		}
 
 		void CWebServer::UploadFloorplanImage(WebEmSession& session, const request& req, std::string& redirect_uri)
@@ -4320,6 +4333,21 @@ namespace http
 			reply::add_header_attachment(&rep, oname);
 		}
 
+		void CWebServer::GetMetrics(WebEmSession& session, const request& req, reply& rep)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			std::string szMetrics = m_latencystats.GetPrometheusText();
+			szMetrics += "# HELP domoticz_log_dropped_lines_total Log lines not written to the log file because it could not keep up\n";
+			szMetrics += "# TYPE domoticz_log_dropped_lines_total counter\n";
+			szMetrics += "domoticz_log_dropped_lines_total " + std::to_string(_log.GetDroppedLines()) + "\n";
+			reply::set_content(&rep, szMetrics);
+			reply::add_header_content_type(&rep, "text/plain; version=0.0.4");
+		}
+
 		void CWebServer::GetDatabaseBackup(WebEmSession& session, const request& req, reply& rep)
 		{
 			if (session.rights != 2)
@@ -4383,35 +4411,17 @@ namespace http
 		WebEmStoredSession CWebServer::GetSession(const std::string& sessionId)
 		{
 			_log.Debug(DEBUG_AUTH, "SessionStore : get...(%s)", sessionId.c_str());
-			WebEmStoredSession session;
 
 			if (sessionId.empty())
 			{
 				_log.Log(LOG_ERROR, "SessionStore : cannot get session without id.");
+				return WebEmStoredSession();
 			}
-			else
+			WebEmStoredSession session = g_sessionCache.GetSession(sessionId);
+			if (session.id.empty())
 			{
-				std::vector<std::vector<std::string>> result;
-				result = m_sql.safe_query("SELECT SessionID, Username, AuthToken, ExpirationDate FROM UserSessions WHERE SessionID = '%q'", sessionId.c_str());
-				if (!result.empty())
-				{
-					session.id = result[0][0];
-					session.username = base64_decode(result[0][1]);
-					session.auth_token = result[0][2];
-
-					std::string sExpirationDate = result[0][3];
-					// time_t now = mytime(NULL);
-					struct tm tExpirationDate;
-					ParseSQLdatetime(session.expires, tExpirationDate, sExpirationDate);
-					// RemoteHost is not used to restore the session
-					// LastUpdate is not used to restore the session
-				}
-				else
-				{
-					_log.Debug(DEBUG_AUTH, "SessionStore : session not Found! (%s)", sessionId.c_str());
-				}
+				_log.Debug(DEBUG_AUTH, "SessionStore : session not Found! (%s)", sessionId.c_str());
 			}
-
 			return session;
 		}
 
@@ -4427,26 +4437,10 @@ namespace http
 				return;
 			}
 
-			char szExpires[30];
-			struct tm ltime;
-			localtime_r(&session.expires, &ltime);
-			strftime(szExpires, sizeof(szExpires), "%Y-%m-%d %H:%M:%S", &ltime);
-
-			std::string remote_host = (session.remote_host.size() <= 50) ? // IPv4 : 15, IPv6 : (39|45)
-				session.remote_host
-				: session.remote_host.substr(0, 50);
-
-			WebEmStoredSession storedSession = GetSession(session.id);
-			if (storedSession.id.empty())
-			{
-				m_sql.safe_query("INSERT INTO UserSessions (SessionID, Username, AuthToken, ExpirationDate, RemoteHost) VALUES ('%q', '%q', '%q', '%q', '%q')", session.id.c_str(),
-					base64_encode(session.username).c_str(), session.auth_token.c_str(), szExpires, remote_host.c_str());
-			}
-			else
-			{
-				m_sql.safe_query("UPDATE UserSessions set AuthToken = '%q', ExpirationDate = '%q', RemoteHost = '%q', LastUpdate = datetime('now', 'localtime') WHERE SessionID = '%q'",
-					session.auth_token.c_str(), szExpires, remote_host.c_str(), session.id.c_str());
-			}
+			WebEmStoredSession storedSession = session;
+			if (storedSession.remote_host.size() > 50) // IPv4 : 15, IPv6 : (39|45)
+				storedSession.remote_host = storedSession.remote_host.substr(0, 50);
+			g_sessionCache.StoreSession(storedSession);
 		}
 
 		/**
@@ -4459,16 +4453,16 @@ namespace http
 			{
 				return;
 			}
-			m_sql.safe_query("DELETE FROM UserSessions WHERE SessionID = '%q'", sessionId.c_str());
+			g_sessionCache.RemoveSession(sessionId);
 		}
 
 		/**
-		 * Remove all expired user sessions.
+		 * Remove all expired user sessions and write the renewed sessions.
 		 */
 		void CWebServer::CleanSessions()
 		{
 			_log.Debug(DEBUG_AUTH, "SessionStore : clean...");
-			m_sql.safe_query("DELETE FROM UserSessions WHERE ExpirationDate < datetime('now', 'localtime')");
+			g_sessionCache.CleanSessions();
 		}
 
 		/**
@@ -4478,7 +4472,7 @@ namespace http
 		void CWebServer::RemoveUsersSessions(const std::string& username, const WebEmSession& exceptSession)
 		{
 			_log.Debug(DEBUG_AUTH, "SessionStore : remove all sessions for User... (%s)", exceptSession.id.c_str());
-			m_sql.safe_query("DELETE FROM UserSessions WHERE (Username=='%q') and (SessionID!='%q')", username.c_str(), exceptSession.id.c_str());
+			g_sessionCache.RemoveUsersSessions(username, exceptSession.id);
 		}
 
 	} // namespace server
@@ -8,6 +8,8 @@
 
 struct lua_State;
 struct lua_Debug;
+class CDomoticzHardwareBase;
+class CLatencyHistogram;
 
 namespace Json
 {
@@ -17,10 +19,14 @@ namespace Json
 namespace http {
 	namespace server {
 		class cWebem;
+		class CJSonStreamWriter;
 		struct _tWebUserPassword;
 class CWebServer : public session_store, public std::enable_shared_from_this<CWebServer>
 {
 	typedef std::function<void(WebEmSession &session, const request &req, Json::Value &root)> webserver_response_function;
+	// Commands with large results write them directly to the reply, without a Json::Value tree
+	// (their query results are still read in full before anything is written)
+	typedef std::function<void(WebEmSession &session, const request &req, CJSonStreamWriter &writer)> webserver_stream_function;
 
       public:
 	struct _tCustomIcon
@@ -35,6 +41,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	bool StartServer(server_settings &settings, const std::string &serverpath, bool bIgnoreUsernamePassword);
 	void StopServer();
 	void RegisterCommandCode(const char *idname, const webserver_response_function &ResponseFunction, bool bypassAuthentication = false);
+	void RegisterStreamingCommandCode(const char *idname, const webserver_stream_function &StreamFunction);
 
 	void GetJSonPage(WebEmSession & session, const request& req, reply & rep);
 	void GetCameraSnapshot(WebEmSession & session, const request& req, reply & rep);
@@ -42,6 +49,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void GetFloorplanImage(WebEmSession& session, const request& req, reply& rep);
 	void GetServiceWorker(WebEmSession& session, const request& req, reply& rep);
 	void GetDatabaseBackup(WebEmSession & session, const request& req, reply & rep);
+	void GetMetrics(WebEmSession &session, const request &req, reply &rep);
 
 	void GetOauth2AuthCode(WebEmSession &session, const request &req, reply &rep);
 	void PostOauth2AccessToken(WebEmSession &session, const request &req, reply &rep);
@@ -94,6 +102,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 
 private:
 	bool HandleCommandParam(const std::string &cparam, WebEmSession & session, const request& req, Json::Value &root);
+	void StreamCommand(const webserver_stream_function &StreamFunction, WebEmSession &session, const request &req, reply &rep, bool bAllowGZip);
     void GroupBy(Json::Value &root, std::string dbasetable, uint64_t idx, std::string sgroupby, bool bUseValuesOrCounter, std::function<std::string (std::string)> counterExpr, std::function<std::string (std::string)> valueExpr, std::function<std::string (double)> sumToResult);
 	void MakeCompareDataSensor(Json::Value& root, const std::string &sgroupby, const std::string &dbasetable, uint64_t deviceidx, const std::string &dfield, const double divider = 1.0, const bool isCounter = false);
 	void AddTodayValueToResult(Json::Value &root, const std::string &sgroupby, const std::string &today, const double todayValue, const std::string &formatString);
@@ -175,6 +184,9 @@ private:
 	void Cmd_GetMyProfile(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_UpdateMyProfile(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_GetUptime(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetRxQueueStats(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetDBConnectionStats(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetLatencyStats(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetActualHistory(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetNewHistory(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetConfig(WebEmSession& session, const request& req, Json::Value& root);
@@ -248,6 +260,7 @@ private:
 	void Cmd_GetInfluxLinks(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_SaveInfluxLink(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_DeleteInfluxLink(WebEmSession& session, const request& req, Json::Value& root);
+	void Cmd_GetInfluxStats(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_SaveHttpLinkConfig(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetHttpLinkConfig(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetHttpLinks(WebEmSession & session, const request& req, Json::Value &root);
@@ -318,7 +331,7 @@ private:
 	void Cmd_GetSettings(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetDevices(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DeleteDevice(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetSceneLog(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetSceneLog(WebEmSession & session, const request& req, CJSonStreamWriter &writer);
 	void Cmd_GetScenes(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_AddScene(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DeleteScene(WebEmSession & session, const request& req, Json::Value &root);
@@ -333,8 +346,8 @@ private:
 	void Cmd_GetSetpointTimers(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetPlans(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetFloorPlans(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetLightLog(WebEmSession & session, const request& req, Json::Value &root);
-	void Cmd_GetTextLog(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetLightLog(WebEmSession & session, const request& req, CJSonStreamWriter &writer);
+	void Cmd_GetTextLog(WebEmSession & session, const request& req, CJSonStreamWriter &writer);
 	void Cmd_GetTransfers(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_DoTransferDevice(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_Events(WebEmSession & session, const request& req, Json::Value &root);
@@ -439,10 +452,35 @@ private:
     void Cmd_TellstickApplySettings(WebEmSession &session, const request &req, Json::Value &root);
 	std::shared_ptr<std::thread> m_thread;
 
-	std::map < std::string, webserver_response_function > m_webcommands;	//Commands
+	// the latency histogram of a command is looked up once, when it is registered
+	struct _tWebCommand
+	{
+		webserver_response_function Function;
+		CLatencyHistogram *pLatency;
+	};
+	struct _tWebStreamCommand
+	{
+		webserver_stream_function Function;
+		CLatencyHistogram *pLatency;
+	};
+	std::map < std::string, _tWebCommand > m_webcommands;	//Commands
+	std::map < std::string, _tWebStreamCommand > m_webstreamcommands;	//Streaming Commands
 	void Do_Work();
 	std::vector<_tCustomIcon> m_custom_light_icons;
 	std::map<int, int> m_custom_light_icons_lookup;
+
+	// Rendered devices of GetJSonDevices, an entry is reused as long as its signature (database row and other inputs) is the same
+	struct _tDeviceJsonCacheItem
+	{
+		std::string Signature;
+		std::shared_ptr<Json::Value> Item;
+	};
+	std::mutex m_device_json_mutex;
+	uint64_t m_device_json_generation = 0;
+	std::map<std::string, std::vector<_tDeviceJsonCacheItem>> m_device_json_cache;
+	std::string GetDeviceJsonSignature(const std::vector<std::string> &sd, const std::string &sDeviceName, bool bHaveTimeout, CDomoticzHardwareBase *pHardware, time_t now);
+	bool GetCachedDeviceJson(const std::string &idx, const std::string &szSignature, Json::Value &item);
+	void StoreCachedDeviceJson(const std::string &idx, const std::string &szSignature, const Json::Value &item);
 	bool m_bDoStop;
 	std::string m_server_alias;
 	uint8_t m_failcount;
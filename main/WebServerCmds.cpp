@@ -26,6 +26,8 @@
 #include "LuaHandler.h"
 #include "Logger.h"
 #include "SQLHelper.h"
+#include "LatencyStats.h"
+#include "../webserver/JSonStreamWriter.h"
 #include "../httpclient/HTTPClient.h"
 #include "../hardware/hardwaretypes.h"
 #include "../webserver/Base64.h"
@@ -1044,6 +1046,12 @@ namespace http
 				s_str >> lastlogtime;
 			}
 
+			// cursor of the lines already received, the sequence number of the last line
+			uint64_t lastseq = 0;
+			std::string slastseq = request::findValue(&req, "lastseq");
+			if (!slastseq.empty())
+				lastseq = std::strtoull(slastseq.c_str(), nullptr, 10);
+
 			_eLogLevel lLevel = LOG_NORM;
 			std::string sloglevel = request::findValue(&req, "loglevel");
 			if (!sloglevel.empty())
@@ -1051,7 +1059,8 @@ namespace http
 				lLevel = (_eLogLevel)atoi(sloglevel.c_str());
 			}
 
-			std::list<CLogger::_tLogLineStruct> logmessages = _log.GetLog(lLevel);
+			std::vector<CLogger::_tLogLineStruct> logmessages;
+			root["LastSeq"] = std::to_string(_log.GetLog(lLevel, lastseq, logmessages));
 			int ii = 0;
 			for (const auto& msg : logmessages)
 			{
@@ -1575,6 +1584,77 @@ namespace http
 			root["seconds"] = seconds;
 		}
 
+		void CWebServer::Cmd_GetRxQueueStats(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			root["status"] = "OK";
+			root["title"] = "GetRxQueueStats";
+
+			int ii = 0;
+			for (const auto &stats : m_mainworker.GetRxQueueStats())
+			{
+				root["result"][ii]["Shard"] = ii;
+				root["result"][ii]["QueueDepth"] = static_cast<Json::UInt64>(stats.QueueDepth);
+				root["result"][ii]["Processed"] = static_cast<Json::UInt64>(stats.Processed);
+				root["result"][ii]["AvgLatencyUs"] = static_cast<Json::UInt64>(stats.AvgLatencyUs);
+				root["result"][ii]["MaxLatencyUs"] = static_cast<Json::UInt64>(stats.MaxLatencyUs);
+				ii++;
+			}
+		}
+
+		void CWebServer::Cmd_GetDBConnectionStats(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			root["status"] = "OK";
+			root["title"] = "GetDBConnectionStats";
+
+			int ii = 0;
+			for (const auto &stats : m_sql.GetConnectionStats())
+			{
+				// the first connection is the primary (read/write) connection
+				root["result"][ii]["Connection"] = (ii == 0) ? "primary" : "read" + std::to_string(ii);
+				root["result"][ii]["Queries"] = static_cast<Json::UInt64>(stats.Queries);
+				root["result"][ii]["AvgWaitUs"] = static_cast<Json::UInt64>((stats.Queries > 0) ? stats.WaitTotalUs / stats.Queries : 0);
+				root["result"][ii]["MaxWaitUs"] = static_cast<Json::UInt64>(stats.WaitMaxUs);
+				root["result"][ii]["AvgBusyUs"] = static_cast<Json::UInt64>((stats.Queries > 0) ? stats.BusyTotalUs / stats.Queries : 0);
+				ii++;
+			}
+		}
+
+		void CWebServer::Cmd_GetLatencyStats(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			root["status"] = "OK";
+			root["title"] = "GetLatencyStats";
+
+			int ii = 0;
+			for (const auto &series : m_latencystats.GetSeries())
+			{
+				const CLatencyHistogram::_tSnapshot &snapshot = series.Snapshot;
+				root["result"][ii]["Stage"] = CLatencyStats::StageName(series.Stage);
+				root["result"][ii]["Name"] = series.Name;
+				root["result"][ii]["Count"] = static_cast<Json::UInt64>(snapshot.Count);
+				root["result"][ii]["AvgUs"] = static_cast<Json::UInt64>((snapshot.Count > 0) ? snapshot.SumUs / snapshot.Count : 0);
+				root["result"][ii]["P50Us"] = static_cast<Json::UInt64>(CLatencyHistogram::Percentile(snapshot, 50));
+				root["result"][ii]["P99Us"] = static_cast<Json::UInt64>(CLatencyHistogram::Percentile(snapshot, 99));
+				root["result"][ii]["MaxUs"] = static_cast<Json::UInt64>(snapshot.MaxUs);
+				root["result"][ii]["TotalMs"] = static_cast<Json::UInt64>(snapshot.SumUs / 1000);
+				ii++;
+			}
+		}
+
 		void CWebServer::Cmd_GetActualHistory(WebEmSession& session, const request& req, Json::Value& root)
 		{
 			root["status"] = "OK";
@@ -4237,6 +4317,9 @@ namespace http
 			m_sql.safe_query("UPDATE Percentage SET DeviceRowID='%q' WHERE (DeviceRowID == '%q') AND (Date>'%q')", sidx.c_str(), newidx.c_str(), szLastOldDate.c_str());
 			m_sql.safe_query("UPDATE Percentage_Calendar SET DeviceRowID='%q' WHERE (DeviceRowID == '%q') AND (Date>'%q')", sidx.c_str(), newidx.c_str(), szLastOldDate.c_str());
 
+			//also in the short log store, before deleting the new device drops its samples there
+			m_sql.TransferShortLogs(std::strtoull(newidx.c_str(), nullptr, 10), std::strtoull(sidx.c_str(), nullptr, 10), szLastOldDate);
+
 			m_sql.DeleteDevices(newidx);
 
 			m_mainworker.m_scheduler.ReloadSchedules();
@@ -4928,7 +5011,7 @@ namespace http
 			}
 		}
 
-		void CWebServer::Cmd_GetLightLog(WebEmSession& session, const request& req, Json::Value& root)
+		void CWebServer::Cmd_GetLightLog(WebEmSession& session, const request& req, CJSonStreamWriter& writer)
 		{
 			uint64_t idx = 0;
 			if (!request::findValue(&req, "idx").empty())
@@ -4955,10 +5038,11 @@ namespace http
 				)
 				return; // no light device! we should not be here!
 
-			root["status"] = "OK";
-			root["title"] = "getlightlog";
+			writer.StartObject();
+			writer.Member("status", "OK");
+			writer.Member("title", "getlightlog");
 
-			result = m_sql.safe_query("SELECT ROWID, nValue, sValue, User, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
+			result = m_sql.safe_query_read("SELECT ROWID, nValue, sValue, User, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
 			if (!result.empty())
 			{
 				std::map<std::string, std::string> selectorStatuses;
@@ -4967,6 +5051,9 @@ namespace http
 					GetSelectorSwitchStatuses(options, selectorStatuses);
 				}
 
+				bool bFirstHaveDimmer = false;
+				bool bFirstHaveGroupCmd = false;
+				bool bFirstHaveSelector = false;
 				int ii = 0;
 				for (const auto& sd : result)
 				{
@@ -5016,11 +5103,12 @@ namespace http
 
 					if (ii == 0)
 					{
-						// Log these parameters once
-						root["HaveDimmer"] = bHaveDimmer;
-						root["result"][ii]["MaxDimLevel"] = maxDimLevel;
-						root["HaveGroupCmd"] = bHaveGroupCmd;
-						root["HaveSelector"] = bHaveSelector;
+						// Log these parameters once (after the result)
+						bFirstHaveDimmer = bHaveDimmer;
+						bFirstHaveGroupCmd = bHaveGroupCmd;
+						bFirstHaveSelector = bHaveSelector;
+						writer.Key("result");
+						writer.StartArray();
 					}
 
 					// Corrent names for certain switch types
@@ -5040,18 +5128,30 @@ namespace http
 						break;
 					}
 
-					root["result"][ii]["idx"] = lidx;
-					root["result"][ii]["Date"] = ldate;
-					root["result"][ii]["Data"] = ldata;
-					root["result"][ii]["Status"] = lstatus;
-					root["result"][ii]["Level"] = llevel;
-					root["result"][ii]["User"] = sUser;
+					writer.StartObject();
+					if (ii == 0)
+						writer.Member("MaxDimLevel", maxDimLevel);
+					writer.Member("idx", lidx);
+					writer.Member("Date", ldate);
+					writer.Member("Data", ldata);
+					writer.Member("Status", lstatus);
+					writer.Member("Level", llevel);
+					writer.Member("User", sUser);
+					writer.EndObject();
 					ii++;
 				}
+				if (ii > 0)
+				{
+					writer.EndArray();
+					writer.Member("HaveDimmer", bFirstHaveDimmer);
+					writer.Member("HaveGroupCmd", bFirstHaveGroupCmd);
+					writer.Member("HaveSelector", bFirstHaveSelector);
+				}
 			}
+			writer.EndObject();
 		}
 
-		void CWebServer::Cmd_GetTextLog(WebEmSession& session, const request& req, Json::Value& root)
+		void CWebServer::Cmd_GetTextLog(WebEmSession& session, const request& req, CJSonStreamWriter& writer)
 		{
 			uint64_t idx = 0;
 			if (!request::findValue(&req, "idx").empty())
@@ -5060,25 +5160,30 @@ namespace http
 			}
 			std::vector<std::vector<std::string>> result;
 
-			root["status"] = "OK";
-			root["title"] = "gettextlog";
+			writer.StartObject();
+			writer.Member("status", "OK");
+			writer.Member("title", "gettextlog");
 
-			result = m_sql.safe_query("SELECT ROWID, sValue, User, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
+			result = m_sql.safe_query_read("SELECT ROWID, sValue, User, Date FROM LightingLog WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
 			if (!result.empty())
 			{
-				int ii = 0;
+				writer.Key("result");
+				writer.StartArray();
 				for (const auto& sd : result)
 				{
-					root["result"][ii]["idx"] = sd[0];
-					root["result"][ii]["Data"] = sd[1];
-					root["result"][ii]["User"] = sd[2];
-					root["result"][ii]["Date"] = sd[3];
-					ii++;
+					writer.StartObject();
+					writer.Member("idx", sd[0]);
+					writer.Member("Data", sd[1]);
+					writer.Member("User", sd[2]);
+					writer.Member("Date", sd[3]);
+					writer.EndObject();
 				}
+				writer.EndArray();
 			}
+			writer.EndObject();
 		}
 
-		void CWebServer::Cmd_GetSceneLog(WebEmSession& session, const request& req, Json::Value& root)
+		void CWebServer::Cmd_GetSceneLog(WebEmSession& session, const request& req, CJSonStreamWriter& writer)
 		{
 			uint64_t idx = 0;
 			if (!request::findValue(&req, "idx").empty())
@@ -5087,23 +5192,28 @@ namespace http
 			}
 			std::vector<std::vector<std::string>> result;
 
-			root["status"] = "OK";
-			root["title"] = "getscenelog";
+			writer.StartObject();
+			writer.Member("status", "OK");
+			writer.Member("title", "getscenelog");
 
-			result = m_sql.safe_query("SELECT ROWID, nValue, User, Date FROM SceneLog WHERE (SceneRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
+			result = m_sql.safe_query_read("SELECT ROWID, nValue, User, Date FROM SceneLog WHERE (SceneRowID==%" PRIu64 ") ORDER BY Date DESC", idx);
 			if (!result.empty())
 			{
-				int ii = 0;
+				writer.Key("result");
+				writer.StartArray();
 				for (const auto& sd : result)
 				{
-					root["result"][ii]["idx"] = sd[0];
+					writer.StartObject();
+					writer.Member("idx", sd[0]);
 					int nValue = atoi(sd[1].c_str());
-					root["result"][ii]["Data"] = (nValue == 0) ? "Off" : "On";
-					root["result"][ii]["User"] = sd[2];
-					root["result"][ii]["Date"] = sd[3];
-					ii++;
+					writer.Member("Data", (nValue == 0) ? "Off" : "On");
+					writer.Member("User", sd[2]);
+					writer.Member("Date", sd[3]);
+					writer.EndObject();
 				}
+				writer.EndArray();
 			}
+			writer.EndObject();
 		}
 
 		void CWebServer::Cmd_RemoteWebClientsLog(WebEmSession& session, const request& req, Json::Value& root)
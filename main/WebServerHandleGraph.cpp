@@ -55,7 +55,7 @@ namespace http
 			struct tm tm1;
 			localtime_r(&now, &tm1);
 
-			result = m_sql.safe_query("SELECT Type, SubType, SwitchType, AddjValue, AddjMulti, AddjValue2, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
+			result = m_sql.safe_query_read("SELECT Type, SubType, SwitchType, AddjValue, AddjMulti, AddjValue2, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
 			if (result.empty())
 				return;
 
@@ -174,8 +174,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Temperature, Chill, Humidity, Barometer, Date, SetPoint FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC",
-						dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Temperature, Chill, Humidity, Barometer, Date, SetPoint", idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -264,7 +263,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Percentage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Percentage, Date", idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -281,7 +280,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Speed, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Speed, Date", idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -300,7 +299,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1, Value2, Value3, Value4, Value5, Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1, Value2, Value3, Value4, Value5, Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC",
 							dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
@@ -429,7 +428,7 @@ namespace http
 											int day = ltime.tm_mday;
 											sprintf(szTmp, "%04d-%02d-%02d", year, mon, day);
 											std::vector<std::vector<std::string>> result2;
-											result2 = m_sql.safe_query(
+											result2 = m_sql.safe_query_read(
 												"SELECT Counter1, Counter2, Counter3, Counter4 FROM Multimeter_Calendar WHERE (DeviceRowID==%" PRIu64
 												") AND (Date=='%q')",
 												idx, szTmp);
@@ -473,7 +472,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -490,7 +489,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -514,7 +513,7 @@ namespace http
 						{
 							vdiv = 1000.0F;
 						}
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -545,7 +544,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -562,7 +561,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -579,7 +578,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -597,7 +596,7 @@ namespace http
 						root["status"] = "OK";
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -622,7 +621,7 @@ namespace http
 
 						root["displaytype"] = displaytype;
 
-						result = m_sql.safe_query("SELECT Value1, Value2, Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value1, Value2, Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -692,7 +691,7 @@ namespace http
 
 						root["displaytype"] = displaytype;
 
-						result = m_sql.safe_query("SELECT Value1, Value2, Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value1, Value2, Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int ii = 0;
@@ -759,7 +758,7 @@ namespace http
 
 						// First check if we had any usage in the short log, if not, its probably a meter without usage
 						bool bHaveUsage = true;
-						result = m_sql.safe_query("SELECT MIN([Usage]), MAX([Usage]) FROM %s WHERE (DeviceRowID==%" PRIu64 ")", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT MIN([Usage]), MAX([Usage]) FROM %s WHERE (DeviceRowID==%" PRIu64 ")", dbasetable.c_str(), idx);
 						if (!result.empty())
 						{
 							int64_t minValue = std::stoll(result[0][0]);
@@ -772,7 +771,7 @@ namespace http
 						}
 
 						int ii = 0;
-						result = m_sql.safe_query("SELECT Value,[Usage], Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+						result = m_sql.safe_query_read("SELECT Value,[Usage], Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 
 						int method = 0;
 						std::string sMethod = request::findValue(&req, "method");
@@ -945,14 +944,14 @@ namespace http
 
 						if (bIsManagedCounter)
 						{
-							result = m_sql.safe_query("SELECT Usage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+							result = m_sql.safe_query_read("SELECT Usage, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 							bHaveFirstValue = true;
 							bHaveFirstRealValue = true;
 							method = 1;
 						}
 						else
 						{
-							result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+							result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
 						}
 
 						if (!result.empty())
@@ -1075,7 +1074,7 @@ namespace http
 											int day = ltime.tm_mday;
 											sprintf(szTmp, "%04d-%02d-%02d", year, mon, day);
 											std::vector<std::vector<std::string>> result2;
-											result2 = m_sql.safe_query(
+											result2 = m_sql.safe_query_read(
 												"SELECT Counter FROM %s_Calendar WHERE (DeviceRowID==%" PRIu64
 												") AND (Date=='%q')",
 												dbasetable.c_str(), idx, szTmp);
@@ -1222,7 +1221,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Level, Date", idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -1246,7 +1245,7 @@ namespace http
 					float LastValue = -1;
 					std::string LastDate;
 
-					result = m_sql.safe_query("SELECT Total, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Total, Date", idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -1274,7 +1273,7 @@ namespace http
 							LastDate = sd[1];
 						}
 						//Add last value
-						result = m_sql.safe_query("SELECT sValue, LastUpdate FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
+						result = m_sql.safe_query_read("SELECT sValue, LastUpdate FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
 						if (!result.empty())
 						{
 							std::string sValue = result[0][0];
@@ -1303,7 +1302,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Direction, Speed, Gust, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Direction, Speed, Gust, Date", idx);
 					if (!result.empty())
 					{
 						int ii = 0;
@@ -1340,7 +1339,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Direction, Speed, Gust FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dbasetable.c_str(), idx);
+					result = m_sql.GetShortLog(dbasetable, "Direction, Speed, Gust", idx);
 					if (!result.empty())
 					{
 						std::map<int, int> _directions;
@@ -1596,7 +1595,7 @@ namespace http
 					getNoon(weekbefore, tm2, tm1.tm_year + 1900, tm1.tm_mon + 1, tm1.tm_mday - 7); // We only want the date
 					sprintf(szDateStart, "%04d-%02d-%02d", tm2.tm_year + 1900, tm2.tm_mon + 1, tm2.tm_mday);
 
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_query_read("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -1614,12 +1613,12 @@ namespace http
 					// add today (have to calculate it)
 					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 					{
-						result = m_sql.safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
+						result = m_sql.safe_query_read("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
 							szDateEnd);
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					}
 					if (!result.empty())
 					{
@@ -1666,7 +1665,7 @@ namespace http
 					int ii = 0;
 					if (dType == pTypeP1Power)
 					{
-						result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6,Date FROM %s WHERE (DeviceRowID==%" PRIu64
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value5,Value6,Date FROM %s WHERE (DeviceRowID==%" PRIu64
 							" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
@@ -1708,7 +1707,7 @@ namespace http
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -1747,7 +1746,7 @@ namespace http
 					// add today (have to calculate it)
 					if (dType == pTypeP1Power)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value1), MAX(Value1), MIN(Value2), MAX(Value2),MIN(Value5), MAX(Value5), MIN(Value6), MAX(Value6) FROM "
+						result = m_sql.safe_query_read("SELECT MIN(Value1), MAX(Value1), MIN(Value2), MAX(Value2),MIN(Value5), MAX(Value5), MIN(Value6), MAX(Value6) FROM "
 							"MultiMeter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
 							idx, szDateEnd);
 						if (!result.empty())
@@ -1807,7 +1806,7 @@ namespace http
 					else if (!bIsManagedCounter)
 					{
 						// get the first value of the day
-						result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateEnd);
 						if (!result.empty())
 						{
 							std::vector<std::string> sd = result[0];
@@ -1817,7 +1816,7 @@ namespace http
 							int64_t total_real;
 
 							// get the last value of the day
-							result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx, szDateEnd);
+							result = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx, szDateEnd);
 							if (!result.empty())
 							{
 								std::vector<std::string> sd = result[0];
@@ -1931,7 +1930,7 @@ namespace http
 					root["title"] = "Graph " + sensor + " " + srange;
 
 					// Actual Year
-					result = m_sql.safe_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
+					result = m_sql.safe_query_read("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
 						" Humidity, Barometer, Temp_Avg, Date, SetPoint_Min,"
 						" SetPoint_Max, SetPoint_Avg "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
@@ -2049,7 +2048,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MIN(Temperature), MAX(Temperature),"
+					result = m_sql.safe_query_read("SELECT MIN(Temperature), MAX(Temperature),"
 						" MIN(Chill), MAX(Chill), AVG(Humidity),"
 						" AVG(Barometer), AVG(Temperature), MIN(SetPoint),"
 						" MAX(SetPoint), AVG(SetPoint) "
@@ -2154,7 +2153,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
+					result = m_sql.safe_query_read("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
 						" Humidity, Barometer, Temp_Avg, Date, SetPoint_Min,"
 						" SetPoint_Max, SetPoint_Avg "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
@@ -2284,7 +2283,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Percentage_Min, Percentage_Max, Percentage_Avg, Date FROM %s WHERE (DeviceRowID==%" PRIu64
+					result = m_sql.safe_query_read("SELECT Percentage_Min, Percentage_Max, Percentage_Avg, Date FROM %s WHERE (DeviceRowID==%" PRIu64
 						" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
@@ -2300,7 +2299,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MIN(Percentage), MAX(Percentage), AVG(Percentage) FROM Percentage WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx,
+					result = m_sql.safe_query_read("SELECT MIN(Percentage), MAX(Percentage), AVG(Percentage) FROM Percentage WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx,
 						szDateEnd);
 					if (!result.empty())
 					{
@@ -2325,7 +2324,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Speed_Min, Speed_Max, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_query_read("SELECT Speed_Min, Speed_Max, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -2339,7 +2338,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MIN(Speed), MAX(Speed) FROM Fan WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+					result = m_sql.safe_query_read("SELECT MIN(Speed), MAX(Speed) FROM Fan WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -2362,7 +2361,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
+					result = m_sql.safe_query_read("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
 						idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -2375,7 +2374,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+					result = m_sql.safe_query_read("SELECT MAX(Level) FROM UV WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -2385,7 +2384,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
+					result = m_sql.safe_query_read("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC", dbasetable.c_str(),
 						idx, szDateStartPrev, szDateEndPrev);
 					if (!result.empty())
 					{
@@ -2411,7 +2410,7 @@ namespace http
 
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_query_read("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart, szDateEnd);
 					int ii = 0;
 					if (!result.empty())
@@ -2429,12 +2428,12 @@ namespace http
 					// add today (have to calculate it)
 					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 					{
-						result = m_sql.safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
+						result = m_sql.safe_query_read("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
 							szDateEnd);
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 					}
 					if (!result.empty())
 					{
@@ -2460,7 +2459,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+					result = m_sql.safe_query_read("SELECT Total, Rate, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 					if (!result.empty())
 					{
@@ -2487,7 +2486,7 @@ namespace http
 					// int nValue = 0;
 					std::string sValue; //Counter
 
-					result = m_sql.safe_query("SELECT sValue FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
+					result = m_sql.safe_query_read("SELECT sValue FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
 					if (!result.empty())
 					{
 						sValue = result[0][0];
@@ -2543,7 +2542,7 @@ namespace http
 						else
 						{
 							// Actual Year
-							result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6, Date,"
+							result = m_sql.safe_query_read("SELECT Value1,Value2,Value5,Value6, Date,"
 								" Counter1, Counter2, Counter3, Counter4 "
 								"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 								" AND Date<='%q') ORDER BY Date ASC",
@@ -2629,7 +2628,7 @@ namespace http
 								}
 							}
 							// Previous Year
-							result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6, Date "
+							result = m_sql.safe_query_read("SELECT Value1,Value2,Value5,Value6, Date "
 								"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 								dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 							if (!result.empty())
@@ -2679,7 +2678,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2692,7 +2691,7 @@ namespace http
 								ii++;
 							}
 						}
-						result = m_sql.safe_query("SELECT Value2,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value2,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 						if (!result.empty())
 						{
@@ -2720,7 +2719,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2756,7 +2755,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value3,Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2823,7 +2822,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value3, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2851,7 +2850,7 @@ namespace http
 
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2878,7 +2877,7 @@ namespace http
 						}
 						root["title"] = "Graph " + sensor + " " + srange;
 
-						result = m_sql.safe_query("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value1,Value2, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
 						{
@@ -2893,7 +2892,7 @@ namespace http
 					}
 					else if (dType == pTypeCURRENT)
 					{
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
 							" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
@@ -2977,7 +2976,7 @@ namespace http
 					}
 					else if (dType == pTypeCURRENTENERGY)
 					{
-						result = m_sql.safe_query("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value3,Value4,Value5,Value6, Date FROM %s WHERE (DeviceRowID==%" PRIu64
 							" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart, szDateEnd);
 						if (!result.empty())
@@ -3206,7 +3205,7 @@ namespace http
 
 							// Actual Year
 							result =
-								m_sql.safe_query("SELECT Value, Date, Counter FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+								m_sql.safe_query_read("SELECT Value, Date, Counter FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 									dbasetable.c_str(), idx, szDateStart, szDateEnd);
 							if (!result.empty())
 							{
@@ -3263,7 +3262,7 @@ namespace http
 							}
 							// Past Year
 							result =
-								m_sql.safe_query("SELECT Value, Date, Counter FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+								m_sql.safe_query_read("SELECT Value, Date, Counter FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 									dbasetable.c_str(), idx, szDateStartPrev, szDateEndPrev);
 							if (!result.empty())
 							{
@@ -3324,7 +3323,7 @@ namespace http
 
 					if (dType == pTypeP1Power)
 					{
-						result = m_sql.safe_query("SELECT "
+						result = m_sql.safe_query_read("SELECT "
 							" MIN(Value1) as levering_laag_min,"
 							" MAX(Value1) as levering_laag_max,"
 							" MIN(Value2) as teruglevering_laag_min,"
@@ -3411,7 +3410,7 @@ namespace http
 					}
 					else if (dType == pTypeAirQuality)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value), AVG(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value), AVG(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3424,7 +3423,7 @@ namespace http
 					else if (((dType == pTypeGeneral) && ((dSubType == sTypeSoilMoisture) || (dSubType == sTypeLeafWetness))) ||
 						((dType == pTypeRFXSensor) && ((dSubType == sTypeRFXSensorAD) || (dSubType == sTypeRFXSensorVolt))))
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3444,7 +3443,7 @@ namespace http
 							vdiv = 1000.0F;
 						}
 
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3485,7 +3484,7 @@ namespace http
 					}
 					else if (dType == pTypeLux)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value), AVG(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value), AVG(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3497,7 +3496,7 @@ namespace http
 					}
 					else if (dType == pTypeWEIGHT)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3510,7 +3509,7 @@ namespace http
 					}
 					else if (dType == pTypeUsage)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
+						result = m_sql.safe_query_read("SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')", idx, szDateEnd);
 						if (!result.empty())
 						{
 							root["result"][ii]["d"] = szDateEnd;
@@ -3526,7 +3525,7 @@ namespace http
 						} else*/
 						{
 							// get the first value
-							result = m_sql.safe_query(
+							result = m_sql.safe_query_read(
 								//"SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
 								"SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateEnd);
 							if (!result.empty())
@@ -3537,7 +3536,7 @@ namespace http
 								int64_t total_real;
 
 								// Get the last value
-								result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
+								result = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
 									szDateEnd);
 								if (!result.empty())
 								{
@@ -3635,7 +3634,7 @@ namespace http
 
 					int ii = 0;
 
-					result = m_sql.safe_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
+					result = m_sql.safe_query_read("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
 						" Gust_Max, Date "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 						" AND Date<='%q') ORDER BY Date ASC",
@@ -3669,7 +3668,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed),"
+					result = m_sql.safe_query_read("SELECT AVG(Direction), MIN(Speed), MAX(Speed),"
 						" MIN(Gust), MAX(Gust) "
 						"FROM Wind WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC",
 						idx, szDateEnd);
@@ -3701,7 +3700,7 @@ namespace http
 						ii++;
 					}
 					// Previous Year
-					result = m_sql.safe_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
+					result = m_sql.safe_query_read("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
 						" Gust_Max, Date "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 						" AND Date<='%q') ORDER BY Date ASC",
@@ -3793,7 +3792,7 @@ namespace http
 					if (sgraphtype == "1")
 					{
 						// Need to get all values of the end date so 23:59:59 is appended to the date string
-						result = m_sql.safe_query("SELECT Temperature, Chill, Humidity, Barometer,"
+						result = m_sql.safe_query_read("SELECT Temperature, Chill, Humidity, Barometer,"
 							" Date, DewPoint, SetPoint "
 							"FROM Temperature WHERE (DeviceRowID==%" PRIu64 ""
 							" AND Date>='%q' AND Date<='%q 23:59:59') ORDER BY Date ASC",
@@ -3861,7 +3860,7 @@ namespace http
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
+						result = m_sql.safe_query_read("SELECT Temp_Min, Temp_Max, Chill_Min, Chill_Max,"
 							" Humidity, Barometer, Date, DewPoint, Temp_Avg,"
 							" SetPoint_Min, SetPoint_Max, SetPoint_Avg "
 							"FROM Temperature_Calendar "
@@ -3941,7 +3940,7 @@ namespace http
 						}
 
 						// add today (have to calculate it)
-						result = m_sql.safe_query("SELECT MIN(Temperature), MAX(Temperature),"
+						result = m_sql.safe_query_read("SELECT MIN(Temperature), MAX(Temperature),"
 							" MIN(Chill), MAX(Chill), AVG(Humidity),"
 							" AVG(Barometer), MIN(DewPoint), AVG(Temperature),"
 							" MIN(SetPoint), MAX(SetPoint), AVG(SetPoint) "
@@ -4020,7 +4019,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ""
+					result = m_sql.safe_query_read("SELECT Level, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ""
 						" AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
 					int ii = 0;
@@ -4034,7 +4033,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT MAX(Level) FROM UV WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
+					result = m_sql.safe_query_read("SELECT MAX(Level) FROM UV WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
 					if (!result.empty())
 					{
 						std::vector<std::string> sd = result[0];
@@ -4049,7 +4048,7 @@ namespace http
 					root["status"] = "OK";
 					root["title"] = "Graph " + sensor + " " + srange;
 
-					result = m_sql.safe_query("SELECT Total, Rate, Date FROM %s "
+					result = m_sql.safe_query_read("SELECT Total, Rate, Date FROM %s "
 						"WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 						dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
 					int ii = 0;
@@ -4065,12 +4064,12 @@ namespace http
 					// add today (have to calculate it)
 					if (dSubType == sTypeRAINWU || dSubType == sTypeRAINByRate)
 					{
-						result = m_sql.safe_query("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
+						result = m_sql.safe_query_read("SELECT Total, Total, Rate FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY ROWID DESC LIMIT 1", idx,
 							szDateEnd.c_str());
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
+						result = m_sql.safe_query_read("SELECT MIN(Total), MAX(Total), MAX(Rate) FROM Rain WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')", idx, szDateEnd.c_str());
 					}
 					if (!result.empty())
 					{
@@ -4106,7 +4105,7 @@ namespace http
 					int ii = 0;
 					if (dType == pTypeP1Power)
 					{
-						result = m_sql.safe_query("SELECT Value1,Value2,Value5,Value6, Date "
+						result = m_sql.safe_query_read("SELECT Value1,Value2,Value5,Value6, Date "
 							"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 							" AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
@@ -4141,7 +4140,7 @@ namespace http
 					}
 					else
 					{
-						result = m_sql.safe_query("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
+						result = m_sql.safe_query_read("SELECT Value, Date FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q' AND Date<='%q') ORDER BY Date ASC",
 							dbasetable.c_str(), idx, szDateStart.c_str(), szDateEnd.c_str());
 						if (!result.empty())
 						{
@@ -4178,7 +4177,7 @@ namespace http
 					// add today (have to calculate it)
 					if (dType == pTypeP1Power)
 					{
-						result = m_sql.safe_query("SELECT MIN(Value1), MAX(Value1), MIN(Value2),"
+						result = m_sql.safe_query_read("SELECT MIN(Value1), MAX(Value1), MIN(Value2),"
 							" MAX(Value2),MIN(Value5), MAX(Value5),"
 							" MIN(Value6), MAX(Value6) "
 							"FROM MultiMeter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
@@ -4227,7 +4226,7 @@ namespace http
 					}
 					else if (!bIsManagedCounter)
 					{ // get the first value of the day
-						result = m_sql.safe_query(
+						result = m_sql.safe_query_read(
 							//"SELECT MIN(Value), MAX(Value) FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q')",
 							"SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date ASC LIMIT 1", idx, szDateEnd.c_str());
 						if (!result.empty())
@@ -4238,7 +4237,7 @@ namespace http
 							int64_t total_real;
 
 							// get the last value of the day
-							result = m_sql.safe_query("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
+							result = m_sql.safe_query_read("SELECT Value FROM Meter WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q') ORDER BY Date DESC LIMIT 1", idx,
 								szDateEnd.c_str());
 							if (!result.empty())
 							{
@@ -4283,7 +4282,7 @@ namespace http
 
 					int ii = 0;
 
-					result = m_sql.safe_query("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
+					result = m_sql.safe_query_read("SELECT Direction, Speed_Min, Speed_Max, Gust_Min,"
 						" Gust_Max, Date "
 						"FROM %s WHERE (DeviceRowID==%" PRIu64 " AND Date>='%q'"
 						" AND Date<='%q') ORDER BY Date ASC",
@@ -4317,7 +4316,7 @@ namespace http
 						}
 					}
 					// add today (have to calculate it)
-					result = m_sql.safe_query("SELECT AVG(Direction), MIN(Speed), MAX(Speed), MIN(Gust), MAX(Gust) FROM Wind WHERE (DeviceRowID==%" PRIu64
+					result = m_sql.safe_query_read("SELECT AVG(Direction), MIN(Speed), MAX(Speed), MIN(Gust), MAX(Gust) FROM Wind WHERE (DeviceRowID==%" PRIu64
 						" AND Date>='%q') ORDER BY Date ASC",
 						idx, szDateEnd.c_str());
 					if (!result.empty())
@@ -31,6 +31,8 @@
 #include "../notifications/NotificationHelper.h"
 #include "appversion.h"
 #include "SignalHandler.h"
+#include "IngestBenchmark.h"
+#include "LatencyStats.h"
 
 #if defined WIN32
 	#include "../msbuild/WindowsHelper.h"
@@ -83,6 +85,13 @@ namespace
 #endif
 		"\t-noupdates do not use the internal update functionality\n"
 		"\t-dbase_disable_wal_mode\n"
+		"\t-dbase_group_commit milliseconds (commit database writes in batches, for example 100, default=0 (off))\n"
+		"\t-dbase_readers number (read-only database connections for web and graph queries, WAL mode only, default=0 (off))\n"
+		"\t-rxworkers number (number of threads decoding received messages, sharded by hardware, default=1)\n"
+		"\t-shortlogstore (also keep the short logs in a compressed store next to the database, used for the day graphs)\n"
+		"\t-backupcompress (write the automatic database backups gzip compressed)\n"
+		"\t-benchmark [frames_file] (replay received frames on a temporary database and report the ingestion throughput, then exit)\n"
+		"\t-benchmark_repeat number (number of times the frames are replayed, default=10)\n"
 #if defined WIN32
 		"\t-log file_path (for example D:\\domoticz.log)\n"
 		"\t-weblog file_path (for example D:\\domoticz_access.log)\n"
@@ -93,6 +102,7 @@ namespace
 		"\t-loglevel (combination of: all,normal,status,error,debug)\n"
 		"\t-debuglevel (combination of: all,normal,hardware,received,webserver,eventsystem,python,thread_id,sql,auth)\n"
 		"\t-notimestamps (do not prepend timestamps to logs; useful with syslog, etc.)\n"
+		"\t-logoverflow [block|drop] (when the log file cannot keep up, wait for it or drop lines, default=block)\n"
 		"\t-php_cgi_path (for example /usr/bin/php-cgi)\n"
 #ifndef WIN32
 		"\t-daemon (run as background daemon)\n"
@@ -137,7 +147,16 @@ std::string szPyVersion="None";
 int ActYear;
 time_t m_StartTime = time(nullptr);
 std::string journalMode="WAL";
-
+int dbaseGroupCommitInterval = 0;
+int dbaseReaders = 0;
+int rxWorkerCount = 1;
+bool bShortLogStore = false;
+bool bBackupCompress = false;
+bool bBenchmark = false;
+std::string szBenchmarkFile;
+int iBenchmarkRepeat = 10;
+
+CLatencyStats m_latencystats; // constructed first, the workers record into it until they are stopped
 MainWorker m_mainworker;
 CLogger _log;
 http::server::CWebServerHelper m_webservers;
@@ -546,6 +565,12 @@ bool ParseConfigFile(const std::string &szConfigFile)
 		else if (szFlag == "log_file") {
 			logfile = sLine;
 		}
+		else if (szFlag == "log_overflow") {
+			if (!_log.SetOverflowPolicy(sLine)) {
+				_log.Log(LOG_ERROR, "Invalid log_overflow value in Configuration file '%s'", szConfigFile.c_str());
+				return false;
+			}
+		}
 		else if (szFlag == "weblog_file") {
 			weblogfile = sLine;
 		}
@@ -570,6 +595,21 @@ bool ParseConfigFile(const std::string &szConfigFile)
 		else if ( (szFlag == "dbase_disable_wal_mode") && (GetConfigBool(sLine) ) )  {
 			journalMode = "DELETE";
 		}
+		else if (szFlag == "dbase_group_commit") {
+			dbaseGroupCommitInterval = atoi(sLine.c_str());
+		}
+		else if (szFlag == "dbase_readers") {
+			dbaseReaders = atoi(sLine.c_str());
+		}
+		else if (szFlag == "rx_workers") {
+			rxWorkerCount = atoi(sLine.c_str());
+		}
+		else if (szFlag == "shortlog_store") {
+			bShortLogStore = GetConfigBool(sLine);
+		}
+		else if (szFlag == "backup_compress") {
+			bBackupCompress = GetConfigBool(sLine);
+		}
 
 		else if (szFlag == "startup_delay") {
 			int DelaySeconds = atoi(sLine.c_str());
@@ -691,6 +731,15 @@ int main(int argc, char**argv)
 			}
 			logfile = cmdLine.GetSafeArgument("-log", 0, "domoticz.log");
 		}
+		if (cmdLine.HasSwitch("-logoverflow"))
+		{
+			std::string szPolicy = cmdLine.GetSafeArgument("-logoverflow", 0, "");
+			if (!_log.SetOverflowPolicy(szPolicy))
+			{
+				_log.Log(LOG_ERROR, "Please specify a log overflow policy (block or drop)");
+				return 1;
+			}
+		}
 		if (cmdLine.HasSwitch("-weblog"))
 		{
 			if (cmdLine.GetArgumentCount("-weblog") != 1)
@@ -1009,6 +1058,31 @@ int main(int argc, char**argv)
 			dbasefile = cmdLine.GetSafeArgument("-dbase", 0, "domoticz.db");
 		}
 	}
+	if (cmdLine.HasSwitch("-benchmark"))
+	{
+		bBenchmark = true;
+		szBenchmarkFile = cmdLine.GetSafeArgument("-benchmark", 0, "");
+		if (cmdLine.HasSwitch("-benchmark_repeat"))
+		{
+			if (cmdLine.GetArgumentCount("-benchmark_repeat") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the number of benchmark repeats");
+				return 1;
+			}
+			iBenchmarkRepeat = atoi(cmdLine.GetSafeArgument("-benchmark_repeat", 0, "10").c_str());
+			if (iBenchmarkRepeat < 1)
+				iBenchmarkRepeat = 1;
+		}
+		// Run on a fresh database, without the web servers
+		dbasefile = szUserDataFolder + "domoticz_benchmark.db";
+		CIngestBenchmark::RemoveDatabase(dbasefile);
+		webserver_settings.listening_port = "0";
+		m_mainworker.SetWebserverSettings(webserver_settings);
+#ifdef WWW_ENABLE_SSL
+		secure_webserver_settings.listening_port = "0";
+		m_mainworker.SetSecureWebserverSettings(secure_webserver_settings);
+#endif
+	}
 	m_sql.SetDatabaseName(dbasefile);
 
 	if (!bUseConfigFile) {
@@ -1016,8 +1090,48 @@ int main(int argc, char**argv)
 		{
 			journalMode = "DELETE";
 		}
+		if (cmdLine.HasSwitch("-dbase_group_commit"))
+		{
+			if (cmdLine.GetArgumentCount("-dbase_group_commit") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify a group commit interval (milliseconds)");
+				return 1;
+			}
+			dbaseGroupCommitInterval = atoi(cmdLine.GetSafeArgument("-dbase_group_commit", 0, "0").c_str());
+		}
+		if (cmdLine.HasSwitch("-dbase_readers"))
+		{
+			if (cmdLine.GetArgumentCount("-dbase_readers") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the number of read-only database connections");
+				return 1;
+			}
+			dbaseReaders = atoi(cmdLine.GetSafeArgument("-dbase_readers", 0, "0").c_str());
+		}
+		if (cmdLine.HasSwitch("-rxworkers"))
+		{
+			if (cmdLine.GetArgumentCount("-rxworkers") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the number of RX worker threads");
+				return 1;
+			}
+			rxWorkerCount = atoi(cmdLine.GetSafeArgument("-rxworkers", 0, "1").c_str());
+		}
+		if (cmdLine.HasSwitch("-shortlogstore"))
+		{
+			bShortLogStore = true;
+		}
+		if (cmdLine.HasSwitch("-backupcompress"))
+		{
+			bBackupCompress = true;
+		}
 	}
 	m_sql.SetJournalMode(journalMode);
+	m_sql.SetGroupCommitInterval(dbaseGroupCommitInterval);
+	m_sql.SetReadPoolSize(dbaseReaders);
+	m_sql.EnableShortLogStore(bShortLogStore);
+	m_sql.EnableBackupCompression(bBackupCompress);
+	m_mainworker.SetRxWorkerCount(rxWorkerCount);
 
 	if (!bUseConfigFile) {
 		if (cmdLine.HasSwitch("-webroot"))
@@ -1130,6 +1244,8 @@ int main(int argc, char**argv)
 		syslog(LOG_INFO, "Domoticz running...");
 	}
 #endif
+	// started after daemonizing, the thread would not survive the fork
+	_log.StartFileWriter();
 
 	m_mainworker.SetIamserverSettings(iamserver_settings);
 
@@ -1162,6 +1278,18 @@ int main(int argc, char**argv)
 		return 1;
 	}
 
+	if (bBenchmark)
+	{
+		bool bResult;
+		{
+			CIngestBenchmark benchmark;
+			bResult = benchmark.Run(szBenchmarkFile, iBenchmarkRepeat);
+		}
+		m_mainworker.Stop();
+		CIngestBenchmark::RemoveDatabase(dbasefile);
+		return (bResult) ? 0 : 1;
+	}
+
 	// start Watchdog thread after daemonization
 	m_LastHeartbeat = mytime(nullptr);
 	std::thread thread_watchdog(Do_Watchdog_Work);
@@ -1226,6 +1354,7 @@ int main(int argc, char**argv)
 #endif
 	g_stop_watchdog = true;
 	thread_watchdog.join();
+	_log.StopFileWriter();
 	return 0;
 }
 
@@ -33,6 +33,7 @@ constexpr const char *szHelp
 	"Available modules:\n"
 	"\thelper\n"
 	"\tbaroforecastcalculator\n"
+	"\tqueue (function benchmark, input: producers [items], for example -input 4 100000)\n"
 	""
 };
 
@@ -207,6 +208,89 @@ bool helper_tester(const std::string szFunction, std::string &szInput, std::stri
 	return bSuccess;
 }
 
+/* **********
+concurrent_queue.h / mpsc_queue.h
+********** */
+struct _tQueueBenchItem
+{
+	std::string Name;
+	std::string UserName;
+	std::vector<uint8_t> vrxCommand;
+	int producer = 0;
+	int sequence = 0;
+};
+
+// Returns the number of items per second passed from the producers to one consumer, or -1 when items arrived out of order
+template <typename Queue>
+double queue_benchmark(Queue &queue, const int iProducers, const int iItems)
+{
+	std::vector<int> vLastSequence(iProducers, -1);
+	std::vector<std::thread> vThreads;
+
+	auto tStart = std::chrono::steady_clock::now();
+	for (int ii = 0; ii < iProducers; ii++)
+	{
+		vThreads.emplace_back([&queue, ii, iItems] {
+			for (int jj = 0; jj < iItems; jj++)
+			{
+				_tQueueBenchItem item;
+				item.Name = "Bench device";
+				item.UserName = "tester";
+				item.vrxCommand.assign(20, static_cast<uint8_t>(jj));
+				item.producer = ii;
+				item.sequence = jj;
+				queue.push(std::move(item));
+			}
+		});
+	}
+	bool bInOrder = true;
+	_tQueueBenchItem item;
+	for (int64_t total = static_cast<int64_t>(iProducers) * iItems; total > 0; total--)
+	{
+		queue.wait_and_pop(item);
+		if (item.sequence != vLastSequence[item.producer] + 1)
+			bInOrder = false;
+		vLastSequence[item.producer] = item.sequence;
+	}
+	for (auto &thread : vThreads)
+		thread.join();
+	double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+	if (!bInOrder)
+		return -1;
+	return (static_cast<double>(iProducers) * iItems) / dSeconds;
+}
+
+bool queue_tester(const std::string szFunction, std::string &szInput, std::string &szOutput)
+{
+	bool bSuccess = false;
+
+	std::vector<std::string> svInputs;
+	StringSplit(szInput, INPUTSEPERATOR, svInputs);
+
+	// benchmark
+	if (szFunction == "benchmark")
+	{
+		int iProducers = std::stoi(svInputs[0]);
+		int iItems = (svInputs.size() > 1) ? std::stoi(svInputs[1]) : 100000;
+		if ((iProducers < 1) || (iProducers > 16) || (iItems < 1))
+		{
+			szOutput = "producers should be 1-16";
+			return false;
+		}
+		concurrent_queue<_tQueueBenchItem> cqueue;
+		double dConcurrent = queue_benchmark(cqueue, iProducers, iItems);
+		mpsc_queue<_tQueueBenchItem> mqueue;
+		double dMpsc = queue_benchmark(mqueue, iProducers, iItems);
+		szOutput = std_format("concurrent_queue: %.0f items/s, mpsc_queue: %.0f items/s", dConcurrent, dMpsc);
+		bSuccess = (dConcurrent > 0) && (dMpsc > 0);
+	}
+	else
+	{
+		szOutput = "NOT FOUND!";
+	}
+	return bSuccess;
+}
+
 /* **********
 Main function
 ********** */
@@ -317,9 +401,17 @@ int main(int argc, char**argv)
 			return 1;
 		}
 	}
-	else if (false)
+	else if (szTestModule == "queue")
 	{
-		/* code */
+		try
+		{
+			bSuccess = queue_tester(szTestFunction, szTestInput, szTestOutput);
+		}
+		catch(const std::exception& e)
+		{
+			Log("Executing : %s (%s) | Crashed! (%s)", szTestFunction.c_str(), szTestModule.c_str(), e.what());
+			return 1;
+		}
 	}
 	else
 	{
@@ -41,10 +41,7 @@ std::string CdzVents::GetVersion()
 
 void CdzVents::EvaluateDzVents(lua_State *lua_state, const std::vector<CEventSystem::_tEventQueue> &items, const int secStatus)
 {
-	// reroute print library to Domoticz logger
-	luaL_openlibs(lua_state);
-	lua_pushcfunction(lua_state, l_domoticz_print);
-	lua_setglobal(lua_state, "print");
+	// the libraries and the print to the Domoticz logger are set up when the state is created
 
 	bool reasonTime = false;
 	bool reasonURL = false;
@@ -876,21 +873,63 @@ void CdzVents::ExportDomoticzDataToLua(lua_State *lua_state, const std::vector<C
 	struct tm ntime;
 	time_t checktime;
 
-	CLuaTable luaTable(lua_state, "domoticzData");
+	// Device tables are kept in the registry of the (pooled) Lua state between runs, only devices changed
+	// since the generation this state has seen, and the ones flagged as changed last run, are built again.
+	uint64_t exportedGeneration = 0;
+	bool bFullExport = true;
+	std::set<uint64_t> rebuildIDs;
+	if (lua_getfield(lua_state, LUA_REGISTRYINDEX, "dzvents_generation") == LUA_TNUMBER)
+	{
+		exportedGeneration = static_cast<uint64_t>(lua_tointeger(lua_state, -1));
+		bFullExport = (exportedGeneration < m_mainworker.m_eventsystem.m_devicestatesResetGeneration);
+	}
+	lua_pop(lua_state, 1);
+	if ((!bFullExport) && (lua_getfield(lua_state, LUA_REGISTRYINDEX, "dzvents_changed") == LUA_TTABLE))
+	{
+		lua_pushnil(lua_state);
+		while (lua_next(lua_state, -2) != 0)
+		{
+			rebuildIDs.insert(static_cast<uint64_t>(lua_tointeger(lua_state, -2)));
+			lua_pop(lua_state, 1);
+		}
+	}
+	lua_settop(lua_state, 0);
+	uint64_t generation = m_mainworker.m_eventsystem.m_devicestatesGeneration;
+	std::vector<std::pair<uint64_t, bool>> vDevices; // device ID, timed out
+	std::vector<uint64_t> vChangedIDs;
+
+	CLuaTable luaTable(lua_state, "dzvents_device_updates");
 
 	// First export all the devices.
 	for (const auto &state : m_mainworker.m_eventsystem.m_devicestates)
 	{
-		CEventSystem::_tDeviceStatus sitem = state.second;
+		const CEventSystem::_tDeviceStatus &stored = state.second;
+		if (stored.ID <= 0)
+			continue;
+
+		ParseSQLdatetime(checktime, ntime, stored.lastUpdate, tm1.tm_isdst);
+		bool timed_out = (now - checktime >= SensorTimeOut * 60);
+		vDevices.emplace_back(stored.ID, timed_out);
+
+		bool triggerDevice = false;
+		for (const auto &item : items)
+		{
+			if (stored.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
+				triggerDevice = true;
+		}
+		if ((!bFullExport) && (!triggerDevice) && (stored.generation <= exportedGeneration) && (rebuildIDs.find(stored.ID) == rebuildIDs.end()))
+			continue;
+		if (triggerDevice)
+			vChangedIDs.push_back(stored.ID);
+
+		CEventSystem::_tDeviceStatus sitem = stored;
 		const char *dev_type = RFX_Type_Desc(sitem.devType, 1);
 		const char *sub_type = RFX_Type_SubType_Desc(sitem.devType, sitem.subType);
 
-		bool triggerDevice = false;
 		for (const auto &item : items)
 		{
-			if (sitem.ID > 0 && sitem.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
+			if (sitem.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
 			{
-				triggerDevice = true;
 				sitem.lastUpdate = item.lastUpdate;
 				sitem.lastLevel = item.lastLevel;
 				sitem.sValue = item.sValue;
@@ -906,99 +945,105 @@ void CdzVents::ExportDomoticzDataToLua(lua_State *lua_state, const std::vector<C
 					sitem.JsonMapBool = item.JsonMapBool;
 			}
 		}
-
-		ParseSQLdatetime(checktime, ntime, sitem.lastUpdate, tm1.tm_isdst);
-		bool timed_out = (now - checktime >= SensorTimeOut * 60);
-		if (sitem.ID > 0)
+		if (triggerDevice)
 		{
-			luaTable.OpenSubTableEntry(index, 1, 14);
-
-			luaTable.AddString("name", sitem.deviceName);
-			luaTable.AddBool("protected", (sitem.protection == 1) );
-			luaTable.AddInteger("id", sitem.ID);
-			luaTable.AddInteger("iconNumber", sitem.customImage);
-			luaTable.AddString("image", sitem.image);
-			luaTable.AddString("baseType","device");
-			luaTable.AddString("deviceType", dev_type);
-			luaTable.AddString("subType", sub_type);
-			luaTable.AddString("switchType", Switch_Type_Desc((_eSwitchType)sitem.switchtype));
-			luaTable.AddInteger("switchTypeValue", sitem.switchtype);
-			luaTable.AddString("lastUpdate", sitem.lastUpdate);
-			luaTable.AddInteger("lastLevel", sitem.lastLevel);
-			luaTable.AddBool("changed", triggerDevice);
-			luaTable.AddBool("timedOut", timed_out);
-
-			//get all svalues separate
-			std::vector<std::string> strarray;
-			StringSplit(sitem.sValue, ";", strarray);
-
-			luaTable.OpenSubTableEntry("rawData", 0, 0);
-			for (size_t i = 0; i < strarray.size(); i++)
-				luaTable.AddString(i + 1, strarray[i]);
+			ParseSQLdatetime(checktime, ntime, sitem.lastUpdate, tm1.tm_isdst);
+			timed_out = (now - checktime >= SensorTimeOut * 60);
+			vDevices.back().second = timed_out;
+		}
 
-			luaTable.CloseSubTableEntry();
+		luaTable.OpenSubTableEntry(static_cast<int64_t>(sitem.ID), 1, 14);
+
+		luaTable.AddString("name", sitem.deviceName);
+		luaTable.AddBool("protected", (sitem.protection == 1) );
+		luaTable.AddInteger("id", sitem.ID);
+		luaTable.AddInteger("iconNumber", sitem.customImage);
+		luaTable.AddString("image", sitem.image);
+		luaTable.AddString("baseType","device");
+		luaTable.AddString("deviceType", dev_type);
+		luaTable.AddString("subType", sub_type);
+		luaTable.AddString("switchType", Switch_Type_Desc((_eSwitchType)sitem.switchtype));
+		luaTable.AddInteger("switchTypeValue", sitem.switchtype);
+		luaTable.AddString("lastUpdate", sitem.lastUpdate);
+		luaTable.AddInteger("lastLevel", sitem.lastLevel);
+		luaTable.AddBool("changed", triggerDevice);
+		luaTable.AddBool("timedOut", timed_out);
+
+		//get all svalues separate
+		std::vector<std::string> strarray;
+		StringSplit(sitem.sValue, ";", strarray);
+
+		luaTable.OpenSubTableEntry("rawData", 0, 0);
+		for (size_t i = 0; i < strarray.size(); i++)
+			luaTable.AddString(i + 1, strarray[i]);
 
-			luaTable.AddString("deviceID", sitem.deviceID);
-			luaTable.AddString("description", sitem.description);
-			luaTable.AddInteger("batteryLevel", sitem.batteryLevel);
-			luaTable.AddInteger("signalLevel", sitem.signalLevel);
+		luaTable.CloseSubTableEntry();
 
-			luaTable.OpenSubTableEntry("data", 0, 0);
-			luaTable.AddString("_state", sitem.nValueWording);
-			luaTable.AddInteger("_nValue", sitem.nValue);
-			luaTable.AddInteger("hardwareID", sitem.hardwareID);
-			if (sitem.devType == pTypeGeneral && sitem.subType == sTypeKwh)
-			{
-				long double value = 0.0F;
-				if (strarray.size() > 1)
-					value = atof(strarray[1].c_str());
-				luaTable.AddNumber("whTotal", value);
-				value = 0.0F;
-				if (!strarray.empty())
-					value = atof(strarray[0].c_str());
-				luaTable.AddNumber("whActual", value);
-			}
+		luaTable.AddString("deviceID", sitem.deviceID);
+		luaTable.AddString("description", sitem.description);
+		luaTable.AddInteger("batteryLevel", sitem.batteryLevel);
+		luaTable.AddInteger("signalLevel", sitem.signalLevel);
 
-			// Now see if we have additional fields from the JSON data
-			if (!sitem.JsonMapString.empty())
-			{
-				for (const auto &item : sitem.JsonMapString)
-				{
-					if (strcmp(m_mainworker.m_eventsystem.JsonMap[item.first].szOriginal, "LevelNames") == 0
-					    || strcmp(m_mainworker.m_eventsystem.JsonMap[item.first].szOriginal, "LevelActions") == 0)
-						luaTable.AddString(m_mainworker.m_eventsystem.JsonMap[item.first].szNew,
-								   base64_decode(item.second));
-					else
-						luaTable.AddString(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
-				}
-			}
+		luaTable.OpenSubTableEntry("data", 0, 0);
+		luaTable.AddString("_state", sitem.nValueWording);
+		luaTable.AddInteger("_nValue", sitem.nValue);
+		luaTable.AddInteger("hardwareID", sitem.hardwareID);
+		if (sitem.devType == pTypeGeneral && sitem.subType == sTypeKwh)
+		{
+			long double value = 0.0F;
+			if (strarray.size() > 1)
+				value = atof(strarray[1].c_str());
+			luaTable.AddNumber("whTotal", value);
+			value = 0.0F;
+			if (!strarray.empty())
+				value = atof(strarray[0].c_str());
+			luaTable.AddNumber("whActual", value);
+		}
 
-			if (!sitem.JsonMapFloat.empty())
+		// Now see if we have additional fields from the JSON data
+		if (!sitem.JsonMapString.empty())
+		{
+			for (const auto &item : sitem.JsonMapString)
 			{
-				for (const auto &item : sitem.JsonMapFloat)
-					luaTable.AddNumber(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
+				if (strcmp(m_mainworker.m_eventsystem.JsonMap[item.first].szOriginal, "LevelNames") == 0
+				    || strcmp(m_mainworker.m_eventsystem.JsonMap[item.first].szOriginal, "LevelActions") == 0)
+					luaTable.AddString(m_mainworker.m_eventsystem.JsonMap[item.first].szNew,
+							   base64_decode(item.second));
+				else
+					luaTable.AddString(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
 			}
+		}
 
-			if (!sitem.JsonMapInt.empty())
-			{
-				for (const auto &item : sitem.JsonMapInt)
-					luaTable.AddInteger(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
-			}
+		if (!sitem.JsonMapFloat.empty())
+		{
+			for (const auto &item : sitem.JsonMapFloat)
+				luaTable.AddNumber(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
+		}
 
-			if (!sitem.JsonMapBool.empty())
-			{
-				for (const auto &item : sitem.JsonMapBool)
-					luaTable.AddBool(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
-			}
+		if (!sitem.JsonMapInt.empty())
+		{
+			for (const auto &item : sitem.JsonMapInt)
+				luaTable.AddInteger(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
+		}
 
-			luaTable.CloseSubTableEntry();
-			luaTable.CloseSubTableEntry();
-			index++;
+		if (!sitem.JsonMapBool.empty())
+		{
+			for (const auto &item : sitem.JsonMapBool)
+				luaTable.AddBool(m_mainworker.m_eventsystem.JsonMap[item.first].szNew, item.second);
 		}
+
+		luaTable.CloseSubTableEntry();
+		luaTable.CloseSubTableEntry();
 	}
 
 	devicestatesMutexLock.unlock();
 
+	luaTable.Publish();
+	UpdateDeviceCache(lua_state, bFullExport, generation, vChangedIDs);
+	index += static_cast<int>(vDevices.size());
+
+	luaTable.InitTable(lua_state, "domoticzData", 0, 0);
+
 	// Now do the scenes and groups.
 	boost::shared_lock<boost::shared_mutex> scenesgroupsMutexLock(m_mainworker.m_eventsystem.m_scenesgroupsMutex);
 
@@ -1163,4 +1208,61 @@ void CdzVents::ExportDomoticzDataToLua(lua_State *lua_state, const std::vector<C
 	ExportHardwareData(luaTable, index, items);
 
 	luaTable.Publish();
+
+	// Devices go first in domoticzData, taken from the cache filled above
+	lua_getglobal(lua_state, "domoticzData");
+	int dataIdx = lua_gettop(lua_state);
+	lua_getfield(lua_state, LUA_REGISTRYINDEX, "dzvents_devices");
+	int cacheIdx = lua_gettop(lua_state);
+	int deviceIndex = 1;
+	for (const auto &device : vDevices)
+	{
+		if (lua_rawgeti(lua_state, cacheIdx, static_cast<lua_Integer>(device.first)) != LUA_TTABLE)
+		{
+			lua_pop(lua_state, 1);
+			lua_createtable(lua_state, 0, 0);
+		}
+		lua_pushboolean(lua_state, device.second);
+		lua_setfield(lua_state, -2, "timedOut");
+		lua_rawseti(lua_state, dataIdx, deviceIndex++);
+	}
+	lua_settop(lua_state, 0);
+}
+
+void CdzVents::UpdateDeviceCache(lua_State *lua_state, const bool bFullExport, const uint64_t generation, const std::vector<uint64_t> &vChangedIDs)
+{
+	// registry.dzvents_devices[id] = device table, for every entry of the published update table
+	if (bFullExport || (lua_getfield(lua_state, LUA_REGISTRYINDEX, "dzvents_devices") != LUA_TTABLE))
+	{
+		lua_settop(lua_state, 0);
+		lua_createtable(lua_state, 0, 0);
+		lua_pushvalue(lua_state, -1);
+		lua_setfield(lua_state, LUA_REGISTRYINDEX, "dzvents_devices");
+	}
+	int cacheIdx = lua_gettop(lua_state);
+
+	lua_getglobal(lua_state, "dzvents_device_updates");
+	int updatesIdx = lua_gettop(lua_state);
+	lua_pushnil(lua_state);
+	while (lua_next(lua_state, updatesIdx) != 0)
+	{
+		lua_pushvalue(lua_state, -2);
+		lua_insert(lua_state, -2);
+		lua_rawset(lua_state, cacheIdx);
+	}
+	lua_pushnil(lua_state);
+	lua_setglobal(lua_state, "dzvents_device_updates");
+
+	// devices exported with changed = true (and the event values) are built again next run
+	lua_createtable(lua_state, 0, static_cast<int>(vChangedIDs.size()));
+	for (const auto id : vChangedIDs)
+	{
+		lua_pushboolean(lua_state, 1);
+		lua_rawseti(lua_state, -2, static_cast<lua_Integer>(id));
+	}
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, "dzvents_changed");
+
+	lua_pushinteger(lua_state, static_cast<lua_Integer>(generation));
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, "dzvents_generation");
+	lua_settop(lua_state, 0);
 }
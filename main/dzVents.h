@@ -4,6 +4,7 @@
 
 class CdzVents
 {
+	friend class CEventSystem;
 public:
   CdzVents();
   ~CdzVents() = default;
@@ -50,6 +51,7 @@ private:
 	bool TriggerCustomEvent(lua_State *lua_state, const std::vector<_tLuaTableValues>& vLuaTable);
 	void ExportHardwareData(CLuaTable &luaTable, int& index, const std::vector<CEventSystem::_tEventQueue>& items);
 	void ExportDomoticzDataToLua(lua_State *lua_state, const std::vector<CEventSystem::_tEventQueue> &items);
+	void UpdateDeviceCache(lua_State *lua_state, bool bFullExport, uint64_t generation, const std::vector<uint64_t> &vChangedIDs);
 	void IterateTable(lua_State *lua_state, const int tIndex, std::vector<_tLuaTableValues> &vLuaTable);
 	void SetGlobalVariables(lua_State *lua_state, const bool reasonTime, const int secStatus);
 	void ProcessHttpResponse(lua_State *lua_state, const std::vector<CEventSystem::_tEventQueue> &items);
@@ -5,11 +5,13 @@
 #include "Logger.h"
 #include "WebServerHelper.h"
 #include "SQLHelper.h"
+#include "LatencyStats.h"
 #include "../push/FibaroPush.h"
 #include "../push/HttpPush.h"
 #include "../push/InfluxPush.h"
 #include "../push/GooglePubSubPush.h"
 #include "../push/MQTTPush.h"
+#include "../push/WebsocketPush.h"
 
 #include "../httpclient/HTTPClient.h"
 #include "../webserver/Base64.h"
@@ -202,6 +204,7 @@ CGooglePubSubPush m_googlepubsubpush;
 CHttpPush m_httppush;
 CInfluxPush m_influxpush;
 CMQTTPush m_mqttpush;
+CWebSocketPublisher m_wspublisher;
 
 
 namespace tcp {
@@ -217,6 +220,9 @@ MainWorker::MainWorker()
 	m_bStartHardware = false;
 	m_hardwareStartCounter = 0;
 
+	// the queues exist from the start, messages pushed before Start are processed once the workers run
+	CreateRxShards();
+
 	// Set default settings for web servers
 	m_webserver_settings.listening_address = "::"; // listen to all network interfaces
 	m_webserver_settings.listening_port = "8080";
@@ -1145,6 +1151,7 @@ bool MainWorker::Start()
 	m_influxpush.Start();
 	m_mqttpush.Start();
 	m_googlepubsubpush.Start();
+	m_wspublisher.Start();
 #ifdef PARSE_RFXCOM_DEVICE_LOG
 	if (m_bStartHardware == false)
 		m_bStartHardware = true;
@@ -1202,9 +1209,17 @@ bool MainWorker::Start()
 
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "MainWorker");
-	m_rxMessageThread = std::make_shared<std::thread>([this] { Do_Work_On_Rx_Messages(); });
-	SetThreadName(m_rxMessageThread->native_handle(), "MainWorkerRxMsg");
-	return (m_thread != nullptr) && (m_rxMessageThread != nullptr);
+	bool bRxStarted = true;
+	for (size_t ii = 0; ii < m_rxShards.size(); ii++)
+	{
+		m_rxShards[ii]->thread = std::make_shared<std::thread>([this, ii] { Do_Work_On_Rx_Messages(ii); });
+		if (m_rxShards.size() == 1)
+			SetThreadName(m_rxShards[ii]->thread->native_handle(), "MainWorkerRxMsg");
+		else
+			SetThreadName(m_rxShards[ii]->thread->native_handle(), std_format("MainWorkerRx%d", static_cast<int>(ii)).c_str());
+		bRxStarted &= (m_rxShards[ii]->thread != nullptr);
+	}
+	return (m_thread != nullptr) && bRxStarted;
 }
 
 
@@ -1215,12 +1230,18 @@ bool MainWorker::Stop()
 		m_notificationsystem.NotifyWait(Notification::DZ_STOP, Notification::STATUS_INFO); // blocking call
 	}
 
-	if (m_rxMessageThread) {
-		// Stop RxMessage thread before hardware to avoid NULL pointer exception
+	if (!m_rxShards.empty()) {
+		// Stop RxMessage threads before hardware to avoid NULL pointer exception
 		m_TaskRXMessage.RequestStop();
 		UnlockRxMessageQueue();
-		m_rxMessageThread->join();
-		m_rxMessageThread.reset();
+		for (auto &shard : m_rxShards)
+		{
+			if (shard->thread)
+			{
+				shard->thread->join();
+				shard->thread.reset();
+			}
+		}
 	}
 	if (m_thread)
 	{
@@ -1236,6 +1257,7 @@ bool MainWorker::Stop()
 		m_influxpush.Stop();
 		m_mqttpush.Stop();
 		m_googlepubsubpush.Stop();
+		m_wspublisher.Stop();
 #ifdef ENABLE_PYTHON
 		m_pluginsystem.StopPluginSystem();
 #endif
@@ -1428,6 +1450,9 @@ void MainWorker::HandleAutomaticBackups()
 
 	DIR* lDir;
 	Notification::_eStatus backupStatus;
+	const bool bCompress = m_sql.IsBackupCompressionEnabled();
+	const std::string szExtension = (bCompress) ? ".db.gz" : ".db";
+	CSQLHelper::_tBackupResult backupResult;
 	//struct dirent *ent;
 
 
@@ -1437,14 +1462,16 @@ void MainWorker::HandleAutomaticBackups()
 		{
 			Json::Value backupInfo;
 			std::stringstream sTmp;
-			sTmp << "backup-hour-" << std::setw(2) << std::setfill('0') << hour << "-" << szInstanceName << ".db";
+			sTmp << "backup-hour-" << std::setw(2) << std::setfill('0') << hour << "-" << szInstanceName << szExtension;
 
 			backupInfo["type"] = "Hour";
 			backupInfo["location"] = sbackup_DirH + sTmp.str();
-			if (m_sql.BackupDatabase(backupInfo["location"].asString())) {
+			if (m_sql.BackupDatabase(backupInfo["location"].asString(), bCompress, &backupResult)) {
 				m_sql.SetLastBackupNo(backupInfo["type"].asString().c_str(), hour);
 
 				backupStatus = Notification::STATUS_OK;
+				backupInfo["size"] = Json::UInt64(backupResult.FileSize);
+				backupInfo["throughput"] = backupResult.MBPerSecond;
 			}
 			else {
 				backupStatus = Notification::STATUS_ERROR;
@@ -1466,13 +1493,15 @@ void MainWorker::HandleAutomaticBackups()
 			now = mytime(nullptr);
 			Json::Value backupInfo;
 			std::stringstream sTmp;
-			sTmp << "backup-day-" << std::setw(2) << std::setfill('0') << day << "-" << szInstanceName << ".db";
+			sTmp << "backup-day-" << std::setw(2) << std::setfill('0') << day << "-" << szInstanceName << szExtension;
 
 			backupInfo["type"] = "Day";
 			backupInfo["location"] = sbackup_DirD + sTmp.str();
-			if (m_sql.BackupDatabase(backupInfo["location"].asString())) {
+			if (m_sql.BackupDatabase(backupInfo["location"].asString(), bCompress, &backupResult)) {
 				m_sql.SetLastBackupNo(backupInfo["type"].asString().c_str(), day);
 				backupStatus = Notification::STATUS_OK;
+				backupInfo["size"] = Json::UInt64(backupResult.FileSize);
+				backupInfo["throughput"] = backupResult.MBPerSecond;
 			}
 			else {
 				backupStatus = Notification::STATUS_ERROR;
@@ -1493,13 +1522,15 @@ void MainWorker::HandleAutomaticBackups()
 			now = mytime(nullptr);
 			Json::Value backupInfo;
 			std::stringstream sTmp;
-			sTmp << "backup-month-" << std::setw(2) << std::setfill('0') << month + 1 << "-" << szInstanceName << ".db";
+			sTmp << "backup-month-" << std::setw(2) << std::setfill('0') << month + 1 << "-" << szInstanceName << szExtension;
 
 			backupInfo["type"] = "Month";
 			backupInfo["location"] = sbackup_DirM + sTmp.str();
-			if (m_sql.BackupDatabase(backupInfo["location"].asString())) {
+			if (m_sql.BackupDatabase(backupInfo["location"].asString(), bCompress, &backupResult)) {
 				m_sql.SetLastBackupNo(backupInfo["type"].asString().c_str(), month);
 				backupStatus = Notification::STATUS_OK;
+				backupInfo["size"] = Json::UInt64(backupResult.FileSize);
+				backupInfo["throughput"] = backupResult.MBPerSecond;
 			}
 			else {
 				backupStatus = Notification::STATUS_ERROR;
@@ -1916,15 +1947,17 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 		pRXCommand[2]);
 #endif
 
-	// Push item to queue
-	m_rxMessageQueue.push(rxMessage);
+	// Push item to the queue of its shard, all messages of one hardware are handled by the same worker to keep them in order
+	rxMessage.EnqueueTime = std::chrono::steady_clock::now();
+	queue_element_trigger* trigger = rxMessage.trigger;
+	m_rxShards[static_cast<size_t>(rxMessage.hardwareId) % m_rxShards.size()]->queue.push(std::move(rxMessage));
 
-	if (rxMessage.trigger != nullptr)
+	if (trigger != nullptr)
 	{
 #ifdef DEBUG_RXQUEUE
 		_log.Log(LOG_STATUS, "RxQueue: wait for rxMessage(%lu) to be processed...", rxMessage.rxMessageIdx);
 #endif
-		while (!rxMessage.trigger->timed_wait(std::chrono::duration<int>(1))) {
+		while (!trigger->timed_wait(std::chrono::duration<int>(1))) {
 #ifdef DEBUG_RXQUEUE
 			_log.Log(LOG_STATUS, "RxQueue: wait 1s for rxMessage(%lu) to be processed...", rxMessage.rxMessageIdx);
 #endif
@@ -1938,7 +1971,7 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 			_log.Log(LOG_STATUS, "RxQueue: rxMessage(%lu) processed", rxMessage.rxMessageIdx);
 		}
 #endif
-		delete rxMessage.trigger;
+		delete trigger;
 	}
 }
 
@@ -1947,24 +1980,74 @@ void MainWorker::UnlockRxMessageQueue()
 #ifdef DEBUG_RXQUEUE
 	_log.Log(LOG_STATUS, "RxQueue: unlock queue using dummy message");
 #endif
-	// Push dummy message to unlock queue
-	_tRxQueueItem rxMessage;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = -1;
-	rxMessage.trigger = nullptr;
-	rxMessage.BatteryLevel = 0;
-	m_rxMessageQueue.push(rxMessage);
+	// Push dummy message to unlock the queue of each shard
+	for (auto &shard : m_rxShards)
+	{
+		_tRxQueueItem rxMessage;
+		rxMessage.rxMessageIdx = m_rxMessageIdx++;
+		rxMessage.hardwareId = -1;
+		rxMessage.trigger = nullptr;
+		rxMessage.BatteryLevel = 0;
+		shard->queue.push(std::move(rxMessage));
+	}
+}
+
+void MainWorker::SetRxWorkerCount(const int count)
+{
+	m_rxWorkerCount = static_cast<size_t>(std::max(1, std::min(count, 32)));
+	CreateRxShards();
+}
+
+void MainWorker::CreateRxShards()
+{
+	// before Start, nothing has been pushed yet
+	m_rxShards.clear();
+	for (size_t ii = 0; ii < m_rxWorkerCount; ii++)
+		m_rxShards.push_back(std::make_unique<_tRxShard>());
+}
+
+void MainWorker::SetRxProcessedCallback(const std::function<void(uint64_t)> &callback)
+{
+	// once this returns no worker is still calling the previous callback
+	std::lock_guard<std::mutex> l(m_rxProcessedCallbackMutex);
+	m_rxProcessedCallback = callback;
+	m_bHaveRxProcessedCallback = (callback != nullptr);
+}
+
+std::vector<MainWorker::_tRxQueueStats> MainWorker::GetRxQueueStats()
+{
+	std::vector<_tRxQueueStats> ret;
+	for (const auto &shard : m_rxShards)
+	{
+		_tRxQueueStats stats;
+		stats.QueueDepth = shard->queue.size();
+		stats.Processed = shard->processed;
+		stats.AvgLatencyUs = (stats.Processed > 0) ? shard->totalLatencyUs / stats.Processed : 0;
+		stats.MaxLatencyUs = shard->maxLatencyUs;
+		ret.push_back(stats);
+	}
+	return ret;
+}
+
+_tTrendCalculator::_eTendencyType MainWorker::GetTrendState(const uint64_t tID)
+{
+	std::lock_guard<std::mutex> l(m_calculatormutex);
+	auto itt = m_trend_calculator.find(tID);
+	if (itt == m_trend_calculator.end())
+		return _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+	return itt->second.m_state;
 }
 
-void MainWorker::Do_Work_On_Rx_Messages()
+void MainWorker::Do_Work_On_Rx_Messages(const size_t shardIdx)
 {
-	_log.Log(LOG_STATUS, "RxQueue: queue worker started...");
+	_tRxShard &shard = *m_rxShards[shardIdx];
+	_log.Log(LOG_STATUS, "RxQueue: queue worker %d started...", static_cast<int>(shardIdx));
 
 	while (!m_TaskRXMessage.IsStopRequested(0))
 	{
 		// Wait and pop next message or timeout
 		_tRxQueueItem rxQItem;
-		bool hasPopped = m_rxMessageQueue.timed_wait_and_pop<std::chrono::duration<int> >(rxQItem, std::chrono::duration<int>(5));
+		bool hasPopped = shard.queue.timed_wait_and_pop<std::chrono::duration<int> >(rxQItem, std::chrono::duration<int>(5));
 		// (if no message for 5 seconds, returns anyway to check m_TaskRXMessage.IsStopRequested)
 
 		if (!hasPopped) {
@@ -2030,14 +2113,30 @@ void MainWorker::Do_Work_On_Rx_Messages()
 			pRXCommand[1],
 			pRXCommand[2]);
 #endif
+		const auto tDecodeStart = std::chrono::steady_clock::now();
 		ProcessRXMessage(pHardware, pRXCommand, rxQItem.Name.c_str(), rxQItem.BatteryLevel, rxQItem.UserName.c_str());
 		if (rxQItem.trigger != nullptr)
 		{
 			rxQItem.trigger->popped();
 		}
+		const auto tProcessed = std::chrono::steady_clock::now();
+		m_latencystats.Record(CLatencyStats::STAGE_RX_QUEUE_WAIT, std::chrono::duration_cast<std::chrono::microseconds>(tDecodeStart - rxQItem.EnqueueTime).count());
+		m_latencystats.Record(CLatencyStats::STAGE_RX_DECODE, std::chrono::duration_cast<std::chrono::microseconds>(tProcessed - tDecodeStart).count());
+
+		uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(tProcessed - rxQItem.EnqueueTime).count();
+		shard.processed++;
+		shard.totalLatencyUs += latency;
+		if (latency > shard.maxLatencyUs)
+			shard.maxLatencyUs = latency;
+		if (m_bHaveRxProcessedCallback)
+		{
+			std::lock_guard<std::mutex> l(m_rxProcessedCallbackMutex);
+			if (m_rxProcessedCallback)
+				m_rxProcessedCallback(latency);
+		}
 	}
 
-	_log.Log(LOG_STATUS, "RxQueue: queue worker stopped...");
+	_log.Log(LOG_STATUS, "RxQueue: queue worker %d stopped...", static_cast<int>(shardIdx));
 }
 
 void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const uint8_t* pRXCommand, const char* defaultName, const int BatteryLevel, const char* userName)
@@ -2281,7 +2380,7 @@ void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const
 
 	if ((BatteryLevel != -1) && (procResult.bProcessBatteryValue))
 	{
-		m_sql.safe_query("UPDATE DeviceStatus SET BatteryLevel=%d WHERE (ID==%" PRIu64 ")", BatteryLevel, DeviceRowIdx);
+		m_sql.UpdateBatteryLevel(DeviceRowIdx, BatteryLevel);
 		m_eventsystem.UpdateBatteryLevel(DeviceRowIdx, BatteryLevel); //GizMoCuz, temporarily... 
 	}
 
@@ -3086,7 +3185,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 	//Apply user defined offset
 	dDirection = std::fmod(dDirection + AddjValue2, 360.0);
 
-	dDirection = m_wind_calculator[windID].AddValueAndReturnAvarage(dDirection);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		dDirection = m_wind_calculator[windID].AddValueAndReturnAvarage(dDirection);
+	}
 
 	std::string strDirection;
 	if (dDirection > 348.75 || dDirection < 11.26)
@@ -3140,7 +3242,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 		intSpeed = intGust;
 	}
 
-	m_wind_calculator[windID].SetSpeedGust(intSpeed, intGust);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_wind_calculator[windID].SetSpeedGust(intSpeed, intGust);
+	}
 
 	float temp = 0, chill = 0;
 	if (subType != sTypeWINDNoTempNoChill)
@@ -3210,7 +3315,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(chill), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(chill), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	if (_log.IsDebugLevelEnabled(DEBUG_RECEIVED))
 	{
@@ -3349,7 +3457,10 @@ void MainWorker::decode_Temp(const CDomoticzHardwareBase* pHardware, const tRBUF
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	bool bHandledNotification = false;
 	uint8_t humidity = 0;
@@ -3664,7 +3775,10 @@ void MainWorker::decode_TempHum(const CDomoticzHardwareBase* pHardware, const tR
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
@@ -3875,7 +3989,10 @@ void MainWorker::decode_TempHumBaro(const CDomoticzHardwareBase* pHardware, cons
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	//calculate Altitude
 	//float seaLevelPressure=101325.0f;
@@ -4011,7 +4128,10 @@ void MainWorker::decode_TempBaro(const CDomoticzHardwareBase* pHardware, const t
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
@@ -4115,7 +4235,10 @@ void MainWorker::decode_TempRain(const CDomoticzHardwareBase* pHardware, const t
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> l(m_calculatormutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	sprintf(szTmp, "%.1f", temp);
 	uint64_t DevRowIdxTemp = m_sql.UpdateValue(pHardware->m_HwdID, 0, ID.c_str(), Unit, pTypeTEMP, sTypeTEMP3, SignalLevel, BatteryLevel, cmnd, szTmp, procResult.DeviceName, true, procResult.Username.c_str());
@@ -11250,17 +11373,20 @@ void MainWorker::decode_DDxxxx(const CDomoticzHardwareBase* pHardware, const tRB
 
 bool MainWorker::GetSensorData(const uint64_t idx, int& nValue, std::string& sValue)
 {
-	std::vector<std::vector<std::string> > result;
 	char szTmp[100];
-	result = m_sql.safe_query("SELECT [Type],[SubType],[nValue],[sValue],[SwitchType] FROM DeviceStatus WHERE (ID==%" PRIu64 ")", idx);
-	if (result.empty())
-		return false;
-	std::vector<std::string> sd = result[0];
-	int devType = atoi(sd[0].c_str());
-	int subType = atoi(sd[1].c_str());
-	nValue = atoi(sd[2].c_str());
-	sValue = sd[3];
-	_eMeterType metertype = (_eMeterType)atoi(sd[4].c_str());
+	int devType, subType;
+	_eMeterType metertype;
+	{
+		CSQLStatement stmt(m_sql, "SELECT [Type],[SubType],[nValue],[sValue],[SwitchType] FROM DeviceStatus WHERE (ID==?)");
+		stmt.Bind(idx);
+		if (!stmt.Step())
+			return false;
+		devType = stmt.GetInt(0);
+		subType = stmt.GetInt(1);
+		nValue = stmt.GetInt(2);
+		sValue = stmt.GetString(3);
+		metertype = (_eMeterType)stmt.GetInt(4);
+	}
 
 	//Special cases
 	if ((devType == pTypeP1Power) && (subType == sTypeP1Power))
@@ -13263,6 +13389,9 @@ bool MainWorker::SwitchScene(const std::string& idx, const std::string& switchcm
 
 bool MainWorker::SwitchScene(const uint64_t idx, std::string switchcmd, const std::string& User)
 {
+	//Scene logic should work on committed device states
+	m_sql.FlushWrites();
+
 	std::vector<std::vector<std::string> > result;
 	int nValue = (switchcmd == "On") ? 1 : 0;
 
@@ -13765,17 +13894,20 @@ void MainWorker::HeartbeatCheck()
 bool MainWorker::UpdateDevice(const int DevIdx, const int nValue, const std::string& sValue, const std::string& userName, const int signallevel, const int batterylevel, const bool parseTrigger)
 {
 	// Get the raw device parameters
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT HardwareID, OrgHardwareID, DeviceID, Unit, Type, SubType FROM DeviceStatus WHERE (ID==%d)", DevIdx);
-	if (result.empty())
-		return false;
-
-	int HardwareID = std::stoi(result[0][0]);
-	int OrgHardwareID = std::stoi(result[0][1]);
-	std::string DeviceID = result[0][2];
-	int unit = std::stoi(result[0][3]);
-	int devType = std::stoi(result[0][4]);
-	int subType = std::stoi(result[0][5]);
+	int HardwareID, OrgHardwareID, unit, devType, subType;
+	std::string DeviceID;
+	{
+		CSQLStatement stmt(m_sql, "SELECT HardwareID, OrgHardwareID, DeviceID, Unit, Type, SubType FROM DeviceStatus WHERE (ID==?)");
+		stmt.Bind(DevIdx);
+		if (!stmt.Step())
+			return false;
+		HardwareID = stmt.GetInt(0);
+		OrgHardwareID = stmt.GetInt(1);
+		DeviceID = stmt.GetString(2);
+		unit = stmt.GetInt(3);
+		devType = stmt.GetInt(4);
+		subType = stmt.GetInt(5);
+	}
 
 	return UpdateDevice(HardwareID, OrgHardwareID, DeviceID, unit, devType, subType, nValue, sValue, userName, signallevel, batterylevel, parseTrigger);
 }
@@ -13918,6 +14050,7 @@ bool MainWorker::UpdateDevice(const int HardwareID, const int OrgHardwareID, con
 				if (temp != 12345.0F)
 				{
 					uint64_t tID = ((uint64_t)(HardwareID & 0x7FFFFFFF) << 32) | (devidx & 0x7FFFFFFF);
+					std::lock_guard<std::mutex> l(m_calculatormutex);
 					m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
 				}
 			}
@@ -6,6 +6,7 @@
 #include "EventSystem.h"
 #include "NotificationSystem.h"
 #include "Camera.h"
+#include <atomic>
 #include <deque>
 #include "WindCalculation.h"
 #include "TrendCalculator.h"
@@ -52,6 +53,20 @@ public:
 	void DecodeRXMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 	void PushAndWaitRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 
+	struct _tRxQueueStats
+	{
+		size_t QueueDepth;
+		uint64_t Processed;
+		uint64_t AvgLatencyUs;
+		uint64_t MaxLatencyUs;
+	};
+	// Number of RX worker threads, messages are sharded by hardware id (must be called before Start)
+	void SetRxWorkerCount(int count);
+	std::vector<_tRxQueueStats> GetRxQueueStats();
+	// Called by the RX workers with the latency (push to processed) of every message, used by the ingestion benchmark.
+	// It can be replaced at any time, the workers call it under a mutex, so once this returns the previous one is no longer called
+	void SetRxProcessedCallback(const std::function<void(uint64_t)> &callback);
+
 	enum eSwitchLightReturnCode
 	{
 		SL_ERROR = 0,			//there was a problem switching the light
@@ -131,6 +146,8 @@ public:
 	std::vector<std::string> m_webthemes;
 	std::map<uint16_t, _tWindCalculator> m_wind_calculator;
 	std::map<uint64_t, _tTrendCalculator> m_trend_calculator;
+	std::mutex m_calculatormutex; // protects m_wind_calculator and m_trend_calculator
+	_tTrendCalculator::_eTendencyType GetTrendState(uint64_t tID);
 
 	time_t m_LastHeartbeat = 0;
 private:
@@ -192,9 +209,8 @@ private:
 
 	// RxMessage queue resources
 	volatile unsigned long m_rxMessageIdx;
-	std::shared_ptr<std::thread> m_rxMessageThread;
 	StoppableTask m_TaskRXMessage;
-	void Do_Work_On_Rx_Messages();
+	void Do_Work_On_Rx_Messages(size_t shardIdx);
 	struct _tRxQueueItem {
 		std::string Name;
 		int BatteryLevel;
@@ -204,8 +220,22 @@ private:
 		boost::uint16_t crc;
 		queue_element_trigger* trigger;
 		std::string UserName;
+		std::chrono::steady_clock::time_point EnqueueTime;
+	};
+	struct _tRxShard
+	{
+		mpsc_queue<_tRxQueueItem> queue;
+		std::shared_ptr<std::thread> thread;
+		std::atomic<uint64_t> processed{ 0 };
+		std::atomic<uint64_t> totalLatencyUs{ 0 };
+		std::atomic<uint64_t> maxLatencyUs{ 0 };
 	};
-	concurrent_queue<_tRxQueueItem> m_rxMessageQueue;
+	size_t m_rxWorkerCount = 1;
+	std::vector<std::unique_ptr<_tRxShard>> m_rxShards;
+	void CreateRxShards();
+	std::mutex m_rxProcessedCallbackMutex; // protects m_rxProcessedCallback
+	std::function<void(uint64_t)> m_rxProcessedCallback;
+	std::atomic<bool> m_bHaveRxProcessedCallback{ false };
 	void UnlockRxMessageQueue();
 	void PushRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 	void CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName, bool wait);
@@ -0,0 +1,223 @@
+/*
+ * mpsc_queue.h
+ *
+ *  Multi producer / single consumer queue, usable in place of concurrent_queue
+ *  when exactly one thread pops.
+ *
+ *  Items are stored in a pre-allocated ring of slots, producers reserve a slot with one
+ *  compare-and-swap and never take a lock (bounded ring, based on the Vyukov bounded queue).
+ *  When the ring is full items go to a mutex guarded overflow list, so a producer never blocks
+ *  or drops an item, and the consumer only takes from that list once the ring is drained so the
+ *  order of each producer is kept.
+ *  The consumer only sleeps on a condition variable when there is nothing to pop; producers just
+ *  touch that mutex when the consumer is actually waiting.
+ */
+#pragma once
+#ifndef MAIN_MPSC_QUEUE_H_
+#define MAIN_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+template<typename Data>
+class mpsc_queue {
+private:
+	struct cell {
+		std::atomic<size_t> sequence;
+		Data data;
+	};
+
+	std::unique_ptr<cell[]> m_buffer;
+	size_t m_mask;
+
+	// keep the producer and consumer positions on different cache lines
+	char m_pad0[64];
+	std::atomic<size_t> m_enqueue_pos;
+	char m_pad1[64];
+	std::atomic<size_t> m_dequeue_pos;
+	char m_pad2[64];
+
+	std::atomic<size_t> m_overflow_count;
+	std::mutex m_overflow_mutex;
+	std::deque<Data> m_overflow;
+
+	std::atomic<bool> m_waiting;
+	std::mutex m_wait_mutex;
+	std::condition_variable m_wait_condition;
+
+	template<typename T>
+	void push_impl(T&& data) {
+		if (m_overflow_count.load(std::memory_order_acquire) == 0) {
+			size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+			for (;;) {
+				cell* pCell = &m_buffer[pos & m_mask];
+				size_t seq = pCell->sequence.load(std::memory_order_acquire);
+				intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+				if (dif == 0) {
+					if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						pCell->data = std::forward<T>(data);
+						pCell->sequence.store(pos + 1, std::memory_order_release);
+						wake_consumer();
+						return;
+					}
+				}
+				else if (dif < 0) {
+					// ring is full
+					break;
+				}
+				else {
+					pos = m_enqueue_pos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_overflow_mutex);
+			m_overflow.push_back(std::forward<T>(data));
+			m_overflow_count.fetch_add(1, std::memory_order_release);
+		}
+		wake_consumer();
+	}
+
+	void wake_consumer() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!m_waiting.load(std::memory_order_relaxed))
+			return;
+		std::unique_lock<std::mutex> lock(m_wait_mutex);
+		lock.unlock();
+		m_wait_condition.notify_one();
+	}
+
+	bool ring_ready() const {
+		size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		size_t seq = m_buffer[pos & m_mask].sequence.load(std::memory_order_acquire);
+		return (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1)) >= 0;
+	}
+
+	bool ring_empty() const {
+		return m_enqueue_pos.load(std::memory_order_acquire) == m_dequeue_pos.load(std::memory_order_relaxed);
+	}
+
+	bool can_pop() const {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ring_ready())
+			return true;
+		return (m_overflow_count.load(std::memory_order_acquire) != 0) && ring_empty();
+	}
+
+	bool pop_ring(Data& popped_value) {
+		size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		cell* pCell = &m_buffer[pos & m_mask];
+		size_t seq = pCell->sequence.load(std::memory_order_acquire);
+		if ((static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1)) < 0)
+			return false;
+		popped_value = std::move(pCell->data);
+		pCell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		m_dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool pop_overflow(Data& popped_value) {
+		// only take from the overflow list when the ring is drained, ring items are older
+		if ((m_overflow_count.load(std::memory_order_acquire) == 0) || (!ring_empty()))
+			return false;
+		std::unique_lock<std::mutex> lock(m_overflow_mutex);
+		if (m_overflow.empty())
+			return false;
+		popped_value = std::move(m_overflow.front());
+		m_overflow.pop_front();
+		m_overflow_count.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+public:
+	explicit mpsc_queue(size_t capacity = 1024) {
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		m_buffer.reset(new cell[size]);
+		m_mask = size - 1;
+		for (size_t ii = 0; ii < size; ii++)
+			m_buffer[ii].sequence.store(ii, std::memory_order_relaxed);
+		m_enqueue_pos.store(0, std::memory_order_relaxed);
+		m_dequeue_pos.store(0, std::memory_order_relaxed);
+		m_overflow_count.store(0, std::memory_order_relaxed);
+		m_waiting.store(false, std::memory_order_relaxed);
+	}
+	mpsc_queue(const mpsc_queue&) = delete;
+	mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+	// approximate when producers are active
+	size_t size() const {
+		return (m_enqueue_pos.load(std::memory_order_relaxed) - m_dequeue_pos.load(std::memory_order_relaxed)) + m_overflow_count.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	// consumer only
+	void clear() {
+		Data dummy;
+		while (try_pop(dummy)) {
+		}
+	}
+
+	void push(Data const& data) {
+		push_impl(data);
+	}
+
+	void push(Data&& data) {
+		push_impl(std::move(data));
+	}
+
+	// consumer only
+	bool try_pop(Data& popped_value) {
+		if (pop_ring(popped_value))
+			return true;
+		return pop_overflow(popped_value);
+	}
+
+	// consumer only, moves all available items to the end of popped_values and returns how many
+	size_t pop_all(std::vector<Data>& popped_values) {
+		size_t count = 0;
+		Data item;
+		while (try_pop(item)) {
+			popped_values.push_back(std::move(item));
+			count++;
+		}
+		return count;
+	}
+
+	// consumer only
+	void wait_and_pop(Data& popped_value) {
+		while (!try_pop(popped_value)) {
+			std::unique_lock<std::mutex> lock(m_wait_mutex);
+			m_waiting.store(true, std::memory_order_relaxed);
+			m_wait_condition.wait(lock, [this] { return can_pop(); });
+			m_waiting.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	// consumer only
+	template<typename Duration>
+	bool timed_wait_and_pop(Data& popped_value, Duration const& wait_duration) {
+		if (try_pop(popped_value))
+			return true;
+		{
+			std::unique_lock<std::mutex> lock(m_wait_mutex);
+			m_waiting.store(true, std::memory_order_relaxed);
+			bool bReady = m_wait_condition.wait_for(lock, wait_duration, [this] { return can_pop(); });
+			m_waiting.store(false, std::memory_order_relaxed);
+			if (!bReady)
+				return false;
+		}
+		return try_pop(popped_value);
+	}
+};
+
+#endif /* MAIN_MPSC_QUEUE_H_ */
@@ -61,5 +61,6 @@ typedef unsigned char       BYTE;
 
 // rarely changing project-specific
 #include "concurrent_queue.h"
+#include "mpsc_queue.h"
 #include "localtime_r.h"
 #include "StoppableTask.h"
@@ -866,7 +866,7 @@ bool CNotificationHelper::CheckAndHandleNotification(
 		return false;
 
 	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+	result = m_sql.safe_query_read("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
 	if (result.empty())
 		return false;
 
@@ -926,7 +926,7 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	pvalue = szTmp;
 
 	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+	result = m_sql.safe_query_read("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
 	if (result.empty())
 		return false;
 	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|";
@@ -1012,7 +1012,7 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 
 	std::vector<std::vector<std::string> > result;
 
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
+	result = m_sql.safe_query_read("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
 		Idx);
 	if (result.empty())
 		return false;
@@ -1124,7 +1124,7 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 		return false;
 	std::vector<std::vector<std::string> > result;
 
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage, Options FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
+	result = m_sql.safe_query_read("SELECT SwitchType, CustomImage, Options FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
 		Idx);
 	if (result.empty())
 		return false;
@@ -1216,7 +1216,7 @@ bool CNotificationHelper::CheckAndHandleRainNotification(
 {
 	std::vector<std::vector<std::string> > result;
 
-	result = m_sql.safe_query("SELECT AddjValue,AddjMulti FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
+	result = m_sql.safe_query_read("SELECT AddjValue,AddjMulti FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
 		Idx);
 	if (result.empty())
 		return false;
@@ -1248,7 +1248,7 @@ bool CNotificationHelper::CheckAndHandleRainNotification(
 	}
 	else
 	{
-		result = m_sql.safe_query("SELECT MIN(Total) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')",
+		result = m_sql.safe_query_read("SELECT MIN(Total) FROM Rain WHERE (DeviceRowID=%" PRIu64 " AND Date>='%q')",
 			Idx, szDateEnd);
 		if (!result.empty())
 		{
@@ -1343,7 +1343,7 @@ void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 						if (SystemUptime() < SensorTimeOut * 60 && (!bRecoveryMessage || n2.SendAlways))
 							continue;
 						std::vector<std::vector<std::string> > result;
-						result = m_sql.safe_query("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+						result = m_sql.safe_query_read("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
 						if (result.empty())
 							continue;
 						szExtraData = "|Name=" + n2.DeviceName + "|SwitchType=" + result[0][0] + "|";
@@ -1587,7 +1587,7 @@ void CNotificationHelper::ReloadNotifications()
 	m_sql.GetPreferencesVar("NotificationSensorInterval", m_NotificationSensorInterval);
 	m_sql.GetPreferencesVar("NotificationSwitchInterval", m_NotificationSwitchInterval);
 
-	result = m_sql.safe_query("SELECT ID, DeviceRowID, Active, Params, CustomMessage, CustomAction, ActiveSystems, Priority, SendAlways, LastSend FROM Notifications ORDER BY DeviceRowID");
+	result = m_sql.safe_query_read("SELECT ID, DeviceRowID, Active, Params, CustomMessage, CustomAction, ActiveSystems, Priority, SendAlways, LastSend FROM Notifications ORDER BY DeviceRowID");
 	if (result.empty())
 		return;
 
@@ -1637,7 +1637,7 @@ void CNotificationHelper::ReloadNotifications()
 		StringSplit(notification.Params, ";", splitresults);
 		if (splitresults[0] == ttype) {
 			std::vector<std::vector<std::string> > result2;
-			result2 = m_sql.safe_query(
+			result2 = m_sql.safe_query_read(
 				"SELECT B.Name, B.LastUpdate "
 				"FROM Notifications AS A "
 				"LEFT OUTER JOIN DeviceStatus AS B "
@@ -7,6 +7,7 @@
 #include "../main/Logger.h"
 #include "../main/mainworker.h"
 #include "../main/RFXtrx.h"
+#include "../main/LatencyStats.h"
 #include "../main/SQLHelper.h"
 #include "../webserver/Base64.h"
 #include "../main/WebServer.h"
@@ -46,6 +47,8 @@ void CFibaroPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowId
 {
 	if (m_bLinkActive)
 	{
+		static CLatencyHistogram *pLatency = m_latencystats.Get(CLatencyStats::STAGE_PUSH_LINK, "fibaro");
+		CLatencyTimer latencyTimer(pLatency);
 		DoFibaroPush(DeviceRowIdx);
 	}
 }
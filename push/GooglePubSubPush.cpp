@@ -5,6 +5,7 @@
 #include "../main/Helper.h"
 #include "../main/Logger.h"
 #include "../main/RFXtrx.h"
+#include "../main/LatencyStats.h"
 #include "../main/SQLHelper.h"
 #include "../main/mainworker.h"
 #include "../main/WebServer.h"
@@ -61,6 +62,8 @@ void CGooglePubSubPush::OnDeviceReceived(const int m_HwdID, const uint64_t Devic
 {
 	if (m_bLinkActive)
 	{
+		static CLatencyHistogram *pLatency = m_latencystats.Get(CLatencyStats::STAGE_PUSH_LINK, "googlepubsub");
+		CLatencyTimer latencyTimer(pLatency);
 		DoGooglePubSubPush(DeviceRowIdx);
 	}
 }
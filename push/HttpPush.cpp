@@ -5,6 +5,7 @@
 #include "../main/Logger.h"
 #include "../hardware/hardwaretypes.h"
 #include "../main/RFXtrx.h"
+#include "../main/LatencyStats.h"
 #include "../main/SQLHelper.h"
 #include "../webserver/Base64.h"
 #include "../main/WebServer.h"
@@ -200,7 +201,6 @@ void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 		replaceAll(httpData, "%h", std::string(hostname));
 		replaceAll(httpData, "%idx", sdeviceId);
 
-		std::string sResult;
 		std::vector<std::string> ExtraHeaders;
 		if (httpAuthInt == 1) {			// BASIC authentication
 			std::stringstream sstr;
@@ -215,13 +215,13 @@ void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 			_log.Log(LOG_NORM, "HttpLink: sending global variable %s with value: %s", targetVariable.c_str(), sendValue.c_str());
 		}
 
+		// send without blocking the thread that received the device update
+		HTTPClient::_eHTTPmethod eMethod;
 		if (httpMethodInt == 0) {			// GET
-			if (!HTTPClient::GET(httpUrl, ExtraHeaders, sResult, true))
-			{
-				_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with GET!");
-			}
+			eMethod = HTTPClient::HTTP_METHOD_GET;
 		}
 		else if (httpMethodInt == 1) {		// POST
+			eMethod = HTTPClient::HTTP_METHOD_POST;
 			if (!httpHeaders.empty())
 			{
 				// Add additional headers
@@ -229,22 +229,30 @@ void CHttpPush::DoHttpPush(const uint64_t DeviceRowIdx)
 				StringSplit(httpHeaders, "\r\n", ExtraHeaders2);
 				std::copy(ExtraHeaders2.begin(), ExtraHeaders2.end(), std::back_inserter(ExtraHeaders));
 			}
-			if (!HTTPClient::POST(httpUrl, httpData, ExtraHeaders, sResult, true, true))
-			{
-				_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with POST!");
-			}
 		}
 		else if (httpMethodInt == 2) {		// PUT
-			if (!HTTPClient::PUT(httpUrl, httpData, ExtraHeaders, sResult, true))
-			{
-				_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with PUT!");
-			}
+			eMethod = HTTPClient::HTTP_METHOD_PUT;
 		}
+		else
+			continue;
 
-		// debug
-		if (httpDebugActive) {
-			_log.Log(LOG_NORM, "HttpLink: response %s", sResult.c_str());
-		}
+		// the request is sent in the background, it is timed until its reply
+		static CLatencyHistogram *pLatency = m_latencystats.Get(CLatencyStats::STAGE_PUSH_LINK, "http");
+		const auto tStart = std::chrono::steady_clock::now();
+		HTTPClient::AsyncRequest(eMethod, httpUrl, httpData, ExtraHeaders,
+			[httpDebugActive, httpMethodInt, tStart](bool bOK, long http_code, const std::vector<unsigned char> &response, const std::vector<std::string> &vHeaderData) {
+				pLatency->Record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count());
+				static const char *szMethods[] = { "GET", "POST", "PUT" };
+				if (!bOK)
+				{
+					_log.Log(LOG_ERROR, "HttpLink: Error sending data to http with %s!", szMethods[httpMethodInt]);
+				}
+				// debug
+				if (httpDebugActive) {
+					std::string sResult(response.begin(), response.end());
+					_log.Log(LOG_NORM, "HttpLink: response %s", sResult.c_str());
+				}
+			});
 	}
 }
 
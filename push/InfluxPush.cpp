@@ -8,13 +8,23 @@
 #include "../main/Logger.h"
 #include "../main/mainworker.h"
 #include "../main/RFXtrx.h"
+#include "../main/LatencyStats.h"
 #include "../main/SQLHelper.h"
 #include "../main/WebServer.h"
 #include "../webserver/Base64.h"
 #include "../webserver/cWebem.h"
+#include "../webserver/GZipHelper.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#define INFLUX_RING_SIZE 100000		  // points kept in memory
+#define INFLUX_BATCH_SIZE 5000		  // max points per write request
+#define INFLUX_FLUSH_INTERVAL_MS 1000	  // max time a point waits for a batch to fill
+#define INFLUX_MAX_RETRY_DELAY_SEC 60
+#define INFLUX_MAX_SPILL_SIZE (64 * 1024 * 1024)
+
+extern std::string szUserDataFolder;
+
 extern CInfluxPush m_influxpush;
 
 CInfluxPush::CInfluxPush()
@@ -30,7 +40,18 @@ bool CInfluxPush::Start()
 	RequestStart();
 
 	UpdateSettings();
-	ReloadPushLinks(m_PushType);
+	ReloadInfluxLinks();
+
+	//points that could not be delivered before the last shutdown are sent first
+	m_szSpillFile = szUserDataFolder + "influxdb_spill.txt";
+	m_spillReadPos = 0;
+	m_spillSize = 0;
+	std::ifstream spill(m_szSpillFile, std::ios::binary | std::ios::ate);
+	if (spill.is_open())
+		m_spillSize = static_cast<uint64_t>(spill.tellg());
+	m_bServerDown = false;
+	m_retryDelaySec = 0;
+	m_nextRetry = std::chrono::steady_clock::now();
 
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "InfluxPush");
@@ -104,10 +125,45 @@ void CInfluxPush::UpdateSettings()
 		sURL << "org=" << m_InfluxUsername;
 		sURL << "&bucket=" << m_InfluxDatabase;
 	}
-	sURL << "&precision=s";
+	sURL << "&precision=ns";
 	m_szURL = sURL.str();
 }
 
+void CInfluxPush::ReloadInfluxLinks()
+{
+	ReloadPushLinks(m_PushType);
+
+	std::vector<std::vector<std::string>> result;
+	result = m_sql.safe_query("SELECT DeviceRowID, DelimitedValue, TargetType, IncludeUnit FROM PushLink WHERE (PushType==%d AND Enabled==1)", PushType::PUSHTYPE_INFLUXDB);
+
+	std::lock_guard<std::mutex> l(m_link_mutex);
+	m_influxlinks.clear();
+	for (const auto &sd : result)
+	{
+		_tInfluxLink ilink;
+		ilink.DelimitedValue = atoi(sd[1].c_str());
+		ilink.TargetType = atoi(sd[2].c_str());
+		ilink.IncludeUnit = atoi(sd[3].c_str());
+		m_influxlinks[std::stoull(sd[0])].push_back(ilink);
+	}
+}
+
+CInfluxPush::_tInfluxStats CInfluxPush::GetStats()
+{
+	_tInfluxStats stats;
+	{
+		std::lock_guard<std::mutex> l(m_background_task_mutex);
+		stats.Queued = m_ringCount;
+	}
+	stats.Sent = m_pointsSent;
+	stats.Retried = m_pointsRetried;
+	stats.Dropped = m_pointsDropped;
+	stats.Spilled = m_pointsSpilled;
+	stats.SpillFileSize = m_spillSize;
+	stats.bServerDown = m_bServerDown;
+	return stats;
+}
+
 void CInfluxPush::OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
 {
 	DoInfluxPush(DeviceRowIdx);
@@ -117,152 +173,363 @@ void CInfluxPush::DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced)
 {
 	if (!m_bLinkActive)
 		return;
-	if (!IsLinkInDatabase(DeviceRowIdx))
-		return;
+
+	std::vector<_tInfluxLink> links;
+	{
+		std::lock_guard<std::mutex> l(m_link_mutex);
+		auto itt = m_influxlinks.find(DeviceRowIdx);
+		if (itt == m_influxlinks.end())
+			return;
+		links = itt->second;
+	}
 
 	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query(
-		"SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.IncludeUnit, B.Name, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-		"WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled==1 AND A.DeviceRowID==B.ID)",
-		PushType::PUSHTYPE_INFLUXDB, DeviceRowIdx);
+	result = m_sql.safe_query("SELECT Type, SubType, nValue, sValue, Name, SwitchType FROM DeviceStatus WHERE (ID == %" PRIu64 ")", DeviceRowIdx);
 	if (result.empty())
 		return;
 
-	time_t atime = mytime(nullptr);
-	for (const auto &sd : result)
+	const auto &sd = result[0];
+	int dType = atoi(sd[0].c_str());
+	int dSubType = atoi(sd[1].c_str());
+	int nValue = atoi(sd[2].c_str());
+	const std::string &sValue = sd[3];
+	int metertype = atoi(sd[5].c_str());
+
+	//tag values can not contain spaces, commas or equal signs
+	std::string name = sd[4];
+	stdreplace(name, " ", "-");
+	stdreplace(name, ",", "\\,");
+	stdreplace(name, "=", "\\=");
+
+	std::vector<std::string> strarray;
+	if (sValue.find(';') != std::string::npos)
+		StringSplit(sValue, ";", strarray);
+
+	uint64_t atime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	std::string szTime = std::to_string(atime);
+
+	for (const auto &link : links)
 	{
 		std::string sendValue;
-		int delpos = atoi(sd[1].c_str());
-		int dType = atoi(sd[3].c_str());
-		int dSubType = atoi(sd[4].c_str());
-		int nValue = atoi(sd[5].c_str());
-		std::string sValue = sd[6];
-		int targetType = atoi(sd[7].c_str());
-		int includeUnit = atoi(sd[8].c_str());
-		std::string name = sd[9];
-		int metertype = atoi(sd[10].c_str());
-
-		std::vector<std::string> strarray;
-		if (sValue.find(';') != std::string::npos)
+		int delpos = link.DelimitedValue;
+		if (!strarray.empty())
 		{
-			StringSplit(sValue, ";", strarray);
-			if (int(strarray.size()) >= delpos)
-			{
-				std::string rawsendValue = strarray[delpos - 1];
-				sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, includeUnit, dType, dSubType, metertype);
-			}
+			if ((delpos > 0) && (int(strarray.size()) >= delpos))
+				sendValue = ProcessSendValue(DeviceRowIdx, strarray[delpos - 1], delpos, nValue, link.IncludeUnit, dType, dSubType, metertype);
 		}
 		else
-			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, includeUnit, dType, dSubType, metertype);
+			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, link.IncludeUnit, dType, dSubType, metertype);
 
 		if (sendValue.empty())
 			continue;
 
-		std::string szKey;
 		std::string vType = CBasePush::DropdownOptionsValue(dType, dSubType, delpos);
 		stdreplace(vType, " ", "-");
-		stdreplace(name, " ", "-");
-		szKey = vType + ",idx=" + sd[0] + ",name=" + name;
+		std::string szKey = vType + ",idx=" + std::to_string(DeviceRowIdx) + ",name=" + name;
 
-		_tPushItem pItem;
-		pItem.skey = szKey;
-		pItem.stimestamp = atime;
-		pItem.svalue = sendValue;
+		std::string szLine = szKey + " value=";
+		if (szKey.find("Text,") == 0)
+		{
+			std::string szText = sendValue;
+			stdreplace(szText, "\\", "\\\\");
+			stdreplace(szText, "\"", "\\\"");
+			szLine += "\"" + szText + "\"";
+		}
+		else
+			szLine += sendValue;
 
-		if ((targetType == 0) && (!bForced))
+		if (m_bInfluxDebugActive)
+		{
+			_log.Log(LOG_NORM, "InfluxLink: value %s", szLine.c_str());
+		}
+		szLine += " " + szTime;
+
+		std::lock_guard<std::mutex> l(m_background_task_mutex);
+		if ((link.TargetType == 0) && (!bForced))
 		{
 			// Only send on change
 			auto itt = m_PushedItems.find(szKey);
 			if (itt != m_PushedItems.end())
 			{
-				if (sendValue == itt->second.svalue)
+				if (sendValue == itt->second)
 					continue;
 			}
-			m_PushedItems[szKey] = pItem;
+			m_PushedItems[szKey] = sendValue;
 		}
+		QueueLine(std::move(szLine));
+	}
+}
 
-		std::lock_guard<std::mutex> l(m_background_task_mutex);
-		if (m_background_task_queue.size() < 50)
-			m_background_task_queue.push_back(pItem);
+// m_background_task_mutex should be locked
+void CInfluxPush::QueueLine(std::string &&line)
+{
+	if (m_ring.empty())
+		m_ring.resize(INFLUX_RING_SIZE);
+	if (m_ringCount == m_ring.size())
+	{
+		//full, overwrite the oldest point
+		m_ringHead = (m_ringHead + 1) % m_ring.size();
+		m_ringCount--;
+		m_pointsDropped++;
 	}
+	m_ring[(m_ringHead + m_ringCount) % m_ring.size()] = std::move(line);
+	m_ringCount++;
 }
 
-void CInfluxPush::Do_Work()
+void CInfluxPush::TakeFromRing(std::vector<std::string> &lines, const size_t maxItems)
+{
+	std::lock_guard<std::mutex> l(m_background_task_mutex);
+	while ((m_ringCount > 0) && (lines.size() < maxItems))
+	{
+		lines.push_back(std::move(m_ring[m_ringHead]));
+		m_ringHead = (m_ringHead + 1) % m_ring.size();
+		m_ringCount--;
+	}
+}
+
+CInfluxPush::eSendResult CInfluxPush::SendBatch(const std::vector<std::string> &lines)
 {
-	std::vector<_tPushItem> _items2do;
+	std::string sSendData;
+	for (const auto &line : lines)
+	{
+		if (!sSendData.empty())
+			sSendData += '\n';
+		sSendData += line;
+	}
 
-	while (!IsStopRequested(500))
+	std::vector<std::string> ExtraHeaders;
+	if (m_bInfluxVersion2)
 	{
-		{ // additional scope for lock (accessing size should be within lock too)
-			std::lock_guard<std::mutex> l(m_background_task_mutex);
-			if (m_background_task_queue.empty())
-				continue;
-			_items2do = m_background_task_queue;
-			m_background_task_queue.clear();
+		ExtraHeaders.push_back("Authorization: Token " + base64_decode(m_InfluxPassword));
+		ExtraHeaders.push_back("Content-type: text/plain");
+	}
+
+	CA2GZIP gzip((char *)sSendData.c_str(), (int)sSendData.size());
+	if (gzip.Length > 0)
+	{
+		sSendData.assign((char *)gzip.pgzip, gzip.Length);
+		ExtraHeaders.push_back("Content-Encoding: gzip");
+	}
+
+	std::string sResult;
+	std::vector<std::string> vHeaderData;
+	bool bSent;
+	{
+		// one sample per batch
+		static CLatencyHistogram *pLatency = m_latencystats.Get(CLatencyStats::STAGE_PUSH_LINK, "influxdb");
+		CLatencyTimer latencyTimer(pLatency);
+		bSent = HTTPClient::POST(m_szURL, sSendData, ExtraHeaders, sResult, vHeaderData, true, true);
+	}
+	if (!bSent)
+	{
+		if (!m_bServerDown)
+			_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (check address/port/database/username/password)");
+		return eSendResult::Retry;
+	}
+
+	//the last status line is the final answer (after redirects)
+	int http_code = 0;
+	for (const auto &header : vHeaderData)
+	{
+		if (header.find("HTTP/") == 0)
+		{
+			size_t pos = header.find(' ');
+			if (pos != std::string::npos)
+				http_code = atoi(header.c_str() + pos + 1);
 		}
+	}
+	if ((http_code >= 200) && (http_code < 300))
+		return eSendResult::Sent;
 
-		if (m_szURL.empty())
+	std::string szMessage;
+	Json::Value root;
+	if ((ParseJSon(sResult, root)) && (root.isObject()))
+	{
+		if (!root["message"].empty())
+			szMessage = root["message"].asString();
+		else if (!root["error"].empty())
+			szMessage = root["error"].asString();
+	}
+
+	//a bad request will never be accepted (invalid line protocol), anything else is probably temporary (restart, credentials, overload)
+	if (http_code == 400)
+	{
+		_log.Log(LOG_ERROR, "InfluxLink: InfluxDB server rejected %d points! (%s)", static_cast<int>(lines.size()), szMessage.c_str());
+		return eSendResult::Rejected;
+	}
+	if (!m_bServerDown)
+		_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (HTTP %d %s)", http_code, szMessage.c_str());
+	return eSendResult::Retry;
+}
+
+void CInfluxPush::OnSendFailed(const size_t nPoints)
+{
+	m_pointsRetried += nPoints;
+	m_bServerDown = true;
+	m_retryDelaySec = (m_retryDelaySec == 0) ? 1 : std::min(m_retryDelaySec * 2, INFLUX_MAX_RETRY_DELAY_SEC);
+	m_nextRetry = std::chrono::steady_clock::now() + std::chrono::seconds(m_retryDelaySec);
+}
+
+void CInfluxPush::SpillToDisk(const std::vector<std::string> &lines)
+{
+	if (lines.empty())
+		return;
+	std::ofstream spill(m_szSpillFile, std::ios::binary | std::ios::app);
+	if (!spill.is_open())
+	{
+		_log.Log(LOG_ERROR, "InfluxLink: Unable to write spill file %s, dropping %d points!", m_szSpillFile.c_str(), static_cast<int>(lines.size()));
+		m_pointsDropped += lines.size();
+		return;
+	}
+	uint64_t spillSize = m_spillSize;
+	for (const auto &line : lines)
+	{
+		if (spillSize + line.size() + 1 > INFLUX_MAX_SPILL_SIZE)
+		{
+			m_pointsDropped++;
 			continue;
+		}
+		spill << line << '\n';
+		spillSize += line.size() + 1;
+		m_pointsSpilled++;
+	}
+	m_spillSize = spillSize;
+}
 
-		std::string sSendData;
+void CInfluxPush::SpillRing()
+{
+	std::vector<std::string> lines;
+	TakeFromRing(lines, INFLUX_RING_SIZE);
+	SpillToDisk(lines);
+}
 
-		for (const auto &item : _items2do)
+//Sends one batch from the spill file, returns true when the spill file is empty
+bool CInfluxPush::ReplaySpill()
+{
+	if (m_spillSize == 0)
+		return true;
+
+	std::vector<std::string> lines;
+	uint64_t readPos = m_spillReadPos;
+	{
+		std::ifstream spill(m_szSpillFile, std::ios::binary);
+		if (spill.is_open())
 		{
-			if (!sSendData.empty())
-				sSendData += '\n';
+			spill.seekg(static_cast<std::streamoff>(readPos));
+			std::string line;
+			while ((lines.size() < INFLUX_BATCH_SIZE) && (std::getline(spill, line)))
+			{
+				readPos += line.size() + 1;
+				if (!line.empty())
+					lines.push_back(line);
+			}
+		}
+	}
+	if (lines.empty())
+	{
+		std::remove(m_szSpillFile.c_str());
+		m_spillReadPos = 0;
+		m_spillSize = 0;
+		return true;
+	}
 
-			std::stringstream sziData;
-			sziData << item.skey << " value=";
-			if (item.skey.find("Text,") == 0)
-				sziData << "\"" << item.svalue << "\"";
-			else
-				sziData << item.svalue;
-			if (m_bInfluxDebugActive)
+	eSendResult ret = SendBatch(lines);
+	if (ret == eSendResult::Retry)
+	{
+		OnSendFailed(lines.size());
+		return false;
+	}
+	if (ret == eSendResult::Sent)
+		m_pointsSent += lines.size();
+	else
+		m_pointsDropped += lines.size();
+	m_bServerDown = false;
+	m_retryDelaySec = 0;
+	m_spillReadPos = readPos;
+	if (m_spillReadPos >= m_spillSize)
+	{
+		std::remove(m_szSpillFile.c_str());
+		m_spillReadPos = 0;
+		m_spillSize = 0;
+		if (m_pointsSpilled > 0)
+			_log.Log(LOG_STATUS, "InfluxLink: Sent all points from the spill file");
+		return true;
+	}
+	return false;
+}
+
+void CInfluxPush::Do_Work()
+{
+	auto lastFlush = std::chrono::steady_clock::now();
+
+	while (!IsStopRequested(100))
+	{
+		if (m_szURL.empty())
+			continue;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now < m_nextRetry)
+		{
+			//server is down, keep the ring free for new points
+			size_t ringCount;
 			{
-				_log.Log(LOG_NORM, "InfluxLink: value %s", sziData.str().c_str());
+				std::lock_guard<std::mutex> l(m_background_task_mutex);
+				ringCount = m_ringCount;
 			}
-			sziData << " " << item.stimestamp;
-			sSendData += sziData.str();
+			if (ringCount > INFLUX_RING_SIZE / 2)
+				SpillRing();
+			continue;
 		}
-		std::vector<std::string> ExtraHeaders;
-		std::string sResult;
-		if (m_bInfluxVersion2)
+
+		//points of a failed request are retried first, then the spill file, then new points
+		if (m_pending.empty())
 		{
-			ExtraHeaders.push_back("Authorization: Token " + base64_decode(m_InfluxPassword));
-			ExtraHeaders.push_back("Content-type: text/plain");
+			if (!ReplaySpill())
+				continue;
+
+			size_t ringCount;
+			{
+				std::lock_guard<std::mutex> l(m_background_task_mutex);
+				ringCount = m_ringCount;
+			}
+			if (ringCount == 0)
+				continue;
+			if ((ringCount < INFLUX_BATCH_SIZE) && (now - lastFlush < std::chrono::milliseconds(INFLUX_FLUSH_INTERVAL_MS)))
+				continue;
+			lastFlush = now;
+			TakeFromRing(m_pending, INFLUX_BATCH_SIZE);
 		}
 
-		bool bRet = HTTPClient::POST(m_szURL, sSendData, ExtraHeaders, sResult, true, true);
-		if (!bRet)
+		eSendResult ret = SendBatch(m_pending);
+		if (ret == eSendResult::Retry)
 		{
-			_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (check address/port/database/username/password)");
+			OnSendFailed(m_pending.size());
+			continue;
 		}
-		else if (!sResult.empty())
+		if (ret == eSendResult::Sent)
+			m_pointsSent += m_pending.size();
+		else
+			m_pointsDropped += m_pending.size();
+		if (m_bServerDown)
+			_log.Log(LOG_STATUS, "InfluxLink: Connection to InfluxDB server restored");
+		m_bServerDown = false;
+		m_retryDelaySec = 0;
+		m_pending.clear();
+	}
+
+	//keep what could not be delivered for the next start
+	if ((!m_bServerDown) && (!m_szURL.empty()) && (m_pending.empty()))
+	{
+		TakeFromRing(m_pending, INFLUX_BATCH_SIZE);
+		if ((!m_pending.empty()) && (SendBatch(m_pending) == eSendResult::Sent))
 		{
-			Json::Value root;
-			bool ret = ParseJSon(sResult, root);
-			if (root.isObject())
-			{
-				if (!root["code"].empty())
-				{
-					std::string szCode = root["code"].asString();
-					bool bHaveError = false;
-					std::string szMessage;
-
-					if (szCode == "unauthorized")
-					{
-						bHaveError = true;
-						szMessage = root["message"].asString();
-					}
-
-					if (bHaveError)
-					{
-						_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (%s)", szMessage.c_str());
-					}
-				}
-			}
+			m_pointsSent += m_pending.size();
+			m_pending.clear();
 		}
 	}
+	SpillToDisk(m_pending);
+	m_pending.clear();
+	SpillRing();
 }
 
 // Webserver helpers
@@ -434,7 +701,7 @@ namespace http
 				m_sql.safe_query("UPDATE PushLink SET DeviceRowID=%d, DelimitedValue=%d, TargetType=%d, Enabled=%d WHERE (ID == '%q')", deviceidi, atoi(valuetosend.c_str()),
 						 targettypei, atoi(linkactive.c_str()), idx.c_str());
 			}
-			m_influxpush.ReloadPushLinks(CBasePush::PushType::PUSHTYPE_INFLUXDB);
+			m_influxpush.ReloadInfluxLinks();
 			root["status"] = "OK";
 			root["title"] = "SaveInfluxLink";
 		}
@@ -451,9 +718,28 @@ namespace http
 			if (idx.empty())
 				return;
 			m_sql.safe_query("DELETE FROM PushLink WHERE (ID=='%q')", idx.c_str());
-			m_influxpush.ReloadPushLinks(CBasePush::PushType::PUSHTYPE_INFLUXDB);
+			m_influxpush.ReloadInfluxLinks();
 			root["status"] = "OK";
 			root["title"] = "DeleteInfluxLink";
 		}
+
+		void CWebServer::Cmd_GetInfluxStats(WebEmSession &session, const request &req, Json::Value &root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			CInfluxPush::_tInfluxStats stats = m_influxpush.GetStats();
+			root["Queued"] = static_cast<Json::UInt64>(stats.Queued);
+			root["Sent"] = static_cast<Json::UInt64>(stats.Sent);
+			root["Retried"] = static_cast<Json::UInt64>(stats.Retried);
+			root["Dropped"] = static_cast<Json::UInt64>(stats.Dropped);
+			root["Spilled"] = static_cast<Json::UInt64>(stats.Spilled);
+			root["SpillFileSize"] = static_cast<Json::UInt64>(stats.SpillFileSize);
+			root["ServerDown"] = stats.bServerDown;
+			root["status"] = "OK";
+			root["title"] = "GetInfluxStats";
+		}
 	} // namespace server
 } // namespace http
@@ -2,21 +2,41 @@
 #include "BasePush.h"
 
 #include "../main/StoppableTask.h"
+#include <atomic>
 
 class CInfluxPush : public CBasePush, public StoppableTask
 {
 public:
+	struct _tInfluxStats
+	{
+		uint64_t Queued;
+		uint64_t Sent;
+		uint64_t Retried;
+		uint64_t Dropped;
+		uint64_t Spilled;
+		uint64_t SpillFileSize;
+		bool bServerDown;
+	};
+
 	CInfluxPush();
 	bool Start();
 	void Stop();
 	void UpdateSettings();
+	void ReloadInfluxLinks();
 	void DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced = false);
+	_tInfluxStats GetStats();
 private:
-	struct _tPushItem
+	struct _tInfluxLink
 	{
-		std::string skey;
-		time_t stimestamp;
-		std::string svalue;
+		int DelimitedValue;
+		int TargetType;
+		int IncludeUnit;
+	};
+	enum class eSendResult
+	{
+		Sent,
+		Retry,
+		Rejected
 	};
 	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand);
 
@@ -24,8 +44,39 @@ private:
 	std::mutex m_background_task_mutex;
 	void Do_Work();
 
-	std::map<std::string, _tPushItem> m_PushedItems;
-	std::vector<_tPushItem> m_background_task_queue;
+	void QueueLine(std::string &&line);
+	void TakeFromRing(std::vector<std::string> &lines, size_t maxItems);
+	eSendResult SendBatch(const std::vector<std::string> &lines);
+	void OnSendFailed(size_t nPoints);
+	bool ReplaySpill();
+	void SpillToDisk(const std::vector<std::string> &lines);
+	void SpillRing();
+
+	// enabled push links per device, so a received packet does not need the PushLink join
+	std::map<uint64_t, std::vector<_tInfluxLink>> m_influxlinks;
+
+	// last value sent per key, for the 'only send on change' links
+	std::map<std::string, std::string> m_PushedItems;
+
+	// bounded ring of formatted line protocol points, the oldest point is dropped when full
+	std::vector<std::string> m_ring;
+	size_t m_ringHead{ 0 };
+	size_t m_ringCount{ 0 };
+
+	// worker thread only
+	std::vector<std::string> m_pending;
+	std::string m_szSpillFile;
+	uint64_t m_spillReadPos{ 0 };
+	std::atomic<uint64_t> m_spillSize{ 0 };
+	std::atomic<bool> m_bServerDown{ false };
+	int m_retryDelaySec{ 0 };
+	std::chrono::steady_clock::time_point m_nextRetry;
+
+	std::atomic<uint64_t> m_pointsSent{ 0 };
+	std::atomic<uint64_t> m_pointsRetried{ 0 };
+	std::atomic<uint64_t> m_pointsDropped{ 0 };
+	std::atomic<uint64_t> m_pointsSpilled{ 0 };
+
 	std::string m_szURL;
 	std::string m_InfluxIP;
 	int m_InfluxPort{ 8086 };
@@ -8,6 +8,7 @@
 #include "../main/Logger.h"
 #include "../main/mainworker.h"
 #include "../main/RFXtrx.h"
+#include "../main/LatencyStats.h"
 #include "../main/SQLHelper.h"
 #include "../main/WebServer.h"
 #include "../webserver/Base64.h"
@@ -266,6 +267,8 @@ void CMQTTPush::Do_Work()
 		for (const auto& item : _items2do)
 		{
 			std::string sTopic = m_TopicOut + "/" + std::to_string(item.idx) + "/state";
+			static CLatencyHistogram *pLatency = m_latencystats.Get(CLatencyStats::STAGE_PUSH_LINK, "mqtt");
+			CLatencyTimer latencyTimer(pLatency);
 			SendMessage(sTopic, item.json);
 		}
 	}
@@ -2,6 +2,11 @@
 #include "WebsocketPush.h"
 #include "../webserver/WebsocketHandler.h"
 #include "../main/mainworker.h"
+#include "../main/Helper.h"
+#include "../main/Logger.h"
+#include "../main/json_helper.h"
+
+#define WEBSOCKET_COALESCE_MS 250
 
 extern boost::signals2::signal<void(const std::string &Subject, const std::string &Text, const std::string &ExtraData, const int Priority, const std::string & Sound, const bool bFromNotification)> sOnNotificationReceived;
 
@@ -19,8 +24,7 @@ void CWebSocketPush::Start()
 	if (isStarted) {
 		return;
 	}
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, auto &&name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
-	m_sDeviceUpdate = m_mainworker.sOnDeviceUpdate.connect([this](auto id, auto idx) { OnDeviceUpdate(id, idx); });
+	m_wspublisher.Subscribe(m_sock);
 	m_sNotification = sOnNotificationReceived.connect([this](auto &&s, auto &&t, auto &&e, auto p, auto &&sound, auto n) { OnNotificationReceived(s, t, e, p, sound, n); });
 	m_sSceneChanged = m_mainworker.sOnSwitchScene.connect([this](auto idx, auto &&name) { OnSceneChange(idx, name); });
 	isStarted = true;
@@ -33,11 +37,7 @@ void CWebSocketPush::Stop()
 
 	std::unique_lock<std::mutex> lock(handlerMutex);
 
-	if (m_sConnection.connected())
-		m_sConnection.disconnect();
-
-	if (m_sDeviceUpdate.connected())
-		m_sDeviceUpdate.disconnect();
+	m_wspublisher.Unsubscribe(m_sock);
 
 	if (m_sNotification.connected())
 		m_sNotification.disconnect();
@@ -110,48 +110,190 @@ bool CWebSocketPush::WeListenTo(const uint64_t DeviceRowIdx)
 	return std::find(listenIdxs.begin(), listenIdxs.end(), DeviceRowIdx) != listenIdxs.end();
 }
 
-void CWebSocketPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
+void CWebSocketPush::OnSceneChange(const uint64_t SceneRowIdx, const std::string& SceneName)
 {
 	std::unique_lock<std::mutex> lock(handlerMutex);
 	if (!isStarted) {
 		return;
 	}
-
-	m_sock->OnDeviceChanged(DeviceRowIdx);
-	if (WeListenTo(DeviceRowIdx)) {
-		// push notification to web socket
-	}
+	m_sock->OnSceneChanged(SceneRowIdx);
 }
 
-void CWebSocketPush::OnDeviceUpdate(const int m_HwdID, const uint64_t DeviceRowIdx)
+void CWebSocketPush::OnNotificationReceived(const std::string & Subject, const std::string & Text, const std::string & ExtraData, const int Priority, const std::string & Sound, const bool bFromNotification)
 {
 	std::unique_lock<std::mutex> lock(handlerMutex);
 	if (!isStarted) {
 		return;
 	}
 
-	m_sock->OnDeviceChanged(DeviceRowIdx);
-	if (WeListenTo(DeviceRowIdx)) {
-		// push notification to web socket
+	// push message to websocket
+	m_sock->SendNotification(Subject, Text, ExtraData, Priority, Sound, bFromNotification);
+}
+
+CWebSocketPublisher::CWebSocketPublisher()
+{
+	m_PushType = PushType::PUSHTYPE_WEBSOCKET;
+}
+
+void CWebSocketPublisher::Start()
+{
+	Stop();
+
+	RequestStart();
+
+	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, auto &&name, auto rx) { OnDeviceChanged(idx); });
+	m_sDeviceUpdate = m_mainworker.sOnDeviceUpdate.connect([this](auto id, auto idx) { OnDeviceChanged(idx); });
+
+	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
+	SetThreadName(m_thread->native_handle(), "WebSocketPub");
+}
+
+void CWebSocketPublisher::Stop()
+{
+	if (m_sConnection.connected())
+		m_sConnection.disconnect();
+	if (m_sDeviceUpdate.connected())
+		m_sDeviceUpdate.disconnect();
+	if (m_thread)
+	{
+		RequestStop();
+		m_thread->join();
+		m_thread.reset();
 	}
+	std::lock_guard<std::mutex> l(m_pendingMutex);
+	m_pendingDevices.clear();
 }
 
-void CWebSocketPush::OnSceneChange(const uint64_t SceneRowIdx, const std::string& SceneName)
+void CWebSocketPublisher::Subscribe(http::server::CWebsocketHandler *sock)
 {
-	std::unique_lock<std::mutex> lock(handlerMutex);
-	if (!isStarted) {
+	std::lock_guard<std::mutex> l(m_subscriberMutex);
+	if (std::find(m_subscribers.begin(), m_subscribers.end(), sock) == m_subscribers.end())
+		m_subscribers.push_back(sock);
+}
+
+void CWebSocketPublisher::Unsubscribe(http::server::CWebsocketHandler *sock)
+{
+	// waits for a running fan-out, after this the connection is not used anymore
+	std::lock_guard<std::mutex> l(m_subscriberMutex);
+	m_subscribers.erase(std::remove(m_subscribers.begin(), m_subscribers.end(), sock), m_subscribers.end());
+	m_logSubscribers.erase(sock);
+}
+
+void CWebSocketPublisher::SubscribeLog(http::server::CWebsocketHandler *sock, const uint32_t LevelMask, const uint64_t LastSequence)
+{
+	std::lock_guard<std::mutex> l(m_subscriberMutex);
+	// only connections that are started, Unsubscribe drops the subscription
+	if (std::find(m_subscribers.begin(), m_subscribers.end(), sock) == m_subscribers.end())
 		return;
-	}
-	m_sock->OnSceneChanged(SceneRowIdx);
+	_tLogSubscription &subscription = m_logSubscribers[sock];
+	subscription.LevelMask = LevelMask;
+	// a cursor beyond the last line comes from before a restart, start over
+	subscription.LastSequence = (LastSequence > _log.GetLastLogSequence()) ? 0 : LastSequence;
 }
 
-void CWebSocketPush::OnNotificationReceived(const std::string & Subject, const std::string & Text, const std::string & ExtraData, const int Priority, const std::string & Sound, const bool bFromNotification)
+void CWebSocketPublisher::UnsubscribeLog(http::server::CWebsocketHandler *sock)
 {
-	std::unique_lock<std::mutex> lock(handlerMutex);
-	if (!isStarted) {
+	std::lock_guard<std::mutex> l(m_subscriberMutex);
+	m_logSubscribers.erase(sock);
+}
+
+void CWebSocketPublisher::OnDeviceChanged(const uint64_t DeviceRowIdx)
+{
+	std::lock_guard<std::mutex> l(m_pendingMutex);
+	m_pendingDevices.insert(DeviceRowIdx);
+}
+
+void CWebSocketPublisher::PushLogLines()
+{
+	std::lock_guard<std::mutex> l(m_subscriberMutex);
+	if (m_logSubscribers.empty())
 		return;
+	const uint64_t lastSequence = _log.GetLastLogSequence();
+
+	// subscribers with the same levels and cursor get the same message, an empty one when no line matched their levels
+	std::map<std::pair<uint32_t, uint64_t>, std::pair<uint64_t, std::string>> messages;
+	std::vector<CLogger::_tLogLineStruct> lines;
+	for (auto &subscriber : m_logSubscribers)
+	{
+		_tLogSubscription &subscription = subscriber.second;
+		if (subscription.LastSequence >= lastSequence)
+			continue;
+		auto itt = messages.find(std::make_pair(subscription.LevelMask, subscription.LastSequence));
+		if (itt == messages.end())
+		{
+			std::pair<uint64_t, std::string> message;
+			message.first = _log.GetLog(subscription.LevelMask, subscription.LastSequence, lines);
+			if (!lines.empty())
+			{
+				Json::Value json;
+				json["event"] = "log";
+				json["LastSeq"] = std::to_string(message.first);
+				int ii = 0;
+				for (const auto &line : lines)
+				{
+					json["result"][ii]["level"] = static_cast<int>(line.level);
+					json["result"][ii]["message"] = line.logmessage;
+					ii++;
+				}
+				message.second = JSonToRawString(json);
+			}
+			itt = messages.insert(std::make_pair(std::make_pair(subscription.LevelMask, subscription.LastSequence), message)).first;
+		}
+		subscription.LastSequence = itt->second.first;
+		if (itt->second.second.empty())
+			continue;
+		try
+		{
+			subscriber.first->SendPacket(itt->second.second);
+		}
+		catch (std::exception &e)
+		{
+			_log.Log(LOG_ERROR, "WebSocketPublisher: Exception: %s", e.what());
+		}
 	}
+}
 
-	// push message to websocket
-	m_sock->SendNotification(Subject, Text, ExtraData, Priority, Sound, bFromNotification);
+void CWebSocketPublisher::Do_Work()
+{
+	while (!IsStopRequested(WEBSOCKET_COALESCE_MS))
+	{
+		PushLogLines();
+
+		std::set<uint64_t> devices;
+		{
+			std::lock_guard<std::mutex> l(m_pendingMutex);
+			devices.swap(m_pendingDevices);
+		}
+		if (devices.empty())
+			continue;
+
+		std::lock_guard<std::mutex> l(m_subscriberMutex);
+		if (m_subscribers.empty())
+			continue;
+
+		// connections that render the same view
+		std::map<std::string, std::vector<http::server::CWebsocketHandler *>> groups;
+		for (auto *sock : m_subscribers)
+			groups[sock->GetViewKey()].push_back(sock);
+
+		for (const auto idx : devices)
+		{
+			std::string query = "type=command&param=getdevices&rid=" + std::to_string(idx);
+			for (const auto &group : groups)
+			{
+				try
+				{
+					std::string response;
+					if (!group.second.front()->GetResponse("device_request", -1, query, true, response))
+						continue;
+					for (auto *sock : group.second)
+						sock->SendPacket(response);
+				}
+				catch (std::exception &e)
+				{
+					_log.Log(LOG_ERROR, "WebSocketPublisher: Exception: %s", e.what());
+				}
+			}
+		}
+	}
 }
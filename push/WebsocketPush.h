@@ -8,6 +8,8 @@ namespace http {
 } // namespace http
 
 #include "../main/StoppableTask.h"
+#include <map>
+#include <set>
 
 class CWebSocketPush : public CBasePush, public StoppableTask
 {
@@ -28,8 +30,6 @@ public:
 	bool WeListenTo(uint64_t DeviceRowIdx);
 
       private:
-	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand);
-	void OnDeviceUpdate(int m_HwdID, uint64_t DeviceRowIdx);
 	void OnNotificationReceived(const std::string &Subject, const std::string &Text, const std::string &ExtraData, int Priority, const std::string &Sound, bool bFromNotification);
 	void OnSceneChange(uint64_t SceneRowIdx, const std::string &SceneName);
 	bool listenRoomplan;
@@ -41,3 +41,39 @@ public:
 	bool isStarted;
 };
 
+// Sends device updates to all websocket connections
+// A changed device is rendered once for each group of connections that get the same view (web server, user and rights)
+// and the same message is written to every connection of that group. Changes of the same device within
+// the coalesce window are sent once.
+// Connections that subscribed to the log get the new log lines after their cursor on the same interval.
+class CWebSocketPublisher : public CBasePush, public StoppableTask
+{
+public:
+	CWebSocketPublisher();
+	void Start();
+	void Stop();
+	void Subscribe(http::server::CWebsocketHandler *sock);
+	void Unsubscribe(http::server::CWebsocketHandler *sock);
+	void SubscribeLog(http::server::CWebsocketHandler *sock, uint32_t LevelMask, uint64_t LastSequence);
+	void UnsubscribeLog(http::server::CWebsocketHandler *sock);
+
+      private:
+	struct _tLogSubscription
+	{
+		uint32_t LevelMask;
+		uint64_t LastSequence;
+	};
+
+	void OnDeviceChanged(uint64_t DeviceRowIdx);
+	void PushLogLines();
+	void Do_Work();
+
+	std::shared_ptr<std::thread> m_thread;
+	std::mutex m_pendingMutex;
+	std::set<uint64_t> m_pendingDevices;
+	std::mutex m_subscriberMutex;
+	std::vector<http::server::CWebsocketHandler *> m_subscribers;
+	std::map<http::server::CWebsocketHandler *, _tLogSubscription> m_logSubscribers;
+};
+extern CWebSocketPublisher m_wspublisher;
+
@@ -0,0 +1,239 @@
+#include "stdafx.h"
+#include "JSonStreamWriter.h"
+#include "reply.hpp"
+#include "request.hpp"
+#include <json/json.h>
+
+// output is collected in chunks of this size before it is deflated
+#define JSON_STREAM_CHUNK_SIZE 16384
+// smaller replies are not compressed
+#define JSON_STREAM_GZIP_MIN_SIZE 1024
+
+namespace http
+{
+	namespace server
+	{
+		CJSonStreamWriter::CJSonStreamWriter(reply &rep, const bool bAllowGZip)
+			: m_rep(rep)
+			, m_bAllowGZip(bAllowGZip)
+		{
+			m_rep.content.clear();
+			m_buffer.reserve(JSON_STREAM_CHUNK_SIZE);
+		}
+
+		CJSonStreamWriter::~CJSonStreamWriter()
+		{
+			if (!m_bFinished)
+				Finish();
+		}
+
+		bool CJSonStreamWriter::AcceptsGZip(const request &req)
+		{
+			const char *encoding_header = request::get_req_header(&req, "Accept-Encoding");
+			return ((encoding_header != nullptr) && (strstr(encoding_header, "gzip") != nullptr));
+		}
+
+		void CJSonStreamWriter::StartObject()
+		{
+			BeforeValue();
+			Write("{", 1);
+			m_first.push_back(true);
+		}
+
+		void CJSonStreamWriter::EndObject()
+		{
+			m_first.pop_back();
+			Write("}", 1);
+		}
+
+		void CJSonStreamWriter::StartArray()
+		{
+			BeforeValue();
+			Write("[", 1);
+			m_first.push_back(true);
+		}
+
+		void CJSonStreamWriter::EndArray()
+		{
+			m_first.pop_back();
+			Write("]", 1);
+		}
+
+		void CJSonStreamWriter::Key(const char *szKey)
+		{
+			if (!m_first.back())
+				Write(",", 1);
+			m_first.back() = false;
+			Write(Json::valueToQuotedString(szKey));
+			Write(":", 1);
+			m_bAfterKey = true;
+		}
+
+		void CJSonStreamWriter::Value(const char *szValue)
+		{
+			BeforeValue();
+			Write(Json::valueToQuotedString(szValue));
+		}
+
+		void CJSonStreamWriter::Value(const std::string &szValue)
+		{
+			Value(szValue.c_str());
+		}
+
+		void CJSonStreamWriter::Value(const int iValue)
+		{
+			BeforeValue();
+			Write(std::to_string(iValue));
+		}
+
+		void CJSonStreamWriter::Value(const unsigned int iValue)
+		{
+			BeforeValue();
+			Write(std::to_string(iValue));
+		}
+
+		void CJSonStreamWriter::Value(const int64_t iValue)
+		{
+			BeforeValue();
+			Write(std::to_string(iValue));
+		}
+
+		void CJSonStreamWriter::Value(const uint64_t iValue)
+		{
+			BeforeValue();
+			Write(std::to_string(iValue));
+		}
+
+		void CJSonStreamWriter::Value(const double dValue)
+		{
+			BeforeValue();
+			// same formatting as the Json::Value writers
+			Write(Json::valueToString(dValue));
+		}
+
+		void CJSonStreamWriter::Value(const bool bValue)
+		{
+			BeforeValue();
+			if (bValue)
+				Write("true", 4);
+			else
+				Write("false", 5);
+		}
+
+		void CJSonStreamWriter::Null()
+		{
+			BeforeValue();
+			Write("null", 4);
+		}
+
+		void CJSonStreamWriter::Value(const Json::Value &value)
+		{
+			switch (value.type())
+			{
+			case Json::intValue:
+				Value(static_cast<int64_t>(value.asLargestInt()));
+				break;
+			case Json::uintValue:
+				Value(static_cast<uint64_t>(value.asLargestUInt()));
+				break;
+			case Json::realValue:
+				Value(value.asDouble());
+				break;
+			case Json::stringValue:
+				Value(value.asString());
+				break;
+			case Json::booleanValue:
+				Value(value.asBool());
+				break;
+			case Json::arrayValue:
+				StartArray();
+				for (const auto &item : value)
+					Value(item);
+				EndArray();
+				break;
+			case Json::objectValue:
+				StartObject();
+				for (auto itt = value.begin(); itt != value.end(); ++itt)
+				{
+					Key(itt.name().c_str());
+					Value(*itt);
+				}
+				EndObject();
+				break;
+			default:
+				Null();
+				break;
+			}
+		}
+
+		void CJSonStreamWriter::Finish()
+		{
+			if (m_bFinished)
+				return;
+			m_bFinished = true;
+			Flush(true);
+			if (m_bDeflating)
+			{
+				m_rep.bIsGZIP = true;
+				reply::add_header(&m_rep, "Content-Encoding", "gzip");
+			}
+		}
+
+		void CJSonStreamWriter::BeforeValue()
+		{
+			m_bEmpty = false;
+			if (m_bAfterKey)
+			{
+				m_bAfterKey = false;
+				return;
+			}
+			if (m_first.empty())
+				return;
+			if (!m_first.back())
+				Write(",", 1);
+			m_first.back() = false;
+		}
+
+		void CJSonStreamWriter::Write(const char *pData, const size_t len)
+		{
+			m_buffer.append(pData, len);
+			if (m_buffer.size() >= JSON_STREAM_CHUNK_SIZE)
+				Flush(false);
+		}
+
+		void CJSonStreamWriter::Flush(const bool bFinish)
+		{
+			if ((!m_bDeflating) && (m_bAllowGZip) && (m_buffer.size() >= JSON_STREAM_GZIP_MIN_SIZE))
+			{
+				memset(&m_zstream, 0, sizeof(m_zstream));
+				// windowBits 15 + 16 writes a gzip header and trailer
+				m_bDeflating = (deflateInit2(&m_zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+			}
+			if (!m_bDeflating)
+			{
+				m_rep.content.append(m_buffer);
+				m_buffer.clear();
+				return;
+			}
+			Deflate((bFinish) ? Z_FINISH : Z_NO_FLUSH);
+			m_buffer.clear();
+			if (bFinish)
+				deflateEnd(&m_zstream);
+		}
+
+		void CJSonStreamWriter::Deflate(const int iFlush)
+		{
+			unsigned char out[JSON_STREAM_CHUNK_SIZE];
+			m_zstream.next_in = reinterpret_cast<Bytef *>(&m_buffer[0]);
+			m_zstream.avail_in = static_cast<uInt>(m_buffer.size());
+			int ret;
+			do
+			{
+				m_zstream.next_out = out;
+				m_zstream.avail_out = sizeof(out);
+				ret = deflate(&m_zstream, iFlush);
+				m_rep.content.append(reinterpret_cast<const char *>(out), sizeof(out) - m_zstream.avail_out);
+			} while ((m_zstream.avail_out == 0) || ((iFlush == Z_FINISH) && (ret == Z_OK)));
+		}
+	} // namespace server
+} // namespace http
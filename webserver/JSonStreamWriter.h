@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace Json
+{
+	class Value;
+} // namespace Json
+
+namespace http
+{
+	namespace server
+	{
+		struct reply;
+		struct request;
+
+		// Writes a JSON document straight into the content of a reply, without building a Json::Value tree first
+		//
+		// When gzip is allowed, the output is deflated while it is written once it has grown past a small threshold
+		// (small replies are sent as they are), so the full uncompressed text is never held in memory.
+		// Keys and values are written in document order, for example:
+		//	writer.StartObject();
+		//	writer.Member("status", "OK");
+		//	writer.Key("result");
+		//	writer.StartArray();
+		//	...
+		//	writer.EndArray();
+		//	writer.EndObject();
+		class CJSonStreamWriter
+		{
+		      public:
+			CJSonStreamWriter(reply &rep, bool bAllowGZip);
+			~CJSonStreamWriter();
+			CJSonStreamWriter(const CJSonStreamWriter &) = delete;
+			CJSonStreamWriter &operator=(const CJSonStreamWriter &) = delete;
+
+			// True when the client accepts a gzip encoded reply
+			static bool AcceptsGZip(const request &req);
+
+			void StartObject();
+			void EndObject();
+			void StartArray();
+			void EndArray();
+			void Key(const char *szKey);
+
+			void Value(const char *szValue);
+			void Value(const std::string &szValue);
+			void Value(int iValue);
+			void Value(unsigned int iValue);
+			void Value(int64_t iValue);
+			void Value(uint64_t iValue);
+			void Value(double dValue);
+			void Value(bool bValue);
+			void Null();
+			// Writes a Json::Value (sub)tree, for parts that are still built as a tree
+			void Value(const Json::Value &value);
+
+			template <typename T> void Member(const char *szKey, const T &value)
+			{
+				Key(szKey);
+				Value(value);
+			}
+
+			// True when nothing has been written yet
+			bool IsEmpty() const
+			{
+				return m_bEmpty;
+			}
+
+			// Completes the reply content and sets the content encoding, called by the destructor when needed
+			void Finish();
+
+		      private:
+			void BeforeValue();
+			void Write(const char *pData, size_t len);
+			void Write(const std::string &szData)
+			{
+				Write(szData.data(), szData.size());
+			}
+			void Flush(bool bFinish);
+			void Deflate(int iFlush);
+
+			reply &m_rep;
+			bool m_bAllowGZip;
+			bool m_bDeflating = false;
+			bool m_bFinished = false;
+			bool m_bEmpty = true;
+			bool m_bAfterKey = false;
+			std::vector<bool> m_first; // per open object/array, true until it has a member
+			std::string m_buffer;
+			z_stream m_zstream;
+		};
+	} // namespace server
+} // namespace http
@@ -25,60 +25,60 @@ namespace http {
 			Stop();
 		}
 
-		boost::tribool CWebsocketHandler::Handle(const std::string &packet_data, bool outbound)
+		static WebEmSession GetWebsocketSession(cWebem *pWebem, const std::string &sessionid, const bool outbound)
 		{
-			Json::Value jsonValue;
-			try
+			// WebSockets only do security during set up so keep pushing the expiry out to stop it being cleaned up
+			WebEmSession session;
+			auto itt = pWebem->m_sessions.find(sessionid);
+			if (itt != pWebem->m_sessions.end())
 			{
-				// WebSockets only do security during set up so keep pushing the expiry out to stop it being cleaned up
-				WebEmSession session;
-				auto itt = myWebem->m_sessions.find(sessionid);
-				if (itt != myWebem->m_sessions.end())
+				session = itt->second;
+			}
+			else
+				// for outbound messages create a temporary session if required
+				// todo: Add the username and rights from the original connection
+				if (outbound)
 				{
-					session = itt->second;
+					time_t nowAnd1Day = ((time_t)mytime(nullptr)) + WEBSOCKET_SESSION_TIMEOUT;
+					session.timeout = nowAnd1Day;
+					session.expires = nowAnd1Day;
+					session.isnew = false;
+					session.rememberme = false;
+					session.reply_status = 200;
 				}
-				else
-					// for outbound messages create a temporary session if required
-					// todo: Add the username and rights from the original connection
-					if (outbound)
-					{
-						time_t nowAnd1Day = ((time_t)mytime(nullptr)) + WEBSOCKET_SESSION_TIMEOUT;
-						session.timeout = nowAnd1Day;
-						session.expires = nowAnd1Day;
-						session.isnew = false;
-						session.rememberme = false;
-						session.reply_status = 200;
-					}
-
+			return session;
+		}
 
+		boost::tribool CWebsocketHandler::Handle(const std::string &packet_data, bool outbound)
+		{
+			try
+			{
 				Json::Value value;
 				if (!ParseJSon(packet_data, value)) {
 					return true;
 				}
 				std::string szEvent = value["event"].asString();
+				if (szEvent == "log_subscribe")
+				{
+					// same lines as the getlog command, pushed from the sequence number the client already has
+					uint32_t levelMask = (value["loglevel"].isNumeric()) ? value["loglevel"].asUInt() : LOG_NORM;
+					uint64_t lastSequence = std::strtoull(value["lastseq"].asString().c_str(), nullptr, 10);
+					m_wspublisher.SubscribeLog(this, levelMask, lastSequence);
+					return true;
+				}
+				if (szEvent == "log_unsubscribe")
+				{
+					m_wspublisher.UnsubscribeLog(this);
+					return true;
+				}
 				if (szEvent.find("request") == std::string::npos)
 					return true;
 
-				request req;
-				req.method = "GET";
-				std::string querystring = value["query"].asString();
-				req.uri = myWebem->GetWebRoot() + "/json.htm?" + querystring;
-				req.http_version_major = 1;
-				req.http_version_minor = 1;
-				req.headers.resize(0); // todo: do we need any headers?
-				req.content.clear();
-				reply rep;
-				if (myWebem->CheckForPageOverride(session, req, rep)) {
-					if (rep.status == reply::ok) {
-						jsonValue["request"] = szEvent;
-						jsonValue["event"] = "response";
-						Json::Value::Int64 reqID = value["requestid"].asInt64();
-						jsonValue["requestid"] = reqID;
-						jsonValue["data"] = rep.content;
-						std::string response = JSonToFormatString(jsonValue);
-						MyWrite(response);
-						return true;
-					}
+				std::string response;
+				if (GetResponse(szEvent, value["requestid"].asInt64(), value["query"].asString(), outbound, response))
+				{
+					MyWrite(response);
+					return true;
 				}
 			}
 			catch (std::exception& e)
@@ -86,12 +86,50 @@ namespace http {
 				_log.Log(LOG_ERROR, "WebsocketHandler::%s Exception: %s", __func__, e.what());
 			}
 
+			Json::Value jsonValue;
 			jsonValue["error"] = "Internal Server Error!!";
 			std::string response = JSonToFormatString(jsonValue);
 			MyWrite(response);
 			return true;
 		}
 
+		bool CWebsocketHandler::GetResponse(const std::string &szEvent, const int64_t requestid, const std::string &querystring, const bool outbound, std::string &response)
+		{
+			WebEmSession session = GetWebsocketSession(myWebem, sessionid, outbound);
+
+			request req;
+			req.method = "GET";
+			req.uri = myWebem->GetWebRoot() + "/json.htm?" + querystring;
+			req.http_version_major = 1;
+			req.http_version_minor = 1;
+			req.headers.resize(0); // todo: do we need any headers?
+			req.content.clear();
+			reply rep;
+			if (!myWebem->CheckForPageOverride(session, req, rep))
+				return false;
+			if (rep.status != reply::ok)
+				return false;
+
+			Json::Value jsonValue;
+			jsonValue["request"] = szEvent;
+			jsonValue["event"] = "response";
+			jsonValue["requestid"] = static_cast<Json::Value::Int64>(requestid);
+			jsonValue["data"] = rep.content;
+			response = JSonToFormatString(jsonValue);
+			return true;
+		}
+
+		std::string CWebsocketHandler::GetViewKey()
+		{
+			WebEmSession session = GetWebsocketSession(myWebem, sessionid, true);
+			return std_format("%p;%d;%s", static_cast<void *>(myWebem), session.rights, session.username.c_str());
+		}
+
+		void CWebsocketHandler::SendPacket(const std::string &packet_data)
+		{
+			MyWrite(packet_data);
+		}
+
 		void CWebsocketHandler::Start()
 		{
 			RequestStart();
@@ -171,24 +209,6 @@ namespace http {
 			}
 		}
 
-		void CWebsocketHandler::OnDeviceChanged(const uint64_t DeviceRowIdx)
-		{
-			try
-			{
-				std::string query = "type=command&param=getdevices&rid=" + std::to_string(DeviceRowIdx);
-				Json::Value request;
-				request["event"] = "device_request";
-				request["requestid"] = -1;
-				request["query"] = query;
-				std::string packet = JSonToFormatString(request);
-				Handle(packet, true);
-			}
-			catch (std::exception& e)
-			{
-				_log.Log(LOG_ERROR, "WebsocketHandler::%s Exception: %s", __func__, e.what());
-			}
-		}
-
 		void CWebsocketHandler::OnSceneChanged(const uint64_t SceneRowIdx)
 		{
 			try
@@ -24,11 +24,15 @@ namespace http
 			virtual boost::tribool Handle(const std::string &packet_data, bool outbound);
 			virtual void Start();
 			virtual void Stop();
-			virtual void OnDeviceChanged(uint64_t DeviceRowIdx);
 			virtual void OnSceneChanged(uint64_t SceneRowIdx);
 			virtual void SendNotification(const std::string &Subject, const std::string &Text, const std::string &ExtraData, int Priority, const std::string &Sound,
 						      bool bFromNotification);
 			virtual void store_session_id(const request &req, const reply &rep);
+			// Connections with the same key get the same response for a request
+			std::string GetViewKey();
+			// Runs a json request and builds the response message, returns false when the request failed
+			bool GetResponse(const std::string &szEvent, int64_t requestid, const std::string &querystring, bool outbound, std::string &response);
+			void SendPacket(const std::string &packet_data);
 
 		      protected:
 			std::function<void(const std::string &packet_data)> MyWrite;
@@ -0,0 +1,114 @@
+//
+// asset_cache.cpp
+// ~~~~~~~~~~~~~~~
+//
+#include "stdafx.h"
+#include "asset_cache.hpp"
+#include <fstream>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "GZipHelper.h"
+
+// larger files are read from disk on every request
+#define ASSET_CACHE_MAX_FILE_SIZE (4 * 1024 * 1024)
+// upper limit of all cached content, further files are not cached
+#define ASSET_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+namespace http {
+namespace server {
+
+static bool stat_file(const std::string &file, struct stat &sb)
+{
+	return ((stat(file.c_str(), &sb) == 0) && ((sb.st_mode & S_IFREG) == S_IFREG));
+}
+
+static size_t asset_size(const asset_cache::asset &item)
+{
+	return item.raw->size() + ((item.gzip) ? item.gzip->size() : 0);
+}
+
+std::shared_ptr<const asset_cache::asset> asset_cache::get(const std::string &full_path, const bool compressible)
+{
+	struct stat sb;
+	std::string file = full_path + ".gz";
+	bool gzip_source = (compressible && stat_file(file, sb));
+	if (!gzip_source)
+	{
+		file = full_path;
+		if (!stat_file(file, sb))
+			return nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> l(mutex_);
+		auto itt = assets_.find(full_path);
+		if ((itt != assets_.end()) && (itt->second->file == file) && (itt->second->last_written == sb.st_mtime) && (itt->second->file_size == sb.st_size))
+			return itt->second;
+	}
+
+	// the file is read without holding the lock, a concurrent request for it may read it as well
+	std::shared_ptr<asset> item = load(file, gzip_source, compressible);
+	if (!item)
+		return nullptr;
+	item->last_written = sb.st_mtime;
+	item->file_size = sb.st_size;
+
+	std::lock_guard<std::mutex> l(mutex_);
+	auto itt = assets_.find(full_path);
+	if (itt != assets_.end())
+	{
+		size_ -= asset_size(*itt->second);
+		assets_.erase(itt);
+	}
+	size_t new_size = asset_size(*item);
+	if ((new_size <= ASSET_CACHE_MAX_FILE_SIZE) && (size_ + new_size <= ASSET_CACHE_MAX_SIZE))
+	{
+		assets_[full_path] = item;
+		size_ += new_size;
+	}
+	return item;
+}
+
+std::shared_ptr<asset_cache::asset> asset_cache::load(const std::string &file, const bool gzip_source, const bool compressible)
+{
+	std::ifstream is(file.c_str(), std::ios::in | std::ios::binary);
+	if (!is.is_open())
+		return nullptr;
+	std::string content((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
+	if (is.bad())
+		return nullptr;
+
+	auto item = std::make_shared<asset>();
+	item->file = file;
+	item->gzip_source = gzip_source;
+	if (gzip_source)
+	{
+		// kept decompressed as well, for clients without gzip support
+		CGZIP2AT<> decompress((LPGZIP)content.c_str(), static_cast<int>(content.size()));
+		item->raw = std::make_shared<const std::string>(decompress.psz, decompress.Length);
+		item->gzip = std::make_shared<const std::string>(std::move(content));
+	}
+	else
+	{
+		if (compressible)
+		{
+			CA2GZIP gzip((char *)content.c_str(), (int)content.size());
+			if ((gzip.Length > 0) && (gzip.Length < (int)content.size()))
+				item->gzip = std::make_shared<const std::string>((char *)gzip.pgzip, gzip.Length);
+		}
+		item->raw = std::make_shared<const std::string>(std::move(content));
+	}
+
+	// the tag is derived from the content, so it stays the same after a restart or a touch of the file
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, reinterpret_cast<const Bytef *>(item->raw->data()), static_cast<uInt>(item->raw->size()));
+	char szTag[50];
+	snprintf(szTag, sizeof(szTag), "\"%zx-%08lx\"", item->raw->size(), static_cast<unsigned long>(crc));
+	item->etag = szTag;
+	snprintf(szTag, sizeof(szTag), "\"%zx-%08lx-gz\"", item->raw->size(), static_cast<unsigned long>(crc));
+	item->gzip_etag = szTag;
+	return item;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,55 @@
+//
+// asset_cache.hpp
+// ~~~~~~~~~~~~~~~
+//
+#pragma once
+#ifndef HTTP_ASSET_CACHE_HPP
+#define HTTP_ASSET_CACHE_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace http {
+namespace server {
+
+/// In memory copies of the static files of the web root, uncompressed and gzip compressed,
+/// so a request does not read (and compress) the file again. An entry is loaded again when
+/// the file it was loaded from changes (modification time or size).
+class asset_cache
+{
+public:
+	struct asset
+	{
+		/// The uncompressed content
+		std::shared_ptr<const std::string> raw;
+		/// The gzip compressed content, not set when the file type is not compressed or compressing does not help
+		std::shared_ptr<const std::string> gzip;
+		/// Strong entity tags of both representations
+		std::string etag;
+		std::string gzip_etag;
+		/// The file the content was loaded from, the .gz sibling when there is one
+		std::string file;
+		bool gzip_source = false;
+		time_t last_written = 0;
+		off_t file_size = 0;
+	};
+
+	/// Returns the cached asset of a file, loading it when needed. Returns nullptr when the file cannot be read.
+	/// For compressible files a precompressed .gz sibling is used when it exists.
+	std::shared_ptr<const asset> get(const std::string &full_path, bool compressible);
+
+private:
+	std::shared_ptr<asset> load(const std::string &file, bool gzip_source, bool compressible);
+
+	std::mutex mutex_;
+	std::map<std::string, std::shared_ptr<const asset>> assets_;
+	/// Total size of the cached content
+	size_t size_ = 0;
+};
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_ASSET_CACHE_HPP
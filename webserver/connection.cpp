@@ -217,7 +217,7 @@ namespace http {
 			}
 		}
 
-		void connection::SocketWrite(const std::string& buf)
+		void connection::SocketWrite(const std::string& buf, const std::shared_ptr<const std::string>& content)
 		{
 			// do not call directly, use MyWrite()
 			if (write_in_progress) {
@@ -225,13 +225,18 @@ namespace http {
 			}
 			write_in_progress = true;
 			write_buffer = buf;
+			write_content = content;
+			std::vector<boost::asio::const_buffer> buffers;
+			buffers.push_back(boost::asio::buffer(write_buffer));
+			if (write_content)
+				buffers.push_back(boost::asio::buffer(*write_content));
 			if (secure_) {
 #ifdef WWW_ENABLE_SSL
-				boost::asio::async_write(*sslsocket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write(err, bytes); });
+				boost::asio::async_write(*sslsocket_, buffers, [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write(err, bytes); });
 #endif
 			}
 			else {
-				boost::asio::async_write(*socket_, boost::asio::buffer(write_buffer), [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write(err, bytes); });
+				boost::asio::async_write(*socket_, buffers, [self = shared_from_this()](auto &&err, auto bytes) { self->handle_write(err, bytes); });
 			}
 
 		}
@@ -244,11 +249,11 @@ namespace http {
 			else {
 				// socket connection not set up yet, add to queue
 				std::unique_lock<std::mutex> lock(writeMutex);
-				writeQ.push_back(CWebsocketFrame::Create(opcode_text, resp, false));
+				writeQ.push_back(std::make_pair(CWebsocketFrame::Create(opcode_text, resp, false), nullptr));
 			}
 		}
 
-		void connection::MyWrite(const std::string& buf)
+		void connection::MyWrite(const std::string& buf, const std::shared_ptr<const std::string>& content)
 		{
 			switch (connection_type) {
 			case ConnectionType::connection_http:
@@ -257,10 +262,10 @@ namespace http {
 				std::unique_lock<std::mutex> lock(writeMutex);
 				if (write_in_progress) {
 					// write in progress, add to queue
-					writeQ.push_back(buf);
+					writeQ.push_back(std::make_pair(buf, content));
 				}
 				else {
-					SocketWrite(buf);
+					SocketWrite(buf, content);
 				}
 				break;
 			}
@@ -445,7 +450,7 @@ namespace http {
 								wlBrowser = "\"" + shdr + "\"";
 							}
 							int wlResCode = (int)reply_.status;
-							int wlContentSize = (int)reply_.content.length();
+							int wlContentSize = (int)reply_.content_size();
 
 							std::stringstream sstr;
 							sstr << std::setw(3) << std::setfill('0') << ((int)tv.tv_usec / 1000);
@@ -495,7 +500,10 @@ namespace http {
 							reply::add_header_if_absent(&reply_, "Keep-Alive", ss.str());
 						}
 
-						MyWrite(reply_.to_string(request_.method));
+						if ((reply_.shared_content) && (request_.method != "HEAD"))
+							MyWrite(reply_.header_to_string(), reply_.shared_content);
+						else
+							MyWrite(reply_.to_string(request_.method));
 						if (reply_.status == reply::switching_protocols) {
 							// this was an upgrade request, set this value after MyWrite to allow the 101 response to go out
 							connection_type = ConnectionType::connection_websocket;
@@ -559,13 +567,14 @@ namespace http {
 		{
 			std::unique_lock<std::mutex> lock(writeMutex);
 			write_buffer.clear();
+			write_content.reset();
 			write_in_progress = false;
 			bool stopConnection = false;
 			if (!error && !writeQ.empty())
 			{
-				std::string buf = writeQ.front();
+				auto item = writeQ.front();
 				writeQ.pop_front();
-				SocketWrite(buf);
+				SocketWrite(item.first, item.second);
 				if (keepalive_)
 				{
 					reset_abandoned_timeout();
@@ -67,8 +67,8 @@ namespace http {
 
 			// send packet over websocket
 			void WS_Write(const std::string& packet_data);
-			/// Add content to write buffer
-			void MyWrite(const std::string& buf);
+			/// Add content to write buffer, shared content is written after it without copying it
+			void MyWrite(const std::string& buf, const std::shared_ptr<const std::string>& content = nullptr);
 			/// Timer handlers
 			void handle_timeout(const boost::system::error_code& error);
 
@@ -86,10 +86,10 @@ namespace http {
 			/// Protect the write queue
 			std::mutex writeMutex;
 			/// Is protected by writeMutex
-			std::deque<std::string> writeQ;
+			std::deque<std::pair<std::string, std::shared_ptr<const std::string>>> writeQ;
 			/// indicates if we are currently writing
 			bool write_in_progress;
-			void SocketWrite(const std::string& buf);
+			void SocketWrite(const std::string& buf, const std::shared_ptr<const std::string>& content);
 
 			bool send_file(const std::string& filename, std::string& attachment_name, reply& rep);
 			std::ifstream sendfile_;
@@ -145,6 +145,8 @@ namespace http {
 
 			/// our write buffer
 			std::string write_buffer;
+			/// shared content written after the write buffer, kept until the write has completed
+			std::shared_ptr<const std::string> write_content;
 
 			/// The buffer that we receive data in
 			boost::asio::streambuf _buf;
@@ -202,7 +202,7 @@ namespace http {
 				ProxyPdu_RESPONSE response;
 				response.m_status = reply_.status;
 				response.m_responseheaders = responseheaders;
-				response.m_content = reply_.content;
+				response.m_content = (reply_.shared_content) ? *reply_.shared_content : reply_.content;
 				// we number the request, because we can send back asynchronously
 				response.m_requestid = pdu->m_requestid;
 
@@ -107,15 +107,21 @@ std::string reply::to_string(const std::string &method)
 {
 	std::string buffers = header_to_string();
 	if (method != "HEAD") {
-		buffers += content;
+		buffers += (shared_content) ? *shared_content : content;
 	}
 	return buffers;
 }
 
+size_t reply::content_size() const
+{
+	return (shared_content) ? shared_content->size() : content.size();
+}
+
 void reply::reset()
 {
 	headers.clear();
 	content = "";
+	shared_content.reset();
 	bIsGZIP = false;
 }
 
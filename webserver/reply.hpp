@@ -13,6 +13,7 @@
 
 #include <string>
 #include <iterator>
+#include <memory>
 #include <boost/asio.hpp>
 #include "header.hpp"
 
@@ -51,6 +52,8 @@ struct reply
 
   /// The content to be sent in the reply.
   std::string content;
+  /// Content shared with the static file cache, sent instead of content when set (without copying it).
+  std::shared_ptr<const std::string> shared_content;
   bool bIsGZIP;
 
   /// The origin of the web request when behind proxies, etc.
@@ -81,6 +84,8 @@ struct reply
   // we use this as an alternative for to_buffers()
   std::string header_to_string();
   std::string to_string(const std::string &method);
+  /// The size of the content that will be sent
+  size_t content_size() const;
 
   // reset the reply, so we can re-use it during long-lived connections
   void reset();
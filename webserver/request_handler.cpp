@@ -307,17 +307,6 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 	// Let's try to process it
 
 	const char* if_none_match = request::get_req_header(&req, "If-None-Match");
-	if (if_none_match != nullptr)
-	{
-		//check if etag matches current tag
-		if (strcmp(if_none_match, szAppVersion.c_str()) == 0)
-		{
-			//nothing changed
-			rep = reply::stock_reply(reply::not_modified);
-			return;
-		}
-	}
-
 
 	// Determine if the Client (Browser) supports a gzip'ped response body
 	bool bClientHasGZipSupport = false;
@@ -343,33 +332,33 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 	if (!m_bIsZIP)
 #endif
 	{
-		std::ifstream is;
-
 		// Check gzip source file support. Only for js/htm(l) and css files.
 		if ((extension.find("js")!=std::string::npos) || (extension.find("htm") != std::string::npos) || (extension.find("css") != std::string::npos))
 		{
 			bIsCompressibleType = true;
-			// Let's see if there is an gzipped version of the source file
-			std::string full_path_withgz = full_path + ".gz";
-			is.open(full_path_withgz.c_str(), std::ios::in | std::ios::binary);
-			if (is.is_open())
-			{
-				bHaveLoadedgzip = true;
-				mInfo.delay_status = false;
-				full_path = full_path_withgz;
-			}
 		}
 
-		if (!is.is_open())
+		// The content comes from the cache, it is read (and compressed) again when the file has changed
+		std::shared_ptr<const asset_cache::asset> asset = assets_.get(full_path, bIsCompressibleType);
+		if (!asset)
+		{
+			rep = reply::stock_reply(reply::not_found);
+			return;
+		}
+		if (asset->gzip_source)
 		{
-			// Try opening the normal (non gzip'ped) source file
-			is.open(full_path.c_str(), std::ios::in | std::ios::binary);
+			// The content was loaded from a gzipped version of the source file
+			bHaveLoadedgzip = true;
+			mInfo.delay_status = false;
 		}
+		full_path = asset->file;
 
-		// Did we find/open a zipped or non-zipped source file?
-		if (!is.is_open())
+		bool bSendGZip = (bClientHasGZipSupport && asset->gzip);
+		const std::string &etag = (bSendGZip) ? asset->gzip_etag : asset->etag;
+		if ((if_none_match != nullptr) && (etag == if_none_match))
 		{
-			rep = reply::stock_reply(reply::not_found);
+			//nothing changed
+			rep = reply::stock_reply(reply::not_modified);
 			return;
 		}
 
@@ -385,44 +374,23 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 				return;
 			}
 		}
-
-		// fill out the reply to be sent to the client.
-		try
+		if (bDoCachePages)
 		{
-			if (bHaveLoadedgzip && (!bClientHasGZipSupport))
-			{
-				// We found an already compressed source file, but the client does not seem to support to received it compressed. So we decompress it first.
-				std::string gzcontent((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
+			reply::add_header(&rep, "ETag", etag, true);
+		}
 
-				CGZIP2AT<> decompress((LPGZIP)gzcontent.c_str(), static_cast<int>(gzcontent.size()));
-				rep.content.append(decompress.psz, decompress.Length);
-				_log.Debug(DEBUG_WEBSERVER, "[web:%s] decompressed content from %s before sending.", request_path.c_str(), full_path.c_str());
-			}
-			else
-			{
-				// Load the sourcefile (compressed or not)
-				rep.content.append((std::istreambuf_iterator<char>(is)), (std::istreambuf_iterator<char>()));
-				rep.bIsGZIP = (bClientHasGZipSupport && bHaveLoadedgzip);
-			}
-			if (bClientHasGZipSupport && bIsCompressibleType && (!bHaveLoadedgzip))
-			{
-				// The sourcefile is not compressed, but the client supports receiving compressed content
-				// and the content is a compressible type so let's compress the content
-				CA2GZIP gzip((char*)rep.content.c_str(), (int)rep.content.size());
-				if ((gzip.Length > 0) && (gzip.Length < (int)rep.content.size()))
-				{
-					bHaveCompressed = true;
-					rep.bIsGZIP = true; // flag for later
-					rep.content.clear();
-					rep.content.append((char*)gzip.pgzip, gzip.Length);
-				}
-			}
+		// fill out the reply to be sent to the client, without copying the content
+		if (bSendGZip)
+		{
+			rep.shared_content = asset->gzip;
+			rep.bIsGZIP = true;
+			bHaveCompressed = !asset->gzip_source;
 		}
-		catch(const std::exception& e)
+		else
 		{
-			_log.Debug(DEBUG_WEBSERVER, "[web:%s] unable to server content from %s (%s).", request_path.c_str(), full_path.c_str(), e.what());
-			rep = reply::stock_reply(reply::not_found);
-			return;
+			rep.shared_content = asset->raw;
+			if (bHaveLoadedgzip)
+				_log.Debug(DEBUG_WEBSERVER, "[web:%s] decompressed content from %s before sending.", request_path.c_str(), full_path.c_str());
 		}
 		rep.status = reply::ok;
 
@@ -437,6 +405,13 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 		  return;
 	  }
 
+	  if ((if_none_match != nullptr) && (strcmp(if_none_match, szAppVersion.c_str()) == 0))
+	  {
+		  //nothing changed
+		  rep = reply::stock_reply(reply::not_modified);
+		  return;
+	  }
+
 	  //remove first /
 	  request_path=request_path.substr(1);
 	  if (bClientHasGZipSupport)
@@ -493,7 +468,7 @@ void request_handler::handle_request(const request &req, reply &rep, modify_info
 	}
 
 	reply::add_header_content_type(&rep, mime_types::extension_to_type(extension));
-	reply::add_header(&rep, "Content-Length", std::to_string(rep.content.size()));
+	reply::add_header(&rep, "Content-Length", std::to_string(rep.content_size()));
 	reply::add_header(&rep, "Access-Control-Allow-Origin", "*");
 	if (myWebem->m_settings.is_secure())
 		reply::add_security_headers(&rep);
@@ -13,6 +13,7 @@
 
 #include <string>
 #include "../main/Noncopyable.h"
+#include "asset_cache.hpp"
 #ifndef WEBSERVER_DONT_USE_ZIP
 	#include <minizip/unzip.h>
 #endif
@@ -64,6 +65,8 @@ protected:
 
 private:
 	bool not_modified(const std::string &full_path, const request &req, reply &rep, modify_info &mInfo);
+	// static files of the web root
+	asset_cache assets_;
 	//zip support
 #ifndef WEBSERVER_DONT_USE_ZIP
 	  zlib_filefunc_def m_ffunc;
@@ -1,7 +1,6 @@
-define(['app'], function (app) {
-	app.controller('LogController', ['$scope', '$rootScope', '$location', '$http', '$interval', '$sce', function ($scope, $rootScope, $location, $http, $interval, $sce) {
+define(['app', 'livesocket'], function (app) {
+	app.controller('LogController', ['$scope', '$rootScope', '$location', '$http', '$interval', '$sce', 'livesocket', function ($scope, $rootScope, $location, $http, $interval, $sce, livesocket) {
 
-		$scope.LastLogTime = 0;
 		$scope.logitems = [];
 		$scope.logitems_status = [];
 		$scope.logitems_error = [];
@@ -12,122 +11,97 @@ define(['app'], function (app) {
 		var LOG_DEBUG = 0x0000008;
 		var LOG_ALL = 0xFFFFFFF;
 
+		// Loads the kept lines once, new lines are pushed over the websocket after the returned sequence number
 		$scope.RefreshLog = function () {
-			if (typeof $scope.mytimer != 'undefined') {
-				$interval.cancel($scope.mytimer);
-				$scope.mytimer = undefined;
-			}
-
-			var bWasAtBottom = true;
-			var div = $("#logcontent #logdata");
-			if (div != null) {
-				if (div[0] != null) {
-					var diff = Math.abs((div[0].scrollHeight - div.scrollTop()) - div.height());
-					if (diff > 9) {
-						bWasAtBottom = false;
-					}
-				}
-			}
-			var lastscrolltop = $("#logcontent #logdata").scrollTop();
-			var llogtime = $scope.LastLogTime;
 			$http({
-			    url: "json.htm?type=command&param=getlog&lastlogtime=" + $scope.LastLogTime + "&loglevel=" + LOG_ALL,
+			    url: "json.htm?type=command&param=getlog&lastseq=0&loglevel=" + LOG_ALL,
 				async: false,
 				dataType: 'json'
 			}).then(function successCallback(response) {
 				var data = response.data;
 				if (typeof data.result != 'undefined') {
-					if (typeof data.LastLogTime != 'undefined') {
-						$scope.LastLogTime = parseInt(data.LastLogTime);
-					}
-					$.each(data.result, function (i, item) {
-					    var message = item.message.replace(/\n/gi, "<br>");
-					    var lines = message.split("<br>")
-					    if (lines.length < 1) return;
-					    var fline = lines[0].split(" ")
-					    if (fline.length < 3) return;
+					AddLogItems(data.result);
+				}
+				livesocket.subscribeLog(LOG_ALL, (typeof data.LastSeq != 'undefined') ? data.LastSeq : 0);
+			}, function errorCallback(response) {
+				livesocket.subscribeLog(LOG_ALL, 0);
+			});
+		}
+
+		function AddLogItems(result) {
+			$.each(result, function (i, item) {
+			    var message = item.message.replace(/\n/gi, "<br>");
+			    var lines = message.split("<br>")
+			    if (lines.length < 1) return;
+			    var fline = lines[0].split(" ")
+			    if (fline.length < 3) return;
 
-					    var sdate = fline[0];
-					    var stime = fline[1];
+			    var sdate = fline[0];
+			    var stime = fline[1];
 
-					    for (i = 0; i < lines.length; i++) {
-					        var lmessage = "";
-					        if (i == 0) {
-					            lmessage = lines[i];
-					        }
-					        else {
-					            lmessage = sdate + " " + stime + " " + lines[i];
-					        }
-					        var logclass = "";
-					        logclass = getLogClass(item.level);
-					        $scope.logitems = $scope.logitems.concat({
-					            mclass: logclass,
-					            text: lmessage
-					        });
-					        if ($scope.logitems.length >= 300)
-					            $scope.logitems.splice(0, ($scope.logitems.length - 300));
-					        if (item.level == LOG_ERROR) {
-					            //Error
-					            $scope.logitems_error = $scope.logitems_error.concat({
-					                mclass: logclass,
-					                text: lmessage
-					            });
-					            if ($scope.logitems_error.length >= 300)
-					                $scope.logitems_error.splice(0, ($scope.logitems_error.length - 300));
+			    for (i = 0; i < lines.length; i++) {
+			        var lmessage = "";
+			        if (i == 0) {
+			            lmessage = lines[i];
+			        }
+			        else {
+			            lmessage = sdate + " " + stime + " " + lines[i];
+			        }
+			        var logclass = "";
+			        logclass = getLogClass(item.level);
+			        $scope.logitems = $scope.logitems.concat({
+			            mclass: logclass,
+			            text: lmessage
+			        });
+			        if ($scope.logitems.length >= 300)
+			            $scope.logitems.splice(0, ($scope.logitems.length - 300));
+			        if (item.level == LOG_ERROR) {
+			            //Error
+			            $scope.logitems_error = $scope.logitems_error.concat({
+			                mclass: logclass,
+			                text: lmessage
+			            });
+			            if ($scope.logitems_error.length >= 300)
+			                $scope.logitems_error.splice(0, ($scope.logitems_error.length - 300));
                             }
-					        else if (item.level == LOG_STATUS) {
-					            //Status
-					            $scope.logitems_status = $scope.logitems_status.concat({
-					                mclass: logclass,
-					                text: lmessage
-					            });
-					            if ($scope.logitems_status.length >= 300)
-					                $scope.logitems_status.splice(0, ($scope.logitems_status.length - 300));
+			        else if (item.level == LOG_STATUS) {
+			            //Status
+			            $scope.logitems_status = $scope.logitems_status.concat({
+			                mclass: logclass,
+			                text: lmessage
+			            });
+			            if ($scope.logitems_status.length >= 300)
+			                $scope.logitems_status.splice(0, ($scope.logitems_status.length - 300));
                             }
-					        else if (item.level == LOG_DEBUG) {
-					            //Debug
-					            $scope.logitems_debug = $scope.logitems_debug.concat({
-					                mclass: logclass,
-					                text: lmessage
-					            });
-					            if ($scope.logitems_debug.length >= 300)
-					                $scope.logitems_debug.splice(0, ($scope.logitems_debug.length - 300));
+			        else if (item.level == LOG_DEBUG) {
+			            //Debug
+			            $scope.logitems_debug = $scope.logitems_debug.concat({
+			                mclass: logclass,
+			                text: lmessage
+			            });
+			            if ($scope.logitems_debug.length >= 300)
+			                $scope.logitems_debug.splice(0, ($scope.logitems_debug.length - 300));
                             }
                         }
-					});
-				}
-				$scope.mytimer = $interval(function () {
-					$scope.RefreshLog();
-				}, 5000);
-			}, function errorCallback(response) {
-				$scope.mytimer = $interval(function () {
-					$scope.RefreshLog();
-				}, 5000);
 			});
 		}
 
-		$scope.ClearLog = function () {
-			if (typeof $scope.mytimer != 'undefined') {
-				$interval.cancel($scope.mytimer);
-				$scope.mytimer = undefined;
+		$scope.$on('log_update', function (event, data) {
+			if (typeof data.result != 'undefined') {
+				AddLogItems(data.result);
 			}
+		});
+
+		$scope.ClearLog = function () {
 			$http({
 				url: "json.htm?type=command&param=clearlog",
 				async: false,
 				dataType: 'json'
 			}).then(function successCallback(response) {
-				var data = response.data;
 				$scope.logitems = [];
 				$scope.logitems_error = [];
 				$scope.logitems_status = [];
 				$scope.logitems_debug = [];
-				$scope.mytimer = $interval(function () {
-					$scope.RefreshLog();
-				}, 5000);
-			}, function errorCallback(response) {
-				$scope.mytimer = $interval(function () {
-					$scope.RefreshLog();
-				}, 5000);
 			});
 		}
 
@@ -143,7 +117,6 @@ define(['app'], function (app) {
 
 		function init() {
 			$("#logcontent").i18n();
-			$scope.LastLogTime = 0;
 			$scope.RefreshLog();
 			$(window).resize(function () { $scope.ResizeLogWindow(); });
 			$scope.ResizeLogWindow();
@@ -164,10 +137,7 @@ define(['app'], function (app) {
 		}
 
 		$scope.$on('$destroy', function () {
-			if (typeof $scope.mytimer != 'undefined') {
-				$interval.cancel($scope.mytimer);
-				$scope.mytimer = undefined;
-			}
+			livesocket.unsubscribeLog();
 			$(window).off("resize");
 		});
 
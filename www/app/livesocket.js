@@ -15,11 +15,14 @@ define(['app.notifications', 'angular-websocket'], function (appNotificationsMod
 			});
 		With this, periodic ajax requests are not neccesary anymore. As the moment there is a device update, the new information gets broadcasted
 		immediately.		
+		New log lines are pushed in the same way after subscribeLog(loglevel, lastseq), as a 'log_update' broadcast with the
+		same result as the getlog command.
 	*/
 	module.service('livesocket', function ($websocket, $http, $rootScope, $q, $location, notifyBrowser) {
 		var webSocket;
 		var requestsCount = 0;
 		var requestsQueue = [];
+		var logSubscription;
 
 		init();
 
@@ -29,6 +32,8 @@ define(['app.notifications', 'angular-websocket'], function (appNotificationsMod
 			 */
 			getJson: getJson,
 			sendRequest: sendRequest,
+			subscribeLog: subscribeLog,
+			unsubscribeLog: unsubscribeLog,
 		};
 
 		function init() {
@@ -45,6 +50,12 @@ define(['app.notifications', 'angular-websocket'], function (appNotificationsMod
 			});
 
 			webSocket.$on('$message', handleMessage)
+			webSocket.$on('$open', function () {
+				// a new connection has no subscription, continue after the last line received
+				if (logSubscription) {
+					webSocket.$$send(logSubscription);
+				}
+			});
 		}
 
 		function handleMessage(msg) {
@@ -59,6 +70,15 @@ define(['app.notifications', 'angular-websocket'], function (appNotificationsMod
 				case "date_time":
 					handleTimeUpdate(msg);
 					return;
+				case "log":
+					if (logSubscription) {
+						logSubscription.lastseq = msg.LastSeq;
+					}
+					$rootScope.$broadcast('log_update', msg);
+					if (!$rootScope.$$phase) {
+						$rootScope.$digest();
+					}
+					return;
 			}
 
 			if (msg.requestid >= 0) {
@@ -134,6 +154,20 @@ define(['app.notifications', 'angular-websocket'], function (appNotificationsMod
 			}
 		}
 
+		function subscribeLog(loglevel, lastseq) {
+			logSubscription = {
+				event: "log_subscribe",
+				loglevel: loglevel,
+				lastseq: lastseq
+			};
+			webSocket.$$send(logSubscription);
+		}
+
+		function unsubscribeLog() {
+			logSubscription = undefined;
+			webSocket.$$send({ event: "log_unsubscribe" });
+		}
+
 		function sendRequest(url) {
 			return $q(function (resolve, reject) {
 				var requestId = ++requestsCount;